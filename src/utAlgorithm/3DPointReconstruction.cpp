@@ -31,10 +31,15 @@
 
 #include "3DPointReconstruction.h"
 
+#include <limits>
+
 #include <utUtil/Logging.h>
 #include <utUtil/Exception.h>
-#include <utMath/Graph/Munkres.h>
+#include <utMath/Graph/LinearAssignment.h>
+#include <utAlgorithm/EpipolarGrid.h>
 #include <utMath/Optimization/LevenbergMarquardt.h>
+#include <utMath/Cholesky.h>
+#include <utUtil/ThreadPool.h>
 #include <utAlgorithm/Function/SinglePointMultiProjection.h>
 
 namespace ublas = boost::numeric::ublas;
@@ -226,32 +231,59 @@ Math::Vector< double, 3 > get3DPositionWithResidual( const std::vector< Math::Ma
 }
 
 
-/** internal of reconstruct3DPoints function */
-template< typename T >
-std::vector< Math::Vector< T, 3 > > reconstruct3DPointsImpl( const std::vector< Math::Vector< T, 2 > > & p1, const std::vector< Math::Vector< T, 2 > > & p2,
-																			const Math::Matrix< T, 3, 4 > & P1, const Math::Matrix< T, 3, 4 > & P2, const Math::Matrix< T, 3, 3 > & fM )
+/**
+ * internal of reconstruct3DPoints function
+ * matches the points with minimal total epipolar distance, pairs further apart than maxDistance are never matched
+ */
+template< typename T, class PointList, class ResultList >
+void reconstruct3DPointsImpl( const PointList & p1, const PointList & p2,
+	const Math::Matrix< T, 3, 4 > & P1, const Math::Matrix< T, 3, 4 > & P2, const Math::Matrix< T, 3, 3 > & fM, ResultList & list,
+	const T maxDistance = std::numeric_limits< T >::max() )
 {
 	
 	const std::size_t p1Size = p1.size();
 	const std::size_t p2Size = p2.size();
+	std::vector< std::size_t > matchList;
 
-	//create match matrix
-	Math::Matrix< T, 0, 0 > matrix( p1Size, p2Size );
-
-	for( std::size_t row( 0 ); row < p1Size; ++row )
+	if ( maxDistance == std::numeric_limits< T >::max() )
 	{
-		for( std::size_t col( 0 ); col < p2Size; ++col )
+		//create match matrix
+		Math::Matrix< T, 0, 0 > matrix( p1Size, p2Size );
+
+		for( std::size_t row( 0 ); row < p1Size; ++row )
 		{
-			matrix( row, col ) = pointToPointDist( p1.at( row ), p2.at( col ), fM );
+			for( std::size_t col( 0 ); col < p2Size; ++col )
+			{
+				matrix( row, col ) = pointToPointDist( p1.at( row ), p2.at( col ), fM );
+			}
 		}
-	}
 
-	Math::Graph::Munkres< T > m( matrix );
-	m.solve();
-	std::vector< std::size_t > matchList = m.getRowMatchList();
+		Math::Graph::solveAssignment( matrix, matchList );
+	}
+	else
+	{
+		// only the points of the second image close to the epipolar line are considered,
+		// pointToPointDist returns squared distances
+		const T maxSquaredDistance = maxDistance * maxDistance;
+		const EpipolarGrid< T > grid( p2, maxDistance );
+		std::vector< std::size_t > candidates;
+		Math::Graph::SparseCostGraph< T > graph( p1Size, p2Size );
+		for( std::size_t row( 0 ); row < p1Size; ++row )
+		{
+			const Math::Vector< T, 2 > x( p1.at( row ) );
+			grid.candidates( ublas::prod( fM, Math::Vector< T, 3 >( x( 0 ), x( 1 ), 1 ) ), candidates );
+			for( std::size_t k( 0 ); k < candidates.size(); ++k )
+			{
+				const T d = pointToPointDist( x, p2.at( candidates[ k ] ), fM );
+				if ( d <= maxSquaredDistance )
+					graph.addEdge( row, candidates[ k ], d );
+			}
+		}
 
-	std::vector< Math::Vector< T, 3 > > list;
+		Math::Graph::solveAssignment( graph, matchList );
+	}
 
+	list.reserve( p1Size );
 	for( std::size_t i( 0 ); i < p1Size; ++i )
 	{
 		if( matchList.at( i ) < p2Size )
@@ -259,22 +291,260 @@ std::vector< Math::Vector< T, 3 > > reconstruct3DPointsImpl( const std::vector<
 			list.push_back( get3DPosition( P1, P2, p1.at( i ), p2.at( matchList.at( i ) ) ) );
 		}
 	}
+}
+
+std::vector< Math::Vector< float, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< float, 2 > > & p1, const std::vector< Math::Vector< float, 2 > > & p2,
+																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM )
+{
+	std::vector< Math::Vector< float, 3 > > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list );
+	return list;
+}
 
+std::vector< Math::Vector< double, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > > & p1, const std::vector< Math::Vector< double, 2 > > & p2,
+																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM )
+{
+	std::vector< Math::Vector< double, 3 > > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list );
 	return list;
 }
 
 std::vector< Math::Vector< float, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< float, 2 > > & p1, const std::vector< Math::Vector< float, 2 > > & p2,
-																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM )
+																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM, float maxDistance )
 {
-	return reconstruct3DPointsImpl( p1, p2, P1, P2, fM );
+	std::vector< Math::Vector< float, 3 > > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list, maxDistance );
+	return list;
 }
 
 std::vector< Math::Vector< double, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > > & p1, const std::vector< Math::Vector< double, 2 > > & p2,
+																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM, double maxDistance )
+{
+	std::vector< Math::Vector< double, 3 > > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list, maxDistance );
+	return list;
+}
+
+Math::VectorList< float, 3 > reconstruct3DPoints( Math::VectorListView< float, 2 > p1, Math::VectorListView< float, 2 > p2,
+																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM )
+{
+	Math::VectorList< float, 3 > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list );
+	return list;
+}
+
+Math::VectorList< double, 3 > reconstruct3DPoints( Math::VectorListView< double, 2 > p1, Math::VectorListView< double, 2 > p2,
 																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM )
 {
-	return reconstruct3DPointsImpl( p1, p2, P1, P2, fM );
+	Math::VectorList< double, 3 > list;
+	reconstruct3DPointsImpl( p1, p2, P1, P2, fM, list );
+	return list;
 }
 
 #endif // HAVE_LAPACK
 
+namespace {
+
+/** triangulates chunks of points for \c triangulatePoints */
+class TriangulationBatch
+{
+public:
+	TriangulationBatch( const std::vector< Math::Matrix< double, 3, 4 > >& cameras,
+		const std::vector< Math::Vector< double, 2 > >& observations, const std::vector< unsigned char >& visibility,
+		std::vector< TriangulatedPoint >& result, const TriangulationOptions& options, const std::size_t chunkSize )
+		: m_cameras( cameras )
+		, m_observations( observations )
+		, m_visibility( visibility )
+		, m_result( result )
+		, m_options( options )
+		, m_chunkSize( chunkSize )
+	{}
+
+	void operator()( const std::size_t chunk )
+	{
+		const std::size_t i1 = std::min( ( chunk + 1 ) * m_chunkSize, m_result.size() );
+		for ( std::size_t i = chunk * m_chunkSize; i < i1; i++ )
+			triangulate( i, m_result[ i ] );
+	}
+
+protected:
+	void triangulate( const std::size_t i, TriangulatedPoint& result ) const
+	{
+		const std::size_t nCameras = m_cameras.size();
+		const unsigned char* pVisible = &m_visibility[ i * nCameras ];
+		const Math::Vector< double, 2 >* pObservations = &m_observations[ i * nCameras ];
+
+		result.position = Math::Vector< double, 3 >( 0, 0, 0 );
+		result.covariance = Math::Matrix< double, 3, 3 >::zeros();
+		result.residual = 0;
+		result.nViews = 0;
+		result.valid = false;
+
+		// normal equations A^T A of the DLT with the homogeneous coordinate fixed to 1
+		Math::Matrix< double, 4, 4 > ata( Math::Matrix< double, 4, 4 >::zeros() );
+		for ( std::size_t c = 0; c < nCameras; c++ )
+		{
+			if ( !pVisible[ c ] )
+				continue;
+			result.nViews++;
+
+			const Math::Matrix< double, 3, 4 >& P( m_cameras[ c ] );
+			for ( std::size_t k = 0; k < 2; k++ )
+			{
+				double a[ 4 ];
+				for ( std::size_t col = 0; col < 4; col++ )
+					a[ col ] = pObservations[ c ]( k ) * P( 2, col ) - P( k, col );
+				for ( std::size_t row = 0; row < 4; row++ )
+					for ( std::size_t col = 0; col <= row; col++ )
+						ata( row, col ) += a[ row ] * a[ col ];
+			}
+		}
+		if ( result.nViews < 2 )
+			return;
+
+		Math::Matrix< double, 3, 3 > l;
+		Math::Vector< double, 3 > x;
+		for ( std::size_t row = 0; row < 3; row++ )
+		{
+			x( row ) = -ata( 3, row );
+			for ( std::size_t col = 0; col <= row; col++ )
+				l( row, col ) = ata( row, col );
+		}
+		if ( !Math::cholesky_factor( l ) )
+			return;
+		Math::cholesky_solve( l, x );
+
+		// Levenberg-Marquardt on the reprojection error
+		Math::Matrix< double, 3, 3 > jtj;
+		Math::Vector< double, 3 > jtr;
+		double cost = reprojection( pVisible, pObservations, x, &jtj, &jtr );
+		double lambda = 1e-3;
+		for ( std::size_t iteration = 0; iteration < m_options.nMaxIterations && lambda < 1e10; )
+		{
+			Math::Vector< double, 3 > step( -jtr );
+			for ( std::size_t row = 0; row < 3; row++ )
+				for ( std::size_t col = 0; col <= row; col++ )
+					l( row, col ) = jtj( row, col ) * ( row == col ? 1 + lambda : 1 );
+			if ( !Math::cholesky_factor( l ) )
+			{
+				lambda *= 10;
+				continue;
+			}
+			Math::cholesky_solve( l, step );
+
+			const Math::Vector< double, 3 > xNew( x + step );
+			const double newCost = reprojection( pVisible, pObservations, xNew, 0, 0 );
+			if ( newCost < cost )
+			{
+				x = xNew;
+				lambda *= 0.1;
+				iteration++;
+				cost = reprojection( pVisible, pObservations, x, &jtj, &jtr );
+				if ( ublas::norm_2( step ) <= 1e-10 * ( 1 + ublas::norm_2( x ) ) )
+					break;
+			}
+			else if ( newCost - cost <= 1e-15 * cost )
+				break; // no decrease beyond machine precision, converged
+			else
+				lambda *= 10;
+		}
+
+		// covariance from the Jacobian at the solution
+		if ( m_options.nMaxIterations == 0 )
+			cost = reprojection( pVisible, pObservations, x, &jtj, &jtr );
+		for ( std::size_t row = 0; row < 3; row++ )
+			for ( std::size_t col = 0; col <= row; col++ )
+				l( row, col ) = jtj( row, col );
+		if ( !Math::cholesky_factor( l ) )
+			return;
+		Math::cholesky_invert( l, result.covariance );
+		result.covariance *= m_options.imageNoise * m_options.imageNoise;
+
+		result.position = x;
+		result.residual = std::sqrt( cost / result.nViews );
+		result.valid = true;
+	}
+
+	/**
+	 * sum of squared reprojection errors of a point, and optionally the lower triangle of
+	 * J^T J and J^T r of its Jacobian
+	 */
+	double reprojection( const unsigned char* pVisible, const Math::Vector< double, 2 >* pObservations,
+		const Math::Vector< double, 3 >& x, Math::Matrix< double, 3, 3 >* pJtJ, Math::Vector< double, 3 >* pJtr ) const
+	{
+		if ( pJtJ )
+		{
+			*pJtJ = Math::Matrix< double, 3, 3 >::zeros();
+			*pJtr = Math::Vector< double, 3 >( 0, 0, 0 );
+		}
+
+		double cost = 0;
+		for ( std::size_t c = 0; c < m_cameras.size(); c++ )
+		{
+			if ( !pVisible[ c ] )
+				continue;
+
+			const Math::Matrix< double, 3, 4 >& P( m_cameras[ c ] );
+			double p[ 3 ];
+			for ( std::size_t row = 0; row < 3; row++ )
+				p[ row ] = P( row, 0 ) * x( 0 ) + P( row, 1 ) * x( 1 ) + P( row, 2 ) * x( 2 ) + P( row, 3 );
+			const double w = 1 / p[ 2 ];
+
+			for ( std::size_t k = 0; k < 2; k++ )
+			{
+				const double u = p[ k ] * w;
+				const double r = u - pObservations[ c ]( k );
+				cost += r * r;
+				if ( !pJtJ )
+					continue;
+
+				// derivative of the projected coordinate u = p_k / p_2
+				double j[ 3 ];
+				for ( std::size_t col = 0; col < 3; col++ )
+					j[ col ] = ( P( k, col ) - u * P( 2, col ) ) * w;
+				for ( std::size_t row = 0; row < 3; row++ )
+				{
+					( *pJtr )( row ) += j[ row ] * r;
+					for ( std::size_t col = 0; col <= row; col++ )
+						( *pJtJ )( row, col ) += j[ row ] * j[ col ];
+				}
+			}
+		}
+		return cost;
+	}
+
+	const std::vector< Math::Matrix< double, 3, 4 > >& m_cameras;
+	const std::vector< Math::Vector< double, 2 > >& m_observations;
+	const std::vector< unsigned char >& m_visibility;
+	std::vector< TriangulatedPoint >& m_result;
+	const TriangulationOptions& m_options;
+	const std::size_t m_chunkSize;
+};
+
+} // anonymous namespace
+
+void triangulatePoints( const std::vector< Math::Matrix< double, 3, 4 > >& cameras,
+	const std::vector< Math::Vector< double, 2 > >& observations, const std::vector< unsigned char >& visibility,
+	std::vector< TriangulatedPoint >& result, const TriangulationOptions& options )
+{
+	if ( observations.size() != visibility.size() )
+		UBITRACK_THROW( "triangulatePoints needs a visibility flag for every observation" );
+	if ( cameras.empty() ? !observations.empty() : observations.size() % cameras.size() != 0 )
+		UBITRACK_THROW( "triangulatePoints needs one observation per point and camera" );
+
+	const std::size_t nPoints = cameras.empty() ? 0 : observations.size() / cameras.size();
+	result.resize( nPoints );
+	if ( nPoints == 0 )
+		return;
+
+	// a few chunks per thread for load balancing
+	const std::size_t nChunks = options.pThreadPool ? std::min( nPoints, 4 * options.pThreadPool->size() ) : 1;
+	const std::size_t chunkSize = ( nPoints + nChunks - 1 ) / nChunks;
+	TriangulationBatch batch( cameras, observations, visibility, result, options, chunkSize );
+	if ( options.pThreadPool )
+		options.pThreadPool->parallelFor( ( nPoints + chunkSize - 1 ) / chunkSize, batch );
+	else
+		batch( 0 );
+}
+
 } } // namespace Ubitrack::Algorithm
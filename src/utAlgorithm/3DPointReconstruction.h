@@ -37,6 +37,11 @@
 #include <utCore.h>
 #include <utMath/Vector.h>
 #include <utMath/Matrix.h>
+#include <utMath/VectorList.h>
+
+namespace Ubitrack { namespace Util {
+	class ThreadPool;
+} } // namespace Ubitrack::Util
 
 namespace Ubitrack { namespace Algorithm {
 
@@ -102,6 +107,41 @@ UBITRACK_EXPORT std::vector< Math::Vector< float, 3 > > reconstruct3DPoints( con
 UBITRACK_EXPORT std::vector< Math::Vector< double, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > > & p1, const std::vector< Math::Vector< double, 2 > > & p2,
 																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM );
 
+/**
+ * @ingroup tracking_algorithms
+ * Reconstructs 3D points from two sets of 2D points, considering only pairs of points
+ * whose epipolar distance does not exceed \c maxDistance.
+ *
+ * Unlike the overload without threshold, the candidates near each epipolar line are
+ * looked up in an \c EpipolarGrid, and the matching runs on a sparse graph of these pairs.
+ * This avoids the n x m distance evaluations and is much faster for large numbers of
+ * points. Points without an admissible partner are not reconstructed.
+ *
+ * Note: also exists with \c double parameters.
+ * @see reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > >&, const std::vector< Math::Vector< double, 2 > >&, const Math::Matrix< double, 3, 4 >&, const Math::Matrix< double, 3, 4 >&, const Math::Matrix< double, 3, 3 >& )
+ * @param maxDistance gating threshold for the distance of a point to the epipolar line of its partner, in pixels
+ */
+UBITRACK_EXPORT std::vector< Math::Vector< float, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< float, 2 > > & p1, const std::vector< Math::Vector< float, 2 > > & p2,
+																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM, float maxDistance );
+
+UBITRACK_EXPORT std::vector< Math::Vector< double, 3 > > reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > > & p1, const std::vector< Math::Vector< double, 2 > > & p2,
+																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM, double maxDistance );
+
+/**
+ * @ingroup tracking_algorithms
+ * Reconstructs 3D points from two sets of 2D points in contiguous storage, e.g. from
+ * \c Measurement::PackedPositionList2, without copying the input.
+ *
+ * Note: also exists with \c double parameters.
+ * @see reconstruct3DPoints( const std::vector< Math::Vector< double, 2 > >&, const std::vector< Math::Vector< double, 2 > >&, const Math::Matrix< double, 3, 4 >&, const Math::Matrix< double, 3, 4 >&, const Math::Matrix< double, 3, 3 >& )
+ * @return the 3D points in contiguous storage
+ */
+UBITRACK_EXPORT Math::VectorList< float, 3 > reconstruct3DPoints( Math::VectorListView< float, 2 > p1, Math::VectorListView< float, 2 > p2,
+																			const Math::Matrix< float, 3, 4 > & P1, const Math::Matrix< float, 3, 4 > & P2, const Math::Matrix< float, 3, 3 > & fM );
+
+UBITRACK_EXPORT Math::VectorList< double, 3 > reconstruct3DPoints( Math::VectorListView< double, 2 > p1, Math::VectorListView< double, 2 > p2,
+																			const Math::Matrix< double, 3, 4 > & P1, const Math::Matrix< double, 3, 4 > & P2, const Math::Matrix< double, 3, 3 > & fM );
+
 
 /**
  * @ingroup tracking_algorithms
@@ -125,6 +165,70 @@ UBITRACK_EXPORT Math::Vector< double, 3 > get3DPosition( const std::vector< Math
 UBITRACK_EXPORT Math::Vector< double, 3 > get3DPositionWithResidual( const std::vector< Math::Matrix< double, 3, 4 > > &P, const std::vector< Math::Vector< double, 2 > >& points, std::size_t flag = 0, double* residual = 0 );
 #endif
 
+/**
+ * Settings of \c triangulatePoints
+ */
+struct TriangulationOptions
+{
+	TriangulationOptions()
+		: nMaxIterations( 10 )
+		, imageNoise( 1.0 )
+		, pThreadPool( 0 )
+	{}
+
+	/** maximal number of Levenberg-Marquardt iterations per point, 0 returns the linear solution */
+	std::size_t nMaxIterations;
+
+	/** standard deviation of the image measurements in pixels, scales the covariances */
+	double imageNoise;
+
+	/** thread pool that triangulates the points in parallel, 0 uses the calling thread */
+	Ubitrack::Util::ThreadPool* pThreadPool;
+};
+
+/**
+ * Result of \c triangulatePoints for a single point
+ */
+struct TriangulatedPoint
+{
+	/** 3D position */
+	Math::Vector< double, 3 > position;
+
+	/** covariance of the position, from the image noise propagated through the reprojection Jacobian */
+	Math::Matrix< double, 3, 3 > covariance;
+
+	/** root mean square reprojection error in pixels */
+	double residual;
+
+	/** number of cameras that observed the point */
+	std::size_t nViews;
+
+	/** false if the point was seen by less than two cameras or its geometry is degenerate */
+	bool valid;
+};
+
+/**
+ * @ingroup tracking_algorithms
+ * Triangulates many points that are observed by a subset of a common set of cameras.
+ *
+ * Each point is first estimated linearly: the inhomogeneous 4x4 normal equations of the DLT
+ * are reduced to a 3x3 system and solved in closed form. The reprojection error is then
+ * minimized with Levenberg-Marquardt on the fixed-size 3x3 normal equations, so no
+ * memory is allocated per point. Points are processed in chunks, optionally in parallel.
+ *
+ * The result is the same as \c get3DPosition with non-linear refinement on the visible
+ * cameras of each point, up to the convergence tolerance.
+ *
+ * @param cameras the 3x4 projection matrices of all n cameras
+ * @param observations image points, n per 3D point: element \c i * n + \c c is the observation of point i in camera c
+ * @param visibility same layout as \c observations, non-zero if the point was observed by the camera
+ * @param result receives one entry per point
+ * @param options number of iterations, image noise and thread pool
+ */
+UBITRACK_EXPORT void triangulatePoints( const std::vector< Math::Matrix< double, 3, 4 > >& cameras,
+	const std::vector< Math::Vector< double, 2 > >& observations, const std::vector< unsigned char >& visibility,
+	std::vector< TriangulatedPoint >& result, const TriangulationOptions& options = TriangulationOptions() );
+
 } } // namespace Ubitrack::Algorithm
 
 #endif
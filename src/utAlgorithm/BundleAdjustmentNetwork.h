@@ -0,0 +1,132 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking_algorithms
+ * @file
+ * Description of a bundle adjustment network (cameras, images, free points and rigid bodies).
+ */
+
+#ifndef __UBITRACK_ALGORITHM_BUNDLEADJUSTMENTNETWORK_H_INCLUDED__
+#define __UBITRACK_ALGORITHM_BUNDLEADJUSTMENTNETWORK_H_INCLUDED__
+
+#include <vector>
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Pose.h>
+
+namespace Ubitrack { namespace Algorithm {
+
+/**
+ * @ingroup tracking_algorithms
+ * Input and output of a bundle adjustment.
+ *
+ * The network consists of
+ * - \c images: the extrinsic poses of all images (world to camera)
+ * - \c intrinsics and \c distortions: one entry per physical camera
+ * - \c points: free 3D points in world coordinates
+ * - \c bodies: rigid point sets in body coordinates, observed at the poses given in
+ *   \c bodyPoses. The first body pose defines the world coordinate system and is not optimized.
+ *
+ * Observations reference these entries by index. All parameters are updated in place
+ * by the bundle adjustment.
+ */
+template< class T >
+struct BundleAdjustmentNetwork
+{
+	typedef std::vector< Math::Vector< T, 3 > > PointsList;
+	typedef std::vector< Math::Pose > PoseList;
+	typedef std::vector< Math::Matrix< T, 3, 3 > > IntrinsicList;
+	typedef std::vector< Math::Vector< T, 4 > > DistortionList;
+
+	/** observation of a free 3D point in an image */
+	struct FreePointMeasurement
+	{
+		/** index into \c points */
+		std::size_t iPoint;
+
+		/** index into \c intrinsics and \c distortions */
+		std::size_t iCamera;
+
+		/** index into \c images */
+		std::size_t iImage;
+
+		/** observed 2D image position */
+		Math::Vector< T, 2 > measurement;
+	};
+
+	/** observation of a point that belongs to a rigid body */
+	struct BodyPointMeasurement
+	{
+		/** index into \c bodies */
+		std::size_t iBody;
+
+		/** index of the point within the body */
+		std::size_t iPoint;
+
+		/** index into \c bodyPoses */
+		std::size_t iBodyPose;
+
+		/** index into \c intrinsics and \c distortions */
+		std::size_t iCamera;
+
+		/** index into \c images */
+		std::size_t iImage;
+
+		/** observed 2D image position */
+		Math::Vector< T, 2 > measurement;
+	};
+
+	BundleAdjustmentNetwork()
+		: bEstimateIntrinsics( false )
+	{}
+
+	/** free 3D points */
+	PointsList points;
+
+	/** rigid bodies, each given as a list of points in body coordinates */
+	std::vector< PointsList > bodies;
+
+	/** poses of the bodies, the first one defines the world coordinate system */
+	PoseList bodyPoses;
+
+	/** extrinsic image poses */
+	PoseList images;
+
+	/** intrinsic camera matrices */
+	IntrinsicList intrinsics;
+
+	/** radial (k1, k2) and tangential (p1, p2) distortion coefficients */
+	DistortionList distortions;
+
+	/** also optimize the intrinsic camera parameters? */
+	bool bEstimateIntrinsics;
+
+	std::vector< FreePointMeasurement > freePointMeasurements;
+	std::vector< BodyPointMeasurement > bodyPointMeasurements;
+};
+
+} } // namespace Ubitrack::Algorithm
+
+#endif // __UBITRACK_ALGORITHM_BUNDLEADJUSTMENTNETWORK_H_INCLUDED__
@@ -33,10 +33,8 @@
 
 #include "Correction.h"
 #include "Distortion.h"
-
-#ifdef HAVE_LAPACK
 #include "Undistortion.h"
-#endif
+#include "UndistortionMap.h"
 
 namespace Ubitrack { namespace Algorithm { namespace CameraLens {
 
@@ -60,6 +58,26 @@ void distort( const Ubitrack::Math::CameraIntrinsics< double >& mat, const std::
 {
 	distort_impl( mat, undistorted, distorted );	
 }
+
+void undistort( const Ubitrack::Math::CameraIntrinsics< float >& mat, std::vector< Math::Vector2f >& points )
+{
+	undistort_impl( mat, points );
+}
+
+void undistort( const Ubitrack::Math::CameraIntrinsics< double >& mat, std::vector< Math::Vector2d >& points )
+{
+	undistort_impl( mat, points );
+}
+
+void undistort( const UndistortionMap< float >& map, std::vector< Math::Vector2f >& points )
+{
+	map.undistort( points );
+}
+
+void undistort( const UndistortionMap< double >& map, std::vector< Math::Vector2d >& points )
+{
+	map.undistort( points );
+}
  
 
 #ifdef HAVE_LAPACK
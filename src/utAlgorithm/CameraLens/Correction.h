@@ -95,6 +95,42 @@ UBITRACK_EXPORT void distort( const Math::CameraIntrinsics< float >& intrinsics,
  */
 UBITRACK_EXPORT void distort( const Math::CameraIntrinsics< double >& intrinsics, const std::vector< Math::Vector2d >& undistorted, std::vector< Math::Vector2d >& distorted );
 
+template< typename T > class UndistortionMap;
+
+/**
+ * remove lens distortion from a list of image points in place
+ *
+ * Inverts the distortion function of void distort( const Math::CameraIntrinsics< float >& intrinsics, const Math::Vector2f& undistorted, Math::Vector2f& distorted );
+ * with Newton iterations that are solved in closed form on the stack. Does not require lapack and does not allocate memory.
+ * When the points of every frame of a camera are undistorted, build an \c UndistortionMap once and use the overloads below.
+ *
+ * @param intrinsics camera intrinsics parameters including 3x3 intrinsic matrix and distortion parameters
+ * @param points distorted 2d image points on entry, undistorted points on exit
+ */
+UBITRACK_EXPORT void undistort( const Math::CameraIntrinsics< float >& intrinsics, std::vector< Math::Vector2f >& points );
+
+/** 
+ * @brief overloaded function \c undistort for lists of 2d points with double precision parameters.
+ *
+ * For further information on this algorithm see void undistort( const Math::CameraIntrinsics< float >& intrinsics, std::vector< Math::Vector2f >& points );
+ */
+UBITRACK_EXPORT void undistort( const Math::CameraIntrinsics< double >& intrinsics, std::vector< Math::Vector2d >& points );
+
+/**
+ * remove lens distortion from a list of image points in place, using a precomputed \c UndistortionMap
+ *
+ * @param map inverse distortion map of the camera (see UndistortionMap.h)
+ * @param points distorted 2d image points on entry, undistorted points on exit
+ */
+UBITRACK_EXPORT void undistort( const UndistortionMap< float >& map, std::vector< Math::Vector2f >& points );
+
+/** 
+ * @brief overloaded function \c undistort using an \c UndistortionMap with double precision parameters.
+ *
+ * For further information on this algorithm see void undistort( const UndistortionMap< float >& map, std::vector< Math::Vector2f >& points );
+ */
+UBITRACK_EXPORT void undistort( const UndistortionMap< double >& map, std::vector< Math::Vector2d >& points );
+
 
 #ifdef HAVE_LAPACK
 
@@ -33,8 +33,13 @@
 #ifndef __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTION_H_INCLUDED__
 #define __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTION_H_INCLUDED__
 
-#include "Distortion.h"
+#include <vector>
+#include <limits>
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
 #include <utMath/CameraIntrinsics.h>
+#include "Distortion.h"
 
 #ifdef HAVE_LAPACK
 #include <utMath/Optimization/LevenbergMarquardt.h>
@@ -195,8 +200,63 @@ public:
 		// J( 1, 1 ) = (k2*pow(x*x+y*y,2)+k3*pow(x*x+y*y,3)+k1*(x*x+y*y)+1)/(k5*pow(x*x+y*y,2)+k6*pow(x*x+y*y,3)+k4*(x*x+y*y)+1)+p2*x*2+p1*y*6+(y*(k1*y*2+k2*y*(x*x+y*y)*4+k3*y*pow(x*x+y*y,2)*6))/(k5*pow(x*x+y*y,2)+k6*pow(x*x+y*y,3)+k4*(x*x+y*y)+1)-y*(k4*y*2+k5*y*(x*x+y*y)*4+k6*y*pow(x*x+y*y,2)*6)*(k2*pow(x*x+y*y,2)+k3*pow(x*x+y*y,3)+k1*(x*x+y*y)+1)*1/pow(k5*pow(x*x+y*y,2)+k6*pow(x*x+y*y,3)+k4*(x*x+y*y)+1,2);
 	}
 };
+
+/**
+ * @internal Newton iterations on the distortion function to invert it for a single point.
+ *
+ * The 2x2 system is solved in closed form on the stack, thus no memory is allocated.
+ * Iterates until the update is smaller than \c epsilon or \c maxIterations is reached.
+ *
+ * @param distorted the distorted point in sensor coordinates
+ * @param undistorted initial estimate on entry, undistorted point in sensor coordinates on exit
+ */
+template< typename T >
+inline void undistort_newton_impl( const Math::Vector< T, 6 >& radVector, const Math::Vector< T, 2 >& tanVector, const Math::Vector< T, 2 >& distorted, Math::Vector< T, 2 >& undistorted, const std::size_t maxIterations, const T epsilon )
+{
+	const PointUndistortion< T > distFunc( radVector, tanVector );
+	Math::Vector< T, 2 > estimate;
+	Math::Matrix< T, 2, 2 > J;
+	for ( std::size_t i = 0; i < maxIterations; i++ )
+	{
+		distFunc.evaluateWithJacobian( estimate, undistorted, J );
+		const T ex = estimate( 0 ) - distorted( 0 );
+		const T ey = estimate( 1 ) - distorted( 1 );
+		const T det = J( 0, 0 ) * J( 1, 1 ) - J( 0, 1 ) * J( 1, 0 );
+		if ( det == T( 0 ) )
+			break;
+
+		const T dx = ( J( 1, 1 ) * ex - J( 0, 1 ) * ey ) / det;
+		const T dy = ( J( 0, 0 ) * ey - J( 1, 0 ) * ex ) / det;
+		undistorted( 0 ) -= dx;
+		undistorted( 1 ) -= dy;
+		if ( dx * dx + dy * dy <= epsilon * epsilon )
+			break;
+	}
+}
+
 }	// namespace ::internal
 
+/**
+ * undistorts a list of image points in place using Newton iterations started at the distorted points.
+ *
+ * Unlike the \c levenbergMarquardt based functions below this does not require lapack and does not
+ * allocate memory per point. For repeated calls with the same intrinsics use an \c UndistortionMap.
+ */
+template< typename T >
+void undistort_impl( const Math::CameraIntrinsics< T >& camIntrin, std::vector< Math::Vector< T, 2 > >& points )
+{
+	const T epsilon = 16 * std::numeric_limits< T >::epsilon();
+	typename std::vector< Math::Vector< T, 2 > >::iterator itEnd = points.end();
+	for ( typename std::vector< Math::Vector< T, 2 > >::iterator it = points.begin(); it != itEnd; ++it )
+	{
+		Math::Vector< T, 2 > camPoint;
+		internal::unproject_impl( camIntrin, *it, camPoint );
+		Math::Vector< T, 2 > undistorted( camPoint );
+		internal::undistort_newton_impl( camIntrin.radial_params, camIntrin.tangential_params, camPoint, undistorted, 20, epsilon );
+		internal::project_impl( camIntrin, undistorted, *it );
+	}
+}
+
 #ifdef HAVE_LAPACK
 
 template< typename T, std::size_t N >
@@ -205,7 +265,8 @@ void undistort_impl( const Math::Vector< T, 6 >& radVector, const Math::Vector<
 	// non-linear minimization
 	Math::Vector< T, N > tmp = ( distorted );
 	internal::PointUndistortion< T > distFunc( radVector, tanVector );
-	Math::Optimization::levenbergMarquardt( distFunc, tmp, distorted, Math::Optimization::OptTerminate( 5, 1e-5 ), Math::Optimization::OptNoNormalize() );
+	Math::Optimization::LMWorkspace< T, N, N > workspace;
+	Math::Optimization::levenbergMarquardt( distFunc, tmp, distorted, Math::Optimization::OptTerminate( 5, 1e-5 ), Math::Optimization::OptNoNormalize(), workspace );
 	undistorted = tmp;
 }
 
@@ -0,0 +1,227 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup calibration
+ * @file
+ * Precomputed inverse lens distortion map for fast undistortion of many image points.
+ */
+
+#ifndef __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
+#define __UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
+
+#include <cmath>
+#include <vector>
+#include <limits>
+
+#include <utUtil/Exception.h>
+#include "Undistortion.h"
+
+namespace Ubitrack { namespace Algorithm { namespace CameraLens {
+
+/**
+ * @ingroup calibration
+ * Inverse of the lens distortion of one camera, sampled on a regular grid over the image.
+ *
+ * The map is built once per \c CameraIntrinsics: every grid node stores the undistorted
+ * sensor coordinates of the corresponding distorted pixel. Undistorting a point then is a
+ * bilinear interpolation of the four surrounding nodes, optionally followed by a few Newton
+ * steps on the distortion function, which are solved in closed form on the stack.
+ * No memory is allocated after construction, and lapack is not required.
+ *
+ * The grid covers the image with a margin of one cell, points further outside are extrapolated
+ * from the border cells and rely on the Newton steps for their accuracy.
+ */
+template< typename T >
+class UndistortionMap
+{
+public:
+	/**
+	 * Builds the map for the image size stored in the intrinsics.
+	 *
+	 * @param intrinsics camera intrinsics, \c dimension must be set
+	 * @param cellSize distance of the grid nodes in pixels
+	 * @param refinementSteps number of Newton steps applied after the interpolation
+	 */
+	UndistortionMap( const Math::CameraIntrinsics< T >& intrinsics, const std::size_t cellSize = 8, const std::size_t refinementSteps = 1 )
+		: m_intrinsics( intrinsics )
+		, m_refinementSteps( refinementSteps )
+	{
+		build( intrinsics.dimension( 0 ), intrinsics.dimension( 1 ), cellSize );
+	}
+
+	/**
+	 * Builds the map for a given image size.
+	 *
+	 * @param intrinsics camera intrinsics
+	 * @param width image width in pixels
+	 * @param height image height in pixels
+	 * @param cellSize distance of the grid nodes in pixels
+	 * @param refinementSteps number of Newton steps applied after the interpolation
+	 */
+	UndistortionMap( const Math::CameraIntrinsics< T >& intrinsics, const std::size_t width, const std::size_t height,
+		const std::size_t cellSize, const std::size_t refinementSteps = 1 )
+		: m_intrinsics( intrinsics )
+		, m_refinementSteps( refinementSteps )
+	{
+		build( width, height, cellSize );
+	}
+
+	/** the intrinsics the map was built for */
+	const Math::CameraIntrinsics< T >& intrinsics() const
+	{ return m_intrinsics; }
+
+	/** number of Newton steps applied after the interpolation */
+	std::size_t refinementSteps() const
+	{ return m_refinementSteps; }
+
+	/** sets the number of Newton steps applied after the interpolation */
+	void setRefinementSteps( const std::size_t steps )
+	{ m_refinementSteps = steps; }
+
+	/**
+	 * removes the lens distortion from a point given in image coordinates (pixels)
+	 *
+	 * @param distorted distorted 2d image point
+	 * @param undistorted undistorted point in image coordinates
+	 */
+	void undistort( const Math::Vector< T, 2 >& distorted, Math::Vector< T, 2 >& undistorted ) const
+	{
+		Math::Vector< T, 2 > camPoint;
+		undistortSensor( distorted, camPoint );
+		internal::project_impl( m_intrinsics, camPoint, undistorted );
+	}
+
+	/** removes the lens distortion from a list of image points in place */
+	void undistort( std::vector< Math::Vector< T, 2 > >& points ) const
+	{
+		typename std::vector< Math::Vector< T, 2 > >::iterator itEnd = points.end();
+		for ( typename std::vector< Math::Vector< T, 2 > >::iterator it = points.begin(); it != itEnd; ++it )
+			undistort( *it, *it );
+	}
+
+	/** removes the lens distortion from a list of image points */
+	void undistort( const std::vector< Math::Vector< T, 2 > >& distorted, std::vector< Math::Vector< T, 2 > >& undistorted ) const
+	{
+		undistorted.resize( distorted.size() );
+		for ( std::size_t i = 0; i < distorted.size(); i++ )
+			undistort( distorted[ i ], undistorted[ i ] );
+	}
+
+	/**
+	 * removes the lens distortion from a point given in image coordinates, but returns the
+	 * undistorted point in normalized sensor coordinates
+	 */
+	void undistortSensor( const Math::Vector< T, 2 >& distorted, Math::Vector< T, 2 >& undistorted ) const
+	{
+		// cell and (possibly extrapolating) weights
+		const T fx = ( distorted( 0 ) - m_originX ) / m_cellSize;
+		const T fy = ( distorted( 1 ) - m_originY ) / m_cellSize;
+		const std::size_t ix = clampCell( fx, m_cols );
+		const std::size_t iy = clampCell( fy, m_rows );
+		const T wx = fx - ix;
+		const T wy = fy - iy;
+
+		const T* n00 = &m_samples[ 2 * ( iy * m_cols + ix ) ];
+		const T* n01 = n00 + 2;
+		const T* n10 = n00 + 2 * m_cols;
+		const T* n11 = n10 + 2;
+		for ( std::size_t c = 0; c < 2; c++ )
+		{
+			const T top = n00[ c ] + wx * ( n01[ c ] - n00[ c ] );
+			const T bottom = n10[ c ] + wx * ( n11[ c ] - n10[ c ] );
+			undistorted( c ) = top + wy * ( bottom - top );
+		}
+
+		if ( m_refinementSteps )
+		{
+			Math::Vector< T, 2 > camPoint;
+			internal::unproject_impl( m_intrinsics, distorted, camPoint );
+			internal::undistort_newton_impl( m_intrinsics.radial_params, m_intrinsics.tangential_params,
+				camPoint, undistorted, m_refinementSteps, T( 0 ) );
+		}
+	}
+
+protected:
+	/** samples the inverse distortion function at all grid nodes */
+	void build( const std::size_t width, const std::size_t height, const std::size_t cellSize )
+	{
+		if ( width == 0 || height == 0 )
+			UBITRACK_THROW( "UndistortionMap requires the image dimension" );
+		if ( cellSize == 0 )
+			UBITRACK_THROW( "UndistortionMap requires a positive cell size" );
+
+		m_cellSize = static_cast< T >( cellSize );
+		m_originX = -m_cellSize;
+		m_originY = -m_cellSize;
+		m_cols = ( width + cellSize - 1 ) / cellSize + 3;
+		m_rows = ( height + cellSize - 1 ) / cellSize + 3;
+		m_samples.resize( 2 * m_cols * m_rows );
+
+		const T epsilon = 16 * std::numeric_limits< T >::epsilon();
+		for ( std::size_t r = 0; r < m_rows; r++ )
+		{
+			// start each row at the undistorted position of the pixel itself
+			Math::Vector< T, 2 > undistorted;
+			for ( std::size_t c = 0; c < m_cols; c++ )
+			{
+				const Math::Vector< T, 2 > pixel( m_originX + c * m_cellSize, m_originY + r * m_cellSize );
+				Math::Vector< T, 2 > camPoint;
+				internal::unproject_impl( m_intrinsics, pixel, camPoint );
+				if ( c == 0 )
+					undistorted = camPoint;
+
+				internal::undistort_newton_impl( m_intrinsics.radial_params, m_intrinsics.tangential_params,
+					camPoint, undistorted, 20, epsilon );
+
+				m_samples[ 2 * ( r * m_cols + c ) ] = undistorted( 0 );
+				m_samples[ 2 * ( r * m_cols + c ) + 1 ] = undistorted( 1 );
+			}
+		}
+	}
+
+	/** index of the left/upper node of the cell to interpolate in */
+	static std::size_t clampCell( const T f, const std::size_t n )
+	{
+		if ( !( f > 0 ) )
+			return 0;
+		const std::size_t i = static_cast< std::size_t >( f );
+		return i > n - 2 ? n - 2 : i;
+	}
+
+	Math::CameraIntrinsics< T > m_intrinsics;
+	std::size_t m_refinementSteps;
+
+	T m_cellSize;
+	T m_originX;
+	T m_originY;
+	std::size_t m_cols;
+	std::size_t m_rows;
+
+	/** interleaved undistorted sensor coordinates of the grid nodes, row major */
+	std::vector< T > m_samples;
+};
+
+}}} // namespace Ubitrack::Algorithm::CameraLens
+
+#endif //__UBITRACK_CALIBRATION_FUNCTION_CAMERALENS_UNDISTORTIONMAP_H_INCLUDED__
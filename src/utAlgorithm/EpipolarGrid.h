@@ -0,0 +1,192 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking_algorithms
+ * @file
+ * Spatial index of image points for epipolar line queries.
+ */
+
+#ifndef __UBITRACK_ALGORITHM_EPIPOLARGRID_H_INCLUDED__
+#define __UBITRACK_ALGORITHM_EPIPOLARGRID_H_INCLUDED__
+
+#include <utMath/Vector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Ubitrack { namespace Algorithm {
+
+/**
+ * @ingroup tracking_algorithms
+ * Uniform grid over the points of one image that returns the points within a band around
+ * an epipolar line.
+ *
+ * The cell size is at least the band width and is chosen such that there are about as many
+ * cells as points. A query walks along the line over the columns (or rows, for steep
+ * lines) of the grid and tests only the points in the cells the band overlaps, which is
+ * O(sqrt(n)) cells instead of n distance evaluations.
+ *
+ * @param T float or double
+ */
+template< typename T >
+class EpipolarGrid
+{
+public:
+	/**
+	 * Builds the grid.
+	 * @param points the image points, a container of 2-vectors with \c size() and \c operator[]
+	 * @param maxDistance half width of the band around the epipolar lines, in pixels
+	 */
+	template< class PointList >
+	EpipolarGrid( const PointList& points, const T maxDistance )
+		: m_maxDistance( maxDistance )
+		, m_nx( 0 )
+		, m_ny( 0 )
+	{
+		const std::size_t n = points.size();
+		if ( n == 0 )
+			return;
+
+		std::vector< T > x( n );
+		std::vector< T > y( n );
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			const Math::Vector< T, 2 > p( points[ i ] );
+			x[ i ] = p( 0 );
+			y[ i ] = p( 1 );
+		}
+		m_x0 = *std::min_element( x.begin(), x.end() );
+		m_y0 = *std::min_element( y.begin(), y.end() );
+		const T w = *std::max_element( x.begin(), x.end() ) - m_x0;
+		const T h = *std::max_element( y.begin(), y.end() ) - m_y0;
+
+		// about one point per cell, but at most n cells in each direction
+		m_cellSize = std::max( std::max( maxDistance, std::sqrt( w * h / n ) ), std::max( w, h ) / n );
+		if ( !( m_cellSize > 0 ) )
+			m_cellSize = 1;
+		m_nx = static_cast< std::size_t >( w / m_cellSize ) + 1;
+		m_ny = static_cast< std::size_t >( h / m_cellSize ) + 1;
+
+		// counting sort of the points by cell
+		std::vector< std::size_t > cellOf( n );
+		m_cellStart.assign( m_nx * m_ny + 1, 0 );
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			const std::size_t cx = std::min( static_cast< std::size_t >( ( x[ i ] - m_x0 ) / m_cellSize ), m_nx - 1 );
+			const std::size_t cy = std::min( static_cast< std::size_t >( ( y[ i ] - m_y0 ) / m_cellSize ), m_ny - 1 );
+			cellOf[ i ] = cy * m_nx + cx;
+			m_cellStart[ cellOf[ i ] + 1 ]++;
+		}
+		for ( std::size_t c = 0; c < m_nx * m_ny; c++ )
+			m_cellStart[ c + 1 ] += m_cellStart[ c ];
+
+		std::vector< std::size_t > pos( m_cellStart.begin(), m_cellStart.end() - 1 );
+		m_x.resize( n );
+		m_y.resize( n );
+		m_index.resize( n );
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			const std::size_t k = pos[ cellOf[ i ] ]++;
+			m_x[ k ] = x[ i ];
+			m_y[ k ] = y[ i ];
+			m_index[ k ] = i;
+		}
+	}
+
+	/**
+	 * Finds the points whose distance to a line does not exceed the band width.
+	 * @param line homogeneous line l, points x on the line satisfy l^T x = 0
+	 * @param result receives the indices of the points, in no particular order
+	 */
+	void candidates( const Math::Vector< T, 3 >& line, std::vector< std::size_t >& result ) const
+	{
+		result.clear();
+		const T a = line( 0 );
+		const T b = line( 1 );
+		const T c = line( 2 );
+		const T norm2 = a * a + b * b;
+		if ( m_nx == 0 || !( norm2 > 0 ) )
+			return;
+
+		// walk along the axis the line is closer to, so each step covers few cells
+		const bool bSteep = std::fabs( a ) > std::fabs( b );
+		const std::size_t nSteps = bSteep ? m_ny : m_nx;
+		const std::size_t nAcross = bSteep ? m_nx : m_ny;
+		const T along0 = bSteep ? m_y0 : m_x0;
+		const T across0 = bSteep ? m_x0 : m_y0;
+		const T slopeDenominator = bSteep ? a : b;
+		const T slopeNumerator = bSteep ? b : a;
+
+		// the band extends this far across in the walking direction
+		const T halfWidth = m_maxDistance * std::sqrt( norm2 ) / std::fabs( slopeDenominator );
+		const T maxDistance2 = m_maxDistance * m_maxDistance * norm2;
+
+		for ( std::size_t step = 0; step < nSteps; step++ )
+		{
+			const T t0 = along0 + step * m_cellSize;
+			const T s0 = -( slopeNumerator * t0 + c ) / slopeDenominator;
+			const T s1 = -( slopeNumerator * ( t0 + m_cellSize ) + c ) / slopeDenominator;
+			const T lo = ( std::min( s0, s1 ) - halfWidth - across0 ) / m_cellSize;
+			const T hi = ( std::max( s0, s1 ) + halfWidth - across0 ) / m_cellSize;
+			if ( hi < 0 || lo >= nAcross )
+				continue;
+
+			const std::size_t first = lo > 0 ? static_cast< std::size_t >( lo ) : 0;
+			const std::size_t last = hi < nAcross - 1 ? static_cast< std::size_t >( hi ) : nAcross - 1;
+			for ( std::size_t across = first; across <= last; across++ )
+			{
+				const std::size_t cell = bSteep ? step * m_nx + across : across * m_nx + step;
+				for ( std::size_t k = m_cellStart[ cell ]; k < m_cellStart[ cell + 1 ]; k++ )
+				{
+					const T d = a * m_x[ k ] + b * m_y[ k ] + c;
+					if ( d * d <= maxDistance2 )
+						result.push_back( m_index[ k ] );
+				}
+			}
+		}
+	}
+
+	/** half width of the band */
+	T maxDistance() const
+	{ return m_maxDistance; }
+
+protected:
+	T m_maxDistance;
+	T m_cellSize;
+	T m_x0;
+	T m_y0;
+	std::size_t m_nx;
+	std::size_t m_ny;
+
+	/** the points of cell c are [ m_cellStart[ c ], m_cellStart[ c + 1 ] ) */
+	std::vector< std::size_t > m_cellStart;
+	std::vector< T > m_x;
+	std::vector< T > m_y;
+	std::vector< std::size_t > m_index;
+};
+
+} } // namespace Ubitrack::Algorithm
+
+#endif // __UBITRACK_ALGORITHM_EPIPOLARGRID_H_INCLUDED__
@@ -29,7 +29,7 @@
  * @author Daniel Pustka <daniel.pustka@in.tum.de>
  */ 
 
-#include "../BundleAdjustment.h"
+#include "../BundleAdjustmentNetwork.h"
 
 #include <boost/numeric/ublas/vector_proxy.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
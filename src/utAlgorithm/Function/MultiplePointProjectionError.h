@@ -50,16 +50,16 @@ dehomogenize( C * ( r * e_r * p * e_r' * r' + t + e_t ) )
  *
  * p and C must be already known, the 7-vector (t, r) is the input to the function.
  */
-template< class VType >
+template< class VType, class PointList = std::vector< Math::Vector< VType, 3 > > >
 class MultiplePointProjectionError
 {
 public:
 	/** 
 	 * constructor.
-	 * @param p reference to vector of 3D-points to be projected (must stay constant during lifetime of the object)
+	 * @param p reference to list of 3D-points to be projected, a \c std::vector or a \c Math::VectorListView (must stay constant during lifetime of the object)
 	 * @param cam reference to 3x3 camera intrinsics matrix (must stay constant during lifetime of the object)
 	 */
-	MultiplePointProjectionError( const std::vector< Math::Vector< VType, 3 > >& p3D, const Math::Matrix< VType, 3, 3 >& cam )
+	MultiplePointProjectionError( const PointList& p3D, const Math::Matrix< VType, 3, 3 >& cam )
 		: m_p3D( p3D )
 		, m_cam( cam )
 	{}
@@ -96,8 +96,9 @@ public:
 			noalias( rotated ) = ublas::prod( rot, m_p3D[ i ] ) + ublas::subrange( input, 0, 3 );
 			noalias( projected ) = ublas::prod( m_cam, rotated );
 			
-			// create jacobian for this measurement
-			QuaternionRotationError< VType > qrf( m_p3D[ i ] );
+			// create jacobian for this measurement (the function keeps a reference to the point)
+			const Math::Vector< VType, 3 >& p3D( m_p3D[ i ] );
+			QuaternionRotationError< VType > qrf( p3D );
 			qrf.jacobian( ublas::subrange( input, 3, 7 ), rotJ );
 			Dehomogenization< 3 >().jacobian( projected, projJ );
 			
@@ -109,7 +110,7 @@ public:
 	}
 	
 protected:
-	const std::vector< Math::Vector< VType, 3 > >& m_p3D;
+	const PointList& m_p3D;
 	const Math::Matrix< VType, 3, 3 >& m_cam;
 };
 
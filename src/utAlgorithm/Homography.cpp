@@ -86,7 +86,7 @@ Math::Matrix< T, 3, 3 > homographyDLTImpl( const std::vector< Math::Vector< T, 2
 	const std::size_t nSingularValues ( std::min( A.size1(), A.size2() ) );
 	Math::Vector< T > s( nSingularValues );
 	Math::Matrix< T, 9, 9 > Vt;
-	Math::Matrix< T, 0, 0 > U( 2 * n_points, 2 * n_points );
+	Math::Matrix< T, 0, 0 > U( 1, 1 ); // not referenced, U is not computed
 	lapack::gesvd( 'N', 'A', A, s, U, Vt );
 
 	// copy result to 3x3 matrix
@@ -44,7 +44,7 @@ static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Cali
 //static log4cpp::Category& optLogger( log4cpp::Category::getInstance( "Ubitrack.Calibration.2D6DPoseEstimation.LM" ) );
 
 
-#include <utMath/Optimization/LevenbergMarquardt.h>
+#include <utMath/Optimization/BlockLevenbergMarquardt.h>
 #include "PoseEstimation2D3D/PlanarPoseEstimation.h"
 #include <utUtil/Exception.h>
 
@@ -66,7 +66,8 @@ std::pair < Math::ErrorPose , double >
 	bool hasInitialPoseProvided,
 	Math::Pose initialPose,
 	int startIndex,
-	int endIndex)
+	int endIndex,
+	Util::ThreadPool* pThreadPool)
 {
 	if (endIndex == -1)
 		endIndex = static_cast<int>( points3d.size() ) - 1 ;
@@ -166,7 +167,9 @@ std::pair < Math::ErrorPose , double >
 		ublas::subrange( param, 0, 3 ) = initialPose.translation();
 		ublas::subrange( param, 3, 6 ) = initialPose.rotation().toLogarithm();
 
-		const double res = Math::Optimization::levenbergMarquardt( f, param, measurements, Math::Optimization::OptTerminate( 10, 1e-6 ), Math::Optimization::OptNoNormalize() );
+		// the observations are evaluated block by block, distributed over the threads of the pool
+		const double res = Math::Optimization::blockLevenbergMarquardt( f, param, measurements, Math::Optimization::OptTerminate( 10, 1e-6 ), 
+			Math::Optimization::OptNoNormalize(), pThreadPool );
 
         // Create an error pose with covariance matrix that has the residual on its diagonal entries
 		const Math::ErrorPose finalPose( Math::Quaternion::fromLogarithm( ublas::subrange( param, 3, 6 ) ), ublas::subrange( param, 0, 3 ), Math::Matrix< double, 6, 6 >::identity( ) * res );
@@ -220,7 +223,8 @@ void multipleCameraPoseEstimationWithLocalBundles (
 	const int minCorrespondences,
 	std::vector < Math::ErrorPose >& poses,
 	std::vector < Math::Scalar < double > >& poseWeights,
-	std::vector < Math::Scalar < int > >& localBundleSizes
+	std::vector < Math::Scalar < int > >& localBundleSizes,
+	Util::ThreadPool* pThreadPool
 	)
 {
 	namespace ublas = boost::numeric::ublas;
@@ -242,7 +246,7 @@ void multipleCameraPoseEstimationWithLocalBundles (
 
 		std::pair < Math::ErrorPose , double > estimate = 
 			multipleCameraEstimatePose (points3d, points2d, points2dWeights, camPoses, camMatrices, minCorrespondences, false,
-			Math::Pose(), localBundleOffset, localBundleOffset + localBundleSizes.at( localBundleIndex ) - 1);
+			Math::Pose(), localBundleOffset, localBundleOffset + localBundleSizes.at( localBundleIndex ) - 1, pThreadPool);
 
 		poses.push_back (estimate.first);
 		poseWeights.push_back (estimate.second);
@@ -262,14 +266,15 @@ void multipleCameraPoseEstimation (
 	Math::ErrorPose& pose,
 	Math::Scalar < double > & poseWeight,
 	bool hasInitialPoseProvided,
-	const Math::Pose initialPose
+	const Math::Pose initialPose,
+	Util::ThreadPool* pThreadPool
 	)
 {
 	checkConsistency ( points3d, points2d, points2dWeights, camPoses, camMatrices );
 
 	std::pair < Math::ErrorPose , double > estimate = 
 		multipleCameraEstimatePose (points3d, points2d, points2dWeights, camPoses, camMatrices, minCorrespondences, hasInitialPoseProvided,
-			initialPose);
+			initialPose, 0, -1, pThreadPool);
 	pose = estimate.first;
 	poseWeight = estimate.second;
 }
@@ -29,6 +29,8 @@
 #include <utMath/Optimization/NewFunction/LinearTransformation.h>
 #include <utMeasurement/Measurement.h>
 
+namespace Ubitrack { namespace Util { class ThreadPool; } }
+
 namespace Ubitrack { namespace Algorithm {
 
 #ifdef HAVE_LAPACK
@@ -67,31 +69,54 @@ public:
 	template< class VT1, class VT2, class MT > 
 	void evaluateWithJacobian( VT1& result, const VT2& input, MT& J ) const
 	{
-		namespace NF = Math::Optimization::Function;
 		namespace ublas = boost::numeric::ublas;
 		const std::size_t n_vis( m_vis.size() );
 		for ( std::size_t i( 0 ); i < n_vis; ++i )
 		{
-				ublas::vector_range< VT1 > subResult( result, ublas::range( i * 2, ( i + 1 ) * 2 ) );
-				ublas::matrix_range< MT > subJ( J, ublas::range( i * 2, ( i + 1 ) * 2 ), ublas::range( 0, 6 ) );
-		
-				( NF::Dehomogenization< 3 >() <<
-				( NF::LinearTransformation< 3, 3 >( m_camI[ m_vis[ i ].second ] ) <<
-					( NF::Addition< 3 >() <<
-						( NF::fixedParameterRef< 3 >( m_camT[ m_vis[ i ].second ] ) ) <<
-						( NF::LinearTransformation< 3, 3 >( m_camR[ m_vis[ i ].second ] ) <<
-							( NF::Addition< 3 >() <<
-								( NF::parameter< 3 >( 0 ) ) <<
-								( NF::LieRotation() <<
-									( NF::parameter< 3 >( 3  ) ) <<
-									( NF::fixedParameterRef< 3 >( m_p3D[ m_vis[ i ].first ] ) )
-								)
+			ublas::vector_range< VT1 > subResult( result, blockRange( i ) );
+			ublas::matrix_range< MT > subJ( J, blockRange( i ), ublas::range( 0, 6 ) );
+			evaluateBlockWithJacobian( i, subResult, input, subJ );
+		}
+	}
+
+	/**
+	 * number of residual blocks for \c Math::Optimization::blockLevenbergMarquardt, one per visibility
+	 */
+	std::size_t blockCount() const
+	{ return m_vis.size(); }
+
+	/**
+	 * rows of the result vector that belong to a residual block
+	 */
+	boost::numeric::ublas::range blockRange( std::size_t i ) const
+	{ return boost::numeric::ublas::range( i * 2, ( i + 1 ) * 2 ); }
+
+	/**
+	 * @param i index of the visibility to evaluate
+	 * @param result 2-vector to store the projected point in
+	 * @param input containing the parameters (target pose as 6-vector)
+	 * @param J 2x6 matrix to store the jacobian (evaluated for input) in
+	 */
+	template< class VT1, class VT2, class MT > 
+	void evaluateBlockWithJacobian( std::size_t i, VT1& result, const VT2& input, MT& J ) const
+	{
+		namespace NF = Math::Optimization::Function;
+		( NF::Dehomogenization< 3 >() <<
+			( NF::LinearTransformation< 3, 3 >( m_camI[ m_vis[ i ].second ] ) <<
+				( NF::Addition< 3 >() <<
+					( NF::fixedParameterRef< 3 >( m_camT[ m_vis[ i ].second ] ) ) <<
+					( NF::LinearTransformation< 3, 3 >( m_camR[ m_vis[ i ].second ] ) <<
+						( NF::Addition< 3 >() <<
+							( NF::parameter< 3 >( 0 ) ) <<
+							( NF::LieRotation() <<
+								( NF::parameter< 3 >( 3  ) ) <<
+								( NF::fixedParameterRef< 3 >( m_p3D[ m_vis[ i ].first ] ) )
 							)
 						)
 					)
 				)
-			).evaluateWithJacobian( input, subResult, subJ );
-		}
+			)
+		).evaluateWithJacobian( input, result, J );
 	}
 	
 protected:
@@ -122,7 +147,8 @@ std::pair < Math::ErrorPose , double >
 	bool hasInitialPoseProvided,
 	Math::Pose initialPose = Math::Pose(),
 	int startIndex = 0,
-	int endIndex = -1);
+	int endIndex = -1,
+	Util::ThreadPool* pThreadPool = 0);
 
 UBITRACK_EXPORT void multipleCameraPoseEstimationWithLocalBundles (
 	const std::vector < Math::Vector< double, 3 > >&  points3d,
@@ -133,7 +159,8 @@ UBITRACK_EXPORT void multipleCameraPoseEstimationWithLocalBundles (
 	const int minCorrespondences,
 	std::vector < Math::ErrorPose >& poses,
 	std::vector < Math::Scalar < double > >& poseWeights,
-	std::vector < Math::Scalar < int > >& localBundleSizes
+	std::vector < Math::Scalar < int > >& localBundleSizes,
+	Util::ThreadPool* pThreadPool = 0
 	);
 
 UBITRACK_EXPORT void multipleCameraPoseEstimation (
@@ -146,7 +173,8 @@ UBITRACK_EXPORT void multipleCameraPoseEstimation (
 	Math::ErrorPose& pose,
 	Math::Scalar < double > & poseWeight,
 	bool hasInitialPoseProvided = false,
-	Math::Pose initialPose = Math::Pose()
+	Math::Pose initialPose = Math::Pose(),
+	Util::ThreadPool* pThreadPool = 0
 	);
 
 #endif // HAVE_LAPACK
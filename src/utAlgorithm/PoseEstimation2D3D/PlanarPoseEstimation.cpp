@@ -146,8 +146,8 @@ Math::Pose poseFromHomography( const Math::Matrix< double, 3, 3 >& H, const Math
 #ifdef HAVE_LAPACK
 
 /** \internal */	
-template< typename T > 
-T optimizePoseImpl( Pose& p, const std::vector< Vector< T, 2 > >& p2D, const std::vector< Vector< T, 3 > >& p3D, 
+template< typename T, class P2List, class P3List > 
+T optimizePoseImpl( Pose& p, const P2List& p2D, const P3List& p3D, 
 	const Matrix< T, 3, 3 >& cam, const std::size_t nIterations  )
 {
 	// copy rot & trans to parameter vector
@@ -159,10 +159,11 @@ T optimizePoseImpl( Pose& p, const std::vector< Vector< T, 2 > >& p2D, const std
 	for ( std::size_t i( 0 ); i < p2D.size(); i++ )
 		ublas::subrange( measurements, 2*i, (i+1)*2 ) = p2D[ i ];
 
-	// perform optimization
-	Function::MultiplePointProjection< T > projection( p3D, cam );
+	// perform optimization, the normal equations of the 7 pose parameters are solved on the stack
+	Function::MultiplePointProjection< T, P3List > projection( p3D, cam );
+	Optimization::LMWorkspace< T, 0, 7 > workspace;
 	T fRes = Optimization::levenbergMarquardt( projection, params, measurements, 
-		Optimization::OptTerminate( nIterations, 1e-6 ), Function::ProjectivePoseNormalize() );
+		Optimization::OptTerminate( nIterations, 1e-6 ), Function::ProjectivePoseNormalize(), workspace );
 
 	// copy back rot & trans from vector
 	p = Pose::fromVector( params );
@@ -186,8 +187,8 @@ double optimizePose( Math::Pose& p, const std::vector< Math::Vector< double, 2 >
 
 
 /** \internal */
-template< typename T >
-Matrix< T, 6, 6 > singleCameraPoseErrorImpl( const Pose& p, const std::vector< Vector< T, 3 > >& p3D, 
+template< typename T, class P3List >
+Matrix< T, 6, 6 > singleCameraPoseErrorImpl( const Pose& p, const P3List& p3D, 
 	const Matrix< T, 3, 3 >& cam, T imageError )
 {
 	// copy rot & trans to parameter vector
@@ -196,7 +197,7 @@ Matrix< T, 6, 6 > singleCameraPoseErrorImpl( const Pose& p, const std::vector< V
 
 	// calculate error
 	Matrix< T, 6, 6 > result;
-	Function::MultiplePointProjectionError< T > projection( p3D, cam );
+	Function::MultiplePointProjectionError< T, P3List > projection( p3D, cam );
 
 	Stochastic::backwardPropagationIdentity( result, imageError, projection, params );
 	
@@ -255,9 +256,11 @@ Math::Matrix< double, 6, 6 > multipleCameraPoseError( const Math::Pose& p,
 	return multipleCameraPoseErrorImpl( p, p3D, cameras, observations, imageError );
 }
 
+/** \internal */
+template< class P2List, class P3List >
 double reprojectionError( 
-	const std::vector< Math::Vector< double, 2 > >& p2d,
-	const std::vector< Math::Vector< double, 3 > >& p3d, 
+	const P2List& p2d,
+	const P3List& p3d, 
 	Math::Pose p, 
 	Math::Matrix< double, 3, 3 > cam )
 {
@@ -316,9 +319,11 @@ Math::ErrorPose computePose(
 	return computePose( p2d, p3d, cam, dummy, optimize, initMethod );
 }
 
-Math::ErrorPose computePose( 
-		const std::vector< Math::Vector< double, 2 > >& p2d,
-		const std::vector< Math::Vector< double, 3 > >& p3d,
+/** \internal */
+template< class P2List, class P3List >
+Math::ErrorPose computePoseImpl( 
+		const P2List& p2d,
+		const P3List& p3d,
 		const Math::Matrix< double, 3, 3 >& cam,
 		double& residual,
 		bool optimize,
@@ -405,8 +410,9 @@ Math::ErrorPose computePose(
 			
 		for ( std::size_t i( 0 ); i < n_points; ++i )
 		{
-			if( p3d[ i ]( 2 ) == last_dim )
-				p3dAs2d.push_back( Math::Vector< double, 2 >( p3d[ i ]( 0 ), p3d[ i ]( 1 ) ) );
+			const Math::Vector< double, 3 > p( p3d[ i ] );
+			if( p( 2 ) == last_dim )
+				p3dAs2d.push_back( Math::Vector< double, 2 >( p( 0 ), p( 1 ) ) );
 			else
 				break;
 		}
@@ -475,12 +481,8 @@ Math::ErrorPose computePose(
 			}
 
 			// compute homography
-			Math::Matrix< double, 3, 3 > H;
-			if ( n_points > 4 )
-				// copy first four elements to new vector
-				H =  Algorithm::homographyDLT( p3dAs2d, std::vector< Math::Vector< double, 2 > >( p2d.begin(), p2d.begin() + 4 ) );
-			else
-				H =  Algorithm::homographyDLT( p3dAs2d, p2d );
+			// copy first four elements to new vector
+			Math::Matrix< double, 3, 3 > H( Algorithm::homographyDLT( p3dAs2d, std::vector< Math::Vector< double, 2 > >( p2d.begin(), p2d.begin() + 4 ) ) );
 
 			// compute initial pose from homography
 			pose = Algorithm::PoseEstimation2D3D::poseFromHomography( H, invK ) * Math::Pose( Math::Quaternion( P ), t );
@@ -496,7 +498,7 @@ Math::ErrorPose computePose(
 	Math::Matrix< double, 6, 6 > covMatrix;
 	if ( optimize )
 	{
-		residual = Algorithm::PoseEstimation2D3D::optimizePose( pose, p2d, p3d, cam );
+		residual = optimizePoseImpl( pose, p2d, p3d, cam, 6 );
 		OPT_LOG_DEBUG( "Refined pose: " << pose << ", residual of 2D image measurements: " << residual);
 	}
 	else
@@ -505,12 +507,48 @@ Math::ErrorPose computePose(
 		OPT_LOG_DEBUG( "NOT refined pose: " << pose << ", residual of 2D image measurements: " << residual);	
 	}
 	
-	covMatrix = Algorithm::PoseEstimation2D3D::singleCameraPoseError( pose, p3d, cam, residual );	
+	covMatrix = singleCameraPoseErrorImpl( pose, p3d, cam, residual );	
 	residual = sqrt( residual / ( n_points * 2 ) );
 	
 	return Math::ErrorPose( pose, covMatrix );
 }
 
+Math::ErrorPose computePose( 
+		const std::vector< Math::Vector< double, 2 > >& p2d,
+		const std::vector< Math::Vector< double, 3 > >& p3d,
+		const Math::Matrix< double, 3, 3 >& cam,
+		double& residual,
+		bool optimize,
+		enum InitializationMethod initMethod
+	)
+{
+	return computePoseImpl( p2d, p3d, cam, residual, optimize, initMethod );
+}
+
+Math::ErrorPose computePose( 
+		Math::VectorListView< double, 2 > p2d,
+		Math::VectorListView< double, 3 > p3d,
+		const Math::Matrix< double, 3, 3 >& cam,
+		bool optimize,
+		enum InitializationMethod initMethod
+	)
+{
+	double dummy;
+	return computePoseImpl( p2d, p3d, cam, dummy, optimize, initMethod );
+}
+
+Math::ErrorPose computePose( 
+		Math::VectorListView< double, 2 > p2d,
+		Math::VectorListView< double, 3 > p3d,
+		const Math::Matrix< double, 3, 3 >& cam,
+		double& residual,
+		bool optimize,
+		enum InitializationMethod initMethod
+	)
+{
+	return computePoseImpl( p2d, p3d, cam, residual, optimize, initMethod );
+}
+
 #endif // HAVE_LAPACK
 
 } } } // namespace Ubitrack::Algorithm::PoseEstimation2D3D
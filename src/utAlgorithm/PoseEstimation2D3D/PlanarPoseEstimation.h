@@ -39,6 +39,7 @@
 #include <utMath/Matrix.h>
 #include <utMath/Pose.h>
 #include <utMath/ErrorPose.h>
+#include <utMath/VectorList.h>
 
 
 namespace Ubitrack { namespace Algorithm { namespace PoseEstimation2D3D {
@@ -167,6 +168,30 @@ UBITRACK_EXPORT Math::ErrorPose computePose(
 		bool optimize = true,
 		enum InitializationMethod initMethod = (enum InitializationMethod)PLANAR_HOMOGRAPHY		
 	);
+
+/**
+ * @ingroup tracking_algorithms
+ * Computes a pose given 2D-3D point correspondences in contiguous storage, e.g. from a
+ * \c Measurement::PackedPositionList2 and a \c Measurement::PackedPositionList. The points are
+ * not copied.
+ * @see computePose( const std::vector< Math::Vector< double, 2 > >&, const std::vector< Math::Vector< double, 3 > >&, const Math::Matrix< double, 3, 3 >&, bool, enum InitializationMethod )
+ */
+UBITRACK_EXPORT Math::ErrorPose computePose( 
+		Math::VectorListView< double, 2 > p2d,
+		Math::VectorListView< double, 3 > p3d,
+		const Math::Matrix< double, 3, 3 >& cam,
+		bool optimize = true,
+		enum InitializationMethod initMethod = (enum InitializationMethod)PLANAR_HOMOGRAPHY
+	);
+
+UBITRACK_EXPORT Math::ErrorPose computePose( 
+		Math::VectorListView< double, 2 > p2d,
+		Math::VectorListView< double, 3 > p3d,
+		const Math::Matrix< double, 3, 3 >& cam,
+		double& residual,
+		bool optimize = true,
+		enum InitializationMethod initMethod = (enum InitializationMethod)PLANAR_HOMOGRAPHY
+	);
 	
 #endif // HAVE_LAPACK
 	
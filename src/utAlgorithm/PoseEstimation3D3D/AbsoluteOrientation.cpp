@@ -74,6 +74,18 @@ bool estimatePose6D_3D3D( const std::vector< Math::Vector3f >& points3dA
 	return estimatePose6D_3D3D( points3dA.begin(), points3dA.end(), pose, points3dB.begin(), points3dB.end() );
 }
 
+bool estimatePose6D_3D3D( Math::VectorListView< double, 3 > points3dA
+	, Math::Pose& pose, Math::VectorListView< double, 3 > points3dB )
+{
+	return estimatePose6D_3D3D( points3dA.begin(), points3dA.end(), pose, points3dB.begin(), points3dB.end() );
+}
+
+bool estimatePose6D_3D3D( Math::VectorListView< float, 3 > points3dA
+	, Math::Pose& pose, Math::VectorListView< float, 3 > points3dB )
+{
+	return estimatePose6D_3D3D( points3dA.begin(), points3dA.end(), pose, points3dB.begin(), points3dB.end() );
+}
+
 bool estimatePose6D_3D3D( const std::vector< Math::Vector3f >& pointsA
 	, Math::Pose& pose
 	, const std::vector< Math::Vector3f >& pointsB
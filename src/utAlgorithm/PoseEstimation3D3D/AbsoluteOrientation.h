@@ -40,6 +40,7 @@
 #include <utMath/Pose.h>
 #include <utMath/Vector.h>
 #include <utMath/Matrix.h>
+#include <utMath/VectorList.h>
 
 #include <vector>
 
@@ -118,6 +119,21 @@ UBITRACK_EXPORT bool estimatePose6D_3D3D( const std::vector< Math::Vector3d >& p
 UBITRACK_EXPORT bool estimatePose6D_3D3D( const std::vector< Math::Vector3f >& points3dA, Math::Pose& pose
 										, const std::vector< Math::Vector3f >& points3dB );
 
+/** 
+ * @brief overloaded function \c estimatePose6D_3D3D for points in contiguous storage, e.g. from a \c Measurement::PackedPositionList.
+ *
+ * The points are not copied. For further information on this algorithm see estimatePose6D_3D3D( const std::vector< Math::Vector3d >& points3dA, Math::Pose& pose, const std::vector< Math::Vector3d >& points3dB );
+ */
+UBITRACK_EXPORT bool estimatePose6D_3D3D( Math::VectorListView< double, 3 > points3dA, Math::Pose& pose
+										, Math::VectorListView< double, 3 > points3dB );
+
+/** 
+ * @internal
+ * @brief overloaded function \c estimatePose6D_3D3D for points in contiguous storage with \c float parameters.
+ */
+UBITRACK_EXPORT bool estimatePose6D_3D3D( Math::VectorListView< float, 3 > points3dA, Math::Pose& pose
+										, Math::VectorListView< float, 3 > points3dB );
+
 /** 
  * @brief This algorithm estimates the rotation between two coordinate frames.
  *
@@ -36,118 +36,20 @@
 
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <boost/numeric/ublas/vector_proxy.hpp>
-#include <boost/numeric/bindings/lapack/gels.hpp>
 
 #include <log4cpp/Category.hh>
 #include <utUtil/Exception.h>
 #include <utUtil/Logging.h>
+#include <utUtil/ThreadPool.h>
 #include <utMath/MatrixOperations.h>
+#include <utMath/Cholesky.h>
 
 //shortcuts to namespaces
 namespace ublas = boost::numeric::ublas;
-namespace lapack = boost::numeric::bindings::lapack;
 
 namespace Ubitrack { namespace Algorithm { namespace PoseEstimation6D6D {
 
 
-//helper class, which is used to mainly store 2 vectors.
-template< typename T >
-class TransformCont
-{
-	private:
-		std::vector<Math::Matrix< T, 4, 4 > > m_hg;
-		std::vector<Math::Matrix< T, 4, 4 > > m_hc;
-		
-	public:
-		void setNumber( const std::size_t i, bool bUseAllPairs )
-		{
-			const std::size_t p = bUseAllPairs ? i * i / 2 : i;
-			m_hg.reserve( p );
-			m_hc.reserve( p );
-		}
-		
-		std::size_t getNumber() const
-		{ return m_hg.size(); }
-		
-		void push_back_hg( const Math::Matrix< T, 4, 4 > &hg )
-		{ m_hg.push_back( hg ); }
-		
-		void push_back_hc( const Math::Matrix< T, 4, 4 > &hc )
-		{ m_hc.push_back( hc ); }
-			
-		const Math::Matrix< T, 4, 4 >& hg_at( const std::size_t i ) const
-		{ return m_hg[ i ]; }
-		
-		const Math::Matrix< T, 4, 4 >& hc_at( const std::size_t i ) const
-		{ return m_hc[ i ]; }
-};
-
-
-/** \internal */
-template<typename T> 
-Math::Vector< T, 3 > computeSidesTrans( const Math::Matrix< T, 4, 4 >& hgij, const Math::Matrix< T, 4, 4 >& hcij, Math::Matrix< T, 3, 3 > rcg, 
-	Math::Matrix< T, 3, 3 > & leftT)
-{
-
-	Math::Matrix< T, 3, 3 > rgij = ublas::subrange(hgij, 0, 3, 0, 3 );
-	Math::Vector< T, 3 > tgij = ublas::subrange( ublas::column(hgij, 3), 0, 3 );
-	Math::Vector< T, 3 > tcij = ublas::subrange( ublas::column(hcij, 3), 0, 3 );
-
-	leftT = rgij - Math::Matrix< T, 3, 3 >::identity();
-
-	return (ublas::prod(rcg, tcij) - tgij);
-}
-
-
-template<typename T> 
-Math::Vector< T, 3 > computeTcg( TransformCont< T >& tc, const Math::Matrix< T, 3, 3 >& rcg)
-{
-	Math::Matrix< T, 0, 0 > tA(3*tc.getNumber(), 3);
-	Math::Matrix< T, 0, 0 > tB(3*tc.getNumber(), 1);
-
-	Math::Matrix< T, 4, 4 > hgij;
-	Math::Matrix< T, 4, 4 > hcij;
-	Math::Matrix< T, 3, 3 > leftT;
-
-	Math::Vector< T, 3 > rightT;
-
-	for(int i=0;i<tc.getNumber();i++)
-	{
-		hgij = tc.hg_at(i);
-		hcij = tc.hc_at(i);
-
-		rightT = computeSidesTrans(hgij, hcij, rcg, leftT);
-		
-		//right side
-		tB(3*i, 0) = rightT(0);
-		tB(3*i+1, 0) = rightT(1);
-		tB(3*i+2, 0) = rightT(2);
-
-		//left side
-
-		tA(3*i, 0)	 = leftT(0, 0);
-		tA(3*i+1, 0) = leftT(1, 0);
-		tA(3*i+2, 0) = leftT(2, 0);
-		tA(3*i, 1)	 = leftT(0, 1);
-		tA(3*i+1, 1) = leftT(1, 1);
-		tA(3*i+2, 1) = leftT(2, 1);
-		tA(3*i, 2)   = leftT(0, 2);
-		tA(3*i+1, 2) = leftT(1, 2);
-		tA(3*i+2, 2) = leftT(2, 2);
-	}
-
-	lapack::gels('N', tA, tB);			//pcg_ will be written to tB, solves tA*tcg = tB and tcg -> tB
-
-	Math::Vector< T, 3 > tcg;
-
-	tcg(0) = tB(0, 0);
-	tcg(1) = tB(1, 0);
-	tcg(2) = tB(2, 0);
-
-	return tcg;	
-}
-
-
 template< typename T > 
 Math::Matrix< T, 3, 3 > skew(const Math::Vector< T, 3 >& rotVec)
 {
@@ -320,99 +222,171 @@ Math::Vector< T, 3 > computeSidesRot( const Math::Matrix< T, 4, 4 >& hgij, const
 }
 
 
-template< typename T > 
-Math::Matrix< T, 3, 3 > computePcg( TransformCont< T >& tc)
+TsaiLenzAccumulator::NormalEquations::NormalEquations()
+	: nPairs( 0 )
+	, rotationNormal( Math::Matrix< double, 3, 3 >::zeros() )
+	, rotationRhs( Math::Vector< double, 3 >::zeros() )
+	, translationNormal( Math::Matrix< double, 3, 3 >::zeros() )
+	, coupling( Math::Matrix< double, 3, 9 >::zeros() )
+	, translationRhs( Math::Vector< double, 3 >::zeros() )
 {
-	Math::Matrix< T, 0, 0 > tA(3*tc.getNumber(), 3);
-	Math::Matrix< T, 0, 0 > tB(3*tc.getNumber(), 1);
+}
 
-	Math::Matrix< T, 4, 4 > hgij;
-	Math::Matrix< T, 4, 4 > hcij;
-	Math::Matrix< T, 3, 3 > skew;
-	
-	Math::Vector< T, 3 > rightR;
 
-	for(int i=0;i<tc.getNumber();i++)
+void TsaiLenzAccumulator::NormalEquations::add( const Math::Matrix< double, 4, 4 >& hgij, const Math::Matrix< double, 4, 4 >& hcij )
+{
+	// rotation: skew( Pgij + Pcij ) * Pcg' = Pcij - Pgij
+	Math::Matrix< double, 3, 3 > skewP;
+	const Math::Vector< double, 3 > rightR = computeSidesRot( hgij, hcij, skewP );
+	for ( std::size_t r = 0; r < 3; r++ )
+		for ( std::size_t k = 0; k < 3; k++ )
+		{
+			rotationRhs( r ) += skewP( k, r ) * rightR( k );
+			for ( std::size_t c = 0; c < 3; c++ )
+				rotationNormal( r, c ) += skewP( k, r ) * skewP( k, c );
+		}
+
+	// translation: ( Rgij - I ) * Tcg = Rcg * Tcij - Tgij
+	for ( std::size_t r = 0; r < 3; r++ )
+		for ( std::size_t k = 0; k < 3; k++ )
+		{
+			const double a = hgij( k, r ) - ( k == r ? 1 : 0 );
+			translationRhs( r ) += a * hgij( k, 3 );
+			for ( std::size_t c = 0; c < 3; c++ )
+			{
+				translationNormal( r, c ) += a * ( hgij( k, c ) - ( k == c ? 1 : 0 ) );
+				coupling( r, 3 * k + c ) += a * hcij( c, 3 );
+			}
+		}
+
+	nPairs++;
+}
+
+
+TsaiLenzAccumulator::NormalEquations& TsaiLenzAccumulator::NormalEquations::operator+=( const NormalEquations& other )
+{
+	nPairs += other.nPairs;
+	rotationNormal += other.rotationNormal;
+	rotationRhs += other.rotationRhs;
+	translationNormal += other.translationNormal;
+	coupling += other.coupling;
+	translationRhs += other.translationRhs;
+	return *this;
+}
+
+
+namespace {
+
+/** the movements between a new pose and the stored poses, split into chunks with separate equations */
+struct NewPosePairs
+{
+	NewPosePairs( const std::vector< Math::Matrix< double, 4, 4 > >& hands, const std::vector< Math::Matrix< double, 4, 4 > >& invEyes,
+		const Math::Matrix< double, 4, 4 >& invHand, const Math::Matrix< double, 4, 4 >& eye, const std::size_t nChunks )
+		: m_hands( hands )
+		, m_invEyes( invEyes )
+		, m_invHand( invHand )
+		, m_eye( eye )
+		, m_equations( nChunks )
+	{}
+
+	void operator()( const std::size_t chunk )
 	{
-		hgij = tc.hg_at(i);
-		hcij = tc.hc_at(i);
-
-		rightR = computeSidesRot(hgij, hcij, skew);
-
-		//right side
-		tB(3*i, 0) = rightR(0);
-		tB(3*i+1, 0) = rightR(1);
-		tB(3*i+2, 0) = rightR(2);
-
-		//left side
-		tA(3*i, 0)	 = skew(0, 0);
-		tA(3*i+1, 0) = skew(1, 0);
-		tA(3*i+2, 0) = skew(2, 0);
-		tA(3*i, 1)	 = skew(0, 1);
-		tA(3*i+1, 1) = skew(1, 1);
-		tA(3*i+2, 1) = skew(2, 1);
-		tA(3*i, 2)   = skew(0, 2);
-		tA(3*i+1, 2) = skew(1, 2);
-		tA(3*i+2, 2) = skew(2, 2);
+		const std::size_t n = m_hands.size();
+		const std::size_t iEnd = ( chunk + 1 ) * n / m_equations.size();
+		for ( std::size_t i = chunk * n / m_equations.size(); i < iEnd; i++ )
+		{
+			const Math::Matrix< double, 4, 4 > hgij( ublas::prod( m_invHand, m_hands[ i ] ) );
+			const Math::Matrix< double, 4, 4 > hcij( ublas::prod( m_eye, m_invEyes[ i ] ) );
+			m_equations[ chunk ].add( hgij, hcij );
+		}
 	}
 
-	lapack::gels('N', tA, tB);			//pcg_ will be written to tB, solves tA*Pcg_ = tB and Pcg_ -> tB
+	const std::vector< Math::Matrix< double, 4, 4 > >& m_hands;
+	const std::vector< Math::Matrix< double, 4, 4 > >& m_invEyes;
+	const Math::Matrix< double, 4, 4 >& m_invHand;
+	const Math::Matrix< double, 4, 4 >& m_eye;
+	std::vector< TsaiLenzAccumulator::NormalEquations > m_equations;
+};
 
-	Math::Vector< T, 3 > pcg_;
+} // anonymous namespace
 
-	pcg_(0) = tB(0, 0);
-	pcg_(1) = tB(1, 0);
-	pcg_(2) = tB(2, 0);
 
-	return getRcg(pcg_);
+TsaiLenzAccumulator::TsaiLenzAccumulator( bool bUseAllPairs, Util::ThreadPool* pThreadPool )
+	: m_bUseAllPairs( bUseAllPairs )
+	, m_pThreadPool( pThreadPool )
+	, m_nPoses( 0 )
+{
 }
 
 
-template<typename T>
-Math::Matrix< T, 4, 4 > computeTransformation(const Math::Matrix< T, 4, 4 >& hi, const Math::Matrix< T, 4, 4 >& hj, int mode) //mode: 0 to compute Hgij, 1 to compute Hcij
+void TsaiLenzAccumulator::addPose( const Math::Matrix< double, 4, 4 >& hand, const Math::Matrix< double, 4, 4 >& eye )
 {
-	Math::Matrix< T, 4, 4 > inverted;
-
-	if(mode == 0) //Hgij
+	const Math::Matrix< double, 4, 4 > invHand( Math::invert_matrix( hand ) );
+	const std::size_t n = m_hands.size();
+	if ( n )
 	{
-		inverted = Math::invert_matrix(hj);				//invert matrix need right function
-		return ublas::prod(inverted, hi);
+		const std::size_t nChunks = m_pThreadPool ? std::min( n, 4 * m_pThreadPool->size() ) : 1;
+		NewPosePairs pairs( m_hands, m_invEyes, invHand, eye, nChunks );
+		if ( m_pThreadPool )
+			m_pThreadPool->parallelFor( nChunks, pairs );
+		else
+			pairs( 0 );
+
+		for ( std::size_t c = 0; c < nChunks; c++ )
+			m_equations += pairs.m_equations[ c ];
 	}
-	else //Hcij
+
+	// only the last pose forms a pair with the next one
+	if ( !m_bUseAllPairs )
 	{
-		inverted = Math::invert_matrix(hi);				//invert matrix need right function
-		return ublas::prod(hj, inverted);
+		m_hands.clear();
+		m_invEyes.clear();
 	}
+	m_hands.push_back( hand );
+	m_invEyes.push_back( Math::invert_matrix( eye ) );
+	m_nPoses++;
 }
 
 
-template<typename T> 
-void fillTransformationVectors( TransformCont<T>& tc, const std::vector<Math::Matrix< T, 4, 4 > >& hand, const std::vector<Math::Matrix< T, 4, 4 > >& eye, bool bUseAllPairs )
+void TsaiLenzAccumulator::addPose( const Math::Pose& hand, const Math::Pose& eye )
 {
-	Math::Matrix< T, 4, 4 > hij;
-	Math::Matrix< T, 4, 4 > hi;
-	Math::Matrix< T, 4, 4 > hj;
-	const std::size_t n_hands( hand.size() ) ;
-	for( std::size_t i( 0 ); i<(n_hands-1); ++i )
-	{
-		const std::size_t to = bUseAllPairs ? n_hands : i + 2;
-		for( std::size_t k( i+1 ); k<to; ++k )
-		{
-			//first we compute the hg
-			hi = hand.at(i);
-			hj = hand.at(k);
+	addPose( Math::Matrix< double, 4, 4 >( hand ), Math::Matrix< double, 4, 4 >( eye ) );
+}
+
 
-			hij = computeTransformation(hi, hj, 0);
-			tc.push_back_hg(hij);
+void TsaiLenzAccumulator::reset()
+{
+	m_nPoses = 0;
+	m_hands.clear();
+	m_invEyes.clear();
+	m_equations = NormalEquations();
+}
 
-			//second we compute the hc
-			hi = eye.at(i);
-			hj = eye.at(k);
 
-			hij = computeTransformation(hi, hj, 1);
-			tc.push_back_hc(hij);
-		}
-	}
+Math::Pose TsaiLenzAccumulator::solve() const
+{
+	if ( m_nPoses <= 2 )
+		return Math::Pose( Math::Quaternion(), Math::Vector< double, 3 >( 0, 0, 0 ) );
+
+	Math::Matrix< double, 3, 3 > l( m_equations.rotationNormal );
+	Math::Vector< double, 3 > pcg_( m_equations.rotationRhs );
+	if ( !Math::cholesky_factor( l ) )
+		UBITRACK_THROW( "Hand-eye calibration is degenerate, the rotation axes of the movements are parallel" );
+	Math::cholesky_solve( l, pcg_ );
+	const Math::Matrix< double, 3, 3 > rcg( getRcg( pcg_ ) );
+
+	Math::Vector< double, 3 > tcg( -m_equations.translationRhs );
+	for ( std::size_t r = 0; r < 3; r++ )
+		for ( std::size_t k = 0; k < 3; k++ )
+			for ( std::size_t c = 0; c < 3; c++ )
+				tcg( r ) += m_equations.coupling( r, 3 * k + c ) * rcg( k, c );
+
+	l = m_equations.translationNormal;
+	if ( !Math::cholesky_factor( l ) )
+		UBITRACK_THROW( "Hand-eye calibration is degenerate, the rotation axes of the movements are parallel" );
+	Math::cholesky_solve( l, tcg );
+
+	return Math::Pose( Math::Quaternion( rcg ), tcg );
 }
 
 
@@ -427,22 +401,11 @@ Math::Pose performHandEyeCalibrationImp ( const std::vector<Math::Matrix< T, 4,
 		UBITRACK_THROW ( "Input sizes do not match" );		
 	}
 
-	if( n_eyes <= 2 )
-	{
-		Math::Vector< T, 3 >* v = new Math::Vector< T, 3 >( 0, 0, 0 );
-		Math::Quaternion* q = new Math::Quaternion();
-		return Math::Pose( *q, *v);
-	}
-	
-	TransformCont< T > tc;
+	TsaiLenzAccumulator accumulator( bUseAllPairs );
+	for( std::size_t i( 0 ); i < n_eyes; ++i )			//ai = eye, bi = hand
+		accumulator.addPose( Math::Matrix< double, 4, 4 >( hand[ i ] ), Math::Matrix< double, 4, 4 >( eye[ i ] ) );
 
-	tc.setNumber( n_eyes, bUseAllPairs );
-
-	fillTransformationVectors( tc, hand, eye, bUseAllPairs );			//readies values //ai = eye, bi = hand
-	Math::Matrix< T, 3, 3 > rcg = computePcg< T >( tc );		//returns Rcg
-	Math::Vector< T, 3 > tcg = computeTcg( tc, rcg );
-
-	return Math::Pose(Math::Quaternion(rcg), tcg);
+	return accumulator.solve();
 }
 
 
@@ -458,35 +421,6 @@ Math::Pose performHandEyeCalibration ( const std::vector< Math::Matrix< double,
 }
 
 
-void fillTransformationVectors( TransformCont<double>& tc, const std::vector<Math::Pose>& hand, const std::vector<Math::Pose>& eye, bool bUseAllPairs )
-{
-	Math::Matrix< double, 4, 4 > hij;
-	Math::Matrix< double, 4, 4 > hi;
-	Math::Matrix< double, 4, 4 > hj;
-	const std::size_t n_hands( hand.size() );
-	for( std::size_t i( 0 ) ; i<(n_hands-1); ++i )
-	{
-		const std::size_t to = bUseAllPairs ? n_hands : i + 2;
-		for( std::size_t k( i+1 ); k<to; ++k )
-		{
-			//first we compute the hg
-			hi = Math::Matrix< double, 4, 4 >(hand.at(i));
-			hj = Math::Matrix< double, 4, 4 >(hand.at(k));
-
-			hij = computeTransformation(hi, hj, 0);
-			tc.push_back_hg(hij);
-
-			//second we compute the hc
-			hi =  Math::Matrix< double, 4, 4 >(eye.at(i));
-			hj =  Math::Matrix< double, 4, 4 >(eye.at(k));
-
-			hij = computeTransformation( hi, hj, 1 );
-			tc.push_back_hc(hij);
-		}
-	}
-}
-
-
 Math::Pose performHandEyeCalibration ( const std::vector< Math::Pose >& hand,  const std::vector< Math::Pose >& eye, bool bUseAllPairs )
 {
 	static log4cpp::Category& logger(log4cpp::Category::getInstance( "Ubitrack.Calibration.HandEyeCalibration" )); 
@@ -497,22 +431,11 @@ Math::Pose performHandEyeCalibration ( const std::vector< Math::Pose >& hand,  c
 		UBITRACK_THROW ( "Input sizes do not match" );		
 	}
 
-	if( n_eyes <= 2 )
-	{
-		Math::Vector< double, 3 >* v = new Math::Vector< double, 3 >( 0, 0, 0 );
-		Math::Quaternion* q = new Math::Quaternion();
-		return Math::Pose( *q, *v);
-	}
-
-	TransformCont< double > tc;
-
-	tc.setNumber( n_eyes, bUseAllPairs );
-
-	fillTransformationVectors( tc, hand, eye, bUseAllPairs );			//readies values //ai = eye, bi = hand
-	Math::Matrix< double, 3, 3 > rcg = computePcg< double >( tc );									//returns also Rcg
-	Math::Vector< double, 3 > tcg = computeTcg( tc, rcg );
+	TsaiLenzAccumulator accumulator( bUseAllPairs );
+	for( std::size_t i( 0 ); i < n_eyes; ++i )
+		accumulator.addPose( hand[ i ], eye[ i ] );
 
-	return Math::Pose(Math::Quaternion( rcg ), tcg);
+	return accumulator.solve();
 }
 
 }}} // namespace Ubitrack::Algorithm::PoseEstimation6D6D
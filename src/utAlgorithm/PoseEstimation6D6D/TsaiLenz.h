@@ -40,6 +40,8 @@
 #include <utMath/Pose.h>
 #include <vector>
 
+namespace Ubitrack { namespace Util { class ThreadPool; } }
+
 namespace Ubitrack { namespace Algorithm { namespace PoseEstimation6D6D {
 
 /**
@@ -61,6 +63,93 @@ UBITRACK_EXPORT Math::Pose performHandEyeCalibration ( const std::vector< Math::
 UBITRACK_EXPORT Math::Pose performHandEyeCalibration ( const std::vector< Math::Pose >& hand,  const std::vector< Math::Pose >& eye, bool bUseAllPairs = true );
 
 
+/**
+ * @ingroup tracking_algorithms
+ * Incremental Tsai-Lenz hand-eye calibration.
+ *
+ * Instead of storing the relative movements of all pairs of poses, the normal equations
+ * of the rotation and the translation stage are accumulated pair by pair. The translation
+ * equations depend linearly on the rotation, so they are kept as a 3x9 coupling term and
+ * combined with the rotation only in \c solve. Adding the n-th pose adds its n-1 pairs
+ * in O(n) time, the memory stays O(n) for the poses. The pairs of one pose can be
+ * distributed over the threads of a pool.
+ *
+ * \c performHandEyeCalibration uses this class.
+ */
+class UBITRACK_EXPORT TsaiLenzAccumulator
+{
+public:
+	/**
+	 * @param bUseAllPairs use the movements between all pairs of poses, otherwise only between consecutive poses
+	 * @param pThreadPool thread pool that processes the pairs of a new pose, 0 runs in the calling thread
+	 */
+	explicit TsaiLenzAccumulator( bool bUseAllPairs = true, Util::ThreadPool* pThreadPool = 0 );
+
+	/**
+	 * Adds a pair of corresponding poses.
+	 * @param hand pose of the hand (marker) in the global (tracker) coordinate system
+	 * @param eye pose of the eye (camera) in the eye coordinate system
+	 */
+	void addPose( const Math::Matrix< double, 4, 4 >& hand, const Math::Matrix< double, 4, 4 >& eye );
+
+	/** @overload */
+	void addPose( const Math::Pose& hand, const Math::Pose& eye );
+
+	/** removes all poses */
+	void reset();
+
+	/** number of added poses */
+	std::size_t size() const
+	{ return m_nPoses; }
+
+	/** number of movements in the normal equations */
+	std::size_t pairs() const
+	{ return m_equations.nPairs; }
+
+	/**
+	 * Computes the transformation between eye and hand from the poses added so far.
+	 * Returns the identity with less than three poses.
+	 * @throws Util::Exception if the movements do not determine the transformation (e.g. all rotations about parallel axes)
+	 */
+	Math::Pose solve() const;
+
+	/** @internal the accumulated normal equations */
+	struct NormalEquations
+	{
+		NormalEquations();
+
+		/** adds the equations of one movement of the hand and of the eye */
+		void add( const Math::Matrix< double, 4, 4 >& hgij, const Math::Matrix< double, 4, 4 >& hcij );
+
+		NormalEquations& operator+=( const NormalEquations& other );
+
+		std::size_t nPairs;
+
+		/** A^T A and A^T b of the rotation stage */
+		Math::Matrix< double, 3, 3 > rotationNormal;
+		Math::Vector< double, 3 > rotationRhs;
+
+		/** A^T A of the translation stage */
+		Math::Matrix< double, 3, 3 > translationNormal;
+
+		/** A^T b of the translation stage is coupling * vec( Rcg ) - translationRhs */
+		Math::Matrix< double, 3, 9 > coupling;
+		Math::Vector< double, 3 > translationRhs;
+	};
+
+protected:
+	bool m_bUseAllPairs;
+	Util::ThreadPool* m_pThreadPool;
+	std::size_t m_nPoses;
+
+	/** the hand poses and the inverse eye poses that still form pairs with new poses */
+	std::vector< Math::Matrix< double, 4, 4 > > m_hands;
+	std::vector< Math::Matrix< double, 4, 4 > > m_invEyes;
+
+	NormalEquations m_equations;
+};
+
+
 }}} // namespace Ubitrack::Algorithm::PoseEstimation6D6D
 
 #endif // HAVE_LAPACK
@@ -55,9 +55,8 @@ namespace blas = boost::numeric::bindings::blas;
 namespace Ubitrack { namespace Algorithm {
 
 /** \internal */
-template< typename T >
-Math::Matrix< T, 3, 4 >projectionDLTImpl( const std::vector< Math::Vector< T, 3 > >& fromPoints,
-	const std::vector< Math::Vector< T, 2 > >& toPoints )
+template< typename T, class FromList, class ToList >
+Math::Matrix< T, 3, 4 >projectionDLTImpl( const FromList& fromPoints, const ToList& toPoints )
 {
 	assert( fromPoints.size() == toPoints.size() );
 	assert( fromPoints.size() >= 6 );
@@ -101,7 +100,7 @@ Math::Matrix< T, 3, 4 >projectionDLTImpl( const std::vector< Math::Vector< T, 3
 	// solve using SVD
 	Math::Vector< T > s( 12 );
 	Math::Matrix< T, 12, 12 > Vt;
-	Math::Matrix< T, 0, 0 > U( 2 * fromPoints.size(), 2 * fromPoints.size() );
+	Math::Matrix< T, 0, 0 > U( 1, 1 ); // not referenced, U is not computed
 	lapack::gesvd( 'N', 'A', A, s, U, Vt );
 
 	// copy result to 3x4 matrix
@@ -132,13 +131,25 @@ Math::Matrix< T, 3, 4 >projectionDLTImpl( const std::vector< Math::Vector< T, 3
 Math::Matrix< float, 3, 4 > projectionDLT( const std::vector< Math::Vector< float, 3 > >& fromPoints,
 	const std::vector< Math::Vector< float, 2 > >& toPoints )
 {
-	return projectionDLTImpl( fromPoints, toPoints );
+	return projectionDLTImpl< float >( fromPoints, toPoints );
 }
 
 Math::Matrix< double, 3, 4 > projectionDLT( const std::vector< Math::Vector< double, 3 > >& fromPoints,
 	const std::vector< Math::Vector< double, 2 > >& toPoints )
 {
-	return projectionDLTImpl( fromPoints, toPoints );
+	return projectionDLTImpl< double >( fromPoints, toPoints );
+}
+
+Math::Matrix< float, 3, 4 > projectionDLT( Math::VectorListView< float, 3 > fromPoints,
+	Math::VectorListView< float, 2 > toPoints )
+{
+	return projectionDLTImpl< float >( fromPoints, toPoints );
+}
+
+Math::Matrix< double, 3, 4 > projectionDLT( Math::VectorListView< double, 3 > fromPoints,
+	Math::VectorListView< double, 2 > toPoints )
+{
+	return projectionDLTImpl< double >( fromPoints, toPoints );
 }
 
 
@@ -37,6 +37,7 @@
 #include <utCore.h>
 #include <utMath/Matrix.h>
 #include <utMath/Vector.h>
+#include <utMath/VectorList.h>
 #include <vector>
 
 namespace Ubitrack { namespace Algorithm {
@@ -62,6 +63,17 @@ UBITRACK_EXPORT Math::Matrix< float, 3, 4 > projectionDLT( const std::vector< Ma
 UBITRACK_EXPORT Math::Matrix< double, 3, 4 > projectionDLT( const std::vector< Math::Vector< double, 3 > >& fromPoints, 
 	const std::vector< Math::Vector< double, 2 > >& toPoints );
 
+/**
+ * @ingroup tracking_algorithms
+ * Computes a 3x4 projection matrix using a linear DLT method on points in contiguous storage.
+ * @see projectionDLT( const std::vector< Math::Vector< double, 3 > >&, const std::vector< Math::Vector< double, 2 > >& )
+ */
+UBITRACK_EXPORT Math::Matrix< float, 3, 4 > projectionDLT( Math::VectorListView< float, 3 > fromPoints, 
+	Math::VectorListView< float, 2 > toPoints );
+
+UBITRACK_EXPORT Math::Matrix< double, 3, 4 > projectionDLT( Math::VectorListView< double, 3 > fromPoints, 
+	Math::VectorListView< double, 2 > toPoints );
+
 
 /**
  * @ingroup tracking_algorithms
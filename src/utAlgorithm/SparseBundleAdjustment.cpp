@@ -0,0 +1,553 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking_algorithms
+ * @file
+ * Implementation of the sparse (Schur complement) bundle adjustment.
+ */
+
+#include "SparseBundleAdjustment.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <boost/numeric/ublas/vector_proxy.hpp>
+
+#include <utMath/Cholesky.h>
+#include <utMath/Util/cast_assign.h>
+#include <utMath/Optimization/Optimization.h>
+#include <utUtil/Exception.h>
+
+#include "Function/Dehomogenization.h"
+#include "Function/RadialDistortion.h"
+#include "Function/LieRotation.h"
+
+// get a logger
+#include <log4cpp/Category.hh>
+static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Algorithm.SparseBundleAdjustment" ) );
+
+
+namespace Ubitrack { namespace Algorithm {
+
+namespace {
+
+namespace ublas = boost::numeric::ublas;
+
+/** marks a missing block index */
+const std::size_t noBlock = std::size_t( -1 );
+
+/** a 6-DOF pose parameter block (translation and rotation logarithm) with cached rotation matrix */
+template< class T >
+struct PoseBlock
+{
+	Math::Vector< T, 6 > param;
+	Math::Matrix< T, 3, 3 > rotation;
+
+	void updateRotation()
+	{ Math::Quaternion::fromLogarithm( ublas::subrange( param, 3, 6 ) ).toMatrix( rotation ); }
+};
+
+/** a single 2D observation together with its residual and jacobian blocks */
+template< class T >
+struct Observation
+{
+	/** pose block of the image */
+	std::size_t iImage;
+
+	/** pose block of the body, \c noBlock for free points and for the world-defining body */
+	std::size_t iBody;
+
+	/** index of the free point, \c noBlock for body points */
+	std::size_t iPoint;
+
+	/** index of the intrinsics */
+	std::size_t iCamera;
+
+	/** point in body coordinates (body points only) */
+	Math::Vector< T, 3 > bodyPoint;
+
+	Math::Vector< T, 2 > measurement;
+	Math::Vector< T, 2 > residual;
+
+	/** 2x6 jacobian wrt. the image pose */
+	Math::Matrix< T, 2, 6 > jImage;
+
+	/** 2x6 jacobian wrt. the body pose */
+	Math::Matrix< T, 2, 6 > jBody;
+
+	/** 2x3 jacobian wrt. the free point */
+	Math::Matrix< T, 2, 3 > jPoint;
+};
+
+
+template< class T >
+class SparseBundleAdjustmentEngine
+{
+public:
+	typedef Math::Matrix< T, 6, 6 > Block66;
+	typedef Math::Matrix< T, 6, 3 > Block63;
+	typedef Math::Matrix< T, 3, 3 > Block33;
+	typedef Math::Vector< T, 6 > Vector6;
+	typedef Math::Vector< T, 3 > Vector3;
+
+	/** lower triangle of a block-sparse symmetric matrix, stored column-wise: m[ j ][ i ] with i >= j */
+	typedef std::vector< std::map< std::size_t, Block66 > > BlockColumns;
+
+	SparseBundleAdjustmentEngine( BundleAdjustmentNetwork< T >& net )
+		: m_net( net )
+		, m_nBodyBlocks( net.bodyPoses.empty() ? 0 : net.bodyPoses.size() - 1 )
+	{
+		if ( net.bEstimateIntrinsics )
+			UBITRACK_THROW( "Sparse bundle adjustment does not support estimation of intrinsics" );
+
+		// pose blocks: body poses (without the first) followed by the images
+		m_poses.resize( m_nBodyBlocks + net.images.size() );
+		for ( std::size_t i = 0; i < m_nBodyBlocks; i++ )
+			initPoseBlock( m_poses[ i ], net.bodyPoses[ i + 1 ] );
+		for ( std::size_t i = 0; i < net.images.size(); i++ )
+			initPoseBlock( m_poses[ m_nBodyBlocks + i ], net.images[ i ] );
+
+		m_points = net.points;
+
+		// observations
+		m_observations.reserve( net.freePointMeasurements.size() + net.bodyPointMeasurements.size() );
+		m_pointObservations.resize( net.points.size() );
+
+		for ( typename std::vector< typename BundleAdjustmentNetwork< T >::FreePointMeasurement >::const_iterator it = net.freePointMeasurements.begin();
+			it != net.freePointMeasurements.end(); it++ )
+		{
+			Observation< T > o;
+			o.iImage = m_nBodyBlocks + it->iImage;
+			o.iBody = noBlock;
+			o.iPoint = it->iPoint;
+			o.iCamera = it->iCamera;
+			o.measurement = it->measurement;
+			m_pointObservations[ it->iPoint ].push_back( m_observations.size() );
+			m_observations.push_back( o );
+		}
+
+		for ( typename std::vector< typename BundleAdjustmentNetwork< T >::BodyPointMeasurement >::const_iterator it = net.bodyPointMeasurements.begin();
+			it != net.bodyPointMeasurements.end(); it++ )
+		{
+			Observation< T > o;
+			o.iImage = m_nBodyBlocks + it->iImage;
+			o.iBody = it->iBodyPose == 0 ? noBlock : it->iBodyPose - 1;
+			o.iPoint = noBlock;
+			o.iCamera = it->iCamera;
+			o.bodyPoint = net.bodies[ it->iBody ][ it->iPoint ];
+			o.measurement = it->measurement;
+			m_observations.push_back( o );
+		}
+
+		m_W.resize( m_observations.size() );
+		m_gPose.resize( m_poses.size() );
+		m_gPoint.resize( m_points.size() );
+		m_V.resize( m_points.size() );
+		m_Vinv.resize( m_points.size() );
+	}
+
+	T optimize( const Math::Optimization::OptTerminate& terminationCriteria )
+	{
+		std::vector< Vector6 > dPose( m_poses.size() );
+		std::vector< Vector3 > dPoint( m_points.size() );
+
+		T fErrPrev = linearize();
+		LOG4CPP_DEBUG( logger, "Sparse bundle adjustment with " << m_poses.size() << " pose blocks, " << m_points.size()
+			<< " points and " << m_observations.size() << " observations, initial residual: " << fErrPrev );
+
+		T fLambda( 1 );
+		const T fStepFactor( 10 );
+		std::size_t iteration = 0;
+		bool bTerminate = false;
+		while ( !bTerminate )
+		{
+			++iteration;
+
+			if ( !solve( fLambda, dPose, dPoint ) )
+			{
+				LOG4CPP_DEBUG( logger, "Reduced camera system not positive definite, increasing lambda" );
+				fLambda *= fStepFactor;
+				bTerminate = terminationCriteria( iteration, fErrPrev, T( 0 ) );
+				continue;
+			}
+
+			// apply step
+			std::vector< PoseBlock< T > > newPoses( m_poses );
+			for ( std::size_t i = 0; i < newPoses.size(); i++ )
+			{
+				newPoses[ i ].param += dPose[ i ];
+				newPoses[ i ].updateRotation();
+			}
+
+			std::vector< Vector3 > newPoints( m_points );
+			for ( std::size_t i = 0; i < newPoints.size(); i++ )
+				newPoints[ i ] += dPoint[ i ];
+
+			// residuals only, the jacobian is computed if the step is accepted
+			T fErr( 0 );
+			for ( typename std::vector< Observation< T > >::iterator it = m_observations.begin(); it != m_observations.end(); ++it )
+				fErr += evaluate( *it, newPoses, newPoints, false );
+
+			LOG4CPP_DEBUG( logger, "Sparse bundle adjustment residual " << iteration << ": " << fErr );
+
+			bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+
+			if ( fErr >= fErrPrev )
+				fLambda *= fStepFactor;
+			else
+			{
+				fLambda /= fStepFactor;
+				m_poses.swap( newPoses );
+				m_points.swap( newPoints );
+				fErrPrev = fErr;
+
+				if ( !bTerminate )
+					linearize();
+			}
+		}
+
+		writeBack();
+		return fErrPrev;
+	}
+
+protected:
+
+	void initPoseBlock( PoseBlock< T >& block, const Math::Pose& pose )
+	{
+		ublas::vector_range< Vector6 > trans( block.param, ublas::range( 0, 3 ) );
+		ublas::vector_range< Vector6 > rot( block.param, ublas::range( 3, 6 ) );
+		Math::Util::vector_cast_assign( trans, pose.translation() );
+		Math::Util::vector_cast_assign( rot, pose.rotation().toLogarithm() );
+		block.updateRotation();
+	}
+
+	Math::Pose poseFromBlock( const PoseBlock< T >& block ) const
+	{
+		return Math::Pose( Math::Quaternion::fromLogarithm( ublas::subrange( block.param, 3, 6 ) ),
+			ublas::subrange( block.param, 0, 3 ) );
+	}
+
+	/**
+	 * computes the residual (and optionally the jacobian blocks) of a single observation
+	 * @return the squared residual
+	 */
+	T evaluate( Observation< T >& o, const std::vector< PoseBlock< T > >& poses, const std::vector< Vector3 >& points, bool bJacobian ) const
+	{
+		const PoseBlock< T >& image( poses[ o.iImage ] );
+
+		// point in world coordinates
+		Vector3 world;
+		if ( o.iPoint != noBlock )
+			world = points[ o.iPoint ];
+		else if ( o.iBody == noBlock )
+			world = o.bodyPoint;
+		else
+		{
+			const PoseBlock< T >& body( poses[ o.iBody ] );
+			noalias( world ) = ublas::prod( body.rotation, o.bodyPoint );
+			noalias( world ) += ublas::subrange( body.param, 0, 3 );
+		}
+
+		// transform into the camera coordinate frame
+		Vector3 transformed( ublas::prod( image.rotation, world ) );
+		noalias( transformed ) += ublas::subrange( image.param, 0, 3 );
+
+		Math::Vector< T, 2 > dehomogenized;
+		Function::Dehomogenization< 3 >().evaluate( dehomogenized, transformed );
+
+		// apply distortion and intrinsics (same model as BundleAdjustmentFunction)
+		const Math::Vector< T, 4 >& d( m_net.distortions[ o.iCamera ] );
+		const Math::Matrix< T, 3, 3 >& K( m_net.intrinsics[ o.iCamera ] );
+		Math::Vector< T, 2 > distorted;
+		Function::RadialDistortionWrtP< T >( d ).evaluate( distorted, dehomogenized );
+
+		o.residual( 0 ) = o.measurement( 0 ) + ( K( 0, 0 ) * distorted( 0 ) + K( 0, 1 ) * distorted( 1 ) + K( 0, 2 ) );
+		o.residual( 1 ) = o.measurement( 1 ) + (                              K( 1, 1 ) * distorted( 1 ) + K( 1, 2 ) );
+
+		if ( bJacobian )
+		{
+			// jacobian of the projection wrt. the point in camera coordinates
+			Math::Matrix< T, 2, 2 > jDistP;
+			Function::RadialDistortionWrtP< T >( d ).jacobian( dehomogenized, jDistP );
+			Math::Matrix< T, 2, 2 > jDistortion;
+			noalias( jDistortion ) = -ublas::prod( ublas::subrange( K, 0, 2, 0, 2 ), jDistP );
+
+			Math::Matrix< T, 2, 3 > jDehom;
+			Function::Dehomogenization< 3 >().jacobian( transformed, jDehom );
+			Math::Matrix< T, 2, 3 > jCamera;
+			noalias( jCamera ) = ublas::prod( jDistortion, jDehom );
+
+			// image pose
+			Math::Matrix< T, 3, 3 > jRot;
+			ublas::subrange( o.jImage, 0, 2, 0, 3 ) = jCamera;
+			Function::LieRotation< T >( world ).jacobian( ublas::subrange( image.param, 3, 6 ), jRot );
+			noalias( ublas::subrange( o.jImage, 0, 2, 3, 6 ) ) = ublas::prod( jCamera, jRot );
+
+			// world point
+			Math::Matrix< T, 2, 3 > jWorld;
+			noalias( jWorld ) = ublas::prod( jCamera, image.rotation );
+
+			if ( o.iPoint != noBlock )
+				o.jPoint = jWorld;
+			else if ( o.iBody != noBlock )
+			{
+				ublas::subrange( o.jBody, 0, 2, 0, 3 ) = jWorld;
+				Function::LieRotation< T >( o.bodyPoint ).jacobian( ublas::subrange( poses[ o.iBody ].param, 3, 6 ), jRot );
+				noalias( ublas::subrange( o.jBody, 0, 2, 3, 6 ) ) = ublas::prod( jWorld, jRot );
+			}
+		}
+
+		return ublas::inner_prod( o.residual, o.residual );
+	}
+
+	/** adds a block to the lower triangle of a block-sparse matrix */
+	static Block66& lowerBlock( BlockColumns& m, std::size_t i, std::size_t j )
+	{
+		typename std::map< std::size_t, Block66 >::iterator it = m[ j ].find( i );
+		if ( it == m[ j ].end() )
+			it = m[ j ].insert( std::make_pair( i, Block66( ublas::zero_matrix< T >( 6, 6 ) ) ) ).first;
+		return it->second;
+	}
+
+	/**
+	 * evaluates all observations with jacobians and builds the (undamped) normal equations
+	 * @return the squared residual
+	 */
+	T linearize()
+	{
+		m_U.assign( m_poses.size(), std::map< std::size_t, Block66 >() );
+		for ( std::size_t i = 0; i < m_poses.size(); i++ )
+		{
+			lowerBlock( m_U, i, i );
+			m_gPose[ i ] = ublas::zero_vector< T >( 6 );
+		}
+		for ( std::size_t i = 0; i < m_points.size(); i++ )
+		{
+			m_V[ i ] = ublas::zero_matrix< T >( 3, 3 );
+			m_gPoint[ i ] = ublas::zero_vector< T >( 3 );
+		}
+
+		T fErr( 0 );
+		for ( std::size_t iO = 0; iO < m_observations.size(); iO++ )
+		{
+			Observation< T >& o( m_observations[ iO ] );
+			fErr += evaluate( o, m_poses, m_points, true );
+
+			noalias( lowerBlock( m_U, o.iImage, o.iImage ) ) += ublas::prod( ublas::trans( o.jImage ), o.jImage );
+			noalias( m_gPose[ o.iImage ] ) += ublas::prod( ublas::trans( o.jImage ), o.residual );
+
+			if ( o.iPoint != noBlock )
+			{
+				noalias( m_V[ o.iPoint ] ) += ublas::prod( ublas::trans( o.jPoint ), o.jPoint );
+				noalias( m_gPoint[ o.iPoint ] ) += ublas::prod( ublas::trans( o.jPoint ), o.residual );
+				noalias( m_W[ iO ] ) = ublas::prod( ublas::trans( o.jImage ), o.jPoint );
+			}
+			else if ( o.iBody != noBlock )
+			{
+				noalias( lowerBlock( m_U, o.iBody, o.iBody ) ) += ublas::prod( ublas::trans( o.jBody ), o.jBody );
+				noalias( m_gPose[ o.iBody ] ) += ublas::prod( ublas::trans( o.jBody ), o.residual );
+
+				// coupling between body and image pose
+				if ( o.iImage > o.iBody )
+					noalias( lowerBlock( m_U, o.iImage, o.iBody ) ) += ublas::prod( ublas::trans( o.jImage ), o.jBody );
+				else
+					noalias( lowerBlock( m_U, o.iBody, o.iImage ) ) += ublas::prod( ublas::trans( o.jBody ), o.jImage );
+			}
+		}
+
+		return fErr;
+	}
+
+	/**
+	 * computes a damped Gauss-Newton step from the current normal equations
+	 * @return false if the system was not positive definite
+	 */
+	bool solve( T fLambda, std::vector< Vector6 >& dPose, std::vector< Vector3 >& dPoint )
+	{
+		// reduced camera system S = U - W V^-1 W^T
+		BlockColumns S( m_U );
+		for ( std::size_t i = 0; i < S.size(); i++ )
+		{
+			Block66& d( S[ i ][ i ] );
+			for ( std::size_t k = 0; k < 6; k++ )
+				d( k, k ) += fLambda;
+			dPose[ i ] = m_gPose[ i ];
+		}
+
+		std::vector< Block63 > WVinv;
+		for ( std::size_t iP = 0; iP < m_points.size(); iP++ )
+		{
+			Block33 V( m_V[ iP ] );
+			for ( std::size_t k = 0; k < 3; k++ )
+				V( k, k ) += fLambda;
+			if ( !Math::cholesky_factor( V ) )
+				return false;
+			Math::cholesky_invert( V, m_Vinv[ iP ] );
+
+			const std::vector< std::size_t >& obs( m_pointObservations[ iP ] );
+			WVinv.resize( obs.size() );
+			for ( std::size_t a = 0; a < obs.size(); a++ )
+			{
+				noalias( WVinv[ a ] ) = ublas::prod( m_W[ obs[ a ] ], m_Vinv[ iP ] );
+				noalias( dPose[ m_observations[ obs[ a ] ].iImage ] ) -= ublas::prod( WVinv[ a ], m_gPoint[ iP ] );
+			}
+
+			for ( std::size_t a = 0; a < obs.size(); a++ )
+			{
+				const std::size_t i = m_observations[ obs[ a ] ].iImage;
+				for ( std::size_t b = 0; b < obs.size(); b++ )
+				{
+					const std::size_t j = m_observations[ obs[ b ] ].iImage;
+					if ( i >= j )
+						noalias( lowerBlock( S, i, j ) ) -= ublas::prod( WVinv[ a ], ublas::trans( m_W[ obs[ b ] ] ) );
+				}
+			}
+		}
+
+		// block-sparse cholesky factorization (right-looking, fill-in is inserted on demand)
+		for ( std::size_t k = 0; k < S.size(); k++ )
+		{
+			std::map< std::size_t, Block66 >& col( S[ k ] );
+			typename std::map< std::size_t, Block66 >::iterator itDiag = col.find( k );
+			Block66& Lkk( itDiag->second );
+			if ( !Math::cholesky_factor( Lkk ) )
+				return false;
+
+			// L_ik = S_ik * L_kk^-T
+			typename std::map< std::size_t, Block66 >::iterator itBegin = itDiag;
+			++itBegin;
+			for ( typename std::map< std::size_t, Block66 >::iterator it = itBegin; it != col.end(); ++it )
+				for ( std::size_t r = 0; r < 6; r++ )
+				{
+					ublas::matrix_row< Block66 > row( it->second, r );
+					Math::triangular_solve_lower( Lkk, row );
+				}
+
+			// update the trailing matrix
+			for ( typename std::map< std::size_t, Block66 >::iterator itI = itBegin; itI != col.end(); ++itI )
+				for ( typename std::map< std::size_t, Block66 >::iterator itJ = itBegin; itJ->first <= itI->first; ++itJ )
+				{
+					noalias( lowerBlock( S, itI->first, itJ->first ) ) -= ublas::prod( itI->second, ublas::trans( itJ->second ) );
+					if ( itJ == itI )
+						break;
+				}
+		}
+
+		// forward substitution
+		for ( std::size_t k = 0; k < S.size(); k++ )
+		{
+			typename std::map< std::size_t, Block66 >::iterator it = S[ k ].find( k );
+			Math::triangular_solve_lower( it->second, dPose[ k ] );
+			for ( ++it; it != S[ k ].end(); ++it )
+				noalias( dPose[ it->first ] ) -= ublas::prod( it->second, dPose[ k ] );
+		}
+
+		// backward substitution
+		for ( std::size_t k = S.size(); k-- > 0; )
+		{
+			typename std::map< std::size_t, Block66 >::iterator itDiag = S[ k ].find( k );
+			typename std::map< std::size_t, Block66 >::iterator it = itDiag;
+			for ( ++it; it != S[ k ].end(); ++it )
+				noalias( dPose[ k ] ) -= ublas::prod( ublas::trans( it->second ), dPose[ it->first ] );
+			Math::triangular_solve_lower_trans( itDiag->second, dPose[ k ] );
+		}
+
+		// back-substitute the points: dp = V^-1 ( g_p - W^T dx )
+		for ( std::size_t iP = 0; iP < m_points.size(); iP++ )
+		{
+			Vector3 g( m_gPoint[ iP ] );
+			const std::vector< std::size_t >& obs( m_pointObservations[ iP ] );
+			for ( std::size_t a = 0; a < obs.size(); a++ )
+				noalias( g ) -= ublas::prod( ublas::trans( m_W[ obs[ a ] ] ), dPose[ m_observations[ obs[ a ] ].iImage ] );
+			noalias( dPoint[ iP ] ) = ublas::prod( m_Vinv[ iP ], g );
+		}
+
+		return true;
+	}
+
+	/** updates the network from the optimized parameters */
+	void writeBack()
+	{
+		m_net.points = m_points;
+		for ( std::size_t i = 0; i < m_nBodyBlocks; i++ )
+			m_net.bodyPoses[ i + 1 ] = poseFromBlock( m_poses[ i ] );
+		for ( std::size_t i = 0; i < m_net.images.size(); i++ )
+			m_net.images[ i ] = poseFromBlock( m_poses[ m_nBodyBlocks + i ] );
+	}
+
+	BundleAdjustmentNetwork< T >& m_net;
+
+	/** number of optimized body poses */
+	const std::size_t m_nBodyBlocks;
+
+	/** body poses followed by image poses */
+	std::vector< PoseBlock< T > > m_poses;
+
+	/** free points */
+	std::vector< Vector3 > m_points;
+
+	std::vector< Observation< T > > m_observations;
+
+	/** indices of the observations of each free point */
+	std::vector< std::vector< std::size_t > > m_pointObservations;
+
+	/** pose-pose part of the normal equations */
+	BlockColumns m_U;
+
+	/** point-point part of the normal equations (block diagonal) */
+	std::vector< Block33 > m_V;
+
+	/** inverse of the damped point blocks of the last solve */
+	std::vector< Block33 > m_Vinv;
+
+	/** pose-point coupling, one block per observation */
+	std::vector< Block63 > m_W;
+
+	/** right hand sides J^T r */
+	std::vector< Vector6 > m_gPose;
+	std::vector< Vector3 > m_gPoint;
+};
+
+template< class T >
+T sparseBundleAdjustmentImpl( BundleAdjustmentNetwork< T >& net, std::size_t maxIterations, double precision )
+{
+	SparseBundleAdjustmentEngine< T > engine( net );
+	return engine.optimize( Math::Optimization::OptTerminate( maxIterations, precision ) );
+}
+
+} // anonymous namespace
+
+
+double sparseBundleAdjustment( BundleAdjustmentNetwork< double >& net, std::size_t maxIterations, double precision )
+{
+	return sparseBundleAdjustmentImpl( net, maxIterations, precision );
+}
+
+float sparseBundleAdjustment( BundleAdjustmentNetwork< float >& net, std::size_t maxIterations, double precision )
+{
+	return sparseBundleAdjustmentImpl( net, maxIterations, precision );
+}
+
+} } // namespace Ubitrack::Algorithm
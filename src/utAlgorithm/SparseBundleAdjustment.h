@@ -0,0 +1,70 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking_algorithms
+ * @file
+ * Sparse Levenberg-Marquardt bundle adjustment using the Schur complement.
+ */
+
+#ifndef __UBITRACK_ALGORITHM_SPARSEBUNDLEADJUSTMENT_H_INCLUDED__
+#define __UBITRACK_ALGORITHM_SPARSEBUNDLEADJUSTMENT_H_INCLUDED__
+
+#include <utCore.h>
+#include "BundleAdjustmentNetwork.h"
+
+namespace Ubitrack { namespace Algorithm {
+
+/**
+ * @ingroup tracking_algorithms
+ * Performs a sparse bundle adjustment of a \c BundleAdjustmentNetwork.
+ *
+ * The parametrization and measurement model are the same as in \c BundleAdjustmentFunction
+ * (see Function/BundleAdjustment.h), but the dense \c measurementSize() x \c parameterSize()
+ * jacobian is never formed. Instead, every observation stores its 2x6 (image pose), 2x6 (body pose)
+ * and 2x3 (point) jacobian blocks. Each Levenberg-Marquardt step eliminates the 3x3 point blocks
+ * with the Schur complement and solves the resulting reduced system over the 6-DOF pose blocks
+ * with a block-sparse Cholesky factorization. Time and memory thus grow linearly with the number
+ * of points and observations.
+ *
+ * Trial steps only evaluate residuals, the jacobian blocks are recomputed after a step is accepted.
+ *
+ * Estimation of the intrinsic parameters (\c bEstimateIntrinsics) is not supported and results
+ * in an exception.
+ *
+ * Note: also exists with \c float parameters.
+ *
+ * @param net the network, updated in place
+ * @param maxIterations maximum number of Levenberg-Marquardt iterations
+ * @param precision stops if the residual changes by less than residual * precision
+ * @return the sum of squared reprojection errors after optimization
+ */
+UBITRACK_EXPORT double sparseBundleAdjustment( BundleAdjustmentNetwork< double >& net,
+	std::size_t maxIterations = 20, double precision = 1e-6 );
+
+UBITRACK_EXPORT float sparseBundleAdjustment( BundleAdjustmentNetwork< float >& net,
+	std::size_t maxIterations = 20, double precision = 1e-6 );
+
+} } // namespace Ubitrack::Algorithm
+
+#endif // __UBITRACK_ALGORITHM_SPARSEBUNDLEADJUSTMENT_H_INCLUDED__
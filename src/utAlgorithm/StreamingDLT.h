@@ -0,0 +1,301 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking_algorithms
+ * @file
+ * Homography and projection matrix estimation from incrementally accumulated normal equations.
+ */
+
+#ifndef __UBITRACK_ALGORITHM_STREAMINGDLT_H_INCLUDED__
+#define __UBITRACK_ALGORITHM_STREAMINGDLT_H_INCLUDED__
+
+#ifdef HAVE_LAPACK
+
+#include <algorithm> // std::max
+#include <cmath>
+
+#include <utUtil/Exception.h>
+#include <utMath/Matrix.h>
+#include <utMath/Vector.h>
+#include <utMath/Geometry/PointNormalization.h>
+
+#include <boost/numeric/bindings/lapack/syev.hpp>
+
+namespace Ubitrack { namespace Algorithm {
+
+/**
+ * @ingroup tracking_algorithms
+ * Linear DLT estimation of a homography ( \c N = 2 ) or a 3x4 projection matrix ( \c N = 3 )
+ * from correspondences that are added and removed one at a time.
+ *
+ * Instead of the 2n x 3(N+1) equation system of \c homographyDLT and \c projectionDLT, only
+ * the 3(N+1) x 3(N+1) matrix A^T A and the first and second moments of the points are stored.
+ * Adding or removing a correspondence costs O(1), so e.g. a homography over a sliding window
+ * can be updated for every new point. \c compute solves the normalized problem with a symmetric
+ * eigendecomposition and gives the same result as the batch functions, up to the precision lost
+ * by forming the normal equations.
+ *
+ * The equations are accumulated in double precision relative to the first correspondence, and
+ * the normalization of Hartley & Zisserman is applied in \c compute for the current point set.
+ * A correspondence that is removed must have been added before.
+ *
+ * Example use case:\n
+ @code
+ StreamingDLT< double, 2 > dlt;
+ for ( std::size_t i = 0; i < fromPoints.size(); i++ )
+ {
+	dlt.add( fromPoints[ i ], toPoints[ i ] );
+	if ( i >= 100 )
+		dlt.remove( fromPoints[ i - 100 ], toPoints[ i - 100 ] );
+	if ( i >= 3 )
+		H = dlt.compute();
+ }
+ @endcode
+ *
+ * @tparam T type of the points and the result ( \c float or \c double )
+ * @tparam N dimension of the source points, 2 for homographies, 3 for projection matrices
+ */
+template< typename T, std::size_t N >
+class StreamingDLT
+{
+public:
+	/** the estimated matrix, maps homogeneous N-vectors to homogeneous 2-vectors */
+	typedef Math::Matrix< T, 3, N + 1 > result_type;
+
+	/** number of unknowns of the equation system */
+	static const std::size_t nUnknowns = 3 * ( N + 1 );
+
+	/** number of correspondences required by \c compute */
+	static const std::size_t minCorrespondences = N == 2 ? 4 : 6;
+
+	StreamingDLT()
+	{ clear(); }
+
+	/** removes all correspondences */
+	void clear()
+	{
+		m_size = 0;
+		for ( std::size_t i = 0; i < N; i++ )
+			m_fromRef[ i ] = m_fromSum[ i ] = m_fromSqSum[ i ] = 0;
+		for ( std::size_t i = 0; i < 2; i++ )
+			m_toRef[ i ] = m_toSum[ i ] = m_toSqSum[ i ] = 0;
+		for ( std::size_t i = 0; i < nUnknowns * nUnknowns; i++ )
+			m_ata[ 0 ][ i ] = m_ata[ 1 ][ i ] = 0;
+	}
+
+	/** adds a correspondence x -> x' */
+	void add( const Math::Vector< T, N >& from, const Math::Vector< T, 2 >& to )
+	{
+		if ( m_size == 0 )
+		{
+			// all sums are relative to the first point to avoid cancellation
+			for ( std::size_t i = 0; i < N; i++ )
+				m_fromRef[ i ] = from( i );
+			for ( std::size_t i = 0; i < 2; i++ )
+				m_toRef[ i ] = to( i );
+		}
+		m_size++;
+		update( from, to, 1.0 );
+	}
+
+	/** adds the correspondences [ iFromBegin, iFromEnd ) -> [ iToBegin, ... ) */
+	template< class FromIterator, class ToIterator >
+	void add( FromIterator iFromBegin, const FromIterator iFromEnd, ToIterator iToBegin )
+	{
+		for ( ; iFromBegin != iFromEnd; ++iFromBegin, ++iToBegin )
+			add( *iFromBegin, *iToBegin );
+	}
+
+	/** removes a correspondence that was added before */
+	void remove( const Math::Vector< T, N >& from, const Math::Vector< T, 2 >& to )
+	{
+		if ( m_size == 0 )
+			UBITRACK_THROW( "Cannot remove a correspondence from an empty DLT" );
+		update( from, to, -1.0 );
+		if ( --m_size == 0 )
+			clear();
+	}
+
+	/** number of correspondences */
+	std::size_t size() const
+	{ return m_size; }
+
+	/**
+	 * Computes the matrix H with x' = Hx from the current correspondences.
+	 * Projection matrices are scaled to a viewing direction of length 1 with the
+	 * centroid of the 3D points in front of the camera, like \c projectionDLT does.
+	 */
+	result_type compute() const
+	{
+		if ( m_size < minCorrespondences )
+			UBITRACK_THROW( "Not enough correspondences for DLT" );
+
+		// normalization parameters of the current point set, relative to the reference point
+		Math::Vector< double, N > fromShift;
+		Math::Vector< double, N > fromScale;
+		for ( std::size_t i = 0; i < N; i++ )
+			moments( m_fromSum[ i ], m_fromSqSum[ i ], fromShift( i ), fromScale( i ) );
+		Math::Vector< double, 2 > toShift;
+		Math::Vector< double, 2 > toScale;
+		for ( std::size_t i = 0; i < 2; i++ )
+			moments( m_toSum[ i ], m_toSqSum[ i ], toShift( i ), toScale( i ) );
+
+		// A^T A is accumulated for the unknowns of G_t^-1 H_n G_f, where G_f and G_t map the
+		// accumulated coordinates to normalized ones. The second equation row of each point is
+		// scaled relative to the first by the normalization of x'.
+		const Math::Matrix< double, N + 1, N + 1 > fromCorrect(
+			Math::Geometry::generateNormalizationMatrix( fromShift, fromScale, false ) );
+		const Math::Matrix< double, 3, 3 > toCorrectInv(
+			Math::Geometry::generateNormalizationMatrix( toShift, toScale, true ) );
+
+		Math::Matrix< double, nUnknowns, nUnknowns > L;
+		for ( std::size_t r1 = 0; r1 < 3; r1++ )
+			for ( std::size_t c1 = 0; c1 <= N; c1++ )
+				for ( std::size_t r2 = 0; r2 < 3; r2++ )
+					for ( std::size_t c2 = 0; c2 <= N; c2++ )
+						L( r1 * ( N + 1 ) + c1, r2 * ( N + 1 ) + c2 ) = toCorrectInv( r1, r2 ) * fromCorrect( c2, c1 );
+
+		const double w0 = toScale( 0 ) * toScale( 0 );
+		const double w1 = toScale( 1 ) * toScale( 1 );
+		Math::Matrix< double, nUnknowns, nUnknowns > M;
+		for ( std::size_t i = 0; i < nUnknowns; i++ )
+			for ( std::size_t j = i; j < nUnknowns; j++ )
+				M( i, j ) = M( j, i ) = w0 * m_ata[ 0 ][ i * nUnknowns + j ] + w1 * m_ata[ 1 ][ i * nUnknowns + j ];
+
+		const Math::Matrix< double, nUnknowns, nUnknowns > ML( boost::numeric::ublas::prod( M, L ) );
+		Math::Matrix< double, nUnknowns, nUnknowns > C( boost::numeric::ublas::prod( boost::numeric::ublas::trans( L ), ML ) );
+
+		// the solution is the eigenvector of the smallest eigenvalue, which lapack returns first
+		Math::Vector< double, nUnknowns > eigenvalues;
+		if ( boost::numeric::bindings::lapack::syev( 'V', 'U', C, eigenvalues, boost::numeric::bindings::lapack::minimal_workspace() ) != 0 )
+			UBITRACK_THROW( "Eigenvalue decomposition for DLT failed" );
+
+		Math::Matrix< double, 3, N + 1 > Hn;
+		for ( std::size_t r = 0; r < 3; r++ )
+			for ( std::size_t c = 0; c <= N; c++ )
+				Hn( r, c ) = C( r * ( N + 1 ) + c, 0 );
+
+		// reverse normalization, including the shift to the reference point
+		for ( std::size_t i = 0; i < N; i++ )
+			fromShift( i ) += m_fromRef[ i ];
+		for ( std::size_t i = 0; i < 2; i++ )
+			toShift( i ) += m_toRef[ i ];
+		const Math::Matrix< double, 3, 3 > toDenormalize(
+			Math::Geometry::generateNormalizationMatrix( toShift, toScale, true ) );
+		const Math::Matrix< double, N + 1, N + 1 > fromNormalize(
+			Math::Geometry::generateNormalizationMatrix( fromShift, fromScale, false ) );
+		const Math::Matrix< double, 3, N + 1 > Htemp( boost::numeric::ublas::prod( toDenormalize, Hn ) );
+		Math::Matrix< double, 3, N + 1 > H( boost::numeric::ublas::prod( Htemp, fromNormalize ) );
+
+		if ( N == 3 )
+		{
+			// viewing direction of length 1, centroid in front of the camera
+			double fViewDirLen = std::sqrt( H( 2, 0 ) * H( 2, 0 ) + H( 2, 1 ) * H( 2, 1 ) + H( 2, 2 ) * H( 2, 2 ) );
+			double z = H( 2, N );
+			for ( std::size_t i = 0; i < N; i++ )
+				z += H( 2, i ) * fromShift( i );
+			if ( z < 0 )
+				fViewDirLen = -fViewDirLen;
+			H *= 1.0 / fViewDirLen;
+		}
+
+		result_type result;
+		for ( std::size_t r = 0; r < 3; r++ )
+			for ( std::size_t c = 0; c <= N; c++ )
+				result( r, c ) = static_cast< T >( H( r, c ) );
+		return result;
+	}
+
+protected:
+	/** adds the equations of one correspondence with weight +1 or -1 */
+	void update( const Math::Vector< T, N >& from, const Math::Vector< T, 2 >& to, const double w )
+	{
+		double x[ N + 1 ];
+		for ( std::size_t i = 0; i < N; i++ )
+		{
+			x[ i ] = from( i ) - m_fromRef[ i ];
+			m_fromSum[ i ] += w * x[ i ];
+			m_fromSqSum[ i ] += w * x[ i ] * x[ i ];
+		}
+		x[ N ] = 1;
+
+		const double u = to( 0 ) - m_toRef[ 0 ];
+		const double v = to( 1 ) - m_toRef[ 1 ];
+		m_toSum[ 0 ] += w * u;
+		m_toSum[ 1 ] += w * v;
+		m_toSqSum[ 0 ] += w * u * u;
+		m_toSqSum[ 1 ] += w * v * v;
+
+		// the two equations [ 0, -x, v x ] and [ x, 0, -u x ] of the DLT
+		double a[ 2 ][ nUnknowns ];
+		for ( std::size_t i = 0; i <= N; i++ )
+		{
+			a[ 0 ][ i ] = 0;
+			a[ 0 ][ N + 1 + i ] = -x[ i ];
+			a[ 0 ][ 2 * ( N + 1 ) + i ] = v * x[ i ];
+			a[ 1 ][ i ] = x[ i ];
+			a[ 1 ][ N + 1 + i ] = 0;
+			a[ 1 ][ 2 * ( N + 1 ) + i ] = -u * x[ i ];
+		}
+
+		// upper triangles only
+		for ( std::size_t k = 0; k < 2; k++ )
+			for ( std::size_t i = 0; i < nUnknowns; i++ )
+			{
+				const double wa = w * a[ k ][ i ];
+				double* pRow = m_ata[ k ] + i * nUnknowns;
+				for ( std::size_t j = i; j < nUnknowns; j++ )
+					pRow[ j ] += wa * a[ k ][ j ];
+			}
+	}
+
+	/** mean and standard deviation from the sums over the current points */
+	void moments( const double sum, const double sqSum, double& mean, double& deviation ) const
+	{
+		mean = sum / m_size;
+		deviation = std::sqrt( std::max( sqSum / m_size - mean * mean, 0.0 ) );
+	}
+
+	/** number of correspondences */
+	std::size_t m_size;
+
+	/** the first correspondence, all sums are relative to it */
+	double m_fromRef[ N ];
+	double m_toRef[ 2 ];
+
+	/** first and second moments of the points */
+	double m_fromSum[ N ];
+	double m_fromSqSum[ N ];
+	double m_toSum[ 2 ];
+	double m_toSqSum[ 2 ];
+
+	/** A^T A of the first and second equation rows, row-major */
+	double m_ata[ 2 ][ nUnknowns * nUnknowns ];
+};
+
+} } // namespace Ubitrack::Algorithm
+
+#endif // HAVE_LAPACK
+
+#endif // __UBITRACK_ALGORITHM_STREAMINGDLT_H_INCLUDED__
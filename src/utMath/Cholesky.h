@@ -0,0 +1,194 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Inline Cholesky factorization for small symmetric positive definite matrices.
+ *
+ * In contrast to the lapack routines (\c posv, \c potrf) these functions work directly
+ * on the elements of stack allocated \c Math::Matrix< T, N, N > objects and do not
+ * allocate any memory. They are meant for the many tiny systems (2x2 up to ~20x20)
+ * that appear in the inner loops of the optimizers and filters.
+ */
+
+
+#ifndef __UBITRACK_MATH_CHOLESKY_H_INCLUDED__
+#define __UBITRACK_MATH_CHOLESKY_H_INCLUDED__
+
+#include <cmath> // std::sqrt
+#include <cstddef> // std::size_t
+
+
+namespace Ubitrack { namespace Math {
+
+/**
+ * Computes the Cholesky factor L of a symmetric positive definite matrix A = L * L^T in place.
+ *
+ * Only the lower triangle of \c a is read. On exit the lower triangle contains L, the
+ * strict upper triangle is left untouched.
+ *
+ * @tparam M a matrix type supporting \c operator()( i, j ) and \c size1()
+ * @param a symmetric matrix on entry, Cholesky factor (lower triangle) on exit
+ * @return \c false if the matrix is not (numerically) positive definite
+ */
+template< class M >
+bool cholesky_factor( M& a )
+{
+	typedef typename M::value_type T;
+	const std::size_t n = a.size1();
+
+	for ( std::size_t j = 0; j < n; ++j )
+	{
+		T d = a( j, j );
+		for ( std::size_t k = 0; k < j; ++k )
+			d -= a( j, k ) * a( j, k );
+
+		if ( !( d > T( 0 ) ) )
+			return false;
+
+		const T ljj = std::sqrt( d );
+		a( j, j ) = ljj;
+
+		const T inv = T( 1 ) / ljj;
+		for ( std::size_t i = j + 1; i < n; ++i )
+		{
+			T s = a( i, j );
+			for ( std::size_t k = 0; k < j; ++k )
+				s -= a( i, k ) * a( j, k );
+			a( i, j ) = s * inv;
+		}
+	}
+	return true;
+}
+
+/**
+ * Solves L * y = b in place by forward substitution.
+ *
+ * @param l matrix holding a lower triangular matrix (e.g. a Cholesky factor)
+ * @param b right hand side on entry, solution on exit
+ */
+template< class M, class V >
+void triangular_solve_lower( const M& l, V& b )
+{
+	typedef typename M::value_type T;
+	const std::size_t n = l.size1();
+
+	for ( std::size_t i = 0; i < n; ++i )
+	{
+		T s = b( i );
+		for ( std::size_t k = 0; k < i; ++k )
+			s -= l( i, k ) * b( k );
+		b( i ) = s / l( i, i );
+	}
+}
+
+/**
+ * Solves L^T * x = b in place by backward substitution.
+ *
+ * @param l matrix holding a lower triangular matrix (e.g. a Cholesky factor)
+ * @param b right hand side on entry, solution on exit
+ */
+template< class M, class V >
+void triangular_solve_lower_trans( const M& l, V& b )
+{
+	typedef typename M::value_type T;
+	const std::size_t n = l.size1();
+
+	for ( std::size_t i = n; i-- > 0; )
+	{
+		T s = b( i );
+		for ( std::size_t k = i + 1; k < n; ++k )
+			s -= l( k, i ) * b( k );
+		b( i ) = s / l( i, i );
+	}
+}
+
+/**
+ * Solves L * L^T * x = b in place, given the Cholesky factor computed by \c cholesky_factor.
+ *
+ * @param l matrix holding the Cholesky factor in its lower triangle
+ * @param b right hand side on entry, solution on exit
+ */
+template< class M, class V >
+void cholesky_solve( const M& l, V& b )
+{
+	triangular_solve_lower( l, b );
+	triangular_solve_lower_trans( l, b );
+}
+
+/**
+ * Solves L * L^T * X = B in place for all columns of B.
+ *
+ * @param l matrix holding the Cholesky factor in its lower triangle
+ * @param b right hand side matrix on entry, solution on exit
+ */
+template< class M, class MB >
+void cholesky_solve_matrix( const M& l, MB& b )
+{
+	typedef typename M::value_type T;
+	const std::size_t n = l.size1();
+
+	for ( std::size_t c = 0; c < b.size2(); ++c )
+	{
+		for ( std::size_t i = 0; i < n; ++i )
+		{
+			T s = b( i, c );
+			for ( std::size_t k = 0; k < i; ++k )
+				s -= l( i, k ) * b( k, c );
+			b( i, c ) = s / l( i, i );
+		}
+
+		for ( std::size_t i = n; i-- > 0; )
+		{
+			T s = b( i, c );
+			for ( std::size_t k = i + 1; k < n; ++k )
+				s -= l( k, i ) * b( k, c );
+			b( i, c ) = s / l( i, i );
+		}
+	}
+}
+
+/**
+ * Computes the (full, symmetric) inverse of A = L * L^T from its Cholesky factor.
+ *
+ * @param l matrix holding the Cholesky factor in its lower triangle
+ * @param inv matrix of the same size receiving the inverse
+ */
+template< class M, class MI >
+void cholesky_invert( const M& l, MI& inv )
+{
+	typedef typename M::value_type T;
+	const std::size_t n = l.size1();
+
+	for ( std::size_t i = 0; i < n; ++i )
+		for ( std::size_t j = 0; j < n; ++j )
+			inv( i, j ) = ( i == j ) ? T( 1 ) : T( 0 );
+
+	cholesky_solve_matrix( l, inv );
+}
+
+} } // namespace Ubitrack::Math
+
+#endif // __UBITRACK_MATH_CHOLESKY_H_INCLUDED__
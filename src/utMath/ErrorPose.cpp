@@ -491,11 +491,9 @@ ErrorPose ErrorPose::operator~() const
 {
 	// covariance transform
 	Matrix< double, 6, 6 > jacobian;
-	Matrix< double, 6, 6 > tmp;
 	Matrix< double, 6, 6 > newCovariance;
 	inversionJacobian( jacobian, *this );
-	noalias( tmp ) = ublas::prod( jacobian, m_covariance );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian ) );
+	Stochastic::transformCovariance( jacobian, m_covariance, newCovariance );
 
 	return ErrorPose( Pose::operator~(), newCovariance );
 }
@@ -506,15 +504,12 @@ ErrorPose operator*( const ErrorPose& a, const ErrorPose& b )
 	// covariance transform
 	Matrix< double, 6, 6 > jacobian1;
 	Matrix< double, 6, 6 > jacobian2;
-	Matrix< double, 6, 6 > tmp;
 	Matrix< double, 6, 6 > newCovariance;
 	multiplicationJacobians( jacobian1, jacobian2, a, b );
 	
 	// here we could save some time by regarding the zero and identity blocks of the jacobians...
-	noalias( tmp ) = ublas::prod( jacobian1, a.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian1 ) );
-	noalias( tmp ) = ublas::prod( jacobian2, b.covariance() );
-	noalias( newCovariance ) += ublas::prod( tmp, ublas::trans( jacobian2 ) );
+	Stochastic::transformCovariance( jacobian1, a.covariance(), newCovariance );
+	Stochastic::transformCovariance( jacobian2, b.covariance(), newCovariance, true );
 
 	return ErrorPose( static_cast< const Pose& >( a ) * static_cast< const Pose& >( b ), newCovariance );
 }
@@ -525,13 +520,11 @@ ErrorPose operator*( const Pose& a, const ErrorPose& b )
 	// covariance transform
 	Matrix< double, 6, 6 > jacobian1;
 	Matrix< double, 6, 6 > jacobian2;
-	Matrix< double, 6, 6 > tmp;
 	Matrix< double, 6, 6 > newCovariance;
 	multiplicationJacobians( jacobian1, jacobian2, a, b );
 	
 	// here we could save some time by regarding the zero and identity blocks of the jacobians...
-	noalias( tmp ) = ublas::prod( jacobian2, b.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian2 ) );
+	Stochastic::transformCovariance( jacobian2, b.covariance(), newCovariance );
 
 	return ErrorPose( static_cast< const Pose& >( a ) * static_cast< const Pose& >( b ), newCovariance );
 }
@@ -542,13 +535,11 @@ ErrorPose operator*( const ErrorPose& a, const Pose& b )
 	// covariance transform
 	Matrix< double, 6, 6 > jacobian1;
 	Matrix< double, 6, 6 > jacobian2;
-	Matrix< double, 6, 6 > tmp;
 	Matrix< double, 6, 6 > newCovariance;
 	multiplicationJacobians( jacobian1, jacobian2, a, b );
 
 	// here we could save some time by regarding the zero and identity blocks of the jacobians...
-	noalias( tmp ) = ublas::prod( jacobian1, a.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian1 ) );
+	Stochastic::transformCovariance( jacobian1, a.covariance(), newCovariance );
 
 	return ErrorPose( static_cast< const Pose& >( a ) * static_cast< const Pose& >( b ), newCovariance );
 }
@@ -560,11 +551,8 @@ ErrorVector< double, 3 > operator*( const ErrorPose& a, const Math::Vector< doub
 	Matrix< double, 3, 6 > jacobian;
 	errorPoseTimesVectorJacobian( jacobian, a, b );
 
-	Matrix< double, 3, 6 > tmp;
 	Matrix< double, 3, 3 > newCovariance;
-
-	noalias( tmp ) = ublas::prod( jacobian, a.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian ) );
+	Stochastic::transformCovariance( jacobian, a.covariance(), newCovariance );
 
 	return ErrorVector< double, 3 >( static_cast< const Pose& >( a ) * b, newCovariance );
 }
@@ -578,11 +566,8 @@ ErrorVector< double, 3 > operator*( const ErrorPose& a, const Math::ErrorVector<
 	Matrix< double, 3, 6 > jacobian;
 	errorPoseTimesVectorJacobian( jacobian, a, b.value );
 
-	Matrix< double, 3, 6 > tmp;
 	Matrix< double, 3, 3 > newCovariance;
-
-	noalias( tmp ) = ublas::prod( jacobian, a.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian ) );
+	Stochastic::transformCovariance( jacobian, a.covariance(), newCovariance );
 
 	return ErrorVector< double, 3 >( static_cast< const Pose& >( a ) * b.value, newCovariance );
 }
@@ -593,15 +578,12 @@ ErrorPose invertMultiply( const ErrorPose& a, const ErrorPose& b )
 	// covariance transform
 	Matrix< double, 6, 6 > jacobian1;
 	Matrix< double, 6, 6 > jacobian2;
-	Matrix< double, 6, 6 > tmp;
 	Matrix< double, 6, 6 > newCovariance;
 	multiplicationJacobians( jacobian1, jacobian2, a, b );
 	
 	// here we could save some time by regarding the zero and identity blocks of the jacobians...
-	noalias( tmp ) = ublas::prod( jacobian1, a.covariance() );
-	noalias( newCovariance ) = ublas::prod( tmp, ublas::trans( jacobian1 ) );
-	noalias( tmp ) = ublas::prod( jacobian2, b.covariance() );
-	noalias( newCovariance ) += ublas::prod( tmp, ublas::trans( jacobian2 ) );
+	Stochastic::transformCovariance( jacobian1, a.covariance(), newCovariance );
+	Stochastic::transformCovariance( jacobian2, b.covariance(), newCovariance, true );
 
 	return ErrorPose( ~static_cast< const Pose& >( a ) * static_cast< const Pose& >( b ), newCovariance );
 }
@@ -617,7 +599,7 @@ void ErrorPose::toAdditiveErrorVector( ErrorVector< double, 7 >& v )
 	// set the w variance to the sum of the x, y, and z rotation errors
 	v.covariance( 6, 6 ) = v.covariance( 3, 3 ) + v.covariance( 4, 4 ) + v.covariance( 5, 5 );
 
-	Stochastic::transformRangeInternalWithCovariance< 7 >( ErrorConversion( rotation() ), v, 3, 7, 3, 7 );
+	Stochastic::transformRangeInternalWithCovariance< 4, 4 >( ErrorConversion( rotation() ), v.value, v.covariance, 3, 3 );
 }
 
 
@@ -625,7 +607,7 @@ ErrorPose ErrorPose::fromAdditiveErrorVector( const ErrorVector< double, 7 >& v
 {
 	Math::ErrorVector< double, 7 > p( v );
 	Quaternion q( Quaternion::fromVector( ublas::subrange( v.value, 3, 7 ) ) );
-	Stochastic::transformRangeInternalWithCovariance< 7 >( ErrorConversion( ~q ), p, 3, 7, 3, 7 );
+	Stochastic::transformRangeInternalWithCovariance< 4, 4 >( ErrorConversion( ~q ), p.value, p.covariance, 3, 3 );
 	
 	return ErrorPose( Pose::fromVector( p.value ), ublas::subrange( p.covariance, 0, 6, 0, 6 ) );
 }
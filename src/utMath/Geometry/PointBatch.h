@@ -0,0 +1,579 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math geometry
+ * @file
+ * Vectorized projection and transformation of batches of points.
+ */
+
+#ifndef __UBITRACK_MATH_GEOMETRY_POINTBATCH_H_INCLUDED__
+#define __UBITRACK_MATH_GEOMETRY_POINTBATCH_H_INCLUDED__
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/VectorList.h>
+
+#include "../Util/type_traits.h"
+
+#include <algorithm> // std::min
+#include <iterator>
+#include <vector>
+
+// the widest instruction set enabled at compile time is used, e.g. -mavx or /arch:AVX
+#if defined( __AVX__ )
+	#include <immintrin.h>
+	#define UBITRACK_POINTBATCH_AVX
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	#include <emmintrin.h>
+	#define UBITRACK_POINTBATCH_SSE2
+#endif
+
+namespace Ubitrack { namespace Math { namespace Geometry {
+
+namespace detail {
+
+/** @internal scalar operations, used without SIMD support and for the remainder of a batch */
+template< typename T >
+struct ScalarOps
+{
+	typedef T type;
+	static const std::size_t width = 1;
+	static type set1( T a ) { return a; }
+	static type load( const T* p ) { return *p; }
+	static void store( T* p, type a ) { *p = a; }
+	static type gather( const char* p, std::size_t ) { return *reinterpret_cast< const T* >( p ); }
+	static void scatter( char* p, std::size_t, type a ) { *reinterpret_cast< T* >( p ) = a; }
+	static type add( type a, type b ) { return a + b; }
+	static type mul( type a, type b ) { return a * b; }
+	static type div( type a, type b ) { return a / b; }
+};
+
+/** @internal widest SIMD operations available for a type */
+template< typename T >
+struct SimdOps
+	: public ScalarOps< T >
+{};
+
+#if defined( UBITRACK_POINTBATCH_AVX )
+
+template<>
+struct SimdOps< double >
+{
+	typedef __m256d type;
+	static const std::size_t width = 4;
+	static type set1( double a ) { return _mm256_set1_pd( a ); }
+	static type load( const double* p ) { return _mm256_loadu_pd( p ); }
+	static void store( double* p, type a ) { _mm256_storeu_pd( p, a ); }
+	static type gather( const char* p, std::size_t s )
+	{
+		return _mm256_setr_pd( *reinterpret_cast< const double* >( p ), *reinterpret_cast< const double* >( p + s ),
+			*reinterpret_cast< const double* >( p + 2 * s ), *reinterpret_cast< const double* >( p + 3 * s ) );
+	}
+	static void scatter( char* p, std::size_t s, type a )
+	{
+		const __m128d lo( _mm256_castpd256_pd128( a ) );
+		const __m128d hi( _mm256_extractf128_pd( a, 1 ) );
+		_mm_storel_pd( reinterpret_cast< double* >( p ), lo );
+		_mm_storeh_pd( reinterpret_cast< double* >( p + s ), lo );
+		_mm_storel_pd( reinterpret_cast< double* >( p + 2 * s ), hi );
+		_mm_storeh_pd( reinterpret_cast< double* >( p + 3 * s ), hi );
+	}
+	static type add( type a, type b ) { return _mm256_add_pd( a, b ); }
+	static type mul( type a, type b ) { return _mm256_mul_pd( a, b ); }
+	static type div( type a, type b ) { return _mm256_div_pd( a, b ); }
+};
+
+template<>
+struct SimdOps< float >
+{
+	typedef __m256 type;
+	static const std::size_t width = 8;
+	static type set1( float a ) { return _mm256_set1_ps( a ); }
+	static type load( const float* p ) { return _mm256_loadu_ps( p ); }
+	static void store( float* p, type a ) { _mm256_storeu_ps( p, a ); }
+	static type gather( const char* p, std::size_t s )
+	{
+		return _mm256_setr_ps( *reinterpret_cast< const float* >( p ), *reinterpret_cast< const float* >( p + s ),
+			*reinterpret_cast< const float* >( p + 2 * s ), *reinterpret_cast< const float* >( p + 3 * s ),
+			*reinterpret_cast< const float* >( p + 4 * s ), *reinterpret_cast< const float* >( p + 5 * s ),
+			*reinterpret_cast< const float* >( p + 6 * s ), *reinterpret_cast< const float* >( p + 7 * s ) );
+	}
+	static void scatter( char* p, std::size_t s, type a )
+	{
+		scatter4( p, s, _mm256_castps256_ps128( a ) );
+		scatter4( p + 4 * s, s, _mm256_extractf128_ps( a, 1 ) );
+	}
+	static void scatter4( char* p, std::size_t s, __m128 a )
+	{
+		_mm_store_ss( reinterpret_cast< float* >( p ), a );
+		_mm_store_ss( reinterpret_cast< float* >( p + s ), _mm_shuffle_ps( a, a, 1 ) );
+		_mm_store_ss( reinterpret_cast< float* >( p + 2 * s ), _mm_shuffle_ps( a, a, 2 ) );
+		_mm_store_ss( reinterpret_cast< float* >( p + 3 * s ), _mm_shuffle_ps( a, a, 3 ) );
+	}
+	static type add( type a, type b ) { return _mm256_add_ps( a, b ); }
+	static type mul( type a, type b ) { return _mm256_mul_ps( a, b ); }
+	static type div( type a, type b ) { return _mm256_div_ps( a, b ); }
+};
+
+#elif defined( UBITRACK_POINTBATCH_SSE2 )
+
+template<>
+struct SimdOps< double >
+{
+	typedef __m128d type;
+	static const std::size_t width = 2;
+	static type set1( double a ) { return _mm_set1_pd( a ); }
+	static type load( const double* p ) { return _mm_loadu_pd( p ); }
+	static void store( double* p, type a ) { _mm_storeu_pd( p, a ); }
+	static type gather( const char* p, std::size_t s )
+	{ return _mm_loadh_pd( _mm_load_sd( reinterpret_cast< const double* >( p ) ), reinterpret_cast< const double* >( p + s ) ); }
+	static void scatter( char* p, std::size_t s, type a )
+	{
+		_mm_storel_pd( reinterpret_cast< double* >( p ), a );
+		_mm_storeh_pd( reinterpret_cast< double* >( p + s ), a );
+	}
+	static type add( type a, type b ) { return _mm_add_pd( a, b ); }
+	static type mul( type a, type b ) { return _mm_mul_pd( a, b ); }
+	static type div( type a, type b ) { return _mm_div_pd( a, b ); }
+};
+
+template<>
+struct SimdOps< float >
+{
+	typedef __m128 type;
+	static const std::size_t width = 4;
+	static type set1( float a ) { return _mm_set1_ps( a ); }
+	static type load( const float* p ) { return _mm_loadu_ps( p ); }
+	static void store( float* p, type a ) { _mm_storeu_ps( p, a ); }
+	static type gather( const char* p, std::size_t s )
+	{
+		return _mm_setr_ps( *reinterpret_cast< const float* >( p ), *reinterpret_cast< const float* >( p + s ),
+			*reinterpret_cast< const float* >( p + 2 * s ), *reinterpret_cast< const float* >( p + 3 * s ) );
+	}
+	static void scatter( char* p, std::size_t s, type a )
+	{
+		_mm_store_ss( reinterpret_cast< float* >( p ), a );
+		_mm_store_ss( reinterpret_cast< float* >( p + s ), _mm_shuffle_ps( a, a, 1 ) );
+		_mm_store_ss( reinterpret_cast< float* >( p + 2 * s ), _mm_shuffle_ps( a, a, 2 ) );
+		_mm_store_ss( reinterpret_cast< float* >( p + 3 * s ), _mm_shuffle_ps( a, a, 3 ) );
+	}
+	static type add( type a, type b ) { return _mm_add_ps( a, b ); }
+	static type mul( type a, type b ) { return _mm_mul_ps( a, b ); }
+	static type div( type a, type b ) { return _mm_div_ps( a, b ); }
+};
+
+#endif
+
+
+/** @internal points given as one array per coordinate */
+template< typename T >
+struct SoaInput
+{
+	const T* const* m_p;
+
+	SoaInput( const T* const* p )
+		: m_p( p )
+	{}
+
+	template< class Ops >
+	typename Ops::type load( std::size_t k, std::size_t i ) const
+	{ return Ops::load( m_p[ k ] + i ); }
+};
+
+/** @internal points stored one after the other, \c stride bytes apart */
+template< typename T >
+struct StridedInput
+{
+	const char* m_p;
+	std::size_t m_stride;
+
+	StridedInput( const char* p, std::size_t stride )
+		: m_p( p )
+		, m_stride( stride )
+	{}
+
+	template< class Ops >
+	typename Ops::type load( std::size_t k, std::size_t i ) const
+	{ return Ops::gather( m_p + i * m_stride + k * sizeof( T ), m_stride ); }
+};
+
+/** @internal results written to one array per coordinate */
+template< typename T >
+struct SoaOutput
+{
+	T* const* m_p;
+
+	SoaOutput( T* const* p )
+		: m_p( p )
+	{}
+
+	template< class Ops >
+	void store( std::size_t o, std::size_t i, typename Ops::type a ) const
+	{ Ops::store( m_p[ o ] + i, a ); }
+};
+
+/** @internal results written one after the other, \c stride bytes apart */
+template< typename T >
+struct StridedOutput
+{
+	char* m_p;
+	std::size_t m_stride;
+
+	StridedOutput( char* p, std::size_t stride )
+		: m_p( p )
+		, m_stride( stride )
+	{}
+
+	template< class Ops >
+	void store( std::size_t o, std::size_t i, typename Ops::type a ) const
+	{ Ops::scatter( m_p + i * m_stride + o * sizeof( T ), m_stride, a ); }
+};
+
+
+/**
+ * @internal Multiplies the points [ i, n ) with the row-major R x ( K + 1 ) matrix \c m, assuming a
+ * homogeneous 1 as last coordinate. If \c bDehomogenize is set, the first R - 1 results are multiplied
+ * by the reciprocal of the last one, which saves divisions but may differ from the \c ProjectPoint
+ * functor in the last bit. All coordinates of a point are read before its results are written, so
+ * packed points can be transformed in place.
+ * @return index of the first unprocessed point, as points are processed in multiples of \c Ops::width
+ */
+template< class Ops, typename T, std::size_t K, std::size_t R, bool bDehomogenize, class Input, class Output >
+std::size_t linearPoints( const T* m, const Input& in, std::size_t i, const std::size_t n, const Output& out )
+{
+	typedef typename Ops::type value_type;
+	const std::size_t nOut = bDehomogenize ? R - 1 : R;
+
+	value_type mv[ R ][ K + 1 ];
+	for ( std::size_t r = 0; r < R; r++ )
+		for ( std::size_t c = 0; c <= K; c++ )
+			mv[ r ][ c ] = Ops::set1( m[ r * ( K + 1 ) + c ] );
+
+	for ( ; i + Ops::width <= n; i += Ops::width )
+	{
+		value_type x[ K ];
+		for ( std::size_t k = 0; k < K; k++ )
+			x[ k ] = in.template load< Ops >( k, i );
+
+		value_type e[ R ];
+		for ( std::size_t r = 0; r < R; r++ )
+		{
+			value_type s( Ops::mul( mv[ r ][ 0 ], x[ 0 ] ) );
+			for ( std::size_t k = 1; k < K; k++ )
+				s = Ops::add( s, Ops::mul( mv[ r ][ k ], x[ k ] ) );
+			e[ r ] = Ops::add( s, mv[ r ][ K ] );
+		}
+
+		if ( bDehomogenize )
+			e[ R - 1 ] = Ops::div( Ops::set1( T( 1 ) ), e[ R - 1 ] );
+		for ( std::size_t o = 0; o < nOut; o++ )
+			out.template store< Ops >( o, i, bDehomogenize ? Ops::mul( e[ o ], e[ R - 1 ] ) : e[ o ] );
+	}
+	return i;
+}
+
+
+/** @internal applies \c linearPoints to all n points, vectorized where possible */
+template< typename T, std::size_t K, std::size_t R, bool bDehomogenize, class Input, class Output >
+void linearPointsAll( const T* m, const Input& in, const std::size_t n, const Output& out )
+{
+	const std::size_t i = linearPoints< SimdOps< T >, T, K, R, bDehomogenize >( m, in, 0, n, out );
+	linearPoints< ScalarOps< T >, T, K, R, bDehomogenize >( m, in, i, n, out );
+}
+
+
+/**
+ * @internal Transforms points stored \c stride bytes apart in blocks, which are buffered on the stack
+ * and appended to an arbitrary output iterator.
+ */
+template< typename T, std::size_t K, std::size_t R, bool bDehomogenize, class OutputIterator >
+void linearPointsToIterator( const T* m, const char* pIn, const std::size_t stride, const std::size_t n, OutputIterator& iOut )
+{
+	const std::size_t nOut = bDehomogenize ? R - 1 : R;
+	const std::size_t blockSize = 64;
+	T out[ nOut ][ blockSize ];
+	T* pOutRows[ nOut ];
+	for ( std::size_t o = 0; o < nOut; o++ )
+		pOutRows[ o ] = out[ o ];
+
+	Math::Vector< T, nOut > v;
+	for ( std::size_t b = 0; b < n; b += blockSize )
+	{
+		const std::size_t count = std::min( blockSize, n - b );
+		linearPointsAll< T, K, R, bDehomogenize >( m, StridedInput< T >( pIn + b * stride, stride ), count,
+			SoaOutput< T >( pOutRows ) );
+
+		for ( std::size_t i = 0; i < count; i++ )
+		{
+			for ( std::size_t o = 0; o < nOut; o++ )
+				v( o ) = out[ o ][ i ];
+			*iOut = v;
+			++iOut;
+		}
+	}
+}
+
+
+/** @internal copies a matrix to a row-major array */
+template< typename T, std::size_t M, std::size_t N >
+void toRowMajor( const Math::Matrix< T, M, N >& mat, T* m )
+{
+	for ( std::size_t r = 0; r < M; r++ )
+		for ( std::size_t c = 0; c < N; c++ )
+			m[ r * N + c ] = mat( r, c );
+}
+
+
+/** @internal true if the iterator walks over vectors at a constant stride in memory */
+template< class Iterator, typename T, std::size_t K >
+struct is_contiguous_points
+	: public Ubitrack::Util::constant_value< bool,
+		Ubitrack::Util::is_same< Iterator, typename std::vector< Math::Vector< T, K > >::const_iterator >::value ||
+		Ubitrack::Util::is_same< Iterator, typename std::vector< Math::Vector< T, K > >::iterator >::value ||
+		Ubitrack::Util::is_same< Iterator, const Math::Vector< T, K >* >::value ||
+		Ubitrack::Util::is_same< Iterator, Math::Vector< T, K >* >::value ||
+		Ubitrack::Util::is_same< Iterator, Math::VectorListIterator< T, K > >::value >
+{};
+
+
+/** @internal true if the output iterator writes vectors at a constant stride in memory */
+template< class Iterator, typename T, std::size_t N >
+struct is_writable_points
+	: public Ubitrack::Util::constant_value< bool,
+		Ubitrack::Util::is_same< Iterator, typename std::vector< Math::Vector< T, N > >::iterator >::value ||
+		Ubitrack::Util::is_same< Iterator, Math::Vector< T, N >* >::value >
+{};
+
+
+/** @internal selects the batch kernels for contiguous K-vectors and a matrix with K + 1 columns */
+template< class Iterator, class VType, std::size_t N >
+struct use_batch_kernel
+{
+	typedef Ubitrack::Util::false_type type;
+};
+
+template< class Iterator, typename T, std::size_t K, std::size_t N >
+struct use_batch_kernel< Iterator, Math::Vector< T, K >, N >
+{
+	typedef Ubitrack::Util::constant_value< bool, K + 1 == N && is_contiguous_points< Iterator, T, K >::value > type;
+};
+
+
+/** @internal address and stride of the first vector of a \c std::vector or an array */
+template< typename T, std::size_t K, class Iterator >
+const char* pointsData( Iterator it, std::size_t& stride )
+{
+	stride = sizeof( Math::Vector< T, K > );
+	return reinterpret_cast< const char* >( ( *it ).content() );
+}
+
+/** @internal address and stride of the first vector of a \c VectorList */
+template< typename T, std::size_t K >
+const char* pointsData( Math::VectorListIterator< T, K > it, std::size_t& stride )
+{
+	stride = K * sizeof( T );
+	return reinterpret_cast< const char* >( it.data() );
+}
+
+
+/** @internal writes the results to an output iterator */
+template< typename T, std::size_t K, std::size_t R, bool bDehomogenize, class OutputIterator >
+void writeLinearPoints( const T* m, const char* pIn, const std::size_t stride, const std::size_t n, OutputIterator& iOut,
+	Ubitrack::Util::false_type )
+{
+	linearPointsToIterator< T, K, R, bDehomogenize >( m, pIn, stride, n, iOut );
+}
+
+/** @internal writes the results directly to contiguous output vectors */
+template< typename T, std::size_t K, std::size_t R, bool bDehomogenize, class OutputIterator >
+void writeLinearPoints( const T* m, const char* pIn, const std::size_t stride, const std::size_t n, OutputIterator& iOut,
+	Ubitrack::Util::true_type )
+{
+	const std::size_t nOut = bDehomogenize ? R - 1 : R;
+	linearPointsAll< T, K, R, bDehomogenize >( m, StridedInput< T >( pIn, stride ), n,
+		StridedOutput< T >( reinterpret_cast< char* >( ( *iOut ).content() ), sizeof( Math::Vector< T, nOut > ) ) );
+	iOut += n;
+}
+
+
+template< bool bDehomogenize, typename T, std::size_t M, std::size_t N, class InputIterator, class OutputIterator >
+bool batchLinearPoints( const Math::Matrix< T, M, N >&, InputIterator, InputIterator, OutputIterator&, Ubitrack::Util::false_type )
+{
+	return false;
+}
+
+template< bool bDehomogenize, typename T, std::size_t M, std::size_t N, class InputIterator, class OutputIterator >
+bool batchLinearPoints( const Math::Matrix< T, M, N >& mat, InputIterator iBegin, InputIterator iEnd, OutputIterator& iOut, Ubitrack::Util::true_type )
+{
+	const std::size_t n = std::distance( iBegin, iEnd );
+	if ( n == 0 )
+		return true;
+
+	T m[ M * N ];
+	toRowMajor( mat, m );
+	std::size_t stride;
+	const char* pIn = pointsData< T, N - 1 >( iBegin, stride );
+
+	const std::size_t nOut = bDehomogenize ? M - 1 : M;
+	writeLinearPoints< T, N - 1, M, bDehomogenize >( m, pIn, stride, n, iOut,
+		is_writable_points< OutputIterator, T, nOut >() );
+	return true;
+}
+
+/**
+ * @internal Applies the batch kernels if the input vectors are contiguous in memory
+ * and the matrix has one column more than the vectors.
+ * @return false if the points have to be processed one by one
+ */
+template< bool bDehomogenize, typename T, std::size_t M, std::size_t N, class InputIterator, class OutputIterator >
+bool batchLinearPoints( const Math::Matrix< T, M, N >& mat, InputIterator iBegin, InputIterator iEnd, OutputIterator& iOut )
+{
+	typedef typename std::iterator_traits< InputIterator >::value_type vector_type;
+	typedef typename use_batch_kernel< InputIterator, vector_type, N >::type use_kernel;
+	return batchLinearPoints< bDehomogenize >( mat, iBegin, iEnd, iOut, use_kernel() );
+}
+
+} // namespace detail
+
+
+/**
+ * @ingroup math geometry
+ * @brief Projects \b 3D \b points given in structure-of-arrays layout.
+ *
+ * Computes @f$ \hat{p} = P \cdot [x_i y_i z_i 1]^T @f$ and @f$ (u_i, v_i) = (\hat{p}_1, \hat{p}_2) / \hat{p}_3 @f$
+ * for all points with SIMD instructions if available (AVX or SSE2, enabled at compile time).
+ * \c project_points uses the same kernels for points in contiguous storage.
+ *
+ * Note: also exists with \c float parameters
+ *
+ * @param projection the \b 3-by-4 \b projection \b matrix
+ * @param pX x-coordinates of the \c n points
+ * @param pY y-coordinates of the \c n points
+ * @param pZ z-coordinates of the \c n points
+ * @param n number of points
+ * @param pU receives the \c n projected x-coordinates
+ * @param pV receives the \c n projected y-coordinates
+ */
+template< typename T >
+void project_points_soa( const Math::Matrix< T, 3, 4 >& projection, const T* pX, const T* pY, const T* pZ,
+	const std::size_t n, T* pU, T* pV )
+{
+	T m[ 12 ];
+	detail::toRowMajor( projection, m );
+	const T* pIn[ 3 ] = { pX, pY, pZ };
+	T* pOut[ 2 ] = { pU, pV };
+	detail::linearPointsAll< T, 3, 3, true >( m, detail::SoaInput< T >( pIn ), n, detail::SoaOutput< T >( pOut ) );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Projects \b 3D \b points packed as \c x0 \c y0 \c z0 \c x1 ... into packed \b 2D \b points \c u0 \c v0 \c u1 ...
+ *
+ * E.g. from the \c data() of a \c Math::VectorList< T, 3 > to a \c Math::VectorList< T, 2 > of the same size.
+ * @see project_points_soa
+ */
+template< typename T >
+void project_points_packed( const Math::Matrix< T, 3, 4 >& projection, const T* pIn, const std::size_t n, T* pOut )
+{
+	T m[ 12 ];
+	detail::toRowMajor( projection, m );
+	detail::linearPointsAll< T, 3, 3, true >( m, detail::StridedInput< T >( reinterpret_cast< const char* >( pIn ), 3 * sizeof( T ) ), n,
+		detail::StridedOutput< T >( reinterpret_cast< char* >( pOut ), 2 * sizeof( T ) ) );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Transforms \b 3D \b points given in structure-of-arrays layout by a \b 3-by-4 \b matrix,
+ * e.g. a pose @f$ [R|t] @f$.
+ *
+ * @param transformation the \b 3-by-4 \b transformation \b matrix
+ * @param pX x-coordinates of the \c n points
+ * @param pY y-coordinates of the \c n points
+ * @param pZ z-coordinates of the \c n points
+ * @param n number of points
+ * @param pOutX receives the \c n transformed x-coordinates
+ * @param pOutY receives the \c n transformed y-coordinates
+ * @param pOutZ receives the \c n transformed z-coordinates
+ */
+template< typename T >
+void transform_points_soa( const Math::Matrix< T, 3, 4 >& transformation, const T* pX, const T* pY, const T* pZ,
+	const std::size_t n, T* pOutX, T* pOutY, T* pOutZ )
+{
+	T m[ 12 ];
+	detail::toRowMajor( transformation, m );
+	const T* pIn[ 3 ] = { pX, pY, pZ };
+	T* pOut[ 3 ] = { pOutX, pOutY, pOutZ };
+	detail::linearPointsAll< T, 3, 3, false >( m, detail::SoaInput< T >( pIn ), n, detail::SoaOutput< T >( pOut ) );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Transforms \b 3D \b points given in structure-of-arrays layout by a homogeneous \b 4-by-4
+ * \b matrix and dehomogenizes the results.
+ * @see transform_points_soa( const Math::Matrix< T, 3, 4 >&, const T*, const T*, const T*, const std::size_t, T*, T*, T* )
+ */
+template< typename T >
+void transform_points_soa( const Math::Matrix< T, 4, 4 >& transformation, const T* pX, const T* pY, const T* pZ,
+	const std::size_t n, T* pOutX, T* pOutY, T* pOutZ )
+{
+	T m[ 16 ];
+	detail::toRowMajor( transformation, m );
+	const T* pIn[ 3 ] = { pX, pY, pZ };
+	T* pOut[ 3 ] = { pOutX, pOutY, pOutZ };
+	detail::linearPointsAll< T, 3, 4, true >( m, detail::SoaInput< T >( pIn ), n, detail::SoaOutput< T >( pOut ) );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Transforms packed \b 3D \b points by a \b 3-by-4 \b matrix into packed \b 3D \b points.
+ * \c pIn and \c pOut may be the same.
+ * @see transform_points_soa
+ */
+template< typename T >
+void transform_points_packed( const Math::Matrix< T, 3, 4 >& transformation, const T* pIn, const std::size_t n, T* pOut )
+{
+	T m[ 12 ];
+	detail::toRowMajor( transformation, m );
+	detail::linearPointsAll< T, 3, 3, false >( m, detail::StridedInput< T >( reinterpret_cast< const char* >( pIn ), 3 * sizeof( T ) ), n,
+		detail::StridedOutput< T >( reinterpret_cast< char* >( pOut ), 3 * sizeof( T ) ) );
+}
+
+/**
+ * @ingroup math geometry
+ * @brief Transforms packed \b 3D \b points by a homogeneous \b 4-by-4 \b matrix into
+ * dehomogenized packed \b 3D \b points. \c pIn and \c pOut may be the same.
+ * @see transform_points_soa
+ */
+template< typename T >
+void transform_points_packed( const Math::Matrix< T, 4, 4 >& transformation, const T* pIn, const std::size_t n, T* pOut )
+{
+	T m[ 16 ];
+	detail::toRowMajor( transformation, m );
+	detail::linearPointsAll< T, 3, 4, true >( m, detail::StridedInput< T >( reinterpret_cast< const char* >( pIn ), 3 * sizeof( T ) ), n,
+		detail::StridedOutput< T >( reinterpret_cast< char* >( pOut ), 3 * sizeof( T ) ) );
+}
+
+} } } // namespace Ubitrack::Math::Geometry
+
+#endif // __UBITRACK_MATH_GEOMETRY_POINTBATCH_H_INCLUDED__
@@ -39,6 +39,7 @@
 #include <utMath/Matrix.h>
 
 #include "container_traits.h"
+#include "PointBatch.h"
 #include "../Util/type_traits.h"
 #include "../Stochastic/identity_iterator.h"
 
@@ -155,6 +156,10 @@ public:
  * - \b 3D : @f$ \hat{p}_{3x1} = P_{3x4} \cdot [p_{1} p_{2} p_{3} 1]^T @f$ 
  * - \b 4D : @f$ \hat{p}_{3x1} = P_{3x4} \cdot [p_{1} p_{2} p_{3} p_{4}]^T @f$
  * \n and finally projects the points via @f$ [\hat{p_{1}} \hat{p_{2}}]^T / \hat{p_{3}} @f$
+ *
+ * Points in contiguous storage ( \c std::vector, arrays or \c Math::VectorList ) are
+ * processed by the vectorized kernels of \c PointBatch.h if the matrix has one column more
+ * than the points (e.g. \b 3D points and a \b 3-by-4 matrix).
  * 
  * Example use case:\n
  @code
@@ -195,6 +200,10 @@ inline void project_points( const Math::Matrix< T, M, N > &projection, const For
 	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< value_type_in, value_type_out >::value ), INPUT_AND_OUTPUT_VECTOR_NEED_SAME_BUILTIN_TYPE );
 	UBITRACK_STATIC_ASSERT( ( Ubitrack::Util::is_same< vector_type_out, Math::Vector< T, 2 > >::value ), OUTPUT_VECTOR_NEEDS_TO_BE_DEFINED_WITH_2_DIMENSIONS );
 
+	// points in contiguous storage are projected in batches with SIMD instructions
+	if ( detail::batchLinearPoints< true >( projection, iBegin, iEnd, iOut ) )
+		return;
+
 	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( projection );
 	std::transform( iBegin, iEnd, id_container.begin(), iOut, ProjectPoint() );
 	
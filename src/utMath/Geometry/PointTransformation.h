@@ -40,6 +40,7 @@
 
 
 #include "container_traits.h"
+#include "PointBatch.h"
 #include "../Util/type_traits.h"
 #include "../Stochastic/identity_iterator.h"
 
@@ -207,6 +208,10 @@ public:
  * - \b 3D : @f$ \hat{p}_{4x1} = M_{4x4} \cdot [p_{1} p_{2} 0 1]^T @f$
  * - \b 3D : @f$ \hat{p}_{4x1} = M_{4x4} \cdot [p_{1} p_{2} p_{3} 1]^T @f$
  * - \b 3D : @f$ \hat{p}_{4x1} = M_{4x4} \cdot [p_{1} p_{2} p_{3} p_{4}]^T @f$
+ *
+ * Points in contiguous storage ( \c std::vector, arrays or \c Math::VectorList ) are
+ * processed by the vectorized kernels of \c PointBatch.h if the matrix has one column more
+ * than the points (e.g. \b 3D points and a \b 3-by-4 or \b 4-by-4 matrix).
  * 
  * Example use case:\n
  @code
@@ -248,6 +253,11 @@ inline void transform_points( const Math::Matrix< T, M, N > &transformation, con
 	UBITRACK_STATIC_ASSERT( (Ubitrack::Util::is_same< vector_type_out, Math::Vector< T, M > >::value ), OUTPUT_VECTOR_NEEDS_SAME_DIMENSION_AS_MATRIX_ROWS );
 
 	// std::transform( iBegin, iEnd, iOut, std::bind1st( TransformPoint< T, M, N, vector_type_in >(), transformation ) );
+
+	// points in contiguous storage are transformed in batches with SIMD instructions
+	if ( detail::batchLinearPoints< false >( transformation, iBegin, iEnd, iOut ) )
+		return;
+
 	const std::size_t n = std::distance( iBegin, iEnd );
 	Ubitrack::Util::identity< const Math::Matrix< T, M, N > > id_container( transformation, n );
 	std::transform( id_container.begin(), id_container.end(), iBegin, iOut, TransformPoint() );
@@ -0,0 +1,471 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math graph
+ * @file
+ * Linear assignment problems solved with shortest augmenting paths.
+ *
+ * Both solvers follow Jonker & Volgenant: the rows are assigned one after the other along
+ * shortest augmenting paths, keeping dual variables so that all reduced costs stay
+ * non-negative. This needs O(n^2 m) time for a dense n x m problem, compared to the
+ * O(n^4) of the step-based \c Munkres class. The sparse variant only visits the edges
+ * of a gated cost graph.
+ */
+
+#ifndef __UBITRACK_MATH_GRAPH_LINEARASSIGNMENT_H_INCLUDED__
+#define __UBITRACK_MATH_GRAPH_LINEARASSIGNMENT_H_INCLUDED__
+
+#include <utMath/Matrix.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Ubitrack { namespace Math { namespace Graph {
+
+/** marks a row or column without assignment */
+const std::size_t unassigned = static_cast< std::size_t >( -1 );
+
+
+/**
+ * @ingroup math graph
+ * Costs of a bipartite graph in which only some pairs of rows and columns are connected,
+ * e.g. the point pairs that pass an epipolar gating threshold.
+ *
+ * Edges can be added in any order. Parallel edges are allowed, the cheapest one is used.
+ */
+template< typename T >
+class SparseCostGraph
+{
+public:
+	/** an edge to a column */
+	struct Edge
+	{
+		std::size_t col;
+		T cost;
+	};
+
+	/** empty graph with \c nRows rows and \c nCols columns */
+	SparseCostGraph( const std::size_t nRows, const std::size_t nCols )
+		: m_nRows( nRows )
+		, m_nCols( nCols )
+		, m_bSorted( true )
+	{}
+
+	/** the entries of a dense cost matrix that do not exceed \c maxCost */
+	SparseCostGraph( const Math::Matrix< T, 0, 0 >& cost, const T maxCost )
+		: m_nRows( cost.size1() )
+		, m_nCols( cost.size2() )
+		, m_bSorted( true )
+	{
+		for ( std::size_t row = 0; row < m_nRows; row++ )
+			for ( std::size_t col = 0; col < m_nCols; col++ )
+				if ( cost( row, col ) <= maxCost )
+					addEdge( row, col, cost( row, col ) );
+	}
+
+	/** connects a row and a column */
+	void addEdge( const std::size_t row, const std::size_t col, const T cost )
+	{
+		if ( !m_rows.empty() && row < m_rows.back() )
+			m_bSorted = false;
+		m_rows.push_back( row );
+		Edge e = { col, cost };
+		m_edges.push_back( e );
+	}
+
+	std::size_t rows() const
+	{ return m_nRows; }
+
+	std::size_t cols() const
+	{ return m_nCols; }
+
+	/** number of edges */
+	std::size_t size() const
+	{ return m_edges.size(); }
+
+	/**
+	 * The edges in compressed row storage: the edges of row i are
+	 * [ edges[ offsets[ i ] ], edges[ offsets[ i + 1 ] ] ).
+	 */
+	void compressedRows( std::vector< std::size_t >& offsets, std::vector< Edge >& edges ) const
+	{
+		offsets.assign( m_nRows + 1, 0 );
+		for ( std::size_t i = 0; i < m_rows.size(); i++ )
+			offsets[ m_rows[ i ] + 1 ]++;
+		for ( std::size_t i = 0; i < m_nRows; i++ )
+			offsets[ i + 1 ] += offsets[ i ];
+
+		if ( m_bSorted )
+		{
+			edges = m_edges;
+			return;
+		}
+
+		// counting sort by row
+		std::vector< std::size_t > pos( offsets.begin(), offsets.end() - 1 );
+		edges.resize( m_edges.size() );
+		for ( std::size_t i = 0; i < m_edges.size(); i++ )
+			edges[ pos[ m_rows[ i ] ]++ ] = m_edges[ i ];
+	}
+
+protected:
+	std::size_t m_nRows;
+	std::size_t m_nCols;
+	bool m_bSorted;
+	std::vector< std::size_t > m_rows;
+	std::vector< Edge > m_edges;
+};
+
+
+/**
+ * @ingroup math graph
+ * Solves a dense rectangular linear assignment problem.
+ *
+ * Assigns each row to a different column (or each column to a different row, if there are
+ * more rows than columns) with minimal total cost.
+ *
+ * @param cost n x m cost matrix
+ * @param rowMatch receives for each row the assigned column, or \c unassigned
+ * @return the total cost of the assignment
+ */
+template< typename T >
+T solveAssignment( const Math::Matrix< T, 0, 0 >& cost, std::vector< std::size_t >& rowMatch )
+{
+	const std::size_t nRows = cost.size1();
+	const std::size_t nCols = cost.size2();
+	rowMatch.assign( nRows, unassigned );
+	if ( nRows == 0 || nCols == 0 )
+		return 0;
+
+	// the algorithm assigns the smaller dimension completely
+	const bool bTransposed = nRows > nCols;
+	const std::size_t n = bTransposed ? nCols : nRows;
+	const std::size_t m = bTransposed ? nRows : nCols;
+
+	// row-major copy, indexed [ row * m + col ] of the possibly transposed problem
+	std::vector< T > c( n * m );
+	for ( std::size_t i = 0; i < nRows; i++ )
+		for ( std::size_t j = 0; j < nCols; j++ )
+			c[ bTransposed ? j * m + i : i * m + j ] = cost( i, j );
+
+	const T inf = std::numeric_limits< T >::max();
+	std::vector< T > u( n, 0 ); // row duals
+	std::vector< T > v( m, 0 ); // column duals
+	std::vector< std::size_t > colMatch( m, unassigned );
+	std::vector< std::size_t > rowOf( n, unassigned );
+
+	// initial column duals with non-negative reduced costs. Columns that remain unassigned
+	// must all keep the same dual, so the column reduction v_j = min_i c_ij is only valid
+	// for square problems
+	if ( n == m )
+		for ( std::size_t j = 0; j < m; j++ )
+		{
+			v[ j ] = c[ j ];
+			for ( std::size_t i = 1; i < n; i++ )
+				v[ j ] = std::min( v[ j ], c[ i * m + j ] );
+		}
+	else
+		std::fill( v.begin(), v.end(), *std::min_element( c.begin(), c.end() ) );
+
+	std::vector< T > dist( m );
+	std::vector< std::size_t > pred( m );
+	std::vector< char > done( m );
+	std::vector< std::size_t > scanned;
+	scanned.reserve( m );
+
+	for ( std::size_t row = 0; row < n; row++ )
+	{
+		// Dijkstra over the columns, starting at the free row
+		std::fill( dist.begin(), dist.end(), inf );
+		std::fill( done.begin(), done.end(), 0 );
+		scanned.clear();
+
+		std::size_t i = row;
+		T di = 0; // distance of row i
+		std::size_t jFree = unassigned;
+		T dFree = 0;
+		while ( true )
+		{
+			const T* pCost = &c[ i * m ];
+			const T ui = u[ i ];
+			std::size_t jMin = unassigned;
+			T dMin = inf;
+			for ( std::size_t j = 0; j < m; j++ )
+			{
+				if ( done[ j ] )
+					continue;
+				const T d = di + pCost[ j ] - ui - v[ j ];
+				if ( d < dist[ j ] )
+				{
+					dist[ j ] = d;
+					pred[ j ] = i;
+				}
+				if ( dist[ j ] < dMin || jMin == unassigned )
+				{
+					dMin = dist[ j ];
+					jMin = j;
+				}
+			}
+
+			done[ jMin ] = 1;
+			scanned.push_back( jMin );
+			if ( colMatch[ jMin ] == unassigned )
+			{
+				jFree = jMin;
+				dFree = dMin;
+				break;
+			}
+			i = colMatch[ jMin ];
+			di = dMin;
+		}
+
+		// update the duals of the scanned columns and their rows, the path gets zero reduced costs
+		u[ row ] += dFree;
+		for ( std::size_t k = 0; k + 1 < scanned.size(); k++ )
+		{
+			const std::size_t j = scanned[ k ];
+			const T delta = dFree - dist[ j ];
+			v[ j ] -= delta;
+			u[ colMatch[ j ] ] += delta;
+		}
+
+		// augment
+		for ( std::size_t j = jFree; ; )
+		{
+			const std::size_t r = pred[ j ];
+			colMatch[ j ] = r;
+			const std::size_t jNext = rowOf[ r ];
+			rowOf[ r ] = j;
+			if ( r == row )
+				break;
+			j = jNext;
+		}
+	}
+
+	T total = 0;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		total += c[ i * m + rowOf[ i ] ];
+		if ( bTransposed )
+			rowMatch[ rowOf[ i ] ] = i;
+		else
+			rowMatch[ i ] = rowOf[ i ];
+	}
+	return total;
+}
+
+
+/**
+ * @ingroup math graph
+ * Solves a linear assignment problem on a sparse cost graph.
+ *
+ * Finds a matching with the largest possible number of assigned rows, and among those the
+ * one with minimal total cost. Rows without a suitable column remain unassigned.
+ *
+ * After a greedy start, each free row runs Dijkstra over the edges of the graph only. If
+ * the row cannot reach a free column, it either stays unassigned or replaces one of the
+ * rows it reached, whichever is cheaper. This is the shortest augmenting path for a
+ * problem where every row has an additional private column of very high cost, so the
+ * result is optimal in the above sense.
+ *
+ * @param graph the allowed pairs and their costs
+ * @param rowMatch receives for each row the assigned column, or \c unassigned
+ * @return the total cost of the assignment
+ */
+template< typename T >
+T solveAssignment( const SparseCostGraph< T >& graph, std::vector< std::size_t >& rowMatch )
+{
+	typedef typename SparseCostGraph< T >::Edge Edge;
+	typedef std::pair< T, std::size_t > HeapEntry;
+
+	const std::size_t nRows = graph.rows();
+	const std::size_t nCols = graph.cols();
+	rowMatch.assign( nRows, unassigned );
+
+	std::vector< std::size_t > offsets;
+	std::vector< Edge > edges;
+	graph.compressedRows( offsets, edges );
+
+	// node potentials, the reduced cost of edge (i, j) is c_ij + pRow_i - pCol_j >= 0.
+	// All free columns share the same potential, so the search may stop at the first one
+	const T inf = std::numeric_limits< T >::max();
+	T minCost = 0;
+	for ( std::size_t k = 0; k < edges.size(); k++ )
+		minCost = k ? std::min( minCost, edges[ k ].cost ) : edges[ k ].cost;
+	std::vector< T > pRow( nRows, 0 );
+	std::vector< T > pCol( nCols, minCost );
+	std::vector< std::size_t > colMatch( nCols, unassigned );
+
+	// greedy start: a row takes its cheapest column if that is still free, with a potential
+	// that makes this edge tight
+	std::vector< std::size_t > freeRows;
+	for ( std::size_t i = 0; i < nRows; i++ )
+	{
+		// rows without edges can never be assigned
+		if ( offsets[ i ] == offsets[ i + 1 ] )
+			continue;
+
+		std::size_t kMin = offsets[ i ];
+		for ( std::size_t k = kMin + 1; k < offsets[ i + 1 ]; k++ )
+			if ( edges[ k ].cost < edges[ kMin ].cost )
+				kMin = k;
+
+		const std::size_t j = edges[ kMin ].col;
+		if ( colMatch[ j ] == unassigned )
+		{
+			colMatch[ j ] = i;
+			rowMatch[ i ] = j;
+			pRow[ i ] = minCost - edges[ kMin ].cost;
+		}
+		else
+			freeRows.push_back( i );
+	}
+
+	std::vector< T > dist( nCols, inf );
+	std::vector< T > rowDist( nRows );
+	std::vector< std::size_t > pred( nCols );
+	std::vector< char > done( nCols, 0 );
+	std::vector< std::size_t > touchedCols;
+	std::vector< std::size_t > reachedRows;
+	std::vector< HeapEntry > heap;
+
+	for ( std::size_t f = 0; f < freeRows.size(); f++ )
+	{
+		const std::size_t row = freeRows[ f ];
+		touchedCols.clear();
+		reachedRows.clear();
+		heap.clear();
+
+		std::size_t i = row;
+		T di = 0;
+		std::size_t jFree = unassigned;
+		T dMax = 0;
+		while ( true )
+		{
+			rowDist[ i ] = di;
+			reachedRows.push_back( i );
+			for ( std::size_t k = offsets[ i ]; k < offsets[ i + 1 ]; k++ )
+			{
+				const std::size_t j = edges[ k ].col;
+				if ( done[ j ] )
+					continue;
+				const T d = di + edges[ k ].cost + pRow[ i ] - pCol[ j ];
+				if ( d < dist[ j ] )
+				{
+					if ( dist[ j ] == inf )
+						touchedCols.push_back( j );
+					dist[ j ] = d;
+					pred[ j ] = i;
+					heap.push_back( HeapEntry( d, j ) );
+					std::push_heap( heap.begin(), heap.end(), std::greater< HeapEntry >() );
+				}
+			}
+
+			// closest column not yet scanned
+			std::size_t j = unassigned;
+			while ( !heap.empty() )
+			{
+				const HeapEntry top( heap.front() );
+				std::pop_heap( heap.begin(), heap.end(), std::greater< HeapEntry >() );
+				heap.pop_back();
+				if ( !done[ top.second ] && top.first == dist[ top.second ] )
+				{
+					j = top.second;
+					break;
+				}
+			}
+			if ( j == unassigned )
+				break; // all reachable columns are assigned
+
+			done[ j ] = 1;
+			dMax = dist[ j ];
+			if ( colMatch[ j ] == unassigned )
+			{
+				jFree = j;
+				break;
+			}
+			i = colMatch[ j ];
+			di = dist[ j ];
+		}
+
+		// the row that ends up unassigned if no free column was found: the cost of shifting
+		// the assignment to some reached row r is rowDist_r + pRow_r - pRow_row
+		std::size_t lastRow = row;
+		if ( jFree == unassigned )
+			for ( std::size_t k = 1; k < reachedRows.size(); k++ )
+				if ( rowDist[ reachedRows[ k ] ] + pRow[ reachedRows[ k ] ] < rowDist[ lastRow ] + pRow[ lastRow ] )
+					lastRow = reachedRows[ k ];
+
+		// potential update, the shortest paths get zero reduced costs and free columns are unchanged
+		for ( std::size_t k = 0; k < reachedRows.size(); k++ )
+			pRow[ reachedRows[ k ] ] += rowDist[ reachedRows[ k ] ] - dMax;
+		for ( std::size_t k = 0; k < touchedCols.size(); k++ )
+		{
+			const std::size_t j = touchedCols[ k ];
+			if ( done[ j ] )
+				pCol[ j ] += dist[ j ] - dMax;
+			dist[ j ] = inf;
+			done[ j ] = 0;
+		}
+
+		// augment
+		std::size_t j = jFree;
+		if ( jFree == unassigned && lastRow != row )
+		{
+			j = rowMatch[ lastRow ];
+			rowMatch[ lastRow ] = unassigned;
+		}
+		if ( j != unassigned )
+			while ( true )
+			{
+				const std::size_t r = pred[ j ];
+				colMatch[ j ] = r;
+				const std::size_t jNext = rowMatch[ r ];
+				rowMatch[ r ] = j;
+				if ( r == row )
+					break;
+				j = jNext;
+			}
+	}
+
+	T total = 0;
+	for ( std::size_t i = 0; i < nRows; i++ )
+		if ( rowMatch[ i ] != unassigned )
+		{
+			// cheapest of possibly parallel edges
+			T c = inf;
+			for ( std::size_t k = offsets[ i ]; k < offsets[ i + 1 ]; k++ )
+				if ( edges[ k ].col == rowMatch[ i ] )
+					c = std::min( c, edges[ k ].cost );
+			total += c;
+		}
+	return total;
+}
+
+} } } // namespace Ubitrack::Math::Graph
+
+#endif // __UBITRACK_MATH_GRAPH_LINEARASSIGNMENT_H_INCLUDED__
@@ -33,6 +33,9 @@
  *
  * the result can be a masked matrix or a ordered new list of vectors
  *
+ * For larger problems use \c solveAssignment from LinearAssignment.h, which needs
+ * O(n^3) instead of O(n^4) time and also accepts sparse cost graphs.
+ *
  * @author Daniel Muhra <muhra@in.tum.de>
  */
 #ifndef __MUNKRES_INCLUDED__
@@ -113,8 +116,8 @@ private:
 	int step6();
 	boost::numeric::ublas::matrix< int > mask_matrix;
 	Math::Matrix< T, 0, 0 > m_matrix;
-	bool *row_mask;
-	bool *col_mask;
+	std::vector< bool > row_mask;
+	std::vector< bool > col_mask;
 	std::size_t saverow, savecol;
 	std::size_t m_max;
 };
@@ -138,9 +141,10 @@ Munkres< T >::Munkres( Math::Matrix< T, 0, 0 > & matrix)
 
 template< typename T >
 bool Munkres< T >::find_uncovered_in_matrix(T item, std::size_t & row, std::size_t & col) {
-	for ( std::size_t row( 0 ) ; row < m_max ; ++row )
+	// row and col are the results, not local loop variables
+	for ( row = 0 ; row < m_max ; ++row )
 		if ( !row_mask[row] )
-			for ( std::size_t col( 0 ) ; col < m_max ; ++col )
+			for ( col = 0 ; col < m_max ; ++col )
 				if ( !col_mask[col] )
 					if ( m_matrix( row, col ) == item )
 						return true;
@@ -416,13 +420,8 @@ void Munkres< T >::solve()
 	int step ( 1 );
 
 	// Z_STAR == 1 == starred, Z_PRIME == 2 == primed
-	row_mask = new bool[m_max];
-	col_mask = new bool[m_max];
-	for ( std::size_t i( 0 ) ; i < m_max ; ++i ) 
-	{
-		row_mask[i] = false;
-		col_mask[i] = false;
-	}
+	row_mask.assign( m_max, false );
+	col_mask.assign( m_max, false );
 
 	while ( notdone ) 
 	{
@@ -0,0 +1,467 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * RANSAC with adaptive termination, preemptive hypothesis tests and parallel evaluation
+ */
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_ADAPTIVERANSAC_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_ADAPTIVERANSAC_INCLUDED__
+
+#include <utCore.h>
+#include <utUtil/ThreadPool.h>
+#include "Ransac.h"
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+
+namespace Ubitrack { namespace Math { namespace Optimization {
+
+/**
+ * Additional settings of \c adaptiveRansac that are not part of \c RansacParameter
+ */
+struct RansacOptions
+{
+	RansacOptions()
+		: seed( 0 )
+		, confidence( 0.99 )
+		, nWorkers( 1 )
+		, nHypothesesPerRound( 4 )
+		, nPreemptiveTests( 0 )
+		, pThreadPool( 0 )
+	{}
+
+	/** seed of the random number generators, worker \c i uses \c seed + \c i */
+	unsigned long seed;
+
+	/** probability of drawing at least one outlier-free sample, determines the number of iterations */
+	double confidence;
+
+	/**
+	 * number of independent hypothesis generators. The result only depends on the seed and the
+	 * number of workers, not on the number of threads that actually execute them.
+	 */
+	std::size_t nWorkers;
+
+	/** number of hypotheses each worker generates before the iteration count is updated, 0 is treated as 1 */
+	std::size_t nHypothesesPerRound;
+
+	/**
+	 * T(d,d) test: a hypothesis is only scored on all values if \c nPreemptiveTests randomly
+	 * selected values are inliers. 0 disables the test.
+	 */
+	std::size_t nPreemptiveTests;
+
+	/** thread pool that executes the workers, 0 runs all workers in the calling thread */
+	Ubitrack::Util::ThreadPool* pThreadPool;
+};
+
+
+namespace detail {
+
+/** @internal number of iterations needed to draw an outlier-free sample with the given confidence */
+inline std::size_t ransacIterations( const std::size_t nInlier, const std::size_t nValues, const std::size_t setSize,
+	const double confidence, const std::size_t nMaxIterations )
+{
+	if ( nInlier == 0 )
+		return nMaxIterations;
+
+	const double pGood = std::pow( double( nInlier ) / double( nValues ), static_cast< int >( setSize ) );
+	if ( pGood >= 1.0 )
+		return 1;
+
+	const double n = std::ceil( std::log( 1.0 - confidence ) / std::log( 1.0 - pGood ) );
+	if ( !( n < double( nMaxIterations ) ) )
+		return nMaxIterations;
+	return std::max< std::size_t >( 1, static_cast< std::size_t >( n ) );
+}
+
+/** @internal access to the values of a one-parameter problem */
+template< class InputIterator, class RansacFunctor >
+class RansacData1
+{
+public:
+	typedef typename std::iterator_traits< InputIterator >::value_type value_type;
+
+	/** @internal buffer for the minimal sample of one worker */
+	struct Sample
+	{
+		std::vector< value_type > list;
+	};
+
+	RansacData1( const InputIterator iBegin, const InputIterator iEnd )
+		: m_iBegin( iBegin )
+		, m_nValues( std::distance( iBegin, iEnd ) )
+	{}
+
+	std::size_t size() const
+	{ return m_nValues; }
+
+	template< class ResultType >
+	bool estimate( ResultType& result, const std::vector< std::size_t >& indices, Sample& sample ) const
+	{
+		sample.list.clear();
+		for ( std::size_t i = 0; i < indices.size(); i++ )
+			sample.list.push_back( value( indices[ i ] ) );
+		return typename RansacFunctor::Estimator()( result, sample.list.begin(), sample.list.end() );
+	}
+
+	template< class ResultType >
+	typename RansacFunctor::value_type evaluate( const ResultType& hypothesis, const std::size_t i ) const
+	{ return typename RansacFunctor::Evaluator()( hypothesis, value( i ) ); }
+
+protected:
+	value_type value( const std::size_t i ) const
+	{
+		InputIterator it( m_iBegin );
+		std::advance( it, i );
+		return *it;
+	}
+
+	const InputIterator m_iBegin;
+	const std::size_t m_nValues;
+};
+
+/** @internal access to the values of a two-parameter problem */
+template< class InputIterator1, class InputIterator2, class RansacFunctor >
+class RansacData2
+{
+public:
+	typedef typename std::iterator_traits< InputIterator1 >::value_type value_type1;
+	typedef typename std::iterator_traits< InputIterator2 >::value_type value_type2;
+
+	/** @internal buffer for the minimal sample of one worker */
+	struct Sample
+	{
+		std::vector< value_type1 > list1;
+		std::vector< value_type2 > list2;
+	};
+
+	RansacData2( const InputIterator1 iBegin1, const InputIterator1 iEnd1, const InputIterator2 iBegin2 )
+		: m_iBegin1( iBegin1 )
+		, m_iBegin2( iBegin2 )
+		, m_nValues( std::distance( iBegin1, iEnd1 ) )
+	{}
+
+	std::size_t size() const
+	{ return m_nValues; }
+
+	template< class ResultType >
+	bool estimate( ResultType& result, const std::vector< std::size_t >& indices, Sample& sample ) const
+	{
+		sample.list1.clear();
+		sample.list2.clear();
+		for ( std::size_t i = 0; i < indices.size(); i++ )
+		{
+			InputIterator1 it1( m_iBegin1 );
+			InputIterator2 it2( m_iBegin2 );
+			std::advance( it1, indices[ i ] );
+			std::advance( it2, indices[ i ] );
+			sample.list1.push_back( *it1 );
+			sample.list2.push_back( *it2 );
+		}
+		return typename RansacFunctor::Estimator()( result, sample.list1.begin(), sample.list1.end(), sample.list2.begin(), sample.list2.end() );
+	}
+
+	template< class ResultType >
+	typename RansacFunctor::value_type evaluate( const ResultType& hypothesis, const std::size_t i ) const
+	{
+		InputIterator1 it1( m_iBegin1 );
+		InputIterator2 it2( m_iBegin2 );
+		std::advance( it1, i );
+		std::advance( it2, i );
+		return typename RansacFunctor::Evaluator()( hypothesis, *it1, *it2 );
+	}
+
+protected:
+	const InputIterator1 m_iBegin1;
+	const InputIterator2 m_iBegin2;
+	const std::size_t m_nValues;
+};
+
+/** @internal state and best result of one hypothesis generator */
+template< class Data, class ResultType, typename T >
+struct RansacWorker
+{
+	boost::mt19937 rng;
+	std::vector< std::size_t > sampleIndices;
+	typename Data::Sample sample;
+	ResultType hypothesis;
+	std::vector< std::size_t > inliers;
+	std::vector< std::size_t > bestInliers;
+	T bestDistance;
+	std::size_t nHypotheses;
+};
+
+/** @internal generates and scores the hypotheses of one round for all workers */
+template< class Data, class ResultType, typename T >
+class RansacRound
+{
+public:
+	typedef RansacWorker< Data, ResultType, T > Worker;
+
+	RansacRound( const Data& data, const RansacParameter< T >& params, const RansacOptions& options, std::vector< Worker >& workers )
+		: m_data( data )
+		, m_params( params )
+		, m_options( options )
+		, m_workers( workers )
+		, m_nHypothesesPerRound( std::max< std::size_t >( options.nHypothesesPerRound, 1 ) )
+		, m_nRoundBest( 0 )
+	{}
+
+	/** the best number of inliers of all workers at the beginning of the round */
+	void setRoundBest( const std::size_t n )
+	{ m_nRoundBest = n; }
+
+	void operator()( const std::size_t iWorker )
+	{
+		Worker& w( m_workers[ iWorker ] );
+		const std::size_t nValues = m_data.size();
+		boost::uniform_int< std::size_t > randIndex( 0, nValues - 1 );
+
+		for ( std::size_t h = 0; h < m_nHypothesesPerRound; h++ )
+		{
+			w.nHypotheses++;
+
+			// draw setSize distinct indices in O(setSize)
+			w.sampleIndices.clear();
+			while ( w.sampleIndices.size() < m_params.setSize )
+			{
+				const std::size_t i = randIndex( w.rng );
+				if ( std::find( w.sampleIndices.begin(), w.sampleIndices.end(), i ) == w.sampleIndices.end() )
+					w.sampleIndices.push_back( i );
+			}
+
+			if ( !m_data.estimate( w.hypothesis, w.sampleIndices, w.sample ) )
+			{
+				OPT_LOG_TRACE( "fast forward, no estimation possible" );
+				continue;
+			}
+
+			// T(d,d) test on random values
+			bool bRejected = false;
+			for ( std::size_t t = 0; t < m_options.nPreemptiveTests && !bRejected; t++ )
+				bRejected = !( m_data.evaluate( w.hypothesis, randIndex( w.rng ) ) < m_params.threshold );
+			if ( bRejected )
+			{
+				OPT_LOG_TRACE( "hypothesis rejected by preemptive test" );
+				continue;
+			}
+
+			// score, stop as soon as the hypothesis cannot reach the best one anymore
+			const std::size_t nBest = std::max( m_nRoundBest, w.bestInliers.size() );
+			const std::size_t nRequired = std::max( nBest, std::max< std::size_t >( m_params.nMinInlier, 1 ) );
+			w.inliers.clear();
+			T fInlierDist( 0 );
+			for ( std::size_t i = 0; i < nValues && w.inliers.size() + ( nValues - i ) >= nRequired; i++ )
+			{
+				const T d = m_data.evaluate( w.hypothesis, i );
+				if ( d < m_params.threshold )
+				{
+					w.inliers.push_back( i );
+					fInlierDist += d;
+				}
+			}
+
+			if ( w.inliers.size() > w.bestInliers.size() ||
+				( !w.inliers.empty() && w.inliers.size() == w.bestInliers.size() && fInlierDist < w.bestDistance ) )
+			{
+				OPT_LOG_TRACE( w.inliers.size() << " inlier, avg dist=" << fInlierDist / w.inliers.size() );
+				w.bestInliers.swap( w.inliers );
+				w.bestDistance = fInlierDist;
+			}
+		}
+	}
+
+protected:
+	const Data& m_data;
+	const RansacParameter< T >& m_params;
+	const RansacOptions& m_options;
+	std::vector< Worker >& m_workers;
+	const std::size_t m_nHypothesesPerRound;
+	std::size_t m_nRoundBest;
+};
+
+/** @internal the adaptive RANSAC loop, returns the inlier indices of the best hypothesis */
+template< class ResultType, class Data, typename T >
+std::size_t adaptiveRansacImpl( const Data& data, const RansacParameter< T >& params, const RansacOptions& options,
+	std::vector< std::size_t >& bestInliers )
+{
+	typedef RansacWorker< Data, ResultType, T > Worker;
+	const std::size_t nValues = data.size();
+	bestInliers.clear();
+	if ( nValues < params.setSize || params.setSize == 0 || nValues < params.nMinInlier )
+		return 0;
+
+	const std::size_t nWorkers = std::max< std::size_t >( options.nWorkers, 1 );
+	std::vector< Worker > workers( nWorkers );
+	for ( std::size_t i = 0; i < nWorkers; i++ )
+	{
+		workers[ i ].rng.seed( static_cast< boost::uint32_t >( options.seed + i ) );
+		workers[ i ].sampleIndices.reserve( params.setSize );
+		workers[ i ].inliers.reserve( nValues );
+		workers[ i ].bestInliers.reserve( nValues );
+		workers[ i ].bestDistance = std::numeric_limits< T >::max();
+		workers[ i ].nHypotheses = 0;
+	}
+
+	RansacRound< Data, ResultType, T > round( data, params, options, workers );
+	std::size_t nIterations = params.nMaxIterations;
+	std::size_t nHypotheses = 0;
+	std::size_t iBestWorker = 0;
+	std::size_t nBest = 0;
+	while ( nHypotheses < nIterations )
+	{
+		round.setRoundBest( nBest );
+		if ( options.pThreadPool )
+			options.pThreadPool->parallelFor( nWorkers, round );
+		else
+			for ( std::size_t i = 0; i < nWorkers; i++ )
+				round( i );
+
+		// merge in worker order to stay deterministic
+		nHypotheses = 0;
+		for ( std::size_t i = 0; i < nWorkers; i++ )
+		{
+			nHypotheses += workers[ i ].nHypotheses;
+			if ( workers[ i ].bestInliers.size() > nBest ||
+				( workers[ i ].bestInliers.size() == nBest && nBest && workers[ i ].bestDistance < workers[ iBestWorker ].bestDistance ) )
+			{
+				nBest = workers[ i ].bestInliers.size();
+				iBestWorker = i;
+			}
+		}
+
+		// adapt the number of iterations to the inlier ratio found so far
+		if ( nBest >= params.nMinInlier )
+			nIterations = ransacIterations( nBest, nValues, params.setSize, options.confidence, params.nMaxIterations );
+		OPT_LOG_TRACE( "RANSAC: " << nHypotheses << " of " << nIterations << " hypotheses, " << nBest << " inlier" );
+	}
+
+	OPT_LOG_DEBUG( "RANSAC: " << nBest << " inlier after " << nHypotheses << " hypotheses" );
+	if ( nBest == 0 || nBest < params.nMinInlier )
+		return 0;
+
+	bestInliers.swap( workers[ iBestWorker ].bestInliers );
+	return nBest;
+}
+
+} // namespace detail
+
+
+/**
+ * @ingroup math
+ * RANSAC algorithm (for one-parameter problems) with adaptive termination.
+ *
+ * Uses the same \c RansacFunctor and \c RansacParameter as \c ransac, but
+ * - draws the minimal samples in O(setSize) with a random number generator per worker that is seeded
+ *   from \c RansacOptions::seed, instead of shuffling all indices with the global \c rand(),
+ * - reuses the sample buffers instead of allocating them for every hypothesis,
+ * - does not stop at the first hypothesis with \c nMinInlier inliers, but keeps the hypothesis with
+ *   the most inliers and lowers the number of iterations from \c params.nMaxIterations to the one
+ *   required for \c RansacOptions::confidence at the inlier ratio found so far,
+ * - stops scoring a hypothesis as soon as it cannot beat the best one, and optionally rejects
+ *   hypotheses early with a T(d,d) test,
+ * - distributes the hypotheses over \c RansacOptions::nWorkers generators that can run on a thread pool.
+ *   The result only depends on the seed and the number of workers. \c Estimator and \c Evaluator
+ *   must be thread-safe in this case.
+ *
+ * @param iBegin an \c iterator point to the first element of a container including the values
+ * @param iEnd an \c iterator point to the final element of a container including the values
+ * @param result returns the best estimated result for the given problem and parameter set
+ * @param model an instance of the struct/class that includes the Estimator and Evaluator FunctorObjects
+ * @param params an instance of the object containing the algorithms parametrization
+ * @param options additional settings
+ * @param pInliers optionally receives the indices of the inliers
+ * @return 0 (failure) or number of inlier on success
+ */
+template< class InputIterator, class ResultType, typename T, class RansacFunctor >
+std::size_t adaptiveRansac( const InputIterator iBegin, const InputIterator iEnd
+	, ResultType& result
+	, const RansacFunctor& model
+	, const RansacParameter< T >& params
+	, const RansacOptions& options = RansacOptions()
+	, std::vector< std::size_t >* pInliers = 0 )
+{
+	const detail::RansacData1< InputIterator, RansacFunctor > data( iBegin, iEnd );
+	std::vector< std::size_t > inliers;
+	const std::size_t nInliers = detail::adaptiveRansacImpl< ResultType >( data, params, options, inliers );
+	if ( !nInliers )
+		return 0;
+
+	// compute final result
+	typename detail::RansacData1< InputIterator, RansacFunctor >::Sample sample;
+	sample.list.reserve( nInliers );
+	if ( !data.estimate( result, inliers, sample ) )
+		return 0;
+
+	if ( pInliers )
+		pInliers->swap( inliers );
+	return nInliers;
+}
+
+/**
+ * @ingroup math
+ * RANSAC algorithm (for two-parameter problems) with adaptive termination.
+ *
+ * See the one-parameter version of \c adaptiveRansac for a description.
+ */
+template< typename InputIterator1, typename InputIterator2, class ResultType, typename T, class RansacFunctor >
+std::size_t adaptiveRansac( const InputIterator1 iBegin1, const InputIterator1 iEnd1
+	, const InputIterator2 iBegin2, const InputIterator2 iEnd2
+	, ResultType& result
+	, const RansacFunctor& model
+	, const RansacParameter< T >& params
+	, const RansacOptions& options = RansacOptions()
+	, std::vector< std::size_t >* pInliers = 0 )
+{
+	assert( std::distance( iBegin1, iEnd1 ) == std::distance( iBegin2, iEnd2 ) );
+	const detail::RansacData2< InputIterator1, InputIterator2, RansacFunctor > data( iBegin1, iEnd1, iBegin2 );
+	std::vector< std::size_t > inliers;
+	const std::size_t nInliers = detail::adaptiveRansacImpl< ResultType >( data, params, options, inliers );
+	if ( !nInliers )
+		return 0;
+
+	// compute final result
+	typename detail::RansacData2< InputIterator1, InputIterator2, RansacFunctor >::Sample sample;
+	sample.list1.reserve( nInliers );
+	sample.list2.reserve( nInliers );
+	if ( !data.estimate( result, inliers, sample ) )
+		return 0;
+
+	if ( pInliers )
+		pInliers->swap( inliers );
+	return nInliers;
+}
+
+}}} // namespace Ubitrack::Math::Optimization
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_ADAPTIVERANSAC_INCLUDED__
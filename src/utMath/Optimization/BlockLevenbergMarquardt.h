@@ -0,0 +1,337 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * Levenberg-Marquardt optimizer for problems made of independent residual blocks
+ */
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_BLOCKLEVENBERGMARQUARDT_H_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_BLOCKLEVENBERGMARQUARDT_H_INCLUDED__
+
+#ifdef HAVE_LAPACK
+
+#include <algorithm>
+#include <vector>
+
+#include "LevenbergMarquardt.h"
+#include <utUtil/ThreadPool.h>
+
+
+namespace Ubitrack { namespace Math { namespace Optimization {
+
+namespace detail {
+
+/**
+ * @internal
+ * Evaluates all residual blocks of a problem and accumulates the (weighted) normal equations
+ * J^T * J, J^T * r and the squared residual r^T * r. The blocks are split into contiguous chunks
+ * that are processed by the threads of a pool, each chunk has its own jacobian buffer and
+ * accumulators, which are summed up in a fixed order afterwards.
+ */
+template< class P, class X, class Y, class WFT >
+class LMBlockReduction
+{
+public:
+	typedef typename X::value_type T;
+
+	LMBlockReduction( const P& problem, const Y& measurement, const WFT& weightFunction,
+		const std::size_t nParams, const std::size_t nChunks )
+		: m_problem( problem )
+		, m_measurement( measurement )
+		, m_weightFunction( weightFunction )
+		, m_nParams( nParams )
+		, m_nBlocks( problem.blockCount() )
+		, m_pParams( 0 )
+		, m_chunks( nChunks )
+	{
+		for ( std::size_t c = 0; c < nChunks; c++ )
+		{
+			m_chunks[ c ].jtj.resize( nParams, nParams, false );
+			m_chunks[ c ].jtr.resize( nParams, false );
+		}
+	}
+
+	/** processes the blocks of one chunk */
+	void operator()( const std::size_t iChunk )
+	{
+		namespace ublas = boost::numeric::ublas;
+		Chunk& c( m_chunks[ iChunk ] );
+		const std::size_t n = m_nParams;
+
+		std::fill( c.jtj.data().begin(), c.jtj.data().end(), T( 0 ) );
+		std::fill( c.jtr.data().begin(), c.jtr.data().end(), T( 0 ) );
+		c.error = T( 0 );
+
+		T* pJtJ = &c.jtj( 0, 0 );
+		const std::size_t iEnd = ( iChunk + 1 ) * m_nBlocks / m_chunks.size();
+		for ( std::size_t iBlock = iChunk * m_nBlocks / m_chunks.size(); iBlock < iEnd; iBlock++ )
+		{
+			const ublas::range rows( m_problem.blockRange( iBlock ) );
+			const std::size_t m = rows.size();
+			if ( m == 0 )
+				continue;
+
+			lmResize( c.estimate, m );
+			lmResize( c.diff, m );
+			lmResize( c.jacobian, m, n );
+
+			m_problem.evaluateBlockWithJacobian( iBlock, c.estimate, *m_pParams, c.jacobian );
+			ublas::noalias( c.diff ) = ublas::subrange( m_measurement, rows.start(), rows.start() + m ) - c.estimate;
+
+			// multiply jacobian and difference with square root of weight matrix
+			if ( !m_weightFunction.noWeights() )
+			{
+				lmResize( c.weights, m );
+				m_weightFunction.computeWeights( c.diff, c.weights );
+				for ( std::size_t k = 0; k < m; k++ )
+				{
+					const T w = sqrt( c.weights( k ) );
+					c.diff( k ) *= w;
+					ublas::row( c.jacobian, k ) *= w;
+				}
+			}
+
+			// the jacobian is stored column major, so J^T * J consists of dot products of contiguous columns
+			const T* pJ = &c.jacobian( 0, 0 );
+			const T* pDiff = &c.diff( 0 );
+			for ( std::size_t j = 0; j < n; j++ )
+			{
+				const T* pColJ = pJ + j * m;
+				T s( 0 );
+				for ( std::size_t k = 0; k < m; k++ )
+					s += pColJ[ k ] * pDiff[ k ];
+				c.jtr( j ) += s;
+
+				for ( std::size_t i = j; i < n; i++ )
+				{
+					const T* pColI = pJ + i * m;
+					T d( 0 );
+					for ( std::size_t k = 0; k < m; k++ )
+						d += pColI[ k ] * pColJ[ k ];
+					pJtJ[ j * n + i ] += d;
+				}
+			}
+
+			for ( std::size_t k = 0; k < m; k++ )
+				c.error += pDiff[ k ] * pDiff[ k ];
+		}
+	}
+
+	/**
+	 * evaluates the problem at \c params and stores the full normal equations in \c jtj and \c jtr
+	 * @return the weighted squared residual
+	 */
+	T run( const X& params, Ubitrack::Util::ThreadPool* pThreadPool, Math::Matrix< T >& jtj, Math::Vector< T >& jtr )
+	{
+		m_pParams = &params;
+		if ( pThreadPool && m_chunks.size() > 1 )
+			pThreadPool->parallelFor( m_chunks.size(), *this );
+		else
+			for ( std::size_t c = 0; c < m_chunks.size(); c++ )
+				( *this )( c );
+		m_pParams = 0;
+
+		// sum up the lower triangles and mirror them to the upper one
+		jtj = m_chunks[ 0 ].jtj;
+		jtr = m_chunks[ 0 ].jtr;
+		T error = m_chunks[ 0 ].error;
+		for ( std::size_t c = 1; c < m_chunks.size(); c++ )
+		{
+			jtj += m_chunks[ c ].jtj;
+			jtr += m_chunks[ c ].jtr;
+			error += m_chunks[ c ].error;
+		}
+		for ( std::size_t j = 0; j < m_nParams; j++ )
+			for ( std::size_t i = j + 1; i < m_nParams; i++ )
+				jtj( j, i ) = jtj( i, j );
+
+		return error;
+	}
+
+protected:
+	/** accumulators and buffers of one chunk */
+	struct Chunk
+	{
+		Math::Matrix< T > jtj;
+		Math::Vector< T > jtr;
+		T error;
+		Math::Vector< T > estimate;
+		Math::Vector< T > diff;
+		Math::Vector< T > weights;
+		Math::Matrix< T > jacobian;
+	};
+
+	const P& m_problem;
+	const Y& m_measurement;
+	const WFT& m_weightFunction;
+	const std::size_t m_nParams;
+	const std::size_t m_nBlocks;
+	const X* m_pParams;
+	std::vector< Chunk > m_chunks;
+};
+
+} // namespace detail
+
+
+/**
+ * @ingroup math
+ * Optimize a problem that consists of independent residual blocks using the levenberg marquardt optimizer.
+ *
+ * In contrast to \c weightedLevenbergMarquardt, the full jacobian is never formed. Each block is
+ * evaluated separately and its contribution to the normal equations is accumulated immediately,
+ * so the memory needed does not depend on the number of measurements. If a thread pool is given,
+ * the blocks are distributed over its threads.
+ *
+ * @par The problem class
+ * The problem class P must implement the following functions, all of which must be safe to call
+ * concurrently from different threads:
+ * \code
+ * std::size_t blockCount() const;
+ * boost::numeric::ublas::range blockRange( std::size_t i ) const;
+ * template< class VT1, class VT2, class MT >
+ * void evaluateBlockWithJacobian( std::size_t i, VT1& result, const VT2& input, MT& J ) const;
+ * \endcode
+ * \c blockRange returns the rows of block i in the measurement vector. The ranges of all blocks
+ * must be disjoint. \c evaluateBlockWithJacobian stores the predicted measurements of block i
+ * in \c result (size of the range) and their derivatives wrt. the parameters in \c J (size of the
+ * range x number of parameters).
+ *
+ * @param problem the problem to optimize -- provides measurement estimates and jacobians per block
+ * @param params initial parameters on entry, optimized parameters on exit
+ * @param measurement the measurement vector
+ * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
+ *   bool operator()( unsigned iteration, double currentError, double previousError )
+ * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
+ * @param weightFunction computes weights from the residual. It is called for each block separately, so the weights
+ *   must only depend on the rows of the block, e.g. a \c TukeyWeightFunction whose rows per measurement divide the block sizes
+ * @param pThreadPool thread pool that evaluates the blocks, 0 runs in the calling thread
+ * @param solver least-squares solver to use
+ * @return the residual of the optimization process
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT >
+typename X::value_type weightedBlockLevenbergMarquardt( const P& problem, X& params, const Y& measurement,
+	const TC& terminationCriteria, const NT& normalize, const WFT& weightFunction,
+	Ubitrack::Util::ThreadPool* pThreadPool = 0, LmSolverType solver = lmUseCholesky,
+	const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+{
+	namespace ublas = boost::numeric::ublas;
+	typedef typename X::value_type T;
+
+	const std::size_t n_params = params.size();
+	const std::size_t n_blocks = problem.blockCount();
+	const std::size_t n_chunks = pThreadPool ? std::max< std::size_t >( 1, std::min( n_blocks, 4 * pThreadPool->size() ) ) : 1;
+	detail::LMBlockReduction< P, X, Y, WFT > reduction( problem, measurement, weightFunction, n_params, n_chunks );
+
+	// normal equations of the current and the trial parameters
+	Math::Matrix< T > jtj[ 2 ];
+	Math::Vector< T > jtr[ 2 ];
+	Math::Matrix< T > matJacobiSquare( n_params, n_params );
+	Math::Vector< T > paramDiff( n_params );
+	X newParams( params );
+	OptStatistics statistics;
+
+	// index of the normal equations of the current parameters
+	std::size_t iCurrent = 0;
+
+	// compute initial error
+	T fErrPrev = reduction.run( params, pThreadPool, jtj[ iCurrent ], jtr[ iCurrent ] );
+	statistics.evaluations++;
+	statistics.jacobianEvaluations++;
+	OPT_LOG_DEBUG( "Block Levenberg-Marquardt residual 0: " << fErrPrev );
+
+	// start optimization loop
+	T fLambda = T( fStepSize );
+	std::size_t iteration = 0;
+	bool bTerminate = false;
+	while ( !bTerminate )
+	{
+		++iteration;
+
+		// do one optimization step
+		ublas::noalias( matJacobiSquare ) = jtj[ iCurrent ];
+		ublas::noalias( paramDiff ) = jtr[ iCurrent ];
+
+		// add lambda to diagonal
+		for ( std::size_t i = 0; i < n_params; i++ )
+			matJacobiSquare( i, i ) += fLambda;
+
+		// do least squares, result in paramDiff
+		if ( !detail::lmSolve( matJacobiSquare, paramDiff, solver ) )
+		{
+			OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
+			continue;
+		}
+
+		OPT_LOG_TRACE( "paramDiff: " << paramDiff );
+		ublas::noalias( newParams ) = params + paramDiff;
+
+		// normalize
+		normalize.evaluate( newParams, newParams );
+
+		// compute new error
+		const std::size_t iTrial = 1 - iCurrent;
+		const T fErr = reduction.run( newParams, pThreadPool, jtj[ iTrial ], jtr[ iTrial ] );
+		statistics.evaluations++;
+		statistics.jacobianEvaluations++;
+		OPT_LOG_DEBUG( "Block Levenberg-Marquardt residual " << iteration << ": " << fErr );
+
+		// check if we should terminate
+		statistics.iterations = iteration;
+		optReportStatistics( terminationCriteria, statistics );
+		bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+
+		// update parameters
+		if ( fErr >= fErrPrev )
+			fLambda *= T( fStepFactor );
+		else
+		{
+			fLambda /= T( fStepFactor );
+			ublas::noalias( params ) = newParams;
+			iCurrent = iTrial;
+			fErrPrev = fErr;
+		}
+	}
+
+	return fErrPrev;
+}
+
+/**
+ * @ingroup math
+ * Optimize a problem that consists of independent residual blocks using the levenberg marquardt optimizer.
+ *
+ * See \c weightedBlockLevenbergMarquardt for a description of the parameters.
+ */
+template< class P, class X, class Y, class TC, class NT >
+typename X::value_type blockLevenbergMarquardt( const P& problem, X& params, const Y& measurement,
+	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(),
+	Ubitrack::Util::ThreadPool* pThreadPool = 0, LmSolverType solver = lmUseCholesky,
+	const typename X::value_type stepSize = 1.0, const typename X::value_type stepFactor = 10.0 )
+{ return weightedBlockLevenbergMarquardt( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(), pThreadPool, solver, stepSize, stepFactor ); }
+
+}}} // namespace Ubitrack::Math::Optimization
+
+#endif	// HAVE_LAPACK
+
+#endif	// __UBITRACK_MATH_OPTIMIZATION_BLOCKLEVENBERGMARQUARDT_H_INCLUDED__
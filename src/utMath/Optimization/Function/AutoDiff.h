@@ -0,0 +1,378 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * Forward-mode automatic differentiation of functions.
+ *
+ * This class will add the evaluateWithJacobian() and jacobian() methods to any function
+ * class whose evaluate() is written for a generic value type, like
+ * \c DiscreteJacobianApproximation does by finite differences.
+ */
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_FUNCTION_AUTODIFF_H_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_FUNCTION_AUTODIFF_H_INCLUDED__
+
+#include <utMath/Vector.h>
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Ubitrack { namespace Math { namespace Optimization { namespace Function {
+
+/**
+ * Number with its derivatives with respect to N parameters (a truncated Taylor series,
+ * also known as dual number or jet).
+ *
+ * The derivatives are stored in the object, so jets live on the stack and in fixed-size
+ * \c Math::Vector objects without allocations. Arithmetic operators and the functions of
+ * \c <cmath> below apply the chain rule. Functions that are to be differentiated must be
+ * written for a generic value type and call the math functions unqualified, e.g.
+ @code
+ using std::sqrt;
+ const T norm = sqrt( x * x + y * y );
+ @endcode
+ * so that argument dependent lookup finds the overloads for jets.
+ *
+ * @tparam T float or double
+ * @tparam N number of parameters
+ */
+template< typename T, std::size_t N >
+struct Jet
+{
+	typedef T value_type;
+	static const std::size_t size = N;
+
+	/** value */
+	T a;
+
+	/** derivatives with respect to the parameters */
+	T v[ N ];
+
+	Jet()
+		: a( 0 )
+	{ std::fill( v, v + N, T( 0 ) ); }
+
+	/** a constant */
+	Jet( const T& value )
+		: a( value )
+	{ std::fill( v, v + N, T( 0 ) ); }
+
+	/** the parameter \c k with the given value */
+	Jet( const T& value, const std::size_t k )
+		: a( value )
+	{
+		std::fill( v, v + N, T( 0 ) );
+		v[ k ] = 1;
+	}
+
+	/** a function of this jet with the given value and derivative */
+	Jet chain( const T& value, const T& derivative ) const
+	{
+		Jet result( value );
+		for ( std::size_t i = 0; i < N; i++ )
+			result.v[ i ] = derivative * v[ i ];
+		return result;
+	}
+
+	Jet operator-() const
+	{ return chain( -a, T( -1 ) ); }
+
+	Jet operator+() const
+	{ return *this; }
+
+	Jet& operator+=( const Jet& b )
+	{
+		a += b.a;
+		for ( std::size_t i = 0; i < N; i++ )
+			v[ i ] += b.v[ i ];
+		return *this;
+	}
+
+	Jet& operator-=( const Jet& b )
+	{
+		a -= b.a;
+		for ( std::size_t i = 0; i < N; i++ )
+			v[ i ] -= b.v[ i ];
+		return *this;
+	}
+
+	Jet& operator*=( const Jet& b )
+	{
+		for ( std::size_t i = 0; i < N; i++ )
+			v[ i ] = a * b.v[ i ] + b.a * v[ i ];
+		a *= b.a;
+		return *this;
+	}
+
+	Jet& operator/=( const Jet& b )
+	{
+		const T inv = 1 / b.a;
+		a *= inv;
+		for ( std::size_t i = 0; i < N; i++ )
+			v[ i ] = ( v[ i ] - a * b.v[ i ] ) * inv;
+		return *this;
+	}
+
+	Jet& operator+=( const T& b )
+	{
+		a += b;
+		return *this;
+	}
+
+	Jet& operator-=( const T& b )
+	{
+		a -= b;
+		return *this;
+	}
+
+	Jet& operator*=( const T& b )
+	{
+		a *= b;
+		for ( std::size_t i = 0; i < N; i++ )
+			v[ i ] *= b;
+		return *this;
+	}
+
+	Jet& operator/=( const T& b )
+	{ return *this *= 1 / b; }
+
+	// defined as friends, so integer and floating point constants convert to T
+	friend Jet operator+( Jet x, const Jet& y ) { return x += y; }
+	friend Jet operator-( Jet x, const Jet& y ) { return x -= y; }
+	friend Jet operator*( Jet x, const Jet& y ) { return x *= y; }
+	friend Jet operator/( Jet x, const Jet& y ) { return x /= y; }
+	friend Jet operator+( Jet x, const T& y ) { return x += y; }
+	friend Jet operator-( Jet x, const T& y ) { return x -= y; }
+	friend Jet operator*( Jet x, const T& y ) { return x *= y; }
+	friend Jet operator/( Jet x, const T& y ) { return x /= y; }
+	friend Jet operator+( const T& x, Jet y ) { return y += x; }
+	friend Jet operator-( const T& x, const Jet& y ) { return y.chain( x - y.a, T( -1 ) ); }
+	friend Jet operator*( const T& x, Jet y ) { return y *= x; }
+	friend Jet operator/( const T& x, const Jet& y ) { return y.chain( x / y.a, -x / ( y.a * y.a ) ); }
+
+	// comparisons use the values only
+	friend bool operator<( const Jet& x, const Jet& y ) { return x.a < y.a; }
+	friend bool operator>( const Jet& x, const Jet& y ) { return x.a > y.a; }
+	friend bool operator<=( const Jet& x, const Jet& y ) { return x.a <= y.a; }
+	friend bool operator>=( const Jet& x, const Jet& y ) { return x.a >= y.a; }
+	friend bool operator==( const Jet& x, const Jet& y ) { return x.a == y.a; }
+	friend bool operator!=( const Jet& x, const Jet& y ) { return x.a != y.a; }
+	friend bool operator<( const Jet& x, const T& y ) { return x.a < y; }
+	friend bool operator>( const Jet& x, const T& y ) { return x.a > y; }
+	friend bool operator<=( const Jet& x, const T& y ) { return x.a <= y; }
+	friend bool operator>=( const Jet& x, const T& y ) { return x.a >= y; }
+	friend bool operator==( const Jet& x, const T& y ) { return x.a == y; }
+	friend bool operator!=( const Jet& x, const T& y ) { return x.a != y; }
+	friend bool operator<( const T& x, const Jet& y ) { return x < y.a; }
+	friend bool operator>( const T& x, const Jet& y ) { return x > y.a; }
+	friend bool operator<=( const T& x, const Jet& y ) { return x <= y.a; }
+	friend bool operator>=( const T& x, const Jet& y ) { return x >= y.a; }
+	friend bool operator==( const T& x, const Jet& y ) { return x == y.a; }
+	friend bool operator!=( const T& x, const Jet& y ) { return x != y.a; }
+};
+
+template< typename T, std::size_t N >
+inline Jet< T, N > sqrt( const Jet< T, N >& x )
+{
+	const T s = std::sqrt( x.a );
+	return x.chain( s, T( 0.5 ) / s );
+}
+
+template< typename T, std::size_t N >
+inline Jet< T, N > exp( const Jet< T, N >& x )
+{
+	const T e = std::exp( x.a );
+	return x.chain( e, e );
+}
+
+template< typename T, std::size_t N >
+inline Jet< T, N > log( const Jet< T, N >& x )
+{ return x.chain( std::log( x.a ), 1 / x.a ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > sin( const Jet< T, N >& x )
+{ return x.chain( std::sin( x.a ), std::cos( x.a ) ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > cos( const Jet< T, N >& x )
+{ return x.chain( std::cos( x.a ), -std::sin( x.a ) ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > tan( const Jet< T, N >& x )
+{
+	const T t = std::tan( x.a );
+	return x.chain( t, 1 + t * t );
+}
+
+template< typename T, std::size_t N >
+inline Jet< T, N > asin( const Jet< T, N >& x )
+{ return x.chain( std::asin( x.a ), 1 / std::sqrt( 1 - x.a * x.a ) ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > acos( const Jet< T, N >& x )
+{ return x.chain( std::acos( x.a ), -1 / std::sqrt( 1 - x.a * x.a ) ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > atan( const Jet< T, N >& x )
+{ return x.chain( std::atan( x.a ), 1 / ( 1 + x.a * x.a ) ); }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > atan2( const Jet< T, N >& y, const Jet< T, N >& x )
+{
+	// d atan2( y, x ) = ( x dy - y dx ) / ( x^2 + y^2 )
+	const T inv = 1 / ( x.a * x.a + y.a * y.a );
+	Jet< T, N > result( std::atan2( y.a, x.a ) );
+	for ( std::size_t i = 0; i < N; i++ )
+		result.v[ i ] = ( x.a * y.v[ i ] - y.a * x.v[ i ] ) * inv;
+	return result;
+}
+
+template< typename T, std::size_t N >
+inline Jet< T, N > fabs( const Jet< T, N >& x )
+{ return x.a < 0 ? -x : x; }
+
+template< typename T, std::size_t N >
+inline Jet< T, N > abs( const Jet< T, N >& x )
+{ return fabs( x ); }
+
+/** power with a constant exponent */
+template< typename T, std::size_t N, typename S >
+inline Jet< T, N > pow( const Jet< T, N >& x, const S exponent )
+{
+	const T e = static_cast< T >( exponent );
+	if ( e == 0 )
+		return Jet< T, N >( 1 );
+	return x.chain( std::pow( x.a, e ), e * std::pow( x.a, e - 1 ) );
+}
+
+
+/**
+ * Function class that computes the jacobian of a function by forward-mode automatic
+ * differentiation.
+ *
+ * The wrapped function class must implement
+ @code
+ template< class VT1, class VT2 > void evaluate( VT1& result, const VT2& input ) const
+ @endcode
+ * computing in \c typename VT2::value_type (or \c VT1::value_type), which is a \c Jet during
+ * differentiation. A single evaluation then gives the result and the exact jacobian, instead of
+ * the n + 1 evaluations and the truncation error of \c DiscreteJacobianApproximation.
+ *
+ * The object keeps the buffer for the differentiated result between calls, so it must not be
+ * used from several threads at the same time.
+ *
+ * @tparam FC the function class
+ * @tparam N number of parameters, i.e. size of the input vector
+ * @tparam T float or double
+ */
+template< class FC, std::size_t N, typename T = double >
+class AutoDiffJacobian
+{
+public:
+	typedef Jet< T, N > jet_type;
+
+	/**
+	 * construct a new differentiation.
+	 * @param f the function object whose jacobian is computed
+	 */
+	AutoDiffJacobian( const FC& f )
+		: m_f( f )
+	{}
+
+	/**
+	 * return the size of the result vector
+	 */
+	unsigned size() const
+	{ return m_f.size(); }
+
+	/**
+	 * Evaluate the function without derivatives.
+	 *
+	 * @param result vector to store the result in
+	 * @param input containing the parameters (to be optimized)
+	 */
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& input ) const
+	{ m_f.evaluate( result, input ); }
+
+	/**
+	 * Evaluate the function on the input \c input and return both the result
+	 * and the jacobian.
+	 *
+	 * @param result vector to store the result in
+	 * @param input containing the parameters (to be optimized)
+	 * @param J matrix to store the jacobian (evaluated for input) in
+	 */
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& J ) const
+	{
+		evaluateJets( input );
+		for ( std::size_t r = 0; r < m_jetResult.size(); r++ )
+		{
+			result( r ) = m_jetResult( r ).a;
+			for ( std::size_t c = 0; c < N; c++ )
+				J( r, c ) = m_jetResult( r ).v[ c ];
+		}
+	}
+
+	/**
+	 * Compute only the jacobian evaluated at the given state.
+	 *
+	 * @param input containing the parameters (to be optimized)
+	 * @param J matrix to store the jacobian (evaluated for input) in
+	 */
+	template< class VT2, class MT >
+	void jacobian( const VT2& input, MT& J ) const
+	{
+		evaluateJets( input );
+		for ( std::size_t r = 0; r < m_jetResult.size(); r++ )
+			for ( std::size_t c = 0; c < N; c++ )
+				J( r, c ) = m_jetResult( r ).v[ c ];
+	}
+
+protected:
+	template< class VT2 >
+	void evaluateJets( const VT2& input ) const
+	{
+		if ( input.size() != N )
+			UBITRACK_THROW( "Parameter vector does not match the size of the automatic differentiation" );
+
+		Math::Vector< jet_type, N > jetInput;
+		for ( std::size_t i = 0; i < N; i++ )
+			jetInput( i ) = jet_type( static_cast< T >( input( i ) ), i );
+
+		if ( m_jetResult.size() != m_f.size() )
+			m_jetResult.resize( m_f.size(), false );
+		m_f.evaluate( m_jetResult, jetInput );
+	}
+
+	FC m_f;
+	mutable Math::Vector< jet_type > m_jetResult;
+};
+
+}}}} // namespace Ubitrack::Math::Optimization::Function
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_FUNCTION_AUTODIFF_H_INCLUDED__
@@ -32,6 +32,9 @@
  * @author Daniel Pustka <daniel.pustka@in.tum.de>
  */
 
+#ifndef __UBITRACK_MATH_OPTIMIZATION_FUNCTION_DISCRETEJACOBIANAPPROXIMATION_H_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_FUNCTION_DISCRETEJACOBIANAPPROXIMATION_H_INCLUDED__
+
 #include <utMath/Vector.h>
 #include <boost/numeric/ublas/matrix_proxy.hpp> // column
  
@@ -40,7 +43,7 @@ namespace Ubitrack { namespace Math { namespace Optimization { namespace Functio
 /**
  * Function class that numerically approximates the jacobian of a function.
  * This requires n function evaluations for each jacobian computation, where n is the size of the
- * input vector.
+ * input vector. See \c AutoDiffJacobian for exact jacobians from a single evaluation.
  */
 template< class FC >
 class DiscreteJacobianApproximation
@@ -138,3 +141,5 @@ protected:
 };
 
 }}}} // namespace Ubitrack::Math::Optimization::Function
+
+#endif // __UBITRACK_MATH_OPTIMIZATION_FUNCTION_DISCRETEJACOBIANAPPROXIMATION_H_INCLUDED__
@@ -37,8 +37,7 @@
 #ifdef HAVE_LAPACK
 
 // Boost
-#include <boost/scoped_ptr.hpp>
-
+#include <boost/type_traits/integral_constant.hpp>
 #include <boost/numeric/ublas/matrix_proxy.hpp>
 #include <boost/numeric/ublas/vector_proxy.hpp>
 
@@ -51,6 +50,7 @@
 // Ubitrack
 #include "../Vector.h"
 #include "../Matrix.h"
+#include "../Cholesky.h"
 #include "Optimization.h"
 #include <utUtil/Exception.h>
 
@@ -60,68 +60,286 @@ namespace Ubitrack { namespace Math { namespace Optimization {
 /** possible solvers to use in levenberg-marquardt optimization */
 enum LmSolverType { lmUseCholesky, lmUseQR, lmUseSVD };
 
+namespace detail {
+
+/** @internal selects a stack allocated matrix if both dimensions are known at compile time */
+template< class T, std::size_t M, std::size_t N > struct LMMatrix { typedef Math::Matrix< T, M, N > type; };
+template< class T, std::size_t N > struct LMMatrix< T, 0, N > { typedef Math::Matrix< T > type; };
+template< class T, std::size_t M > struct LMMatrix< T, M, 0 > { typedef Math::Matrix< T > type; };
+template< class T > struct LMMatrix< T, 0, 0 > { typedef Math::Matrix< T > type; };
+
+/** @internal resizes a heap allocated vector, only if necessary */
+template< class T >
+void lmResize( Math::Vector< T >& v, const std::size_t n )
+{
+	if ( v.size() != n )
+		v.resize( n, false );
+}
+
+/** @internal stack allocated vectors cannot be resized */
+template< class T, std::size_t N >
+void lmResize( Math::Vector< T, N >&, const std::size_t n )
+{
+	if ( n != N )
+		UBITRACK_THROW( "Levenberg-Marquardt workspace size does not match the problem" );
+}
+
+/** @internal resizes a heap allocated matrix, only if necessary */
+template< class T >
+void lmResize( Math::Matrix< T >& m, const std::size_t n1, const std::size_t n2 )
+{
+	if ( m.size1() != n1 || m.size2() != n2 )
+		m.resize( n1, n2, false );
+}
+
+/** @internal stack allocated matrices cannot be resized */
+template< class T, std::size_t M, std::size_t N >
+void lmResize( Math::Matrix< T, M, N >&, const std::size_t n1, const std::size_t n2 )
+{
+	if ( n1 != M || n2 != N )
+		UBITRACK_THROW( "Levenberg-Marquardt workspace size does not match the problem" );
+}
+
+/** @internal the lapack bindings treat plain ublas vectors as single column matrices, but not \c Math::Vector */
+template< class V >
+typename V::base_type& lmColumn( V& v )
+{ return v; }
+
+template< class V >
+const typename V::base_type& lmColumn( const V& v )
+{ return v; }
+
+/** @internal computes J^T * J (lower triangle only for cholesky) and J^T * r with blas */
+template< class T, class MJ, class VR, class VP >
+void lmNormalEquations( const MJ& jacobian, const VR& diff, Math::Matrix< T >& jtj, VP& jtr, const LmSolverType solver )
+{
+	namespace blas = boost::numeric::bindings::blas;
+	if ( solver == lmUseCholesky )
+		blas::syrk( 'L', 'T', T( 1 ), jacobian, T( 0 ), jtj );
+	else
+		blas::gemm( 'T', 'N', T( 1 ), jacobian, jacobian, T( 0 ), jtj );
+
+	blas::gemm( 'T', 'N', T( 1 ), jacobian, lmColumn( diff ), T( 0 ), lmColumn( jtr ) );
+}
+
+/** @internal computes J^T * J and J^T * r inline for a fixed number of parameters */
+template< class T, std::size_t N, class MJ, class VR, class VP >
+void lmNormalEquations( const MJ& jacobian, const VR& diff, Math::Matrix< T, N, N >& jtj, VP& jtr, const LmSolverType )
+{
+	const std::size_t n_meas = jacobian.size1();
+	for ( std::size_t i = 0; i < N; i++ )
+	{
+		for ( std::size_t j = 0; j <= i; j++ )
+		{
+			T s( 0 );
+			for ( std::size_t k = 0; k < n_meas; k++ )
+				s += jacobian( k, i ) * jacobian( k, j );
+			jtj( i, j ) = s;
+			jtj( j, i ) = s;
+		}
+
+		T s( 0 );
+		for ( std::size_t k = 0; k < n_meas; k++ )
+			s += jacobian( k, i ) * diff( k );
+		jtr( i ) = s;
+	}
+}
+
+/** @internal solves the normal equations with lapack */
+template< class T >
+bool lmCholeskySolve( Math::Matrix< T >& jtj, Math::Vector< T >& jtr )
+{
+	return boost::numeric::bindings::lapack::posv( 'L', jtj, lmColumn( jtr ) ) == 0;
+}
+
+/** @internal solves the normal equations with an inline cholesky decomposition for a fixed number of parameters */
+template< class T, std::size_t N >
+bool lmCholeskySolve( Math::Matrix< T, N, N >& jtj, Math::Vector< T, N >& jtr )
+{
+	if ( !Math::cholesky_factor( jtj ) )
+		return false;
+	Math::cholesky_solve( jtj, jtr );
+	return true;
+}
+
+/**
+ * @internal solves the damped normal equations with the selected solver, the result is stored in \c jtr.
+ * Returns false and switches the solver to SVD if the cholesky decomposition fails.
+ */
+template< class MT, class VT >
+bool lmSolve( MT& jtj, VT& jtr, LmSolverType& solver )
+{
+	namespace lapack = boost::numeric::bindings::lapack;
+	namespace ublas = boost::numeric::ublas;
+	typedef typename VT::value_type T;
+
+	switch ( solver )
+	{
+	case lmUseCholesky:
+		if ( !lmCholeskySolve( jtj, jtr ) )
+		{
+			solver = lmUseSVD;
+			return false;
+		}
+		break;
+
+	case lmUseQR:
+		if ( lapack::gels( 'N', jtj, lmColumn( jtr ) ) != 0 )
+			UBITRACK_THROW( "lapack::gels returned an error" );
+		break;
+
+	case lmUseSVD:
+		{
+			Math::Vector< T > sv( jtr.size() );
+			int rank;
+			if ( lapack::gelss( jtj, lmColumn( jtr ), sv, T( -1 ), rank ) != 0 )
+				UBITRACK_THROW( "lapack::gelss returned an error" );
+			OPT_LOG_DEBUG( "Effective rank: " << rank );
+			OPT_LOG_TRACE( "Singular values: " << sv );
+			OPT_LOG_TRACE( "Highest singular vector: " << ublas::row( jtj, 0 ) );
+			OPT_LOG_TRACE( "Lowest effective singular vector: " << ublas::row( jtj, rank - 1 ) );
+		}
+		break;
+	}
+	return true;
+}
+
+} // namespace detail
+
+
 /**
  * @ingroup math
- * Optimize a given problem using the levenberg marquardt optimizer.
+ * Preallocated memory for \c weightedLevenbergMarquardt.
  *
- * @par The problem class
- * The problem class P must be modeled after the UnaryFunctionPrototype and implement the function
- * \c evaluateWithJacobian which computes the predicted measurement and the jacobian wrt. the parameters to optimize.
+ * A workspace can be kept by the caller and reused for many optimizations of the same size,
+ * such that the optimizer does not allocate memory on every call. Both sizes default to 0,
+ * which selects heap allocated buffers that are resized when the problem size changes.
  *
- * @param problem the problem to optimize -- provides measurement estimates and jacobians
- * @param params initial parameters on entry, optimized parameters on exit
- * @param measurement the measurement vector
- * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
- *   bool operator()( unsigned iteration, double currentError, double previousError )
- * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
- * @param solver least-squares solver to use
- * @return the residual of the optimization process
+ * If the number of parameters \c NParams is known at compile time, the normal equations are
+ * stored on the stack and solved with an inline cholesky decomposition (see Cholesky.h) instead
+ * of lapack. If also the number of measurements \c NMeas is fixed, the optimization does not
+ * allocate any memory at all (unless the SVD fallback is needed).
+ *
+ * @tparam T floating point type
+ * @tparam NMeas number of measurements, or 0 if unknown at compile time
+ * @tparam NParams number of parameters, or 0 if unknown at compile time
  */
-template< class P, class X, class Y, class TC, class NT, class WFT > 
-typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
-	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
-	 const WFT& weightFunction = OptNoWeightFunction(), LmSolverType solver = lmUseCholesky,
-	 const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+template< class T, std::size_t NMeas = 0, std::size_t NParams = 0 >
+struct LMWorkspace
 {
-	namespace lapack = boost::numeric::bindings::lapack;
-	namespace blas = boost::numeric::bindings::blas;
+	typedef typename detail::LMMatrix< T, NMeas, NParams >::type JacobianType;
+	typedef typename detail::LMMatrix< T, NParams, NParams >::type NormalMatrixType;
+	typedef Math::Vector< T, NMeas > MeasurementType;
+	typedef Math::Vector< T, NParams > ParameterType;
+
+	LMWorkspace()
+	{}
+
+	LMWorkspace( const std::size_t n_meas, const std::size_t n_params )
+	{ resize( n_meas, n_params ); }
+
+	/** adapts heap allocated buffers to the problem size, does nothing if the size did not change */
+	void resize( const std::size_t n_meas, const std::size_t n_params )
+	{
+		for ( std::size_t i = 0; i < 2; i++ )
+		{
+			detail::lmResize( jacobian[ i ], n_meas, n_params );
+			detail::lmResize( measurementDiff[ i ], n_meas );
+		}
+		detail::lmResize( estimatedMeasurement, n_meas );
+		detail::lmResize( weights, n_meas );
+		detail::lmResize( jacobiSquare, n_params, n_params );
+		detail::lmResize( paramDiff, n_params );
+		detail::lmResize( newParams, n_params );
+	}
+
+	/** jacobians of the current and the trial parameters */
+	JacobianType jacobian[ 2 ];
+
+	/** (weighted) differences between measurement and estimate of the current and the trial parameters */
+	MeasurementType measurementDiff[ 2 ];
+
+	MeasurementType estimatedMeasurement;
+	MeasurementType weights;
+	NormalMatrixType jacobiSquare;
+	ParameterType paramDiff;
+	ParameterType newParams;
+};
+
+
+namespace detail {
+
+/** @internal computes the weights of a measurement difference and multiplies the difference with their square roots */
+template< class WFT, class VD, class VW >
+void lmWeightDifference( const WFT& weightFunction, VD& diff, VW& weights )
+{
+	weightFunction.computeWeights( diff, weights );
+	for ( std::size_t i = 0; i < diff.size(); i++ )
+		diff( i ) *= sqrt( weights( i ) );
+	OPT_LOG_TRACE( "weights = " << weights );
+}
+
+/** @internal multiplies the rows of a jacobian with the square roots of the weights */
+template< class MJ, class VW >
+void lmWeightJacobian( MJ& jacobian, const VW& weights )
+{
+	for ( std::size_t i = 0; i < jacobian.size1(); i++ )
+		boost::numeric::ublas::row( jacobian, i ) *= sqrt( weights( i ) );
+}
+
+/** @internal evaluates a trial step together with its jacobian */
+template< class P, class VR, class VP, class MJ >
+void lmEvaluateTrial( P& problem, VR& result, const VP& params, MJ& jacobian, boost::false_type )
+{ problem.evaluateWithJacobian( result, params, jacobian ); }
+
+/** @internal evaluates only the measurement estimate of a trial step */
+template< class P, class VR, class VP, class MJ >
+void lmEvaluateTrial( P& problem, VR& result, const VP& params, MJ&, boost::true_type )
+{ problem.evaluate( result, params ); }
+
+/**
+ * @internal implementation of \c weightedLevenbergMarquardt and \c weightedLazyLevenbergMarquardt.
+ * If \c Lazy is \c boost::true_type, trial steps only evaluate the residual and the jacobian is
+ * computed after a step has been accepted.
+ */
+template< class Lazy, class P, class X, class Y, class TC, class NT, class WFT, std::size_t NMeas, std::size_t NParams > 
+typename X::value_type lmOptimize( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize, const WFT& weightFunction, 
+	LMWorkspace< typename X::value_type, NMeas, NParams >& workspace, LmSolverType solver,
+	const typename X::value_type fStepSize, const typename X::value_type fStepFactor )
+{
+	const bool bLazyJacobian = Lazy::value;
 	namespace ublas = boost::numeric::ublas;
 	typedef typename X::value_type T;
-	typedef typename Math::Matrix< T >::base_type MatType;
-	typedef typename Math::Vector< T >::base_type VecType;
 	
 	const std::size_t n_meas = measurement.size();
 	const std::size_t n_params = params.size();
-	// create some matrices and vectors
-	boost::scoped_ptr< MatType > pJacobian( new MatType( n_meas, n_params ) );
-	boost::scoped_ptr< MatType > pJacobian2( new MatType( n_meas, n_params ) );
-	MatType matJacobiSquare( n_params, n_params );
-	boost::scoped_ptr< VecType > pMeasurementDiff( new VecType( n_meas ) );
-	boost::scoped_ptr< VecType > pMeasurementDiff2( new VecType( n_meas ) );
-	VecType paramDiff( n_params );
-	VecType estimatedMeasurement( n_meas );
-	VecType newParams( n_params );
+	workspace.resize( n_meas, n_params );
+
+	typename LMWorkspace< T, NMeas, NParams >::NormalMatrixType& matJacobiSquare( workspace.jacobiSquare );
+	typename LMWorkspace< T, NMeas, NParams >::ParameterType& paramDiff( workspace.paramDiff );
+	typename LMWorkspace< T, NMeas, NParams >::ParameterType& newParams( workspace.newParams );
+	typename LMWorkspace< T, NMeas, NParams >::MeasurementType& estimatedMeasurement( workspace.estimatedMeasurement );
+	OptStatistics statistics;
+
+	// index of the jacobian and measurement difference of the current parameters
+	std::size_t iCurrent = 0;
 
 	// compute initial error
-	problem.evaluateWithJacobian( estimatedMeasurement, params, *pJacobian );
-	ublas::noalias( *pMeasurementDiff ) = measurement - estimatedMeasurement;
-	OPT_LOG_TRACE( "Measurement Diff = " << *pMeasurementDiff );
+	problem.evaluateWithJacobian( estimatedMeasurement, params, workspace.jacobian[ iCurrent ] );
+	statistics.evaluations++;
+	statistics.jacobianEvaluations++;
+	ublas::noalias( workspace.measurementDiff[ iCurrent ] ) = measurement - estimatedMeasurement;
+	OPT_LOG_TRACE( "Measurement Diff = " << workspace.measurementDiff[ iCurrent ] );
 
 	// multiply jacobian and difference with sqare root of weight matrix
 	if ( !weightFunction.noWeights() )
 	{
-		VecType weightVector( n_meas );
-		weightFunction.computeWeights( *pMeasurementDiff, weightVector );
-		for ( std::size_t i = 0; i < n_meas; i++ )
-		{
-			const T w = sqrt( weightVector( i ) );
-			(*pMeasurementDiff)( i ) *= w;
-			ublas::row( *pJacobian, i ) *= w;
-		}
-		OPT_LOG_TRACE( "weights = " << weightVector );
+		lmWeightDifference( weightFunction, workspace.measurementDiff[ iCurrent ], workspace.weights );
+		lmWeightJacobian( workspace.jacobian[ iCurrent ], workspace.weights );
 	}
 
-	T fErrPrev = ublas::inner_prod( *pMeasurementDiff, *pMeasurementDiff );
+	T fErrPrev = ublas::inner_prod( workspace.measurementDiff[ iCurrent ], workspace.measurementDiff[ iCurrent ] );
 	OPT_LOG_DEBUG( "Levenberg-Marquardt residual 0: " << fErrPrev );
 
 	// start optimization loop
@@ -133,46 +351,17 @@ typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const
 		++iteration;
 
 		// do one optimization step
-		if ( solver == lmUseCholesky )
-			blas::syrk( 'L', 'T', T( 1 ), *pJacobian, T( 0 ), matJacobiSquare );
-		else
-			blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pJacobian, T( 0 ), matJacobiSquare );
-
-		blas::gemm( 'T', 'N', T( 1 ), *pJacobian, *pMeasurementDiff, T( 0 ), paramDiff );
+		lmNormalEquations( workspace.jacobian[ iCurrent ], workspace.measurementDiff[ iCurrent ], matJacobiSquare, paramDiff, solver );
 		
 		// add lambda to diagonal
 		for ( std::size_t i = 0; i < n_params; i++ )
 			matJacobiSquare( i, i ) += fLambda;		
 		
-		// do least squares
-		switch ( solver )
+		// do least squares, result in paramDiff
+		if ( !lmSolve( matJacobiSquare, paramDiff, solver ) )
 		{
-		case lmUseCholesky:
-			if ( lapack::posv( 'L', matJacobiSquare, paramDiff ) != 0 ) // result in paramDiff
-			{
-				OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
-				solver = lmUseSVD;
-				continue;
-			}
-			break;
-
-		case lmUseQR:
-			if ( lapack::gels( 'N', matJacobiSquare, paramDiff ) != 0 ) // result in paramDiff
-				UBITRACK_THROW( "lapack::gels returned an error" );
-			break;
-
-		case lmUseSVD:
-			{
-				Math::Vector< T > sv( n_params );
-				int rank;
-				if ( lapack::gelss( matJacobiSquare, paramDiff, sv, T( -1 ), rank ) != 0 ) // result in paramDiff
-					UBITRACK_THROW( "lapack::gelss returned an error" );
-				OPT_LOG_DEBUG( "Effective rank: " << rank );
-				OPT_LOG_TRACE( "Singular values: " << sv );
-				OPT_LOG_TRACE( "Highest singular vector: " << ublas::row( matJacobiSquare, 0 ) );
-				OPT_LOG_TRACE( "Lowest effective singular vector: " << ublas::row( matJacobiSquare, rank - 1 ) );
-			}
-			break;
+			OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
+			continue;
 		}
 
 		OPT_LOG_TRACE( "paramDiff: " << paramDiff );
@@ -182,29 +371,29 @@ typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const
 		normalize.evaluate( newParams, newParams );
 
 		// compute new error
-		problem.evaluateWithJacobian( estimatedMeasurement, newParams, *pJacobian2 );
-		ublas::noalias( *pMeasurementDiff2 ) = measurement - estimatedMeasurement;
+		const std::size_t iTrial = 1 - iCurrent;
+		lmEvaluateTrial( problem, estimatedMeasurement, newParams, workspace.jacobian[ iTrial ], Lazy() );
+		statistics.evaluations++;
+		if ( !bLazyJacobian )
+			statistics.jacobianEvaluations++;
+		ublas::noalias( workspace.measurementDiff[ iTrial ] ) = measurement - estimatedMeasurement;
 
 		// multiply jacobian and difference with square root of weight matrix
 		if ( !weightFunction.noWeights() )
 		{
-			VecType weightVector( n_meas );
-			weightFunction.computeWeights( *pMeasurementDiff2, weightVector );
-			for ( std::size_t  i = 0; i < n_meas; i++ )
-			{
-				const T w = sqrt( weightVector( i ) );
-				(*pMeasurementDiff2)( i ) *= w;
-				ublas::row( *pJacobian2, i ) *= w;
-			}
-			OPT_LOG_TRACE( "weights = " << weightVector );
+			lmWeightDifference( weightFunction, workspace.measurementDiff[ iTrial ], workspace.weights );
+			if ( !bLazyJacobian )
+				lmWeightJacobian( workspace.jacobian[ iTrial ], workspace.weights );
 		}
 
-		const T fErr = ublas::inner_prod( *pMeasurementDiff2, *pMeasurementDiff2 );
+		const T fErr = ublas::inner_prod( workspace.measurementDiff[ iTrial ], workspace.measurementDiff[ iTrial ] );
 
-		OPT_LOG_TRACE( "measurementDiff: " << *pMeasurementDiff2 );
+		OPT_LOG_TRACE( "measurementDiff: " << workspace.measurementDiff[ iTrial ] );
 		OPT_LOG_DEBUG( "Levenberg-Marquardt residual " << iteration << ": " << fErr );
 
 		// check if we should terminate
+		statistics.iterations = iteration;
+		optReportStatistics( terminationCriteria, statistics );
 		bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
 
 		// update parameters
@@ -213,13 +402,20 @@ typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const
 		else
 		{
 			fLambda /= T( fStepFactor );
-			params = newParams;
+			ublas::noalias( params ) = newParams;
 
-			// swap measurementDiff
-			pMeasurementDiff.swap( pMeasurementDiff2 );
+			// the jacobian of an accepted step is only needed if the optimization continues
+			if ( bLazyJacobian && !bTerminate )
+			{
+				problem.evaluateWithJacobian( estimatedMeasurement, newParams, workspace.jacobian[ iTrial ] );
+				statistics.evaluations++;
+				statistics.jacobianEvaluations++;
+				if ( !weightFunction.noWeights() )
+					lmWeightJacobian( workspace.jacobian[ iTrial ], workspace.weights );
+			}
 
-			// swap jacobian
-			pJacobian.swap( pJacobian2 );
+			// swap measurementDiff and jacobian
+			iCurrent = iTrial;
 			
 			fErrPrev = fErr;
 		}
@@ -228,6 +424,68 @@ typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const
 	return fErrPrev;
 }
 
+} // namespace detail
+
+
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer, using a preallocated workspace.
+ *
+ * See the overload without workspace below for a description of the parameters.
+ * Use an \c LMWorkspace with a fixed number of parameters for small problems that are optimized often.
+ *
+ * @param workspace memory used by the optimizer, resized if necessary
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT, std::size_t NMeas, std::size_t NParams > 
+typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize, const WFT& weightFunction, 
+	LMWorkspace< typename X::value_type, NMeas, NParams >& workspace, LmSolverType solver = lmUseCholesky,
+	const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+{
+	return detail::lmOptimize< boost::false_type >( problem, params, measurement, terminationCriteria, normalize, weightFunction,
+		workspace, solver, fStepSize, fStepFactor );
+}
+
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer.
+ *
+ * @par The problem class
+ * The problem class P must be modeled after the UnaryFunctionPrototype and implement the function
+ * \c evaluateWithJacobian which computes the predicted measurement and the jacobian wrt. the parameters to optimize.
+ *
+ * @param problem the problem to optimize -- provides measurement estimates and jacobians
+ * @param params initial parameters on entry, optimized parameters on exit
+ * @param measurement the measurement vector
+ * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
+ *   bool operator()( unsigned iteration, double currentError, double previousError )
+ * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
+ * @param solver least-squares solver to use
+ * @return the residual of the optimization process
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT > 
+typename X::value_type weightedLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
+	 const WFT& weightFunction = OptNoWeightFunction(), LmSolverType solver = lmUseCholesky,
+	 const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+{
+	LMWorkspace< typename X::value_type > workspace( measurement.size(), params.size() );
+	return weightedLevenbergMarquardt( problem, params, measurement, terminationCriteria, normalize, weightFunction, 
+		workspace, solver, fStepSize, fStepFactor );
+}
+
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer, using a preallocated workspace.
+ *
+ * See \c weightedLevenbergMarquardt for a description of the parameters.
+ */
+template< class P, class X, class Y, class TC, class NT, std::size_t NMeas, std::size_t NParams > 
+typename X::value_type levenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize, LMWorkspace< typename X::value_type, NMeas, NParams >& workspace,
+	LmSolverType solver = lmUseCholesky, const typename X::value_type stepSize = 1.0, const typename X::value_type stepFactor = 10.0  )
+{ return weightedLevenbergMarquardt( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(), workspace, solver, stepSize, stepFactor ); }
+
 /**
  * @ingroup math
  * Optimize a given problem using the levenberg marquardt optimizer.
@@ -251,6 +509,45 @@ typename X::value_type levenbergMarquardt( P& problem, X& params, const Y& measu
 	LmSolverType solver = lmUseCholesky, const typename X::value_type stepSize = 1.0, const typename X::value_type stepFactor = 10.0  )
 { return weightedLevenbergMarquardt( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(), solver, stepSize, stepFactor ); }
 
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer, computing jacobians only for accepted steps.
+ *
+ * \c weightedLevenbergMarquardt evaluates the jacobian at every trial step, also at those that are
+ * rejected because they increase the residual. This variant evaluates only the measurement estimate
+ * for trial steps and computes the jacobian after a step has been accepted (and the optimization
+ * does not terminate), which pays off if many steps are rejected or the jacobian is expensive.
+ * Accepted steps evaluate the problem twice, so for cheap jacobians the eager variant is faster.
+ *
+ * The problem class must implement \c evaluate in addition to \c evaluateWithJacobian. See the
+ * overloads of \c weightedLevenbergMarquardt for a description of the parameters.
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT, std::size_t NMeas, std::size_t NParams > 
+typename X::value_type weightedLazyLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize, const WFT& weightFunction, 
+	LMWorkspace< typename X::value_type, NMeas, NParams >& workspace, LmSolverType solver = lmUseCholesky,
+	const typename X::value_type fStepSize = 1.0, const typename X::value_type fStepFactor = 10.0 )
+{
+	return detail::lmOptimize< boost::true_type >( problem, params, measurement, terminationCriteria, normalize, weightFunction,
+		workspace, solver, fStepSize, fStepFactor );
+}
+
+/**
+ * @ingroup math
+ * Optimize a given problem using the levenberg marquardt optimizer, computing jacobians only for accepted steps.
+ *
+ * See \c weightedLazyLevenbergMarquardt for a description of the parameters.
+ */
+template< class P, class X, class Y, class TC, class NT > 
+typename X::value_type lazyLevenbergMarquardt( P& problem, X& params, const Y& measurement, 
+	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(), 
+	LmSolverType solver = lmUseCholesky, const typename X::value_type stepSize = 1.0, const typename X::value_type stepFactor = 10.0  )
+{
+	LMWorkspace< typename X::value_type > workspace( measurement.size(), params.size() );
+	return weightedLazyLevenbergMarquardt( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(),
+		workspace, solver, stepSize, stepFactor );
+}
+
 }}} // namespace Ubitrack::Math::Optimization
 
 #endif	// HAVE_LAPACK
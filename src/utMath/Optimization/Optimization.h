@@ -81,6 +81,64 @@ protected:
 };
 
 
+/**
+ * Iterations and problem evaluations of an optimization. The optimizers pass the statistics to
+ * \c optReportStatistics before each call of the termination criteria.
+ */
+struct OptStatistics
+{
+	OptStatistics()
+		: iterations( 0 )
+		, evaluations( 0 )
+		, jacobianEvaluations( 0 )
+	{}
+
+	/** number of iterations, including those with rejected steps */
+	std::size_t iterations;
+
+	/** number of evaluations of the measurement estimate, with or without jacobian */
+	std::size_t evaluations;
+
+	/** number of evaluations of the jacobian */
+	std::size_t jacobianEvaluations;
+};
+
+
+/** 
+ * Termination criteria like \c OptTerminate that also keeps the statistics of the last optimization,
+ * e.g. to compare the number of jacobian evaluations of different optimizers.
+ */
+class OptTerminateWithStatistics
+	: public OptTerminate
+{
+public:
+	/** see \c OptTerminate */
+	OptTerminateWithStatistics( const std::size_t maxIterations, double precision = 0.0 )
+		: OptTerminate( maxIterations, precision )
+	{}
+
+	/** statistics of the last (or running) optimization */
+	const OptStatistics& statistics() const
+	{ return m_statistics; }
+
+	/** called by the optimizer */
+	void report( const OptStatistics& statistics ) const
+	{ m_statistics = statistics; }
+
+protected:
+	mutable OptStatistics m_statistics;
+};
+
+
+/** passes statistics to the termination criteria, ignored by default */
+template< class TC >
+inline void optReportStatistics( const TC&, const OptStatistics& )
+{}
+
+inline void optReportStatistics( const OptTerminateWithStatistics& terminationCriteria, const OptStatistics& statistics )
+{ terminationCriteria.report( statistics ); }
+
+
 /** default normalization, which does nothing */
 struct OptNoNormalize
 {
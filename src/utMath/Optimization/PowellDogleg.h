@@ -0,0 +1,251 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math
+ * @file
+ * Powell's dogleg trust region optimizer
+ */
+
+#ifndef __UBITRACK_MATH_OPTIMIZATION_POWELLDOGLEG_H_INCLUDED__
+#define __UBITRACK_MATH_OPTIMIZATION_POWELLDOGLEG_H_INCLUDED__
+
+#ifdef HAVE_LAPACK
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "LevenbergMarquardt.h"
+
+
+namespace Ubitrack { namespace Math { namespace Optimization {
+
+/**
+ * @ingroup math
+ * Optimize a given problem using Powell's dogleg trust region method, using a preallocated workspace.
+ *
+ * Each iteration combines the Gauss-Newton step and the steepest descent (Cauchy) step such that
+ * the step length stays within a trust region. The radius of the region grows if the reduction of
+ * the residual matches the prediction of the linear model, and shrinks otherwise.
+ *
+ * Unlike \c weightedLevenbergMarquardt, where every change of lambda requires solving the damped
+ * normal equations again, the normal equations are solved only once per jacobian: after a rejected
+ * step, the next step is computed from the cached Gauss-Newton and Cauchy steps with the smaller
+ * radius. Trial steps only evaluate the measurement estimate, the jacobian is computed after a step
+ * has been accepted.
+ *
+ * @par The problem class
+ * The problem class P must be modeled after the UnaryFunctionPrototype and implement the functions
+ * \c evaluate and \c evaluateWithJacobian.
+ *
+ * @param problem the problem to optimize -- provides measurement estimates and jacobians
+ * @param params initial parameters on entry, optimized parameters on exit
+ * @param measurement the measurement vector
+ * @param terminationCriteria functor that returns true if the optimization should terminate. Is called with
+ *   bool operator()( unsigned iteration, double currentError, double previousError )
+ * @param normalize a UnaryFunction called after each iteration to normalize the result. Only needs to implement \c evaluate()
+ * @param weightFunction computes weights from the residual, see \c weightedLevenbergMarquardt
+ * @param workspace memory used by the optimizer, resized if necessary. Only the first jacobian is used.
+ * @param solver least-squares solver for the Gauss-Newton step
+ * @param fRadius initial radius of the trust region in parameter space
+ * @return the residual of the optimization process
+ */
+template< class P, class X, class Y, class TC, class NT, class WFT, std::size_t NMeas, std::size_t NParams >
+typename X::value_type weightedPowellDogleg( P& problem, X& params, const Y& measurement,
+	const TC& terminationCriteria, const NT& normalize, const WFT& weightFunction,
+	LMWorkspace< typename X::value_type, NMeas, NParams >& workspace, LmSolverType solver = lmUseCholesky,
+	const typename X::value_type fRadius = 1.0 )
+{
+	namespace ublas = boost::numeric::ublas;
+	typedef typename X::value_type T;
+	typedef typename LMWorkspace< T, NMeas, NParams >::ParameterType ParameterType;
+
+	const std::size_t n_meas = measurement.size();
+	const std::size_t n_params = params.size();
+	workspace.resize( n_meas, n_params );
+
+	typename LMWorkspace< T, NMeas, NParams >::JacobianType& jacobian( workspace.jacobian[ 0 ] );
+	typename LMWorkspace< T, NMeas, NParams >::MeasurementType& estimatedMeasurement( workspace.estimatedMeasurement );
+	ParameterType& step( workspace.paramDiff );
+	ParameterType& newParams( workspace.newParams );
+	ParameterType gradient( workspace.paramDiff );
+	ParameterType gaussNewton( workspace.paramDiff );
+	OptStatistics statistics;
+
+	// index of the measurement difference of the current parameters
+	std::size_t iCurrent = 0;
+
+	// compute initial error
+	problem.evaluateWithJacobian( estimatedMeasurement, params, jacobian );
+	statistics.evaluations++;
+	statistics.jacobianEvaluations++;
+	ublas::noalias( workspace.measurementDiff[ iCurrent ] ) = measurement - estimatedMeasurement;
+	if ( !weightFunction.noWeights() )
+	{
+		detail::lmWeightDifference( weightFunction, workspace.measurementDiff[ iCurrent ], workspace.weights );
+		detail::lmWeightJacobian( jacobian, workspace.weights );
+	}
+
+	T fErrPrev = ublas::inner_prod( workspace.measurementDiff[ iCurrent ], workspace.measurementDiff[ iCurrent ] );
+	OPT_LOG_DEBUG( "Dogleg residual 0: " << fErrPrev );
+
+	// steps of the current jacobian
+	bool bNewJacobian = true;
+	T fGradientNorm( 0 );
+	T fCauchyLength( 0 );
+	T fGaussNewtonNorm( 0 );
+
+	T fDelta = fRadius;
+	std::size_t iteration = 0;
+	bool bTerminate = false;
+	while ( !bTerminate )
+	{
+		++iteration;
+
+		if ( bNewJacobian )
+		{
+			// gradient J^T * r and Gauss-Newton step ( J^T * J )^-1 * J^T * r
+			detail::lmNormalEquations( jacobian, workspace.measurementDiff[ iCurrent ], workspace.jacobiSquare, gradient, solver );
+			ublas::noalias( gaussNewton ) = gradient;
+
+			// a tiny damping keeps the cholesky decomposition working for parameters with a gauge freedom,
+			// e.g. the length of a quaternion. The gradient is orthogonal to such directions.
+			T fMaxDiagonal( 0 );
+			for ( std::size_t i = 0; i < n_params; i++ )
+				fMaxDiagonal = std::max( fMaxDiagonal, workspace.jacobiSquare( i, i ) );
+			for ( std::size_t i = 0; i < n_params; i++ )
+				workspace.jacobiSquare( i, i ) += std::sqrt( std::numeric_limits< T >::epsilon() ) * fMaxDiagonal;
+
+			if ( !detail::lmSolve( workspace.jacobiSquare, gaussNewton, solver ) )
+			{
+				OPT_LOG_DEBUG( "Error in cholesky decomposition, switching to SVD" );
+				continue;
+			}
+
+			// the minimum of the linear model along the gradient is at alpha * gradient
+			fGradientNorm = ublas::norm_2( gradient );
+			ublas::noalias( estimatedMeasurement ) = ublas::prod( jacobian, gradient );
+			const T fJg = ublas::norm_2( estimatedMeasurement );
+			fCauchyLength = fJg > T( 0 ) ? fGradientNorm * fGradientNorm * fGradientNorm / ( fJg * fJg ) : T( 0 );
+			fGaussNewtonNorm = ublas::norm_2( gaussNewton );
+			bNewJacobian = false;
+		}
+
+		// dogleg step within the trust region
+		if ( fGaussNewtonNorm <= fDelta )
+			ublas::noalias( step ) = gaussNewton;
+		else if ( fCauchyLength >= fDelta )
+			ublas::noalias( step ) = ( fDelta / fGradientNorm ) * gradient;
+		else
+		{
+			// from the cauchy point towards the Gauss-Newton step until the boundary is reached
+			ublas::noalias( step ) = ( fCauchyLength / fGradientNorm ) * gradient;
+			ublas::noalias( newParams ) = gaussNewton - step;
+			const T a = ublas::inner_prod( newParams, newParams );
+			const T b = ublas::inner_prod( step, newParams );
+			const T c = fCauchyLength * fCauchyLength - fDelta * fDelta;
+			const T beta = ( -b + std::sqrt( b * b - a * c ) ) / a;
+			step += beta * newParams;
+		}
+		const T fStepNorm = ublas::norm_2( step );
+
+		// reduction of r^T * r predicted by the linear model
+		ublas::noalias( estimatedMeasurement ) = ublas::prod( jacobian, step );
+		const T fJh = ublas::norm_2( estimatedMeasurement );
+		const T fPredicted = 2 * ublas::inner_prod( step, gradient ) - fJh * fJh;
+
+		OPT_LOG_TRACE( "step: " << step );
+		ublas::noalias( newParams ) = params + step;
+		normalize.evaluate( newParams, newParams );
+
+		// compute new error
+		const std::size_t iTrial = 1 - iCurrent;
+		problem.evaluate( estimatedMeasurement, newParams );
+		statistics.evaluations++;
+		ublas::noalias( workspace.measurementDiff[ iTrial ] ) = measurement - estimatedMeasurement;
+		if ( !weightFunction.noWeights() )
+			detail::lmWeightDifference( weightFunction, workspace.measurementDiff[ iTrial ], workspace.weights );
+
+		const T fErr = ublas::inner_prod( workspace.measurementDiff[ iTrial ], workspace.measurementDiff[ iTrial ] );
+		OPT_LOG_DEBUG( "Dogleg residual " << iteration << ": " << fErr << ", radius " << fDelta );
+
+		// check if we should terminate
+		statistics.iterations = iteration;
+		optReportStatistics( terminationCriteria, statistics );
+		bTerminate = terminationCriteria( iteration, fErr, fErrPrev );
+
+		// adapt the trust region to the quality of the linear model
+		const T fRho = fPredicted > T( 0 ) ? ( fErrPrev - fErr ) / fPredicted : T( -1 );
+		if ( fRho > T( 0.75 ) )
+			fDelta = std::max( fDelta, 3 * fStepNorm );
+		else if ( fRho < T( 0.25 ) )
+			fDelta = fStepNorm / 2;
+
+		// update parameters
+		if ( fErr < fErrPrev )
+		{
+			ublas::noalias( params ) = newParams;
+			iCurrent = iTrial;
+			fErrPrev = fErr;
+
+			if ( !bTerminate )
+			{
+				problem.evaluateWithJacobian( estimatedMeasurement, params, jacobian );
+				statistics.evaluations++;
+				statistics.jacobianEvaluations++;
+				if ( !weightFunction.noWeights() )
+					detail::lmWeightJacobian( jacobian, workspace.weights );
+				bNewJacobian = true;
+			}
+		}
+
+		// the trust region has collapsed
+		if ( fDelta <= std::numeric_limits< T >::epsilon() * ( ublas::norm_2( params ) + std::numeric_limits< T >::epsilon() ) )
+			bTerminate = true;
+	}
+
+	return fErrPrev;
+}
+
+/**
+ * @ingroup math
+ * Optimize a given problem using Powell's dogleg trust region method.
+ *
+ * See \c weightedPowellDogleg for a description of the parameters.
+ */
+template< class P, class X, class Y, class TC, class NT >
+typename X::value_type powellDogleg( P& problem, X& params, const Y& measurement,
+	const TC& terminationCriteria, const NT& normalize = OptNoNormalize(),
+	LmSolverType solver = lmUseCholesky, const typename X::value_type radius = 1.0 )
+{
+	LMWorkspace< typename X::value_type > workspace( measurement.size(), params.size() );
+	return weightedPowellDogleg( problem, params, measurement, terminationCriteria, normalize, OptNoWeightFunction(),
+		workspace, solver, radius );
+}
+
+}}} // namespace Ubitrack::Math::Optimization
+
+#endif	// HAVE_LAPACK
+
+#endif	// __UBITRACK_MATH_OPTIMIZATION_POWELLDOGLEG_H_INCLUDED__
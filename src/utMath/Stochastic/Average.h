@@ -31,6 +31,9 @@
  * @author Christian Waechter <christian.waechter@in.tum.de> (modified)
  */
 
+#ifndef __UBITRACK_MATH_STOCHASTIC_AVERAGE_H_INCLUDED__
+#define __UBITRACK_MATH_STOCHASTIC_AVERAGE_H_INCLUDED__
+
 // Ubitrack
 #include "../Scalar.h"
 #include "../Pose.h"
@@ -78,7 +81,11 @@ namespace Ubitrack { namespace Math { namespace Stochastic {
  AveragerCovariance.getAverage();
  
  @endcode
- * 
+ *
+ * The covariance is computed from raw sums, which loses precision for values far from the
+ * origin. Use \c Moments and \c QuaternionMoments from Moments.h for large recordings or
+ * when partial results of several threads have to be merged.
+ *
  */
 template< typename ResultType, std::size_t N = Util::TypeToVector< ResultType >::size >
 struct Average
@@ -151,7 +158,7 @@ struct Average< ResultType, 1 >
 
 /// overloaded unary bracket operator for Quaternion measurements, that brings all rotation measurements in the same hemisphere
 template<>
-void Average< Math::Quaternion >::operator() ( const value_type& value )
+inline void Average< Math::Quaternion >::operator() ( const value_type& value )
 {
 	++m_counter;
 	mean_type tmp;
@@ -161,7 +168,7 @@ void Average< Math::Quaternion >::operator() ( const value_type& value )
 
 /// overloaded getAverage function for Quaternion measurements, when new struct is available this should not be necessary anymore.
 template<>
-Math::Quaternion Average< Math::Quaternion >::getAverage() const
+inline Math::Quaternion Average< Math::Quaternion >::getAverage() const
 {
 	const mean_type mean = m_mean / m_counter;
 	return Quaternion( mean[ 0 ], mean[ 1 ], mean[ 2 ], mean[ 3 ] ).normalize();
@@ -169,7 +176,7 @@ Math::Quaternion Average< Math::Quaternion >::getAverage() const
 
 /// overloaded unary bracket operator for pose measurements, that brings all rotation measurements in the same hemisphere
 template<>
-void Average< Math::Pose >::operator() ( const value_type& value )
+inline void Average< Math::Pose >::operator() ( const value_type& value )
 {
 	++m_counter;
 	mean_type tmp;
@@ -188,7 +195,7 @@ void Average< Math::Pose >::operator() ( const value_type& value )
 
 /// overloaded getAverage function for Pose measurements, when new struct is available this should not be necessary anymore as well.
 template<>
-Math::Pose Average< Math::Pose >::getAverage() const
+inline Math::Pose Average< Math::Pose >::getAverage() const
 {
 	
 	const mean_type mean = m_mean / m_counter;
@@ -318,3 +325,5 @@ public:
 };
 
 } } } // namespace Ubitrack::Math::Stochastic
+
+#endif // __UBITRACK_MATH_STOCHASTIC_AVERAGE_H_INCLUDED__
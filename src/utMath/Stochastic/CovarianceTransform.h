@@ -43,6 +43,82 @@
 
 namespace Ubitrack { namespace Math { namespace Stochastic {
 
+namespace detail {
+
+/** @internal size of a \c Math::Vector that is known at compile time, 0 otherwise */
+template< class V >
+struct FixedSize
+{ static const std::size_t value = 0; };
+
+template< class T, std::size_t N >
+struct FixedSize< Math::Vector< T, N > >
+{ static const std::size_t value = N; };
+
+/** @internal type of a M x N jacobian, allocated on the stack if both sizes are known at compile time */
+template< class T, std::size_t M, std::size_t N >
+struct JacobianMatrix
+{ typedef Math::Matrix< T, M, N > type; };
+
+template< class T, std::size_t M >
+struct JacobianMatrix< T, M, 0 >
+{ typedef Math::Matrix< T > type; };
+
+template< class T, std::size_t N >
+struct JacobianMatrix< T, 0, N >
+{ typedef Math::Matrix< T > type; };
+
+template< class T >
+struct JacobianMatrix< T, 0, 0 >
+{ typedef Math::Matrix< T > type; };
+
+} // namespace detail
+
+
+/**
+ * Transforms a covariance matrix by a jacobian: resultCov = J * inCov * J^T.
+ *
+ * The result is symmetric, therefore only its lower triangle is computed and copied to the upper
+ * triangle. The intermediate product J * inCov has the type of the jacobian, which keeps it on the
+ * stack for fixed-size matrices.
+ *
+ * @param jacobian the jacobian J, a \c Math::Matrix
+ * @param inCov the covariance to be transformed, may be the same object as \c resultCov
+ * @param resultCov the transformed covariance (out)
+ * @param bAccumulate add the transformed covariance to \c resultCov instead of overwriting it
+ */
+template< class MT1, class MT2, class MT3 >
+void transformCovariance( const MT1& jacobian, const MT2& inCov, MT3& resultCov, const bool bAccumulate = false )
+{
+	typedef typename MT1::value_type VType;
+	const std::size_t m = jacobian.size1();
+	const std::size_t n = jacobian.size2();
+
+	// im = J * inCov
+	MT1 im( m, n );
+	for ( std::size_t j = 0; j < n; j++ )
+		for ( std::size_t i = 0; i < m; i++ )
+		{
+			VType s( 0 );
+			for ( std::size_t k = 0; k < n; k++ )
+				s += jacobian( i, k ) * inCov( k, j );
+			im( i, j ) = s;
+		}
+
+	// lower triangle of im * J^T
+	for ( std::size_t j = 0; j < m; j++ )
+		for ( std::size_t i = j; i < m; i++ )
+		{
+			VType s( 0 );
+			for ( std::size_t k = 0; k < n; k++ )
+				s += im( i, k ) * jacobian( j, k );
+			if ( bAccumulate )
+				s += resultCov( i, j );
+			resultCov( i, j ) = s;
+			resultCov( j, i ) = s;
+		}
+}
+
+
 /**
  * Transforms the vector by some function f and returns the result as a new vector with associated
  * covariance.
@@ -71,17 +147,16 @@ namespace Ubitrack { namespace Math { namespace Stochastic {
 template< class F, class VectorType1, class MT1, class VectorType2, class MT2 > 
 void transformWithCovariance( const F& f, VectorType1& resultVec, MT1& resultCov, const VectorType2& inVec, const MT2& inCov )
 {
-	namespace ublas = boost::numeric::ublas;
 	typedef typename VectorType1::value_type		VType;
-	typedef typename Math::Matrix< VType >	MatrixType;
+	typedef typename detail::JacobianMatrix< VType, detail::FixedSize< VectorType1 >::value,
+		detail::FixedSize< VectorType2 >::value >::type JacobianType;
 
 	// compute result and jacobian
-	MatrixType jacobian( resultVec.size(), inVec.size() );
+	JacobianType jacobian( resultVec.size(), inVec.size() );
 	f.evaluateWithJacobian( resultVec, inVec, jacobian );
 	
 	// transform covariance
-	MatrixType im( ublas::prod( jacobian, inCov ) );
-	noalias( resultCov ) = ublas::prod( im, ublas::trans( jacobian ) );
+	transformCovariance( jacobian, inCov, resultCov );
 }
 
 
@@ -166,6 +241,77 @@ void transformRangeInternalWithCovariance( const F& f, ErrorVector< VType, N >&
 	transformRangeInternalWithCovariance( f, v.value, v.covariance, iOutBegin, iOutEnd, iInBegin, iInEnd );
 }
 
+/**
+ * Overload for subvectors with sizes known at compile time, e.g. the quaternion of a pose.
+ *
+ * Works without any heap allocation and gives exactly the same result as the overload above.
+ * The sizes of the updated subvector ( \c NOut ) and of the input subvector ( \c NIn ) must be
+ * given explicitly as template parameters.
+ *
+ * @param f, see \c transform
+ * @param value the vector to be transformed
+ * @param covariance covariance of the vector
+ * @param iOutBegin first index of the subvector to be updated
+ * @param iInBegin first index of subvector used as input to f
+ */
+template< std::size_t NOut, std::size_t NIn, class F, class VT, class MT > 
+void transformRangeInternalWithCovariance( const F& f, VT& value, MT& covariance, unsigned iOutBegin, unsigned iInBegin )
+{
+	namespace ublas = boost::numeric::ublas;
+	typedef typename VT::value_type VType;
+	const std::size_t iOutEnd = iOutBegin + NOut;
+	
+	// compute result and jacobian
+	Math::Vector< VType, NOut > result;
+	Math::Matrix< VType, NOut, NIn > jacobian;
+	f.evaluateWithJacobian( result, ublas::subrange( value, iInBegin, iInBegin + NIn ), jacobian );
+	
+	// the diagonal part, before the covariance is modified
+	Math::Matrix< VType, NOut, NIn > im;
+	for ( std::size_t k = 0; k < NIn; k++ )
+		for ( std::size_t i = 0; i < NOut; i++ )
+		{
+			VType s( 0 );
+			for ( std::size_t l = 0; l < NIn; l++ )
+				s += jacobian( i, l ) * covariance( iInBegin + l, iInBegin + k );
+			im( i, k ) = s;
+		}
+
+	Math::Matrix< VType, NOut, NOut > diagonal;
+	for ( std::size_t j = 0; j < NOut; j++ )
+		for ( std::size_t i = 0; i < NOut; i++ )
+		{
+			VType s( 0 );
+			for ( std::size_t k = 0; k < NIn; k++ )
+				s += im( i, k ) * jacobian( j, k );
+			diagonal( i, j ) = s;
+		}
+	
+	// the rows/columns outside the updated subvector, one column at a time
+	for ( std::size_t c = 0; c < value.size(); c++ )
+	{
+		if ( c >= iOutBegin && c < iOutEnd )
+			continue;
+		
+		Math::Vector< VType, NOut > column;
+		for ( std::size_t i = 0; i < NOut; i++ )
+		{
+			VType s( 0 );
+			for ( std::size_t l = 0; l < NIn; l++ )
+				s += jacobian( i, l ) * covariance( iInBegin + l, c );
+			column( i ) = s;
+		}
+		
+		for ( std::size_t i = 0; i < NOut; i++ )
+			covariance( iOutBegin + i, c ) = covariance( c, iOutBegin + i ) = column( i );
+	}
+	
+	for ( std::size_t j = 0; j < NOut; j++ )
+		for ( std::size_t i = 0; i < NOut; i++ )
+			covariance( iOutBegin + i, iOutBegin + j ) = diagonal( i, j );
+	ublas::subrange( value, iOutBegin, iOutEnd ) = result;
+}
+
 
 /**
  * Transforms two vectors by some function f and computes the result with covariance
@@ -175,21 +321,17 @@ template< class F, class VectorType1, class MT1, class VectorType2, class MT2, c
 void binarytransformWithCovariance( const F& f, VectorType1& resultVec, MT1& resultCov, 
 	const VectorType2& inVec1, const MT2& inCov1, const VT3& inVec2, const MT3& inCov2 )
 {
-	namespace ublas = boost::numeric::ublas;
 	typedef typename VectorType1::value_type VType;
-	typedef typename Math::Matrix< VType >	MatrixType;
-	
+	const std::size_t M = detail::FixedSize< VectorType1 >::value;
 
 	// compute result and jacobian
-	MatrixType jacobian1( resultVec.size(), inVec1.size() );
-	MatrixType jacobian2( resultVec.size(), inVec2.size() );
+	typename detail::JacobianMatrix< VType, M, detail::FixedSize< VectorType2 >::value >::type jacobian1( resultVec.size(), inVec1.size() );
+	typename detail::JacobianMatrix< VType, M, detail::FixedSize< VT3 >::value >::type jacobian2( resultVec.size(), inVec2.size() );
 	f.evaluateWithJacobian( resultVec, inVec1, inVec2, jacobian1, jacobian2 );
 	
 	// transform covariance
-	MatrixType im1( ublas::prod( jacobian1, inCov1 ) );
-	noalias( resultCov ) = ublas::prod( im1, ublas::trans( jacobian1 ) );
-	MatrixType im2( ublas::prod( jacobian2, inCov2 ) );
-	noalias( resultCov ) += ublas::prod( im2, ublas::trans( jacobian2 ) );
+	transformCovariance( jacobian1, inCov1, resultCov );
+	transformCovariance( jacobian2, inCov2, resultCov, true );
 }
 
 
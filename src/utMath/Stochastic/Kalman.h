@@ -39,6 +39,11 @@
 #include <boost/numeric/bindings/lapack/posv.hpp>
 #include <boost/numeric/bindings/lapack/gesv.hpp>
 #include "../ErrorVector.h"
+#include "../Cholesky.h"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm> // std::swap
 
 // to turn on logging of internal processing, create a log4cpp::Category object called "logger"
 // and #define KALMAN_LOGGING before including this header 
@@ -230,12 +235,268 @@ void kalmanMeasurementUpdateIdentity( Math::ErrorVector< double, N >& state,
 }
 
 
+namespace detail {
+
+/**
+ * @internal Solves S * X = B in place for all columns of B using gaussian elimination with partial
+ * pivoting. Used as fallback if the innovation covariance is not numerically positive definite.
+ * \c s is destroyed.
+ */
+template< class T, std::size_t M, std::size_t N >
+void kalmanSolveGeneral( Math::Matrix< T, M, M >& s, Math::Matrix< T, M, N >& b )
+{
+	for ( std::size_t c = 0; c < M; c++ )
+	{
+		// find pivot
+		std::size_t p = c;
+		for ( std::size_t r = c + 1; r < M; r++ )
+			if ( std::fabs( s( r, c ) ) > std::fabs( s( p, c ) ) )
+				p = r;
+
+		if ( p != c )
+		{
+			for ( std::size_t j = 0; j < M; j++ )
+				std::swap( s( c, j ), s( p, j ) );
+			for ( std::size_t j = 0; j < N; j++ )
+				std::swap( b( c, j ), b( p, j ) );
+		}
+
+		// eliminate below the pivot
+		for ( std::size_t r = c + 1; r < M; r++ )
+		{
+			const T f = s( r, c ) / s( c, c );
+			for ( std::size_t j = c; j < M; j++ )
+				s( r, j ) -= f * s( c, j );
+			for ( std::size_t j = 0; j < N; j++ )
+				b( r, j ) -= f * b( c, j );
+		}
+	}
+
+	// back substitution
+	for ( std::size_t r = M; r-- > 0; )
+		for ( std::size_t j = 0; j < N; j++ )
+		{
+			T v = b( r, j );
+			for ( std::size_t k = r + 1; k < M; k++ )
+				v -= s( r, k ) * b( k, j );
+			b( r, j ) = v / s( r, r );
+		}
+}
+
+/**
+ * @internal Second half of the fixed-size measurement update, shared by all jacobian types.
+ *
+ * Computes the kalman gain K = C * S^-1 with a Cholesky solve and updates the state and the
+ * covariance in Joseph form, which for the optimal gain reads
+ * P' = P - K * C^T - C * K^T + K * S * K^T and keeps P' symmetric and positive semidefinite.
+ *
+ * @param state state vector of size N
+ * @param stateCov state covariance of size N x N
+ * @param c P * H^T
+ * @param s innovation covariance H * P * H^T + R
+ * @param innovation measurement - predicted measurement
+ */
+template< std::size_t N, std::size_t M, class VState, class MStateCov, class T >
+void kalmanJosephUpdate( VState& state, MStateCov& stateCov, const Math::Matrix< T, N, M >& c,
+	const Math::Matrix< T, M, M >& s, const Math::Vector< T, M >& innovation )
+{
+	// K^T = S^-1 * C^T
+	Math::Matrix< T, M, N > gainTrans;
+	for ( std::size_t k = 0; k < M; k++ )
+		for ( std::size_t i = 0; i < N; i++ )
+			gainTrans( k, i ) = c( i, k );
+
+	Math::Matrix< T, M, M > factor( s );
+	if ( Math::cholesky_factor( factor ) )
+		Math::cholesky_solve_matrix( factor, gainTrans );
+	else
+	{
+		// problem in the cholesky decomposition, try something else instead.
+		KALMAN_LOG_NOTICE( "Problem in cholesky decomposition for KF. Trying something else." );
+		factor = s;
+		kalmanSolveGeneral( factor, gainTrans );
+	}
+
+	// update state
+	for ( std::size_t i = 0; i < N; i++ )
+	{
+		T d( 0 );
+		for ( std::size_t k = 0; k < M; k++ )
+			d += gainTrans( k, i ) * innovation( k );
+		state( i ) += d;
+	}
+
+	// S * K^T
+	Math::Matrix< T, M, N > sGainTrans;
+	for ( std::size_t k = 0; k < M; k++ )
+		for ( std::size_t i = 0; i < N; i++ )
+		{
+			T d( 0 );
+			for ( std::size_t l = 0; l < M; l++ )
+				d += s( k, l ) * gainTrans( l, i );
+			sGainTrans( k, i ) = d;
+		}
+
+	// update covariance, upper triangle mirrored to the lower one
+	for ( std::size_t i = 0; i < N; i++ )
+		for ( std::size_t j = i; j < N; j++ )
+		{
+			T d( 0 );
+			for ( std::size_t k = 0; k < M; k++ )
+				d += gainTrans( k, i ) * ( sGainTrans( k, j ) - c( j, k ) ) - c( i, k ) * gainTrans( k, j );
+			const T v = stateCov( i, j ) + d;
+			stateCov( i, j ) = v;
+			stateCov( j, i ) = v;
+		}
+}
+
+} // namespace detail
+
+
+/**
+ * Fixed-size measurement update of a kalman filter for a general measurement function.
+ *
+ * Same as the dynamic version, but the state size \c N, the number of inputs \c NIn of the
+ * measurement function and the measurement size \c M are compile time constants. All
+ * temporaries are allocated on the stack, the innovation covariance is not inverted but
+ * decomposed by Cholesky and the covariance is updated in Joseph form.
+ *
+ * The state and its covariance may be of any (also dynamic) vector and matrix type, as long
+ * as their size is \c N. The covariance must be symmetric.
+ *
+ * Example: <tt>kalmanMeasurementUpdate< 13, 7, 3 >( state, cov, f, z, R, 6, 13 );</tt>
+ *
+ * @param state reference to state vector. Should contain the predicted value of a time update and
+ *     will be updated by the measurement.
+ * @param stateCov reference to state vector covariance matrix.
+ * @param measurementFunction function object of the measurement function. Must be modeled after
+ *   the \c Ubitrack::Algorithm::Function::Prototype
+ * @param measurement reference to measurement vector
+ * @param measurementCov reference to measurement covariance
+ * @param iBegin index of first element of state vector used as input to the measurement function.
+ * @param iEnd index of element after subvector of state used as input to measurement function, must be iBegin + NIn
+ */
+template< std::size_t N, std::size_t NIn, std::size_t M, class VState, class MStateCov, class MF, class VMeas, class MMeasCov >
+void kalmanMeasurementUpdate( VState& state, MStateCov& stateCov, const MF& measurementFunction,
+	const VMeas& measurement, const MMeasCov& measurementCov, std::size_t iBegin, std::size_t iEnd )
+{
+	namespace ublas = boost::numeric::ublas;
+	typedef typename VState::value_type VType;
+
+	assert( state.size() == N && iEnd - iBegin == NIn && iEnd <= N );
+	assert( measurement.size() == M );
+
+	// compute predicted measurement and jacobian
+	Math::Vector< VType, M > predicted;
+	Math::Matrix< VType, M, NIn > jacobian;
+	measurementFunction.evaluateWithJacobian( predicted, ublas::subrange( state, iBegin, iEnd ), jacobian );
+
+	// C = P * H^T
+	Math::Matrix< VType, N, M > c;
+	for ( std::size_t i = 0; i < N; i++ )
+		for ( std::size_t k = 0; k < M; k++ )
+		{
+			VType d( 0 );
+			for ( std::size_t j = 0; j < NIn; j++ )
+				d += stateCov( i, iBegin + j ) * jacobian( k, j );
+			c( i, k ) = d;
+		}
+
+	// S = H * P * H^T + R
+	Math::Matrix< VType, M, M > s;
+	for ( std::size_t k = 0; k < M; k++ )
+		for ( std::size_t l = 0; l < M; l++ )
+		{
+			VType d( measurementCov( k, l ) );
+			for ( std::size_t j = 0; j < NIn; j++ )
+				d += jacobian( k, j ) * c( iBegin + j, l );
+			s( k, l ) = d;
+		}
+
+	Math::Vector< VType, M > innovation;
+	for ( std::size_t k = 0; k < M; k++ )
+		innovation( k ) = measurement( k ) - predicted( k );
+
+	detail::kalmanJosephUpdate( state, stateCov, c, s, innovation );
+}
+
+
+/**
+ * Fixed-size measurement update for measurement functions that select elements of the state,
+ * i.e. where every row of the jacobian is a unit vector. Measurement element k corresponds to
+ * the state element \c indices[ k ]. No jacobian is built, the products with it reduce to
+ * copying rows and columns of the covariance.
+ *
+ * Example for a pose measurement with rotation at index iR:
+ * <tt>const std::size_t indices[ 7 ] = { 0, 1, 2, iR, iR + 1, iR + 2, iR + 3 };
+ * kalmanMeasurementUpdateSelection< 13, 7 >( state, cov, z, R, indices );</tt>
+ *
+ * @param state reference to state vector of size N
+ * @param stateCov reference to the symmetric state vector covariance matrix
+ * @param measurement reference to measurement vector of size M
+ * @param measurementCov reference to measurement covariance
+ * @param indices state element for each measurement element
+ */
+template< std::size_t N, std::size_t M, class VState, class MStateCov, class VMeas, class MMeasCov >
+void kalmanMeasurementUpdateSelection( VState& state, MStateCov& stateCov,
+	const VMeas& measurement, const MMeasCov& measurementCov, const std::size_t ( &indices )[ M ] )
+{
+	typedef typename VState::value_type VType;
+
+	assert( state.size() == N );
+	assert( measurement.size() == M );
+
+	// C = P * H^T are the selected columns of P
+	Math::Matrix< VType, N, M > c;
+	for ( std::size_t i = 0; i < N; i++ )
+		for ( std::size_t k = 0; k < M; k++ )
+			c( i, k ) = stateCov( i, indices[ k ] );
+
+	// S = H * P * H^T + R
+	Math::Matrix< VType, M, M > s;
+	for ( std::size_t k = 0; k < M; k++ )
+		for ( std::size_t l = 0; l < M; l++ )
+			s( k, l ) = c( indices[ k ], l ) + measurementCov( k, l );
+
+	Math::Vector< VType, M > innovation;
+	for ( std::size_t k = 0; k < M; k++ )
+		innovation( k ) = measurement( k ) - state( indices[ k ] );
+
+	detail::kalmanJosephUpdate( state, stateCov, c, s, innovation );
+}
+
+
+/**
+ * Fixed-size version of \c kalmanMeasurementUpdateIdentity, see \c kalmanMeasurementUpdateSelection.
+ *
+ * @param state reference to state vector of size N
+ * @param stateCov reference to the symmetric state vector covariance matrix
+ * @param measurement reference to measurement vector of size M
+ * @param measurementCov reference to measurement covariance
+ * @param iBegin index of first element of state vector to update
+ * @param iEnd index of element after subvector of state vector to update, must be iBegin + M
+ */
+template< std::size_t N, std::size_t M, class VState, class MStateCov, class VMeas, class MMeasCov >
+void kalmanMeasurementUpdateIdentity( VState& state, MStateCov& stateCov,
+	const VMeas& measurement, const MMeasCov& measurementCov, const std::size_t iBegin, const std::size_t iEnd )
+{
+	assert( iEnd - iBegin == M );
+
+	std::size_t indices[ M ];
+	for ( std::size_t k = 0; k < M; k++ )
+		indices[ k ] = iBegin + k;
+
+	kalmanMeasurementUpdateSelection< N, M >( state, stateCov, measurement, measurementCov, indices );
+}
+
+
 // TODO: kalmanMeasurementUpdate without iBegin and iEnd (using optimized uBlas)
 
 } } } // namespace Ubitrack::Math::Stochastic
 
 #undef KALMAN_LOG_DEBUG
 #undef KALMAN_LOG_TRACE
+#undef KALMAN_LOG_NOTICE
 
 #endif // HAVE_LAPACK
 
@@ -0,0 +1,442 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math stochastic
+ * @file
+ * Mergeable accumulators for the mean and covariance of vectors and for the mean of rotations.
+ */
+
+#ifndef __UBITRACK_MATH_STOCHASTIC_MOMENTS_H_INCLUDED__
+#define __UBITRACK_MATH_STOCHASTIC_MOMENTS_H_INCLUDED__
+
+#include "../Vector.h"
+#include "../Matrix.h"
+#include "../ErrorVector.h"
+#include "../Quaternion.h"
+#include <utUtil/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace Ubitrack { namespace Math { namespace Stochastic {
+
+/**
+ * @ingroup math stochastic
+ * @brief Numerically stable, mergeable accumulator of the mean and covariance of N-vectors.
+ *
+ * Single values are added with Welford's update, which keeps the mean and the sum of
+ * squared differences to the mean instead of raw sums, so values far from the origin do
+ * not lose precision. Two accumulators over disjoint sets of values can be merged
+ * (Chan et al.), which allows to split large recordings over threads, see
+ * \c accumulate_moments.
+ *
+ * Like \c Average it can be used with \c std::for_each:
+ @code
+ std::vector< Vector3d > points3d;
+ Moments< double, 3 > moments = std::for_each( points3d.begin(), points3d.end(), Moments< double, 3 >() );
+ moments.covariance();
+ @endcode
+ *
+ * @tparam T float or double
+ * @tparam N dimension of the vectors
+ */
+template< typename T, std::size_t N >
+class Moments
+{
+public:
+	typedef T value_type;
+	static const std::size_t size = N;
+
+	Moments()
+		: m_n( 0 )
+	{
+		std::fill( m_mean, m_mean + N, static_cast< T >( 0 ) );
+		std::fill( m_m2, m_m2 + N * N, static_cast< T >( 0 ) );
+	}
+
+	/**
+	 * Creates an accumulator from the moments of a set of values.
+	 * @param n number of values
+	 * @param mean their mean
+	 * @param m2 sum of the outer products of their differences to the mean, N x N row-major, only the upper triangle is read
+	 */
+	Moments( const std::size_t n, const T* mean, const T* m2 )
+		: m_n( n )
+	{
+		std::copy( mean, mean + N, m_mean );
+		std::copy( m2, m2 + N * N, m_m2 );
+	}
+
+	/** adds a value, anything with \c operator[] */
+	template< class VecType >
+	void operator()( const VecType& value )
+	{
+		m_n++;
+		T delta[ N ];
+		for ( std::size_t i = 0; i < N; i++ )
+		{
+			delta[ i ] = static_cast< T >( value[ i ] ) - m_mean[ i ];
+			m_mean[ i ] += delta[ i ] / m_n;
+		}
+		for ( std::size_t i = 0; i < N; i++ )
+		{
+			const T d = static_cast< T >( value[ i ] ) - m_mean[ i ];
+			for ( std::size_t j = 0; j <= i; j++ )
+				m_m2[ j * N + i ] += delta[ j ] * d;
+		}
+	}
+
+	/** adds the values of another accumulator */
+	void merge( const Moments& other )
+	{
+		if ( other.m_n == 0 )
+			return;
+		if ( m_n == 0 )
+		{
+			*this = other;
+			return;
+		}
+
+		const std::size_t n = m_n + other.m_n;
+		const T f = static_cast< T >( m_n ) * static_cast< T >( other.m_n ) / static_cast< T >( n );
+		T delta[ N ];
+		for ( std::size_t i = 0; i < N; i++ )
+		{
+			delta[ i ] = other.m_mean[ i ] - m_mean[ i ];
+			m_mean[ i ] += delta[ i ] * static_cast< T >( other.m_n ) / static_cast< T >( n );
+		}
+		for ( std::size_t i = 0; i < N; i++ )
+			for ( std::size_t j = i; j < N; j++ )
+				m_m2[ i * N + j ] += other.m_m2[ i * N + j ] + f * delta[ i ] * delta[ j ];
+		m_n = n;
+	}
+
+	/** number of values */
+	std::size_t count() const
+	{ return m_n; }
+
+	/** the mean of the values */
+	Math::Vector< T, N > mean() const
+	{
+		Math::Vector< T, N > result;
+		for ( std::size_t i = 0; i < N; i++ )
+			result( i ) = m_mean[ i ];
+		return result;
+	}
+
+	/** the covariance of the values, normalized by the number of values like \c Average */
+	Math::Matrix< T, N, N > covariance() const
+	{
+		Math::Matrix< T, N, N > result;
+		for ( std::size_t i = 0; i < N; i++ )
+			for ( std::size_t j = i; j < N; j++ )
+				result( i, j ) = result( j, i ) = m_n ? m_m2[ i * N + j ] / m_n : 0;
+		return result;
+	}
+
+	/** mean and covariance */
+	Math::ErrorVector< T, N > errorVector() const
+	{ return Math::ErrorVector< T, N >( mean(), covariance() ); }
+
+protected:
+	std::size_t m_n;
+	T m_mean[ N ];
+
+	/** sum of the outer products of the differences to the mean, upper triangle */
+	T m_m2[ N * N ];
+};
+
+
+/**
+ * @ingroup math stochastic
+ * @brief Mergeable accumulator of the mean of rotations.
+ *
+ * Accumulates the outer products of the quaternions. The mean is the eigenvector of the
+ * largest eigenvalue of their sum (Markley et al., "Averaging Quaternions", 2007), which
+ * minimizes the squared Frobenius distance of the rotation matrices and does not depend
+ * on the signs of the quaternions.
+ */
+class QuaternionMoments
+{
+public:
+	QuaternionMoments()
+		: m_n( 0 )
+		, m_outer( Math::Matrix< double, 4, 4 >::zeros() )
+	{}
+
+	/** adds a rotation */
+	void operator()( const Math::Quaternion& q )
+	{
+		const double v[ 4 ] = { q.x(), q.y(), q.z(), q.w() };
+		m_n++;
+		for ( std::size_t i = 0; i < 4; i++ )
+			for ( std::size_t j = i; j < 4; j++ )
+				m_outer( i, j ) += v[ i ] * v[ j ];
+	}
+
+	/** adds the rotations of another accumulator */
+	void merge( const QuaternionMoments& other )
+	{
+		m_n += other.m_n;
+		m_outer += other.m_outer;
+	}
+
+	/** number of rotations */
+	std::size_t count() const
+	{ return m_n; }
+
+	/** the mean rotation, with a non-negative real part */
+	Math::Quaternion mean() const;
+
+	/** the sum of the outer products of the quaternions (x, y, z, w), upper triangle */
+	const Math::Matrix< double, 4, 4 >& outerProducts() const
+	{ return m_outer; }
+
+protected:
+	std::size_t m_n;
+	Math::Matrix< double, 4, 4 > m_outer;
+};
+
+
+namespace detail {
+
+/** @internal number of values that are processed together by \c accumulate_moments */
+static const std::size_t momentsBlockSize = 64;
+
+/**
+ * @internal eigen decomposition of a small symmetric matrix with cyclic Jacobi rotations,
+ * the columns of \c v receive the eigenvectors of the eigenvalues on the diagonal of \c a
+ */
+template< typename T, std::size_t N >
+void jacobiEigen( Math::Matrix< T, N, N >& a, Math::Matrix< T, N, N >& v )
+{
+	v = Math::Matrix< T, N, N >::identity();
+	for ( std::size_t sweep = 0; sweep < 50; sweep++ )
+	{
+		T off = 0;
+		T diag = 0;
+		for ( std::size_t p = 0; p < N; p++ )
+		{
+			diag += a( p, p ) * a( p, p );
+			for ( std::size_t q = p + 1; q < N; q++ )
+				off += a( p, q ) * a( p, q );
+		}
+		if ( off <= std::numeric_limits< T >::epsilon() * std::numeric_limits< T >::epsilon() * diag )
+			return;
+
+		for ( std::size_t p = 0; p < N; p++ )
+			for ( std::size_t q = p + 1; q < N; q++ )
+			{
+				if ( a( p, q ) == 0 )
+					continue;
+
+				const T theta = ( a( q, q ) - a( p, p ) ) / ( 2 * a( p, q ) );
+				const T t = ( theta >= 0 ? 1 : -1 ) / ( std::fabs( theta ) + std::sqrt( theta * theta + 1 ) );
+				const T c = 1 / std::sqrt( t * t + 1 );
+				const T s = t * c;
+				for ( std::size_t k = 0; k < N; k++ )
+				{
+					const T akp = a( k, p );
+					const T akq = a( k, q );
+					a( k, p ) = c * akp - s * akq;
+					a( k, q ) = s * akp + c * akq;
+				}
+				for ( std::size_t k = 0; k < N; k++ )
+				{
+					const T apk = a( p, k );
+					const T aqk = a( q, k );
+					a( p, k ) = c * apk - s * aqk;
+					a( q, k ) = s * apk + c * aqk;
+
+					const T vkp = v( k, p );
+					const T vkq = v( k, q );
+					v( k, p ) = c * vkp - s * vkq;
+					v( k, q ) = s * vkp + c * vkq;
+				}
+			}
+	}
+}
+
+/**
+ * @internal accumulates chunks of a random access range, each chunk into its own result.
+ * The values are copied in blocks to one contiguous row per dimension, the moments of a
+ * block are computed with two passes over these rows and merged into the result.
+ */
+template< typename T, std::size_t N, typename InputIterator >
+struct MomentsReduction
+{
+	MomentsReduction( const InputIterator begin, const std::size_t n, const std::size_t nChunks )
+		: m_begin( begin )
+		, m_n( n )
+		, m_results( nChunks )
+	{}
+
+	void operator()( const std::size_t chunk )
+	{
+		T x[ N ][ momentsBlockSize ];
+		T mean[ N ];
+		T m2[ N * N ];
+
+		const std::size_t end = ( chunk + 1 ) * m_n / m_results.size();
+		for ( std::size_t start = chunk * m_n / m_results.size(); start < end; start += momentsBlockSize )
+		{
+			const std::size_t m = std::min( momentsBlockSize, end - start );
+			for ( std::size_t j = 0; j < m; j++ )
+			{
+				const typename std::iterator_traits< InputIterator >::value_type& value = *( m_begin + ( start + j ) );
+				for ( std::size_t i = 0; i < N; i++ )
+					x[ i ][ j ] = static_cast< T >( value[ i ] );
+			}
+
+			for ( std::size_t i = 0; i < N; i++ )
+			{
+				T sum = 0;
+				for ( std::size_t j = 0; j < m; j++ )
+					sum += x[ i ][ j ];
+				mean[ i ] = sum / m;
+				for ( std::size_t j = 0; j < m; j++ )
+					x[ i ][ j ] -= mean[ i ];
+			}
+
+			for ( std::size_t i1 = 0; i1 < N; i1++ )
+				for ( std::size_t i2 = i1; i2 < N; i2++ )
+				{
+					T sum = 0;
+					for ( std::size_t j = 0; j < m; j++ )
+						sum += x[ i1 ][ j ] * x[ i2 ][ j ];
+					m2[ i1 * N + i2 ] = sum;
+				}
+
+			m_results[ chunk ].merge( Moments< T, N >( m, mean, m2 ) );
+		}
+	}
+
+	const InputIterator m_begin;
+	const std::size_t m_n;
+	std::vector< Moments< T, N > > m_results;
+};
+
+/** @internal accumulates chunks of a random access range of quaternions */
+template< typename InputIterator >
+struct QuaternionReduction
+{
+	QuaternionReduction( const InputIterator begin, const std::size_t n, const std::size_t nChunks )
+		: m_begin( begin )
+		, m_n( n )
+		, m_results( nChunks )
+	{}
+
+	void operator()( const std::size_t chunk )
+	{
+		const std::size_t end = ( chunk + 1 ) * m_n / m_results.size();
+		for ( std::size_t i = chunk * m_n / m_results.size(); i < end; i++ )
+			m_results[ chunk ]( *( m_begin + i ) );
+	}
+
+	const InputIterator m_begin;
+	const std::size_t m_n;
+	std::vector< QuaternionMoments > m_results;
+};
+
+/** @internal runs a reduction on the pool and merges the chunk results in order */
+template< class Reduction, class Result >
+void runReduction( Reduction& reduction, Result& result, Ubitrack::Util::ThreadPool* pThreadPool )
+{
+	if ( pThreadPool )
+		pThreadPool->parallelFor( reduction.m_results.size(), reduction );
+	else
+		for ( std::size_t c = 0; c < reduction.m_results.size(); c++ )
+			reduction( c );
+
+	for ( std::size_t c = 0; c < reduction.m_results.size(); c++ )
+		result.merge( reduction.m_results[ c ] );
+}
+
+} // namespace detail
+
+
+inline Math::Quaternion QuaternionMoments::mean() const
+{
+	Math::Matrix< double, 4, 4 > a( m_outer );
+	for ( std::size_t i = 0; i < 4; i++ )
+		for ( std::size_t j = 0; j < i; j++ )
+			a( i, j ) = a( j, i );
+
+	Math::Matrix< double, 4, 4 > v;
+	detail::jacobiEigen( a, v );
+	std::size_t best = 0;
+	for ( std::size_t i = 1; i < 4; i++ )
+		if ( a( i, i ) > a( best, best ) )
+			best = i;
+
+	const double sign = v( 3, best ) < 0 ? -1 : 1;
+	return Math::Quaternion( sign * v( 0, best ), sign * v( 1, best ), sign * v( 2, best ), sign * v( 3, best ) ).normalize();
+}
+
+
+/**
+ * @ingroup math stochastic
+ * @brief adds a large range of vectors to a \c Moments accumulator
+ *
+ * The range is split into chunks that are accumulated in parallel on the threads of the
+ * pool and merged in order. Within a chunk, blocks of values are transposed to contiguous
+ * rows per dimension, so the inner loops run over the values and can be vectorized.
+ *
+ * @param begin random access iterator to the first value, anything with \c operator[]
+ * @param end iterator behind the last value
+ * @param result accumulator the values are added to
+ * @param pThreadPool thread pool, 0 runs in the calling thread
+ */
+template< typename T, std::size_t N, typename InputIterator >
+void accumulate_moments( const InputIterator begin, const InputIterator end, Moments< T, N >& result, Ubitrack::Util::ThreadPool* pThreadPool = 0 )
+{
+	const std::size_t n = std::distance( begin, end );
+	if ( n == 0 )
+		return;
+	const std::size_t nChunks = pThreadPool ? std::min( ( n + detail::momentsBlockSize - 1 ) / detail::momentsBlockSize, 4 * pThreadPool->size() ) : 1;
+	detail::MomentsReduction< T, N, InputIterator > reduction( begin, n, nChunks );
+	detail::runReduction( reduction, result, pThreadPool );
+}
+
+/**
+ * @ingroup math stochastic
+ * @brief adds a large range of quaternions to a \c QuaternionMoments accumulator, see \c accumulate_moments
+ */
+template< typename InputIterator >
+void accumulate_moments( const InputIterator begin, const InputIterator end, QuaternionMoments& result, Ubitrack::Util::ThreadPool* pThreadPool = 0 )
+{
+	const std::size_t n = std::distance( begin, end );
+	if ( n == 0 )
+		return;
+	const std::size_t nChunks = pThreadPool ? std::min( n, 4 * pThreadPool->size() ) : 1;
+	detail::QuaternionReduction< InputIterator > reduction( begin, n, nChunks );
+	detail::runReduction( reduction, result, pThreadPool );
+}
+
+} } } // namespace Ubitrack::Math::Stochastic
+
+#endif // __UBITRACK_MATH_STOCHASTIC_MOMENTS_H_INCLUDED__
@@ -0,0 +1,574 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup math stochastic
+ * @file
+ * Moving mean, covariance and timing statistics of measurement streams.
+ */
+
+#ifndef __UBITRACK_MATH_STOCHASTIC_STREAMINGSTATISTICS_H_INCLUDED__
+#define __UBITRACK_MATH_STOCHASTIC_STREAMINGSTATISTICS_H_INCLUDED__
+
+#include "../Vector.h"
+#include "../Matrix.h"
+#include "../Quaternion.h"
+#include "../Pose.h"
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Ubitrack { namespace Math { namespace Stochastic {
+
+/** time of a sample in nanoseconds, the same as \c Measurement::Timestamp */
+typedef unsigned long long int StreamTimestamp;
+
+namespace detail {
+
+/**
+ * @internal converts the payload of a stream to a flat vector and the mean of these vectors back.
+ * Rotations are flipped into the hemisphere of the current mean before they are added.
+ */
+template< class Payload >
+struct StreamTraits;
+
+template< typename T, std::size_t N >
+struct StreamTraits< Math::Vector< T, N > >
+{
+	typedef T precision_type;
+	static const std::size_t size = N;
+
+	static void toVector( const Math::Vector< T, N >& value, const T*, T* x )
+	{
+		for ( std::size_t i = 0; i < N; i++ )
+			x[ i ] = value( i );
+	}
+
+	static Math::Vector< T, N > fromMean( const T* mean )
+	{
+		Math::Vector< T, N > result;
+		for ( std::size_t i = 0; i < N; i++ )
+			result( i ) = mean[ i ];
+		return result;
+	}
+};
+
+template<>
+struct StreamTraits< Math::Quaternion >
+{
+	typedef double precision_type;
+	static const std::size_t size = 4;
+
+	static void toVector( const Math::Quaternion& value, const double* reference, double* x )
+	{
+		x[ 0 ] = value.x();
+		x[ 1 ] = value.y();
+		x[ 2 ] = value.z();
+		x[ 3 ] = value.w();
+		if ( x[ 0 ] * reference[ 0 ] + x[ 1 ] * reference[ 1 ] + x[ 2 ] * reference[ 2 ] + x[ 3 ] * reference[ 3 ] < 0 )
+			for ( std::size_t i = 0; i < 4; i++ )
+				x[ i ] = -x[ i ];
+	}
+
+	static Math::Quaternion fromMean( const double* mean )
+	{
+		return Math::Quaternion( mean[ 0 ], mean[ 1 ], mean[ 2 ], mean[ 3 ] ).normalize();
+	}
+};
+
+template<>
+struct StreamTraits< Math::Pose >
+{
+	typedef double precision_type;
+	static const std::size_t size = 7;
+
+	static void toVector( const Math::Pose& value, const double* reference, double* x )
+	{
+		for ( std::size_t i = 0; i < 3; i++ )
+			x[ i ] = value.translation()( i );
+		StreamTraits< Math::Quaternion >::toVector( value.rotation(), reference + 3, x + 3 );
+	}
+
+	static Math::Pose fromMean( const double* mean )
+	{
+		return Math::Pose( StreamTraits< Math::Quaternion >::fromMean( mean + 3 ), Math::Vector< double, 3 >( mean[ 0 ], mean[ 1 ], mean[ 2 ] ) );
+	}
+};
+
+
+/**
+ * @internal ring buffer of flat sample vectors and their times, with the mean and the scatter
+ * around the mean updated when samples are added at the back or removed at the front.
+ *
+ * Removing samples with the inverse Welford update slowly accumulates rounding errors, so the
+ * moments are recomputed from the buffer each time as many updates as the buffer holds have
+ * happened, which keeps the cost per sample constant.
+ */
+template< typename T, std::size_t D >
+class WindowMoments
+{
+public:
+	explicit WindowMoments( const std::size_t capacity )
+		: m_capacity( capacity )
+		, m_values( capacity * D )
+		, m_times( capacity )
+	{
+		if ( capacity == 0 )
+			UBITRACK_THROW( "Streaming statistics need a window of at least one sample" );
+		clear();
+	}
+
+	void clear()
+	{
+		m_first = 0;
+		m_n = 0;
+		m_nUpdates = 0;
+		m_sumSquaredIntervals = 0;
+		std::fill( m_mean, m_mean + D, static_cast< T >( 0 ) );
+		std::fill( m_m2, m_m2 + D * D, static_cast< T >( 0 ) );
+	}
+
+	/** adds a sample at the back, the buffer must not be full */
+	void pushBack( const T* x, const StreamTimestamp t )
+	{
+		if ( m_n > 0 )
+		{
+			const double interval = static_cast< double >( t ) - static_cast< double >( backTime() );
+			m_sumSquaredIntervals += interval * interval;
+		}
+
+		const std::size_t slot = ( m_first + m_n ) % m_capacity;
+		std::copy( x, x + D, &m_values[ slot * D ] );
+		m_times[ slot ] = t;
+		m_n++;
+
+		T delta[ D ];
+		for ( std::size_t i = 0; i < D; i++ )
+		{
+			delta[ i ] = x[ i ] - m_mean[ i ];
+			m_mean[ i ] += delta[ i ] / m_n;
+		}
+		for ( std::size_t i = 0; i < D; i++ )
+			for ( std::size_t j = i; j < D; j++ )
+				m_m2[ i * D + j ] += delta[ i ] * ( x[ j ] - m_mean[ j ] );
+
+		updated();
+	}
+
+	/** removes the oldest sample, the buffer must not be empty */
+	void popFront()
+	{
+		const T* x = &m_values[ m_first * D ];
+		if ( m_n == 1 )
+		{
+			clear();
+			return;
+		}
+
+		const double interval = static_cast< double >( m_times[ ( m_first + 1 ) % m_capacity ] ) - static_cast< double >( frontTime() );
+		m_sumSquaredIntervals -= interval * interval;
+
+		m_n--;
+		T delta[ D ];
+		for ( std::size_t i = 0; i < D; i++ )
+		{
+			delta[ i ] = x[ i ] - m_mean[ i ];
+			m_mean[ i ] -= delta[ i ] / m_n;
+		}
+		for ( std::size_t i = 0; i < D; i++ )
+			for ( std::size_t j = i; j < D; j++ )
+				m_m2[ i * D + j ] -= delta[ i ] * ( x[ j ] - m_mean[ j ] );
+		m_first = ( m_first + 1 ) % m_capacity;
+
+		updated();
+	}
+
+	std::size_t size() const
+	{ return m_n; }
+
+	std::size_t capacity() const
+	{ return m_capacity; }
+
+	StreamTimestamp frontTime() const
+	{ return m_times[ m_first ]; }
+
+	StreamTimestamp backTime() const
+	{ return m_times[ ( m_first + m_n - 1 ) % m_capacity ]; }
+
+	const T* mean() const
+	{ return m_mean; }
+
+	Math::Matrix< T, D, D > covariance() const
+	{
+		Math::Matrix< T, D, D > result;
+		for ( std::size_t i = 0; i < D; i++ )
+			for ( std::size_t j = i; j < D; j++ )
+				result( i, j ) = result( j, i ) = m_n ? m_m2[ i * D + j ] / m_n : 0;
+		return result;
+	}
+
+	/** mean time between consecutive samples in nanoseconds */
+	double meanInterval() const
+	{ return m_n < 2 ? 0.0 : ( static_cast< double >( backTime() ) - static_cast< double >( frontTime() ) ) / ( m_n - 1 ); }
+
+	/** standard deviation of the time between consecutive samples in nanoseconds */
+	double jitter() const
+	{
+		if ( m_n < 2 )
+			return 0.0;
+		const double mean = meanInterval();
+		return std::sqrt( std::max( 0.0, m_sumSquaredIntervals / ( m_n - 1 ) - mean * mean ) );
+	}
+
+protected:
+	void updated()
+	{
+		if ( ++m_nUpdates >= m_capacity )
+			recompute();
+	}
+
+	/** two-pass computation of the moments from the buffer */
+	void recompute()
+	{
+		m_nUpdates = 0;
+		std::fill( m_mean, m_mean + D, static_cast< T >( 0 ) );
+		std::fill( m_m2, m_m2 + D * D, static_cast< T >( 0 ) );
+		m_sumSquaredIntervals = 0;
+		if ( m_n == 0 )
+			return;
+
+		for ( std::size_t k = 0; k < m_n; k++ )
+		{
+			const T* x = &m_values[ ( ( m_first + k ) % m_capacity ) * D ];
+			for ( std::size_t i = 0; i < D; i++ )
+				m_mean[ i ] += x[ i ];
+		}
+		for ( std::size_t i = 0; i < D; i++ )
+			m_mean[ i ] /= m_n;
+
+		for ( std::size_t k = 0; k < m_n; k++ )
+		{
+			const std::size_t slot = ( m_first + k ) % m_capacity;
+			const T* x = &m_values[ slot * D ];
+			for ( std::size_t i = 0; i < D; i++ )
+				for ( std::size_t j = i; j < D; j++ )
+					m_m2[ i * D + j ] += ( x[ i ] - m_mean[ i ] ) * ( x[ j ] - m_mean[ j ] );
+
+			if ( k > 0 )
+			{
+				const double interval = static_cast< double >( m_times[ slot ] ) - static_cast< double >( m_times[ ( slot + m_capacity - 1 ) % m_capacity ] );
+				m_sumSquaredIntervals += interval * interval;
+			}
+		}
+	}
+
+	std::size_t m_capacity;
+	std::vector< T > m_values;
+	std::vector< StreamTimestamp > m_times;
+	std::size_t m_first;
+	std::size_t m_n;
+	std::size_t m_nUpdates;
+
+	T m_mean[ D ];
+
+	/** sum of the outer products of the differences to the mean, upper triangle */
+	T m_m2[ D * D ];
+
+	double m_sumSquaredIntervals;
+};
+
+} // namespace detail
+
+
+/**
+ * @ingroup math stochastic
+ * @brief Mean and covariance of the last n samples of a stream.
+ *
+ * The samples are kept in a ring buffer that is allocated once in the constructor. Adding a
+ * sample removes the oldest one from the moments and adds the new one, in constant time.
+ *
+ * Supported payloads are \c Vector< T, N >, \c Quaternion and \c Pose. Rotations are averaged
+ * by normalizing the mean of the quaternions after flipping each one into the hemisphere of
+ * the mean, which is accurate for the small spread within a window of a tracked object. The
+ * covariance is that of the flat representation (x, y, z, w for rotations, translation first
+ * for poses), normalized by the number of samples like \c Average.
+ *
+ * @tparam Payload type of the samples
+ */
+template< class Payload >
+class SlidingWindowStatistics
+{
+public:
+	typedef detail::StreamTraits< Payload > traits_type;
+	typedef typename traits_type::precision_type precision_type;
+	static const std::size_t size_vector = traits_type::size;
+
+	/** @param nSamples window length */
+	explicit SlidingWindowStatistics( const std::size_t nSamples )
+		: m_window( nSamples )
+	{}
+
+	/** adds a sample, dropping the oldest one if the window is full */
+	void push( const Payload& value )
+	{
+		precision_type x[ size_vector ];
+		traits_type::toVector( value, m_window.mean(), x );
+		if ( m_window.size() == m_window.capacity() )
+			m_window.popFront();
+		m_window.pushBack( x, 0 );
+	}
+
+	/** adds the payload of a \c Measurement::Measurement< Payload > */
+	template< class MeasurementType >
+	void pushMeasurement( const MeasurementType& m )
+	{ push( *m ); }
+
+	void clear()
+	{ m_window.clear(); }
+
+	/** number of samples in the window */
+	std::size_t size() const
+	{ return m_window.size(); }
+
+	/** true when the window holds \c nSamples samples */
+	bool full() const
+	{ return m_window.size() == m_window.capacity(); }
+
+	Payload mean() const
+	{ return traits_type::fromMean( m_window.mean() ); }
+
+	Math::Matrix< precision_type, size_vector, size_vector > covariance() const
+	{ return m_window.covariance(); }
+
+protected:
+	detail::WindowMoments< precision_type, size_vector > m_window;
+};
+
+
+/**
+ * @ingroup math stochastic
+ * @brief Mean, covariance and timing of the samples of a stream within a time span.
+ *
+ * Samples older than the time span before the newest sample are removed when a new sample
+ * arrives. The buffer holds at most \c maxSamples samples, which are allocated once; if more
+ * samples arrive within the time span, the oldest ones are removed early. Timestamps are
+ * expected in non-decreasing order.
+ *
+ * Besides the moments of the payload, see \c SlidingWindowStatistics, the mean interval and
+ * the jitter (standard deviation of the intervals) between consecutive samples are available
+ * to monitor the health of a tracker.
+ *
+ * @tparam Payload type of the samples
+ */
+template< class Payload >
+class TimeWindowStatistics
+{
+public:
+	typedef detail::StreamTraits< Payload > traits_type;
+	typedef typename traits_type::precision_type precision_type;
+	static const std::size_t size_vector = traits_type::size;
+
+	/**
+	 * @param duration time span of the window in nanoseconds
+	 * @param maxSamples maximum number of samples within the time span
+	 */
+	TimeWindowStatistics( const StreamTimestamp duration, const std::size_t maxSamples )
+		: m_duration( duration )
+		, m_window( maxSamples )
+	{}
+
+	/** adds a sample and removes the samples that left the time span */
+	void push( const StreamTimestamp t, const Payload& value )
+	{
+		while ( m_window.size() > 0 && ( m_window.size() == m_window.capacity() || m_window.frontTime() + m_duration <= t ) )
+			m_window.popFront();
+
+		precision_type x[ size_vector ];
+		traits_type::toVector( value, m_window.mean(), x );
+		m_window.pushBack( x, t );
+	}
+
+	/** adds a \c Measurement::Measurement< Payload > */
+	template< class MeasurementType >
+	void pushMeasurement( const MeasurementType& m )
+	{ push( m.time(), *m ); }
+
+	void clear()
+	{ m_window.clear(); }
+
+	/** number of samples in the window */
+	std::size_t size() const
+	{ return m_window.size(); }
+
+	Payload mean() const
+	{ return traits_type::fromMean( m_window.mean() ); }
+
+	Math::Matrix< precision_type, size_vector, size_vector > covariance() const
+	{ return m_window.covariance(); }
+
+	/** mean time between consecutive samples in nanoseconds, 0 for less than two samples */
+	double meanInterval() const
+	{ return m_window.meanInterval(); }
+
+	/** standard deviation of the time between consecutive samples in nanoseconds */
+	double jitter() const
+	{ return m_window.jitter(); }
+
+	/** samples per second, 0 for less than two samples or if all samples have the same timestamp */
+	double rate() const
+	{
+		const double interval = m_window.meanInterval();
+		return m_window.size() < 2 || interval <= 0 ? 0.0 : 1e9 / interval;
+	}
+
+protected:
+	StreamTimestamp m_duration;
+	detail::WindowMoments< precision_type, size_vector > m_window;
+};
+
+
+/**
+ * @ingroup math stochastic
+ * @brief Exponentially weighted mean and covariance of a stream.
+ *
+ * Each sample is weighted with \c alpha and the previous statistics with 1 - \c alpha
+ * (incremental form of D. H. D. West, 1979). No samples are stored. If the samples are
+ * added with a time, the mean interval and the jitter between them are weighted the same way.
+ * See \c SlidingWindowStatistics for the supported payloads.
+ *
+ * @tparam Payload type of the samples
+ */
+template< class Payload >
+class ExponentialStatistics
+{
+public:
+	typedef detail::StreamTraits< Payload > traits_type;
+	typedef typename traits_type::precision_type precision_type;
+	static const std::size_t size_vector = traits_type::size;
+
+	/** @param alpha weight of a new sample, in (0, 1] */
+	explicit ExponentialStatistics( const precision_type alpha )
+		: m_alpha( alpha )
+	{
+		if ( !( alpha > 0 && alpha <= 1 ) )
+			UBITRACK_THROW( "Weight of the exponential statistics must be in (0, 1]" );
+		clear();
+	}
+
+	void clear()
+	{
+		m_n = 0;
+		m_lastTime = 0;
+		m_meanInterval = 0;
+		m_intervalVariance = 0;
+		std::fill( m_mean, m_mean + size_vector, static_cast< precision_type >( 0 ) );
+		std::fill( m_cov, m_cov + size_vector * size_vector, static_cast< precision_type >( 0 ) );
+	}
+
+	/** adds a sample */
+	void push( const Payload& value )
+	{
+		precision_type x[ size_vector ];
+		traits_type::toVector( value, m_mean, x );
+		if ( m_n++ == 0 )
+		{
+			std::copy( x, x + size_vector, m_mean );
+			return;
+		}
+
+		precision_type delta[ size_vector ];
+		for ( std::size_t i = 0; i < size_vector; i++ )
+		{
+			delta[ i ] = x[ i ] - m_mean[ i ];
+			m_mean[ i ] += m_alpha * delta[ i ];
+		}
+		for ( std::size_t i = 0; i < size_vector; i++ )
+			for ( std::size_t j = i; j < size_vector; j++ )
+				m_cov[ i * size_vector + j ] = ( 1 - m_alpha ) * ( m_cov[ i * size_vector + j ] + m_alpha * delta[ i ] * delta[ j ] );
+	}
+
+	/** adds a sample with its time in nanoseconds */
+	void push( const StreamTimestamp t, const Payload& value )
+	{
+		if ( m_n > 0 )
+		{
+			const double interval = static_cast< double >( t ) - static_cast< double >( m_lastTime );
+			if ( m_n == 1 )
+				m_meanInterval = interval;
+			else
+			{
+				const double delta = interval - m_meanInterval;
+				m_meanInterval += m_alpha * delta;
+				m_intervalVariance = ( 1 - m_alpha ) * ( m_intervalVariance + m_alpha * delta * delta );
+			}
+		}
+		m_lastTime = t;
+		push( value );
+	}
+
+	/** adds a \c Measurement::Measurement< Payload > */
+	template< class MeasurementType >
+	void pushMeasurement( const MeasurementType& m )
+	{ push( m.time(), *m ); }
+
+	/** number of samples added */
+	std::size_t count() const
+	{ return m_n; }
+
+	Payload mean() const
+	{ return traits_type::fromMean( m_mean ); }
+
+	Math::Matrix< precision_type, size_vector, size_vector > covariance() const
+	{
+		Math::Matrix< precision_type, size_vector, size_vector > result;
+		for ( std::size_t i = 0; i < size_vector; i++ )
+			for ( std::size_t j = i; j < size_vector; j++ )
+				result( i, j ) = result( j, i ) = m_cov[ i * size_vector + j ];
+		return result;
+	}
+
+	/** weighted mean time between consecutive samples in nanoseconds */
+	double meanInterval() const
+	{ return m_meanInterval; }
+
+	/** weighted standard deviation of the time between consecutive samples in nanoseconds */
+	double jitter() const
+	{ return std::sqrt( m_intervalVariance ); }
+
+protected:
+	precision_type m_alpha;
+	std::size_t m_n;
+	StreamTimestamp m_lastTime;
+	double m_meanInterval;
+	double m_intervalVariance;
+	precision_type m_mean[ size_vector ];
+
+	/** upper triangle of the covariance */
+	precision_type m_cov[ size_vector * size_vector ];
+};
+
+} } } // namespace Ubitrack::Math::Stochastic
+
+#endif // __UBITRACK_MATH_STOCHASTIC_STREAMINGSTATISTICS_H_INCLUDED__
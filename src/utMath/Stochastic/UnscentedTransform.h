@@ -22,140 +22,345 @@
  */
 
 /**
+ * @ingroup math
+ * @file
+ * Unscented transform of vectors with covariance
+ *
  * @author Tobias Reichl <reichl@in.tum.de>
  */
 
 #ifndef __UBITRACK_MATH_UNSCENTEDTRANSFORM_H_INCLUDED__
 #define __UBITRACK_MATH_UNSCENTEDTRANSFORM_H_INCLUDED__
- 
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+#include <boost/numeric/ublas/vector_proxy.hpp>
 
 #include <utMath/Pose.h>
 #include <utMath/Vector.h>
 #include <utMath/Matrix.h>
+#include <utMath/Cholesky.h>
 #include <utMath/Optimization/LevenbergMarquardt.h>
-
-// #include <boost/numeric/ublas/matrix_proxy.hpp>
-// #include <boost/numeric/ublas/vector_proxy.hpp>
+#include <utUtil/Exception.h>
+#include <utUtil/ThreadPool.h>
 
 namespace Ubitrack { namespace Math { namespace Stochastic {
 
 /**
- * Performs an Unscented Transform based on a set of measurements in 2D, a given variance (the probability distribution
- * in 2D is assumed to be isotrophic)  a 2D->6D function, and returns the predicted 6D covariance.
+ * @ingroup math stochastic
+ * @brief settings of the unscented transform
+ *
+ * The sigma points are placed at the mean and at +/- sqrt( n + lambda ) times the columns of the
+ * Cholesky factor of the covariance, with lambda = alpha^2 * ( n + kappa ) - n. The default values
+ * give the symmetric set of 2n points at +/- sqrt( n ) standard deviations plus the mean with weight 0.
  */
+struct UnscentedTransformOptions
+{
+	UnscentedTransformOptions()
+		: alpha( 1.0 )
+		, beta( 0.0 )
+		, kappa( 0.0 )
+		, pThreadPool( 0 )
+	{}
+
+	/** spread of the sigma points */
+	double alpha;
+
+	/** prior knowledge of the distribution, 2 is optimal for gaussians */
+	double beta;
+
+	/** secondary scaling parameter */
+	double kappa;
 
-// Note: the UnscentedTransform might be generalizable to arbitrary measurements and matrix dimensions,
-//    the covariance computation is specialized here (reduction from seven to six DOF)...
+	/** thread pool that evaluates the sigma points, 0 runs in the calling thread */
+	Ubitrack::Util::ThreadPool* pThreadPool;
+};
 
-template< class PType, class VType >
-Math::Matrix< double, 6, 6 > unscentedTransform(
-		const std::vector< Math::Vector< VType, 2 > >& measurements,
-		VType variance, PType& problem)
+
+/**
+ * @ingroup math stochastic
+ * Computes the 2n+1 sigma points of a vector with covariance and their weights.
+ *
+ * The point 0 is the mean, points 2i+1 and 2i+2 lie in positive and negative direction of column
+ * i of the Cholesky factor of the covariance.
+ *
+ * @param mean mean of the distribution (n-vector)
+ * @param covariance covariance of the distribution (n x n), must be positive definite
+ * @param options scaling parameters
+ * @param points the sigma points (out)
+ * @param meanWeights weights of the sigma points for the mean (out)
+ * @param covarianceWeights weights of the sigma points for the covariance (out)
+ */
+template< class VT, class MT >
+void unscentedSigmaPoints( const VT& mean, const MT& covariance, const UnscentedTransformOptions& options,
+	std::vector< Math::Vector< typename VT::value_type > >& points,
+	std::vector< typename VT::value_type >& meanWeights, std::vector< typename VT::value_type >& covarianceWeights )
 {
-	namespace ublas = boost::numeric::ublas;
+	typedef typename VT::value_type T;
+	const std::size_t n = mean.size();
 
-	// Get standard deviation
-	VType stddev = sqrt(variance);
-	
-	// Storage for optimized parameters
-	std::vector< Math::Vector< VType > > optimizedParameters;
+	Math::Matrix< T > factor( covariance );
+	if ( !Math::cholesky_factor( factor ) )
+		UBITRACK_THROW( "Unscented transform needs a positive definite covariance" );
 
-	// First guess of parameters
-	// TODO: better values than zero?
-	Math::Vector< VType, 7 > params = Math::Vector< VType, 7 >::zeros();
-	// Avoid degenerate (absolute value of zero) quaternion
-	params( 4 ) = 1;
+	const T lambda = T( options.alpha * options.alpha * ( n + options.kappa ) - n );
+	const T gamma = std::sqrt( n + lambda );
 
-	// Combine measurements into single vector
-	Math::Vector< VType > measurementsCombined ( 2 * measurements.size() );
-	for ( unsigned i = 0; i < measurements.size(); i++ )
+	points.resize( 2 * n + 1 );
+	points[ 0 ] = mean;
+	for ( std::size_t i = 0; i < n; i++ )
 	{
-		measurementsCombined[ 2 * i ] = measurements[ i ][ 0 ];
-		measurementsCombined[ 2 * i + 1 ] = measurements[ i ][ 1 ];
+		points[ 2 * i + 1 ] = mean;
+		points[ 2 * i + 2 ] = mean;
+		for ( std::size_t j = i; j < n; j++ )
+		{
+			points[ 2 * i + 1 ]( j ) += gamma * factor( j, i );
+			points[ 2 * i + 2 ]( j ) -= gamma * factor( j, i );
+		}
 	}
-	
-	// Create undisturbed set
-	Math::Vector< VType > sigmaSet ( 2 * measurements.size() );
-	sigmaSet = measurementsCombined;
-	
-	// LevenbergMarquadt on undisturbed set
-	VType residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-		Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
-
-	// Store optimized parameters
-	optimizedParameters.push_back(params);
-	
-	// Iterate over all measurements
-	for ( unsigned i = 0; i < measurementsCombined.size(); i++ )
+
+	meanWeights.assign( 2 * n + 1, T( 1 ) / ( 2 * ( n + lambda ) ) );
+	covarianceWeights.assign( 2 * n + 1, T( 1 ) / ( 2 * ( n + lambda ) ) );
+	meanWeights[ 0 ] = lambda / ( n + lambda );
+	covarianceWeights[ 0 ] = meanWeights[ 0 ] + T( 1 - options.alpha * options.alpha + options.beta );
+}
+
+
+namespace detail {
+
+/** @internal evaluates a function for a range of sigma points, one chunk per task of a thread pool */
+template< class F, class T >
+struct UnscentedEvaluation
+{
+	UnscentedEvaluation( const F& f, const std::vector< Math::Vector< T > >& points, std::vector< Math::Vector< T > >& results, const std::size_t nChunks )
+		: m_f( f )
+		, m_points( points )
+		, m_results( results )
+		, m_nChunks( nChunks )
+	{}
+
+	void operator()( const std::size_t chunk )
+	{
+		const std::size_t iEnd = ( chunk + 1 ) * m_points.size() / m_nChunks;
+		for ( std::size_t i = chunk * m_points.size() / m_nChunks; i < iEnd; i++ )
+			m_f.evaluate( m_results[ i ], m_points[ i ] );
+	}
+
+	const F& m_f;
+	const std::vector< Math::Vector< T > >& m_points;
+	std::vector< Math::Vector< T > >& m_results;
+	const std::size_t m_nChunks;
+};
+
+} // namespace detail
+
+
+/**
+ * @ingroup math stochastic
+ * Evaluates a function for all sigma points, in parallel if a thread pool is given.
+ *
+ * @param f function modeled after the \c UnaryFunctionPrototype, needs \c size() and a thread-safe \c evaluate()
+ * @param points the sigma points
+ * @param results the function values at the sigma points (out)
+ * @param pThreadPool thread pool that evaluates the points, 0 runs in the calling thread
+ */
+template< class F, class T >
+void unscentedEvaluate( const F& f, const std::vector< Math::Vector< T > >& points, std::vector< Math::Vector< T > >& results,
+	Ubitrack::Util::ThreadPool* pThreadPool = 0 )
+{
+	results.resize( points.size() );
+	for ( std::size_t i = 0; i < points.size(); i++ )
+		if ( results[ i ].size() != f.size() )
+			results[ i ].resize( f.size() );
+
+	const std::size_t nChunks = pThreadPool ? std::min( points.size(), 4 * pThreadPool->size() ) : 1;
+	detail::UnscentedEvaluation< F, T > evaluation( f, points, results, nChunks );
+	if ( pThreadPool )
+		pThreadPool->parallelFor( nChunks, evaluation );
+	else
+		evaluation( 0 );
+}
+
+
+/**
+ * @ingroup math stochastic
+ * Transforms a vector with covariance by a function f using the unscented transform.
+ *
+ * In contrast to \c transformWithCovariance, no jacobian is needed and the nonlinearity of f is
+ * taken into account up to second order. The function is evaluated at the 2n+1 sigma points, which
+ * are independent and evaluated in parallel if \c options.pThreadPool is set.
+ *
+ * @param f function modeled after the \c UnaryFunctionPrototype, needs \c size() and a thread-safe \c evaluate()
+ * @param resultVec mean of the result (out)
+ * @param resultCov covariance of the result (out)
+ * @param inVec input vector
+ * @param inCov covariance of the input vector
+ * @param options scaling of the sigma points and thread pool
+ */
+template< class F, class VT1, class MT1, class VT2, class MT2 >
+void unscentedTransform( const F& f, VT1& resultVec, MT1& resultCov, const VT2& inVec, const MT2& inCov,
+	const UnscentedTransformOptions& options = UnscentedTransformOptions() )
+{
+	namespace ublas = boost::numeric::ublas;
+	typedef typename VT2::value_type T;
+
+	std::vector< Math::Vector< T > > points;
+	std::vector< T > meanWeights;
+	std::vector< T > covarianceWeights;
+	unscentedSigmaPoints( inVec, inCov, options, points, meanWeights, covarianceWeights );
+
+	std::vector< Math::Vector< T > > results;
+	unscentedEvaluate( f, points, results, options.pThreadPool );
+
+	Math::Vector< T > mean( ublas::zero_vector< T >( f.size() ) );
+	for ( std::size_t i = 0; i < results.size(); i++ )
+		mean += meanWeights[ i ] * results[ i ];
+
+	Math::Matrix< T > covariance( ublas::zero_matrix< T >( f.size(), f.size() ) );
+	for ( std::size_t i = 0; i < results.size(); i++ )
 	{
-		// Copy undisturbed set and disturb it
-		sigmaSet = measurementsCombined;
-		sigmaSet[ i ] += stddev;
+		const Math::Vector< T > d( results[ i ] - mean );
+		covariance += covarianceWeights[ i ] * ublas::outer_prod( d, d );
+	}
+
+	resultVec = mean;
+	resultCov = covariance;
+}
 
-		// Reset parameters
-		params = Math::Vector< VType, 7 >::zeros();
-		params( 4 ) = 1;
 
-		// LevenbergMarquadt on disturbed set
-		residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-			Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
+#ifdef HAVE_LAPACK
 
-		// Debugging: output progress
-		// std::cout << "+";
+/**
+ * @ingroup math stochastic
+ * The function that maps a measurement vector to the parameters that minimize a least-squares problem.
+ *
+ * Every evaluation runs a Levenberg-Marquardt optimization starting from the same initial parameters.
+ * Used with \c unscentedTransform to propagate the covariance of measurements to the estimated
+ * parameters; the initial parameters should then be the solution for the unperturbed measurements,
+ * such that the optimizations of the sigma points need only few iterations.
+ *
+ * @tparam P problem class, see \c levenbergMarquardt. \c evaluateWithJacobian must be thread-safe if used in parallel.
+ * @tparam T floating point type
+ * @tparam NT normalization of the parameters
+ */
+template< class P, class T = double, class NT = Optimization::OptNoNormalize >
+class LeastSquaresSolution
+{
+public:
+	/**
+	 * @param problem the problem to optimize, must stay valid during the lifetime of this object
+	 * @param initial start of every optimization
+	 * @param criteria termination criteria of the optimizations
+	 * @param normalize normalization of the parameters after each step
+	 */
+	LeastSquaresSolution( const P& problem, const Math::Vector< T >& initial,
+		const Optimization::OptTerminate& criteria, const NT& normalize = NT() )
+		: m_problem( problem )
+		, m_initial( initial )
+		, m_criteria( criteria )
+		, m_normalize( normalize )
+	{}
 
-		// Store optimized parameters
-		optimizedParameters.push_back(params);
+	/** number of parameters */
+	std::size_t size() const
+	{ return m_initial.size(); }
 
-		// Copy undisturbed set and disturb it
-		sigmaSet = measurementsCombined;
-		sigmaSet[ i ] -= stddev;
+	/**
+	 * @param result the optimized parameters (out)
+	 * @param measurement the measurement vector of the problem
+	 */
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& measurement ) const
+	{
+		Math::Vector< T > params( m_initial );
+		const Math::Vector< T > y( measurement );
+		Optimization::levenbergMarquardt( m_problem, params, y, m_criteria, m_normalize );
+		result = params;
+	}
 
-		// Reset parameters
-		params = Math::Vector< VType, 7 >::zeros();
-		params( 4 ) = 1;
+protected:
+	const P& m_problem;
+	const Math::Vector< T > m_initial;
+	const Optimization::OptTerminate m_criteria;
+	const NT m_normalize;
+};
 
-		// LevenbergMarquadt on disturbed set
-		residual = Math::Optimization::levenbergMarquardt(problem, params, sigmaSet,
-			Math::Optimization::OptTerminate( 200, 1e-6 ), Math::Optimization::OptNoNormalize());
 
-		// Debugging: output progress
-		// std::cout << "-";
+/**
+ * @ingroup math stochastic
+ * Performs an Unscented Transform based on a set of measurements in 2D, a given variance (the probability distribution
+ * in 2D is assumed to be isotrophic)  a 2D->6D function, and returns the predicted 6D covariance.
+ *
+ * The pose is first refined with the unperturbed measurements, then the optimizations of the
+ * sigma points start from this solution and run in parallel if a thread pool is given.
+ *
+ * @param measurements the 2D measurements
+ * @param variance variance of each measurement coordinate
+ * @param problem measurement function of the 7-vector pose (translation, quaternion), see \c levenbergMarquardt
+ * @param initialPose estimate of the pose, e.g. from a linear method
+ * @param normalize normalization of the 7-vector after each optimization step, e.g. \c ProjectivePoseNormalize
+ * @param options scaling of the sigma points and thread pool
+ * @return covariance of translation and rotation (vector part of the quaternion error)
+ */
+template< class PType, class VType, class NT >
+Math::Matrix< double, 6, 6 > unscentedTransformPose( const std::vector< Math::Vector< VType, 2 > >& measurements,
+	VType variance, const PType& problem, const Math::Pose& initialPose, const NT& normalize,
+	const UnscentedTransformOptions& options = UnscentedTransformOptions() )
+{
+	namespace ublas = boost::numeric::ublas;
+	const Optimization::OptTerminate criteria( 200, 1e-6 );
 
-		// Store optimized parameters
-		optimizedParameters.push_back(params);
+	// Combine measurements into single vector
+	const std::size_t n = 2 * measurements.size();
+	Math::Vector< VType > measurementsCombined( n );
+	for ( std::size_t i = 0; i < measurements.size(); i++ )
+	{
+		measurementsCombined[ 2 * i ] = measurements[ i ][ 0 ];
+		measurementsCombined[ 2 * i + 1 ] = measurements[ i ][ 1 ];
 	}
-	// Debugging: output progress
-	// std::cout << std::endl;
-	
-	// Compute average pose
-	Math::Vector< double, 7 > avgPose( Math::Vector< double, 7 >::zeros(); );
-	for ( typename std::vector< Math::Vector< VType > >::iterator it = optimizedParameters.begin();
-			it != optimizedParameters.end(); it++ )
+
+	// LevenbergMarquadt on undisturbed set
+	Math::Vector< VType > nominal( 7 );
+	initialPose.toVector( nominal );
+	Optimization::levenbergMarquardt( problem, nominal, measurementsCombined, criteria, normalize );
+
+	// solve the sigma points, starting at the nominal solution
+	std::vector< Math::Vector< VType > > sigmaPoints;
+	std::vector< VType > meanWeights;
+	std::vector< VType > covarianceWeights;
+	unscentedSigmaPoints( measurementsCombined, Math::Matrix< VType >( ublas::identity_matrix< VType >( n ) * variance ), options,
+		sigmaPoints, meanWeights, covarianceWeights );
+
+	std::vector< Math::Vector< VType > > optimizedParameters;
+	unscentedEvaluate( LeastSquaresSolution< PType, VType, NT >( problem, nominal, criteria, normalize ), sigmaPoints,
+		optimizedParameters, options.pThreadPool );
+
+	// Compute average pose, with all quaternions in the hemisphere of the nominal solution
+	Math::Vector< double, 7 > avgPose( Math::Vector< double, 7 >::zeros() );
+	for ( std::size_t i = 0; i < optimizedParameters.size(); i++ )
 	{
-		if ( it != optimizedParameters.begin() && 
-			ublas::inner_prod( ublas::subrange( *it, 3, 7 ), ublas::subrange( avgPose, 3, 7 ) ) < 0 )
-			ublas::subrange( *it, 3, 7 ) *= -1;
-		avgPose += *it;
+		Math::Vector< VType >& params( optimizedParameters[ i ] );
+		if ( ublas::inner_prod( ublas::subrange( params, 3, 7 ), ublas::subrange( nominal, 3, 7 ) ) < 0 )
+			ublas::subrange( params, 3, 7 ) *= -1;
+		avgPose += meanWeights[ i ] * params;
 	}
-	avgPose /= optimizedParameters.size();
-	
-	// Debugging: output average pose
-	// std::cout << "Average pose:" << std::endl;
-	// std::cout << avgPose << std::endl;
 
 	// Get average rotation
 	Math::Quaternion avgQuat( Math::Quaternion::fromVector( ublas::subrange( avgPose, 3, 7 ) ) );
 	avgQuat.normalize();
-	
+
 	// Compute covariance
 	Math::Matrix< double, 6, 6 > covariance( Math::Matrix< double, 6, 6 >::zeros() );
-	for ( typename std::vector< Math::Vector< VType > >::iterator it = optimizedParameters.begin();
-			it != optimizedParameters.end(); it++ )
+	for ( std::size_t i = 0; i < optimizedParameters.size(); i++ )
 	{
+		const Math::Vector< VType >& params( optimizedParameters[ i ] );
 		Math::Vector< double, 6 > localError;
-		ublas::subrange( localError, 0, 3 ) = ublas::subrange( *it, 0, 3 ) - ublas::subrange( avgPose, 0, 3 );;
-		
-		Math::Quaternion qLocal((*it)[ 3 ], (*it)[ 4 ], (*it)[ 5 ], (*it)[ 6 ]);
+		ublas::subrange( localError, 0, 3 ) = ublas::subrange( params, 0, 3 ) - ublas::subrange( avgPose, 0, 3 );
+
+		Math::Quaternion qLocal( Math::Quaternion::fromVector( ublas::subrange( params, 3, 7 ) ) );
 		qLocal.normalize();
 
 		Math::Quaternion qDiff( avgQuat * ~qLocal );
@@ -164,20 +369,15 @@ Math::Matrix< double, 6, 6 > unscentedTransform(
 		localError( 5 ) = qDiff.z();
 		if ( qDiff.w() < 0 )
 			ublas::subrange( localError, 3, 6 ) *= -1;
-		covariance += ublas::outer_prod( localError, localError );
-
-		// Debugging: output error inner product
-		// VType innerProd = ublas::inner_prod( localError, localError );
-		// std::cout << "Inner product:" << std::endl;
-		// std::cout << innerProd << std::endl;
+		covariance += covarianceWeights[ i ] * ublas::outer_prod( localError, localError );
 	}
-	covariance /= optimizedParameters.size();
-	
+
 	// Return 6D covariance
 	return covariance;
-
 }
-	
+
+#endif // HAVE_LAPACK
+
 }}} // namespace Ubitrack::Math::Stochastic
 
 #endif
@@ -31,8 +31,12 @@
 #include <utUtil/Exception.h>
 #include <utUtil/StaticAssert.h>
 #include "../Functors/MatrixFunctors.h"
+#include "../Cholesky.h"
+#include "../Matrix.h"
+#include <utUtil/ThreadPool.h>
  
 // std
+#include <cmath>
 #include <vector>
 #include <limits> 
 #include <numeric>
@@ -77,7 +81,7 @@ struct Probability
 			{
 				// UBITRACK_THROW( "Cannot calculate covariance inverse, determinant is NaN or zero." );
 			
-				const value_type tmpconstant = 1 / std::sqrt( std::pow( static_cast< value_type >( 2.0 * 3.14159 ), size * static_cast< value_type >( 0.5 ) ) * std::fabs ( det ) );
+				const value_type tmpconstant = 1 / std::sqrt( std::pow( static_cast< value_type >( 2.0 * 3.14159265358979323846 ), static_cast< value_type >( size ) ) * std::fabs ( det ) );
 				constant = tmpconstant;
 				// if( constant != constant ) //trick to check if the value is valid
 					// UBITRACK_THROW( "Cannot reliable determine constant value of probability density function, it is NaN." );
@@ -145,35 +149,278 @@ T log_likelihood( const InputIterator1 ipBegin, const InputIterator1 ipEnd, cons
 }
 
 
+/**
+ * Settings of \c expectation_maximization
+ */
+struct ExpectationMaximizationOptions
+{
+	ExpectationMaximizationOptions()
+		: nMaxIterations( 100 )
+		, threshold( 1e-5 )
+		, regularization( 1e-9 )
+		, pThreadPool( 0 )
+	{}
+
+	/** maximal number of iterations */
+	std::size_t nMaxIterations;
+
+	/** the iterations stop when the relative change of the log-likelihood falls below this value */
+	double threshold;
+
+	/** added to the diagonal of covariances that are not positive definite */
+	double regularization;
+
+	/** thread pool that executes the E-step, 0 runs it in the calling thread */
+	Ubitrack::Util::ThreadPool* pThreadPool;
+};
+
+
+namespace detail {
+
+/** @internal number of samples that are processed together in the E-step */
+static const std::size_t emBlockSize = 64;
+
+/** @internal a weighted Gaussian prepared for the evaluation of log-densities */
+template< typename T, std::size_t N >
+struct LogGaussian
+{
+	/** false if the weight is zero or the covariance is not positive definite */
+	bool valid;
+
+	/** log( weight ) - 1/2 log( det( 2 pi covariance ) ) */
+	T logConstant;
+
+	T mean[ N ];
+
+	/** lower Cholesky factor of the covariance, row-major */
+	T factor[ N * N ];
+
+	/** inverse of the diagonal of the factor */
+	T invDiagonal[ N ];
+
+	/** factors the covariance, adding the regularization to the diagonal if necessary */
+	void set( const Gaussian< T, N >& gaussian, const T weight, const T regularization )
+	{
+		std::copy( gaussian.mean, gaussian.mean + N, mean );
+		valid = false;
+		if ( !( weight > 0 ) )
+			return;
+
+		for ( std::size_t iTry = 0; iTry < 2 && !valid; iTry++ )
+		{
+			Math::Matrix< T, N, N > l;
+			for ( std::size_t i = 0; i < N; i++ )
+				for ( std::size_t j = 0; j < N; j++ )
+					l( i, j ) = gaussian.covariance[ i * N + j ] + ( i == j && iTry ? regularization : 0 );
+			if ( !cholesky_factor( l ) )
+				continue;
+
+			valid = true;
+			logConstant = std::log( weight ) - static_cast< T >( 0.5 * N * std::log( 2 * 3.14159265358979323846 ) );
+			for ( std::size_t i = 0; i < N; i++ )
+			{
+				for ( std::size_t j = 0; j <= i; j++ )
+					factor[ i * N + j ] = l( i, j );
+				invDiagonal[ i ] = 1 / l( i, i );
+				logConstant -= std::log( l( i, i ) );
+			}
+		}
+	}
+};
+
+/** @internal weighted sums of one component, relative to its current mean */
+template< typename T, std::size_t N >
+struct EMStatistics
+{
+	/** sum of the responsibilities */
+	T weight;
+
+	/** sum of the weighted differences to the mean */
+	T sum[ N ];
+
+	/** sum of the weighted outer products of the differences, upper triangle */
+	T scatter[ N * N ];
+
+	void reset()
+	{
+		weight = 0;
+		std::fill( sum, sum + N, static_cast< T >( 0 ) );
+		std::fill( scatter, scatter + N * N, static_cast< T >( 0 ) );
+	}
+};
+
+/**
+ * @internal the E-step over the samples, stored in blocks of \c emBlockSize samples with one
+ * contiguous row per dimension. The log-densities of a whole block are evaluated per
+ * component with loops over the samples, the responsibilities follow from log-sum-exp.
+ * The statistics of the M-step and the log-likelihood are accumulated in the same pass,
+ * separately for each chunk of blocks.
+ */
+template< typename T, std::size_t N >
+struct EStep
+{
+	EStep( const std::vector< T >& data, const std::size_t n, const std::vector< LogGaussian< T, N > >& components, const std::size_t nChunks )
+		: m_data( data )
+		, m_n( n )
+		, m_nBlocks( ( n + emBlockSize - 1 ) / emBlockSize )
+		, m_components( components )
+		, m_stats( nChunks, std::vector< EMStatistics< T, N > >( components.size() ) )
+		, m_logDensities( nChunks, std::vector< T >( components.size() * emBlockSize ) )
+		, m_logLikelihood( nChunks )
+	{}
+
+	std::size_t chunks() const
+	{ return m_stats.size(); }
+
+	void operator()( const std::size_t chunk )
+	{
+		const std::size_t k = m_components.size();
+		std::vector< EMStatistics< T, N > >& stats = m_stats[ chunk ];
+		for ( std::size_t c = 0; c < k; c++ )
+			stats[ c ].reset();
+		m_logLikelihood[ chunk ] = 0;
+
+		T* logDensity = &m_logDensities[ chunk ][ 0 ];
+		T y[ N ][ emBlockSize ];
+		T maxLog[ emBlockSize ];
+		T sumExp[ emBlockSize ];
+
+		const std::size_t blockEnd = ( chunk + 1 ) * m_nBlocks / chunks();
+		for ( std::size_t block = chunk * m_nBlocks / chunks(); block < blockEnd; block++ )
+		{
+			const T* x = &m_data[ block * N * emBlockSize ];
+			const std::size_t m = std::min( emBlockSize, m_n - block * emBlockSize );
+
+			// log-densities: solve L y = x - mean for all samples of the block
+			std::fill( maxLog, maxLog + emBlockSize, -std::numeric_limits< T >::infinity() );
+			for ( std::size_t c = 0; c < k; c++ )
+			{
+				const LogGaussian< T, N >& g = m_components[ c ];
+				T* logD = logDensity + c * emBlockSize;
+				if ( !g.valid )
+				{
+					std::fill( logD, logD + emBlockSize, -std::numeric_limits< T >::infinity() );
+					continue;
+				}
+
+				std::fill( logD, logD + emBlockSize, static_cast< T >( 0 ) );
+				for ( std::size_t i = 0; i < N; i++ )
+				{
+					const T* xi = x + i * emBlockSize;
+					for ( std::size_t j = 0; j < emBlockSize; j++ )
+						y[ i ][ j ] = xi[ j ] - g.mean[ i ];
+					for ( std::size_t l = 0; l < i; l++ )
+					{
+						const T f = g.factor[ i * N + l ];
+						for ( std::size_t j = 0; j < emBlockSize; j++ )
+							y[ i ][ j ] -= f * y[ l ][ j ];
+					}
+					for ( std::size_t j = 0; j < emBlockSize; j++ )
+					{
+						y[ i ][ j ] *= g.invDiagonal[ i ];
+						logD[ j ] += y[ i ][ j ] * y[ i ][ j ];
+					}
+				}
+				for ( std::size_t j = 0; j < emBlockSize; j++ )
+				{
+					logD[ j ] = g.logConstant - static_cast< T >( 0.5 ) * logD[ j ];
+					maxLog[ j ] = std::max( maxLog[ j ], logD[ j ] );
+				}
+			}
+
+			// log-sum-exp over the components, the scaled densities replace the log-densities
+			std::fill( sumExp, sumExp + emBlockSize, static_cast< T >( 0 ) );
+			for ( std::size_t c = 0; c < k; c++ )
+				if ( m_components[ c ].valid )
+					for ( std::size_t j = 0; j < m; j++ )
+						sumExp[ j ] += logDensity[ c * emBlockSize + j ] = std::exp( logDensity[ c * emBlockSize + j ] - maxLog[ j ] );
+			for ( std::size_t j = 0; j < m; j++ )
+			{
+				m_logLikelihood[ chunk ] += maxLog[ j ] + std::log( sumExp[ j ] );
+				sumExp[ j ] = 1 / sumExp[ j ];
+			}
+
+			// responsibilities and the statistics of the M-step
+			for ( std::size_t c = 0; c < k; c++ )
+			{
+				const LogGaussian< T, N >& g = m_components[ c ];
+				if ( !g.valid )
+					continue;
+
+				EMStatistics< T, N >& s = stats[ c ];
+				for ( std::size_t j = 0; j < m; j++ )
+				{
+					const T r = logDensity[ c * emBlockSize + j ] * sumExp[ j ];
+					T d[ N ];
+					for ( std::size_t i = 0; i < N; i++ )
+						d[ i ] = x[ i * emBlockSize + j ] - g.mean[ i ];
+
+					s.weight += r;
+					for ( std::size_t i1 = 0; i1 < N; i1++ )
+					{
+						const T rd = r * d[ i1 ];
+						s.sum[ i1 ] += rd;
+						for ( std::size_t i2 = i1; i2 < N; i2++ )
+							s.scatter[ i1 * N + i2 ] += rd * d[ i2 ];
+					}
+				}
+			}
+		}
+	}
+
+	const std::vector< T >& m_data;
+	const std::size_t m_n;
+	const std::size_t m_nBlocks;
+	const std::vector< LogGaussian< T, N > >& m_components;
+
+	/** accumulators of the chunks */
+	std::vector< std::vector< EMStatistics< T, N > > > m_stats;
+	std::vector< std::vector< T > > m_logDensities;
+	std::vector< T > m_logLikelihood;
+};
+
+} // namespace detail
+
+
 /**
  * Expectation Maximization
  *
- * This is a template-framework to carry out the expectation maximization algorithm.
+ * This is a template-framework to carry out the expectation maximization algorithm
+ * for a mixture of weighted Gaussians.
+ *
+ * All computations are done in the log domain: each Gaussian is evaluated through its
+ * Cholesky factor, which is computed once per iteration, and the responsibilities are
+ * normalized with log-sum-exp, so distant or high-dimensional data does not underflow.
+ * The samples are copied into blocks with one contiguous row per dimension, and the
+ * E-step runs over these blocks, optionally in parallel on \c options.pThreadPool. The
+ * log-likelihood and the sums of the M-step are a by-product of the E-step. Covariances
+ * are estimated relative to the previous mean to avoid cancellation.
+ *
+ * The iterations stop when the relative change of the log-likelihood falls below
+ * \c options.threshold. The returned log-likelihood belongs to the returned mixture.
+ * Components whose weight drops to zero or whose covariance stays singular after the
+ * regularization get a weight of zero and are not updated anymore.
  * 
  * @tparam InputIterator defines the type of input values
  * @tparam OutputIterator defines the type of output values (Probability Distribution)
- * @param itBegin
- * @param itEnd
- * @param itBeginGauss
- * @param itEndGauss
+ * @param itBegin iterator pointing to the first sample, a vector with \c operator[]
+ * @param itEnd iterator pointing behind the last sample
+ * @param itBeginGauss iterator pointing to the first weighted Gaussian, initial guess on entry and result on exit
+ * @param itEndGauss iterator pointing behind the last weighted Gaussian
+ * @param options further settings, see \c ExpectationMaximizationOptions
+ * @return the mean log-likelihood of the samples
  */
-
 template< typename InputIterator, typename OutputIterator >
 typename std::iterator_traits< OutputIterator >::value_type::value_type expectation_maximization( 
 	const InputIterator itBegin, const InputIterator itEnd
-	, OutputIterator itBeginGauss, OutputIterator itEndGauss )
+	, OutputIterator itBeginGauss, OutputIterator itEndGauss
+	, const ExpectationMaximizationOptions& options = ExpectationMaximizationOptions() )
 {
-	/// @todo need to check if this type has an susbscript operator operator[]
-	// the type of the multivariate data, e.g. float/double/int/char...
-	typedef typename std::iterator_traits< InputIterator >::value_type value_type;
-	
 	//type of the probability density function
 	typedef typename std::iterator_traits< OutputIterator >::value_type pdf_type;
-	
-	//some general abbreviations, needed in the algorithm
 	typedef typename pdf_type::value_type numeric_type;
-	typedef typename std::vector< numeric_type > numeric_container_type;
-	typedef typename numeric_container_type::iterator NumIterator;
+	static const std::size_t N = pdf_type::size;
+	typedef detail::LogGaussian< numeric_type, N > log_gaussian_type;
 	
 	//determine the number of elements/ pdfs
 	const std::size_t n = std::distance( itBegin, itEnd );
@@ -181,98 +428,96 @@ typename std::iterator_traits< OutputIterator >::value_type::value_type expectat
 	
 	// you never should have less values than expected clusters:
 	assert( n > k_cluster );
-		
-	const numeric_type threshold( static_cast< numeric_type > ( 1e-5 ) );
-	const std::size_t max_iter( 100 );
 	
-	//assign the norms
-	// norm : norm_{1} ,.., norm_{n}
-	std::vector< numeric_type > norms( n , 0 );
-	// norms.reserve( n );
-	// norms.assign( n, 0 );
+	// copy the samples into blocks, one row per dimension
+	const std::size_t blockSize = detail::emBlockSize;
+	const std::size_t nBlocks = ( n + blockSize - 1 ) / blockSize;
+	std::vector< numeric_type > data( nBlocks * N * blockSize, 0 );
+	{
+		std::size_t j = 0;
+		for( InputIterator valueIter( itBegin ); valueIter != itEnd; ++valueIter, ++j )
+			for( std::size_t i( 0 ); i < N; ++i )
+				data[ ( ( j / blockSize ) * N + i ) * blockSize + j % blockSize ] = static_cast< numeric_type >( (*valueIter)[ i ] );
+	}
 	
+	std::vector< log_gaussian_type > components( k_cluster );
+	const std::size_t nChunks = options.pThreadPool ? std::min( nBlocks, 4 * options.pThreadPool->size() ) : 1;
+	detail::EStep< numeric_type, N > eStep( data, n, components, nChunks );
 	
-	//assign the gamma values
-	// gamma : g_{1,1} ,.., g_{n,1} ,..., g_{1,k} ,..., g_{n,k}
-	std::vector< numeric_type > gammas( n*k_cluster, 0 );
-	// gammas.reserve( n*k_cluster );
-	// gammas.assign( n*k_cluster, 0 );
-		
-	numeric_type likelihood = log_likelihood< numeric_type >( itBeginGauss, itEndGauss, itBegin, itEnd );
-	// std::cout << "1st Likelihood " << likelihood << std::endl;	
-	
-	std::size_t i( 0 );
-	for( ; i< max_iter; ++i )
+	numeric_type likelihood( 0 );
+	for( std::size_t iter( 0 ); ; ++iter )
 	{
-		
-		
-		NumIterator gammaIter( gammas.begin() );
-		
-		// Expectation Step:
-		for( OutputIterator pdfIter( itBeginGauss ); pdfIter< itEndGauss; ++pdfIter )
 		{
-			const Probability< pdf_type > pdf( *pdfIter );
-			NumIterator normIter( norms.begin() );
-			for( InputIterator valueIter( itBegin ); valueIter != itEnd; ++valueIter, ++normIter, ++gammaIter  )
-			{
-				(*normIter) += (*gammaIter) = pdfIter->weight * pdf( *valueIter );
-				// std::cout << "Probability of " << *valueIter << " at " << *pdfIter << ":\n" << pdf( *valueIter ) << "\n";
-			}
+			std::size_t k( 0 );
+			for( OutputIterator pdfIter( itBeginGauss ); pdfIter != itEndGauss; ++pdfIter, ++k )
+				components[ k ].set( *pdfIter, pdfIter->weight, static_cast< numeric_type >( options.regularization ) );
 		}
-			
 		
-		// const numeric_type summe_all = std::accumulate( gammas.begin(), gammas.end(), static_cast< numeric_type >( 0 ) );
-		//std::transform( norms.begin(), norms.end(), norms.begin(), std::bind1st( std::divides< numeric_type >(), 1./static_cast< numeric_type > ( n ) ) );
+		// Expectation Step:
+		if ( options.pThreadPool )
+			options.pThreadPool->parallelFor( nChunks, eStep );
+		else
+			for ( std::size_t c = 0; c < nChunks; c++ )
+				eStep( c );
+		
+		numeric_type newLikelihood( 0 );
+		for ( std::size_t c = 0; c < nChunks; c++ )
+			newLikelihood += eStep.m_logLikelihood[ c ];
+		newLikelihood /= static_cast< numeric_type >( n );
+		
+		//check convergence criteria, the mixture is not updated anymore
+		if( !( newLikelihood > -std::numeric_limits< numeric_type >::infinity() ) )
+			return newLikelihood;
+		if( iter > 0 && std::fabs( likelihood - newLikelihood ) < ( options.threshold * std::fabs( likelihood ) ) )
+			return newLikelihood;
+		likelihood = newLikelihood;
+		if( iter == options.nMaxIterations )
+			return likelihood;
 		
-		gammaIter = gammas.begin();
-		for( OutputIterator pdfIter( itBeginGauss ); pdfIter != itEndGauss ; std::advance( gammaIter, n ), ++pdfIter )
+		// Maximization Step:
+		std::size_t k( 0 );
+		for( OutputIterator pdfIter( itBeginGauss ); pdfIter != itEndGauss ; ++pdfIter, ++k )
 		{
-			// std::transform( gammaIter, gammaIter+n, norms.begin(), gammaIter, std::multiplies< numeric_type >() );
-			std::transform( gammaIter, gammaIter+n, norms.begin(), gammaIter, std::divides< numeric_type >() );
-			const numeric_type summe = std::accumulate( gammaIter, gammaIter+n, static_cast< numeric_type >( 0 ) );
-			if( summe == 0 )
+			if( !components[ k ].valid )
 			{
 				pdfIter->weight = 0;
-				// std::cout << "Sum of gammas resulted in zero " << std::endl;
 				continue;
 			}
 			
-
-			// std::cout << " Distance " << std::distance( gammas.begin(), gammaIter ) << "\n";
-			std::transform( gammaIter, gammaIter+n, gammaIter, std::bind2nd( std::multiplies< numeric_type >(), 1./summe ) );
+			detail::EMStatistics< numeric_type, N > s( eStep.m_stats[ 0 ][ k ] );
+			for ( std::size_t c = 1; c < nChunks; c++ )
+			{
+				const detail::EMStatistics< numeric_type, N >& sc = eStep.m_stats[ c ][ k ];
+				s.weight += sc.weight;
+				for( std::size_t i( 0 ); i < N; ++i )
+					s.sum[ i ] += sc.sum[ i ];
+				for( std::size_t i( 0 ); i < N * N; ++i )
+					s.scatter[ i ] += sc.scatter[ i ];
+			}
 			
-			// std::cout << " Sum for the PDFS " << std::accumulate( gammaIter, gammaIter+n, static_cast< numeric_type >( 0 ) )  << std::endl;
-			pdfIter->weight = summe / n ;
-			if( pdfIter->weight != pdfIter->weight )
+			pdfIter->weight = s.weight / n;
+			if( !( s.weight > 0 ) )
+			{
 				pdfIter->weight = 0;
-			else
-				estimate_gaussian( itBegin, itEnd, gammaIter, *pdfIter );
-			// std::cout << "Gaussian " <<  (*pdfIter) << std::endl;
-		}
-		// {
-			// numeric_type sum = 0;
-			// for( OutputIterator pdfIter( itBeginGauss ); pdfIter != itEndGauss ; ++pdfIter )
-				// sum += pdfIter->weight;
-			// std::cout << "Sum of all weights (should correspond to one ): " << sum <<  std::endl;
-		// }
-		
-		//check convergence criteria
-		const numeric_type newLikelihood = log_likelihood< numeric_type >( itBeginGauss, itEndGauss, itBegin, itEnd );
-		if ( std::abs( likelihood - newLikelihood ) <  ( threshold * std::fabs( likelihood ) ) )
-			return newLikelihood;
+				continue;
+			}
 			
-		if( newLikelihood != newLikelihood )
-			return likelihood;
-		likelihood = newLikelihood;
-		// std::cout << "Likelihood " << likelihood << std::endl;
-		
-		std::fill( norms.begin(), norms.end(), 0 );
+			numeric_type shift[ N ];
+			for( std::size_t i( 0 ); i < N; ++i )
+			{
+				shift[ i ] = s.sum[ i ] / s.weight;
+				pdfIter->mean[ i ] += shift[ i ];
+			}
+			pdfIter->variance = 0;
+			for( std::size_t i1( 0 ); i1 < N; ++i1 )
+			{
+				for( std::size_t i2( i1 ); i2 < N; ++i2 )
+					pdfIter->covariance[ i2*N+i1 ] = pdfIter->covariance[ i1*N+i2 ] = s.scatter[ i1*N+i2 ] / s.weight - shift[ i1 ] * shift[ i2 ];
+				pdfIter->variance += pdfIter->covariance[ i1*N+i1 ];
+			}
+			pdfIter->standardDeviation = std::sqrt( pdfIter->variance );
+		}
 	}
-	
-	// std::cout << "Gaussians after " << i << " iterations\n";
-	// for( OutputIterator pdfIter( itBeginGauss ); pdfIter != itEndGauss ; ++pdfIter )
-		// std::cout << (pdfIter->gaussian) << std::endl;
-	return likelihood;
 };
 
 } } } // namespace Ubitrack::Math::Stochastic
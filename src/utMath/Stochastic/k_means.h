@@ -42,103 +42,19 @@
 
 // some helper header/template stuff
 #include <utUtil/StaticAssert.h>
+#include <utUtil/ThreadPool.h>
 #include "../Geometry/container_traits.h"
 #include "identity_iterator.h"
 
 
 // std
 #include <vector>
+#include <cassert>
 #include <limits> 
 #include <numeric>
 #include <algorithm>
 #include <functional>
 
-namespace {
-
-// small internal template to support k-means: 
-// assigns the indices, according to the minimal distance between
-// cluster and vector. 
-// -> index relates to number of nearest cluster
-template< typename InputIterator, typename BinaryOperator  >
-struct assign_indices
-{
-	typedef typename std::iterator_traits< InputIterator >::value_type vector_type;
-	typedef typename vector_type::value_type value_type;
-	const InputIterator iBegin;
-	const InputIterator iEnd;
-	BinaryOperator distanceFunc;
-	// const std::size_t n;
-	// std::vector< value_type > distances;
-	// const typename std::vector< value_type >::iterator itD;
-	
-	
-	assign_indices( const InputIterator first , const InputIterator last, BinaryOperator distanceFuncIn )
-		: iBegin( first )
-		, iEnd( last )
-		, distanceFunc( distanceFuncIn )
-		// , n( std::distance( first, last ) )
-		// , distances( n, 0 )
-		// , itD ( distances.begin() )
-		{}
-	
-
-	template< template< typename, std::size_t > class VecType, typename T, std::size_t N >
-	std::size_t operator()( const VecType< T, N >& vec ) const
-	{
-		// std::vector< T > distances;
-		// distances.reserve( n );
-		// std::transform( iBegin, iEnd, Ubitrack::Util::identity< VecType< T, N > >( vec ).begin(), std::back_inserter( distances ), SquarredDistance() );
-		// std::transform( iBegin, iEnd, Ubitrack::Util::identity< VecType< T, N > >( vec ).begin(), itD, SquarredDistance() );
-		// const std::vector< value_type >::iterator itDist = std::min_element( itD, distances.end() );
-		// return std::distance( itD, itDist );
-		
-		std::size_t k( 0 );
-		InputIterator iter = iBegin;
-		value_type d = distanceFunc( vec, (*iter++) );
-		
-		for( std::size_t k_now( 1 ) ; iter != iEnd; ++iter, ++k_now )
-		{
-			const value_type d_new = distanceFunc( vec, (*iter) );
-			if( d_new < d )
-			{
-				d = d_new;
-				k = k_now;
-			}
-		}
-		return k;
-	}
-};
-
-// small template to support k-means
-template< typename InputIterator >
-struct assign_to_mean
-{
-	InputIterator iBegin;
-	
-	assign_to_mean( InputIterator first )
-		: iBegin( first ) {}
-
-	template< typename VecType, typename iType >
-	void operator()( const VecType& vec, const iType index )
-	{
-		*(iBegin + index) += vec;
-	}
-};
-
-// a helper function
-template< typename T1, typename T2, typename BinaryFunction >
-BinaryFunction k_means_accumulate( const T1 pFirst1, const T1 pLast, const T2 pFirst2, BinaryFunction op )
-{
-	T1 first1 = pFirst1;
-	T2 first2 = pFirst2;
-	for( ; first1 != pLast; ++first1, ++first2 )
-		op( *first1, *first2 );
-
-	return op;
-};
-
-} // namespace anonymous
-
 
 namespace Ubitrack{ namespace Math { namespace Stochastic {
  
@@ -259,87 +175,348 @@ std::size_t copy_probability( const InputIterator iBegin, const InputIterator iE
 };
 
 
-/** @internal function only, please see other k-means for explanation
+/**
+ * @ingroup math stochastic
+ * @brief settings of the k-means algorithm
+ */
+struct KMeansOptions
+{
+	KMeansOptions()
+		: nMaxIterations( 100 )
+		, tolerance( 1e-4 )
+		, batchSize( 0 )
+		, pThreadPool( 0 )
+	{}
+
+	/** maximal number of iterations, in mini-batch mode the number of batches */
+	std::size_t nMaxIterations;
+
+	/** the iterations stop when the mean movement of the centroids falls below this value */
+	double tolerance;
+
+	/**
+	 * number of randomly drawn elements that update the centroids in each iteration
+	 * (mini-batch k-means), 0 uses all elements in every iteration
+	 */
+	std::size_t batchSize;
+
+	/** thread pool that executes the assignment step, 0 runs it in the calling thread */
+	Ubitrack::Util::ThreadPool* pThreadPool;
+};
+
+
+namespace detail {
+
+/**
+ * @internal one pass of k-means over a range of elements: assigns each element to its
+ * nearest centroid and accumulates the sums and counts of the clusters.
+ *
+ * The elements are split into chunks that can be processed in parallel, each chunk has its
+ * own accumulators. Distance evaluations are skipped with the bounds of Hamerly's
+ * algorithm: \c upper is an upper bound of the distance to the assigned centroid,
+ * \c lower a lower bound of the distance to all other centroids. Both are updated with
+ * the movement of the centroids since the last pass.
+ */
+template< typename InputIterator, typename MeanType, typename BinaryOperator >
+struct KMeansPass
+{
+	typedef typename MeanType::value_type value_type;
+
+	KMeansPass( const InputIterator iBegin, const std::vector< MeanType >& centroids, BinaryOperator distanceFunc )
+		: m_iBegin( iBegin )
+		, m_centroids( centroids )
+		, m_distanceFunc( distanceFunc )
+		, m_pSamples( 0 )
+		, m_nItems( 0 )
+		, m_bInitial( true )
+		, m_maxMove( 0 )
+		, m_secondMaxMove( 0 )
+		, m_iMaxMove( 0 )
+	{}
+
+	/** sets the number of elements and chunks and allocates the accumulators */
+	void resize( const std::size_t nItems, const std::size_t nChunks )
+	{
+		m_nItems = nItems;
+		m_sums.resize( nChunks );
+		m_counts.resize( nChunks );
+		m_changes.resize( nChunks );
+	}
+
+	std::size_t chunks() const
+	{ return m_sums.size(); }
+
+	/** runs all chunks, in parallel if a pool is given */
+	void run( Ubitrack::Util::ThreadPool* pThreadPool )
+	{
+		if ( pThreadPool )
+			pThreadPool->parallelFor( chunks(), *this );
+		else
+			for ( std::size_t i = 0; i < chunks(); i++ )
+				(*this)( i );
+	}
+
+	/** finds the nearest and second nearest centroid of an element */
+	template< typename VecType >
+	std::size_t nearest( const VecType& vec, value_type& d1, value_type& d2 ) const
+	{
+		std::size_t k = 0;
+		d1 = std::numeric_limits< value_type >::max();
+		d2 = std::numeric_limits< value_type >::max();
+		for ( std::size_t j = 0; j < m_centroids.size(); j++ )
+		{
+			const value_type d = m_distanceFunc( vec, m_centroids[ j ] );
+			if ( d < d1 )
+			{
+				d2 = d1;
+				d1 = d;
+				k = j;
+			}
+			else if ( d < d2 )
+				d2 = d;
+		}
+		return k;
+	}
+
+	void operator()( const std::size_t chunk )
+	{
+		const std::size_t k = m_centroids.size();
+		std::vector< MeanType >& sums = m_sums[ chunk ];
+		std::vector< std::size_t >& counts = m_counts[ chunk ];
+		sums.assign( k, MeanType::zeros() );
+		counts.assign( k, 0 );
+		m_changes[ chunk ] = 0;
+
+		const std::size_t iEnd = ( chunk + 1 ) * m_nItems / chunks();
+		for ( std::size_t i = chunk * m_nItems / chunks(); i < iEnd; i++ )
+		{
+			std::size_t index;
+			if ( m_pSamples )
+			{
+				// mini-batch: no bounds are kept for the samples
+				value_type d1, d2;
+				const typename std::iterator_traits< InputIterator >::value_type& vec = *( m_iBegin + m_pSamples[ i ] );
+				index = nearest( vec, d1, d2 );
+				sums[ index ] += vec;
+			}
+			else
+			{
+				const typename std::iterator_traits< InputIterator >::value_type& vec = *( m_iBegin + i );
+				if ( m_bInitial )
+					index = nearest( vec, m_upper[ i ], m_lower[ i ] );
+				else
+				{
+					index = m_indices[ i ];
+					m_upper[ i ] += m_move[ index ];
+					m_lower[ i ] -= index == m_iMaxMove ? m_secondMaxMove : m_maxMove;
+
+					// the assignment can only change if the bounds overlap
+					const value_type bound = std::max( m_halfSeparation[ index ], m_lower[ i ] );
+					if ( m_upper[ i ] > bound )
+					{
+						m_upper[ i ] = m_distanceFunc( vec, m_centroids[ index ] );
+						if ( m_upper[ i ] > bound )
+							index = nearest( vec, m_upper[ i ], m_lower[ i ] );
+					}
+					if ( index != m_indices[ i ] )
+						m_changes[ chunk ]++;
+				}
+				m_indices[ i ] = index;
+				sums[ index ] += vec;
+			}
+			counts[ index ]++;
+		}
+	}
+
+	const InputIterator m_iBegin;
+	const std::vector< MeanType >& m_centroids;
+	BinaryOperator m_distanceFunc;
+
+	/** indices of the elements of a mini-batch, 0 processes all elements */
+	const std::size_t* m_pSamples;
+	std::size_t m_nItems;
+
+	/** compute the bounds from scratch? */
+	bool m_bInitial;
+
+	std::vector< std::size_t > m_indices;
+	std::vector< value_type > m_upper;
+	std::vector< value_type > m_lower;
+
+	/** half of the distance of each centroid to the nearest other centroid */
+	std::vector< value_type > m_halfSeparation;
+
+	/** movement of the centroids in the last update */
+	std::vector< value_type > m_move;
+	value_type m_maxMove;
+	value_type m_secondMaxMove;
+	std::size_t m_iMaxMove;
+
+	/** accumulators of the chunks */
+	std::vector< std::vector< MeanType > > m_sums;
+	std::vector< std::vector< std::size_t > > m_counts;
+	std::vector< std::size_t > m_changes;
+};
+
+} // namespace detail
+
+
+/**
+ * @ingroup math stochastic
+ * @brief refines k centroids of clusters from a set of elements
  *
+ * Starting from the given centroids, the elements are assigned to their nearest centroid
+ * and the centroids are moved to the mean of their elements until the assignment does not
+ * change anymore, the mean movement of the centroids falls below \c options.tolerance or
+ * \c options.nMaxIterations is reached. The assignment and the accumulation of the new
+ * means are done in a single pass over the elements, which can be distributed over the
+ * threads of \c options.pThreadPool. Distance evaluations are skipped with the triangle
+ * inequality (Hamerly's variant of Elkan's algorithm), so the distance function needs to
+ * be a metric (e.g. \c Distance, but not \c SquaredDistance). Clusters that lose all their
+ * elements keep their centroid.
  *
- * @tparam InputIterator type of input iterator to container of values
- * @tparam OutputIterator type of the output iterator to container of the clusters
+ * If \c options.batchSize is set, the centroids are updated from random mini-batches of
+ * the elements instead (Sculley, "Web-scale k-means clustering", 2010), which converges
+ * to a slightly worse solution but much faster on large sets. The elements are assigned to
+ * the final centroids in one pass at the end.
+ *
+ * @tparam InputIterator type of random access iterator to container of values
+ * @tparam OutputIterator type of random access iterator to container of the clusters
  * @tparam IndicesIterator type of the output iterator to container of the indices
  * @tparam BinaryOperator type of the evaluation function to estimate distance of elements
+ * @param iBegin \c iterator pointing to first input element
+ * @param iEnd \c iterator pointing behind the last input element
+ * @param itMeanBegin \c iterator pointing to the first centroid, the initial centroids are replaced by the result
+ * @param itMeanEnd \c iterator pointing behind the last centroid
+ * @param indicesOut output \c iterator receiving the index of the cluster of every input element
+ * @param distanceFunc metric between an element and a centroid
+ * @param options further settings, see \c KMeansOptions
+ * @return mean movement of the centroids in the last iteration
  */
- 
 template< typename InputIterator, typename OutputIterator, typename IndicesIterator, typename BinaryOperator >
 typename std::iterator_traits< OutputIterator >::value_type::value_type k_means( 
 	const InputIterator iBegin, const InputIterator iEnd
 	, OutputIterator itMeanBegin, OutputIterator itMeanEnd
-	, IndicesIterator indicesOut, BinaryOperator distanceFunc )
+	, IndicesIterator indicesOut, BinaryOperator distanceFunc
+	, const KMeansOptions& options = KMeansOptions() )
 {
-	// some typedefs regarding the input vector type
-	typedef typename std::iterator_traits< InputIterator >::value_type vector_in_type;
-	
-	// some typedefs regarding the output iterator container (including the means)
 	typedef typename std::iterator_traits< OutputIterator >::value_type vector_out_type;
-	typedef typename std::vector< vector_out_type > mean_container_type;
-	typedef typename mean_container_type::iterator mean_type_iterator;
 	typedef typename vector_out_type::value_type value_type; // <- the means define the distance type
-	
-	// some typedefs regarding the indices container
-	typedef typename Ubitrack::Util::container_traits< IndicesIterator >::value_type indices_type;
-	typedef typename std::vector< indices_type > indices_container_type;
+	typedef detail::KMeansPass< InputIterator, vector_out_type, BinaryOperator > pass_type;
 
-	// we use a quadratic type for epsilon, such that we do not need to calculate square roots later
-	const value_type epsilon = std::pow( static_cast< value_type > (1e-02), 2 );
-	const std::size_t max_iter = 100; // I hope the name says all
-	
-	// std::cout << "Vector Type " << typeid( vector_in_type ).name() << " of dimension=" << N << " and type=" << typeid( T ).name() << "\n";	
-	
 	const std::size_t n = std::distance( iBegin, iEnd );
 	const std::size_t n_cluster = std::distance( itMeanBegin, itMeanEnd );
 	assert( n > n_cluster );
-	// std::cout << "k-means called with " << n << " elements to determine " << n_cluster << " clusters\n";
-
-	//assign indices for the first time
-	indices_container_type indices;
-	indices.reserve( n );
-	std::transform( iBegin, iEnd, std::back_inserter( indices ), assign_indices< mean_type_iterator, BinaryOperator >( itMeanBegin, itMeanEnd, distanceFunc ) );
-	
-	
-	std::size_t i( 0 );
-	value_type diff_error;
-	for( ; i<max_iter; ++i )
+	if ( n_cluster == 0 )
+		return 0;
+
+	std::vector< vector_out_type > centroids( itMeanBegin, itMeanEnd );
+	pass_type pass( iBegin, centroids, distanceFunc );
+	pass.m_indices.resize( n );
+	pass.m_upper.resize( n );
+	pass.m_lower.resize( n );
+	pass.m_halfSeparation.resize( n_cluster );
+	pass.m_move.resize( n_cluster );
+
+	const std::size_t nBatch = std::min( options.batchSize, n );
+	const std::size_t nItems = nBatch ? nBatch : n;
+	const std::size_t nChunks = options.pThreadPool ? std::min( nItems, 4 * options.pThreadPool->size() ) : 1;
+	pass.resize( nItems, nChunks );
+
+	// mini-batches: all samples seen by a cluster so far, determine its learning rate
+	std::vector< std::size_t > samples( nBatch );
+	std::vector< std::size_t > seen( n_cluster, 0 );
+	if ( nBatch )
+		pass.m_pSamples = &samples[ 0 ];
+	else
+		pass.run( options.pThreadPool );
+
+	value_type diff_error( 0 );
+	for ( std::size_t iter = 0; iter < options.nMaxIterations; iter++ )
 	{
-		// set some "fresh" (empty) mean values 
-		mean_container_type means_temp;
-		means_temp.reserve( n_cluster );
-		means_temp.assign( n_cluster, vector_out_type::zeros() );
-				
-		//accumulate the means from the clusters 
-		k_means_accumulate( iBegin, iEnd, indices.begin(), assign_to_mean< mean_type_iterator >( means_temp.begin() ) );
-		
-		// reset the amount of gathered values for the means, could be done nicer...
-		for( std::size_t k = 0; k<n_cluster; ++k )
-			means_temp[ k ] /= std::count ( indices.begin(), indices.end(), k );
-		
-		// calculate the summarized difference
-		std::vector< value_type > norms1;
-		norms1.reserve( n_cluster );
-		std::transform( itMeanBegin, itMeanEnd, means_temp.begin(), std::back_inserter( norms1 ), distanceFunc );
-		diff_error = std::accumulate( norms1.begin(), norms1.end(), static_cast< value_type >( 0 ) ) / n_cluster;
-		
-		// store the new means values
-		itMeanEnd = std::copy( means_temp.begin(), means_temp.end(), itMeanBegin );
+		if ( nBatch )
+		{
+			for ( std::size_t i = 0; i < nBatch; i++ )
+				samples[ i ] = Math::Random::distribute_uniform< std::size_t >( 0, n - 1 );
+			pass.run( options.pThreadPool );
+		}
 
-		// finally assign the indices to the corresponding clusters for the new loop
-		std::transform( iBegin, iEnd, indices.begin(), assign_indices< mean_type_iterator, BinaryOperator >( itMeanBegin, itMeanEnd, distanceFunc ) );
-		
-		if( diff_error < epsilon )
+		// new centroids from the accumulators of the last pass
+		diff_error = 0;
+		pass.m_maxMove = pass.m_secondMaxMove = 0;
+		for ( std::size_t k = 0; k < n_cluster; k++ )
+		{
+			vector_out_type sum( pass.m_sums[ 0 ][ k ] );
+			std::size_t count = pass.m_counts[ 0 ][ k ];
+			for ( std::size_t c = 1; c < nChunks; c++ )
+			{
+				sum += pass.m_sums[ c ][ k ];
+				count += pass.m_counts[ c ][ k ];
+			}
+
+			pass.m_move[ k ] = 0;
+			if ( count == 0 )
+				continue;
+
+			vector_out_type mean;
+			if ( nBatch )
+			{
+				seen[ k ] += count;
+				mean = centroids[ k ] + ( sum - centroids[ k ] * static_cast< value_type >( count ) ) / static_cast< value_type >( seen[ k ] );
+			}
+			else
+				mean = sum / static_cast< value_type >( count );
+
+			pass.m_move[ k ] = distanceFunc( centroids[ k ], mean );
+			centroids[ k ] = mean;
+			diff_error += pass.m_move[ k ];
+			if ( pass.m_move[ k ] > pass.m_maxMove )
+			{
+				pass.m_secondMaxMove = pass.m_maxMove;
+				pass.m_maxMove = pass.m_move[ k ];
+				pass.m_iMaxMove = k;
+			}
+			else if ( pass.m_move[ k ] > pass.m_secondMaxMove )
+				pass.m_secondMaxMove = pass.m_move[ k ];
+		}
+		diff_error /= n_cluster;
+
+		if ( nBatch )
+		{
+			if ( diff_error < options.tolerance )
+				break;
+			continue;
+		}
+
+		for ( std::size_t k = 0; k < n_cluster; k++ )
+		{
+			value_type d = std::numeric_limits< value_type >::max();
+			for ( std::size_t j = 0; j < n_cluster; j++ )
+				if ( j != k )
+					d = std::min( d, distanceFunc( centroids[ k ], centroids[ j ] ) );
+			pass.m_halfSeparation[ k ] = d / 2;
+		}
+
+		pass.m_bInitial = false;
+		pass.run( options.pThreadPool );
+
+		std::size_t changes = 0;
+		for ( std::size_t c = 0; c < nChunks; c++ )
+			changes += pass.m_changes[ c ];
+		if ( changes == 0 || diff_error < options.tolerance )
 			break;
 	}
-	
-	// and copy the indices to the corresponding output iterator
-	std::copy( indices.begin(), indices.end(), indicesOut );
-	
-	// std::cout << "Exit after " << i << " iterations with " << diff_error <<  " mean of summarized differences.\n" ;
+
+	if ( nBatch )
+	{
+		// assign all elements to the final centroids
+		pass.m_pSamples = 0;
+		pass.resize( n, options.pThreadPool ? std::min( n, 4 * options.pThreadPool->size() ) : 1 );
+		pass.run( options.pThreadPool );
+	}
+
+	std::copy( centroids.begin(), centroids.end(), itMeanBegin );
+	std::copy( pass.m_indices.begin(), pass.m_indices.end(), indicesOut );
 	return diff_error;
 };
 
@@ -377,9 +554,11 @@ typename std::iterator_traits< OutputIterator >::value_type::value_type k_means(
  * @param n_cluster a value that signs the amount of clusters and corresponding centroids that are expected within the input elements
  * @param iBeginMean output \c iterator pointing to first element in container/storage class for storing the determined centroids ( usually \c begin() or \c std::back_inserter(container) )
  * @param itIndices output \c iterator pointing to first element in container/storage class for storing the indices to the centroids of the corresponding input elements ( usually \c begin() or \c std::back_inserter(container) )
+ * @param options further settings, see \c KMeansOptions
  */ 
 template< typename InputIterator, typename OutputIterator1, typename OutputIterator2 >
-void k_means( const InputIterator iBeginValues, const InputIterator iEndValues, const std::size_t n_cluster, OutputIterator1 itCentroids, OutputIterator2 itIndices )
+void k_means( const InputIterator iBeginValues, const InputIterator iEndValues, const std::size_t n_cluster, OutputIterator1 itCentroids, OutputIterator2 itIndices
+	, const KMeansOptions& options = KMeansOptions() )
 {
 	typedef typename std::iterator_traits< InputIterator >::value_type vector_type;	
 	typedef typename std::vector< vector_type > mean_container_type;
@@ -396,7 +575,7 @@ void k_means( const InputIterator iBeginValues, const InputIterator iEndValues,
 	
 	copy_probability( iBeginValues, iEndValues, n_cluster, std::back_inserter( means ), Distance< vector_type >() );
 	
-	k_means( iBeginValues, iEndValues, means.begin(), means.end(), itIndices, SquaredDistance< vector_type >() );
+	k_means( iBeginValues, iEndValues, means.begin(), means.end(), itIndices, Distance< vector_type >(), options );
 	
 	// copy the resulting mean values to output iterator
 	std::copy( means.begin(), means.end(), itCentroids );
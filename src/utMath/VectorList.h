@@ -0,0 +1,456 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup math
+ * @file
+ * Lists of fixed size vectors in contiguous storage
+ */
+
+#ifndef __UBITRACK_MATH_VECTORLIST_H_INCLUDED__
+#define __UBITRACK_MATH_VECTORLIST_H_INCLUDED__
+
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include "Vector.h"
+
+namespace Ubitrack { namespace Math {
+
+template< typename T, std::size_t N > class VectorList;
+
+
+/**
+ * @ingroup math
+ * Random access iterator over packed vectors. Dereferencing returns a \c Math::Vector< T, N >
+ * by value, so the iterator can be used with the iterator based algorithms that read
+ * \c std::vector< Math::Vector< T, N > >.
+ */
+template< typename T, std::size_t N >
+class VectorListIterator
+{
+public:
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef Vector< T, N > value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const value_type* pointer;
+	typedef const value_type reference;
+
+	VectorListIterator()
+		: m_p( 0 )
+	{}
+
+	explicit VectorListIterator( const T* p )
+		: m_p( p )
+	{}
+
+	value_type operator*() const
+	{ return value_type( m_p ); }
+
+	value_type operator[]( difference_type i ) const
+	{ return value_type( m_p + i * difference_type( N ) ); }
+
+	VectorListIterator& operator++()
+	{ m_p += N; return *this; }
+
+	VectorListIterator operator++( int )
+	{ VectorListIterator tmp( *this ); m_p += N; return tmp; }
+
+	VectorListIterator& operator--()
+	{ m_p -= N; return *this; }
+
+	VectorListIterator operator--( int )
+	{ VectorListIterator tmp( *this ); m_p -= N; return tmp; }
+
+	VectorListIterator& operator+=( difference_type n )
+	{ m_p += n * difference_type( N ); return *this; }
+
+	VectorListIterator& operator-=( difference_type n )
+	{ m_p -= n * difference_type( N ); return *this; }
+
+	VectorListIterator operator+( difference_type n ) const
+	{ return VectorListIterator( m_p + n * difference_type( N ) ); }
+
+	VectorListIterator operator-( difference_type n ) const
+	{ return VectorListIterator( m_p - n * difference_type( N ) ); }
+
+	difference_type operator-( const VectorListIterator& other ) const
+	{ return ( m_p - other.m_p ) / difference_type( N ); }
+
+	bool operator==( const VectorListIterator& other ) const
+	{ return m_p == other.m_p; }
+
+	bool operator!=( const VectorListIterator& other ) const
+	{ return m_p != other.m_p; }
+
+	bool operator<( const VectorListIterator& other ) const
+	{ return m_p < other.m_p; }
+
+	/** pointer to the packed elements of the current vector */
+	const T* data() const
+	{ return m_p; }
+
+protected:
+	const T* m_p;
+};
+
+
+/**
+ * @ingroup math
+ * Read-only view of \c size vectors with \c N elements each, stored packed as
+ * \c T[ size * N ] in memory that is owned by someone else, e.g. a \c VectorList.
+ *
+ * Views are cheap to copy and to slice and are meant to be passed by value to algorithms.
+ * Element access returns \c Math::Vector< T, N > by value.
+ */
+template< typename T, std::size_t N >
+class VectorListView
+{
+public:
+	typedef Vector< T, N > value_type;
+	typedef T scalar_type;
+	typedef std::size_t size_type;
+	typedef VectorListIterator< T, N > const_iterator;
+	typedef const_iterator iterator;
+
+	/** number of elements per vector */
+	static const std::size_t dimension = N;
+
+	VectorListView()
+		: m_pData( 0 )
+		, m_size( 0 )
+	{}
+
+	/** view on \c size packed vectors at \c pData */
+	VectorListView( const T* pData, std::size_t size )
+		: m_pData( pData )
+		, m_size( size )
+	{}
+
+	/** view on all vectors of a list, valid as long as the list is neither changed nor destroyed */
+	VectorListView( const VectorList< T, N >& list )
+		: m_pData( list.data() )
+		, m_size( list.size() )
+	{}
+
+	std::size_t size() const
+	{ return m_size; }
+
+	bool empty() const
+	{ return m_size == 0; }
+
+	/** packed elements, \c size() * \c N values */
+	const T* data() const
+	{ return m_pData; }
+
+	value_type operator[]( std::size_t i ) const
+	{ return value_type( m_pData + i * N ); }
+
+	/** element access with range check, throws \c std::out_of_range */
+	value_type at( std::size_t i ) const
+	{
+		if ( i >= m_size )
+			throw std::out_of_range( "VectorListView::at" );
+		return ( *this )[ i ];
+	}
+
+	/** element j of vector i */
+	T operator()( std::size_t i, std::size_t j ) const
+	{ return m_pData[ i * N + j ]; }
+
+	const_iterator begin() const
+	{ return const_iterator( m_pData ); }
+
+	const_iterator end() const
+	{ return const_iterator( m_pData + m_size * N ); }
+
+	/** view on the vectors [ iBegin, iEnd ) */
+	VectorListView subview( std::size_t iBegin, std::size_t iEnd ) const
+	{ return VectorListView( m_pData + iBegin * N, iEnd - iBegin ); }
+
+protected:
+	const T* m_pData;
+	std::size_t m_size;
+};
+
+
+/**
+ * @ingroup math
+ * List of vectors with \c N elements each in contiguous storage.
+ *
+ * In contrast to \c std::vector< Math::Vector< T, N > >, whose elements each carry a size
+ * field, the elements are guaranteed to be packed as \c T[ size() * N ], so \c data() can be
+ * handed to SIMD code or external libraries directly.
+ *
+ * The storage is shared between copies and slices and only copied when a list that shares
+ * its storage is modified (copy-on-write). Thus fanning out a list measurement to several
+ * consumers or passing a sub-range on does not copy any data.
+ *
+ * Algorithms take read-only access through \c VectorListView, which every list converts to.
+ */
+template< typename T, std::size_t N >
+class VectorList
+{
+public:
+	typedef Vector< T, N > value_type;
+	typedef T scalar_type;
+	typedef std::size_t size_type;
+	typedef VectorListIterator< T, N > const_iterator;
+	typedef const_iterator iterator;
+
+	/** number of elements per vector */
+	static const std::size_t dimension = N;
+
+	/** empty list */
+	VectorList()
+		: m_offset( 0 )
+		, m_size( 0 )
+	{}
+
+	/** list of \c size zero vectors */
+	explicit VectorList( std::size_t size )
+		: m_pStorage( new std::vector< T >( size * N, T( 0 ) ) )
+		, m_offset( 0 )
+		, m_size( size )
+	{}
+
+	/** copies a range of \c Math::Vector< T, N > */
+	template< class InputIterator >
+	VectorList( InputIterator iBegin, InputIterator iEnd )
+		: m_pStorage( new std::vector< T >() )
+		, m_offset( 0 )
+		, m_size( 0 )
+	{
+		for ( ; iBegin != iEnd; ++iBegin )
+			push_back( *iBegin );
+	}
+
+	/** copies a \c std::vector of vectors */
+	explicit VectorList( const std::vector< value_type >& v )
+		: m_pStorage( new std::vector< T >( v.size() * N ) )
+		, m_offset( 0 )
+		, m_size( v.size() )
+	{
+		for ( std::size_t i = 0; i < v.size(); i++ )
+			std::copy( v[ i ].begin(), v[ i ].end(), &( *m_pStorage )[ i * N ] );
+	}
+
+	/** copies the vectors of a view */
+	explicit VectorList( const VectorListView< T, N >& view )
+		: m_pStorage( new std::vector< T >( view.data(), view.data() + view.size() * N ) )
+		, m_offset( 0 )
+		, m_size( view.size() )
+	{}
+
+	std::size_t size() const
+	{ return m_size; }
+
+	bool empty() const
+	{ return m_size == 0; }
+
+	/** packed elements, \c size() * \c N values */
+	const T* data() const
+	{ return m_size ? &( *m_pStorage )[ m_offset ] : 0; }
+
+	/** packed elements for writing, copies the storage if it is shared */
+	T* data()
+	{
+		detach();
+		return m_size ? &( *m_pStorage )[ m_offset ] : 0;
+	}
+
+	value_type operator[]( std::size_t i ) const
+	{ return value_type( data() + i * N ); }
+
+	/** element access with range check, throws \c std::out_of_range */
+	value_type at( std::size_t i ) const
+	{
+		if ( i >= m_size )
+			throw std::out_of_range( "VectorList::at" );
+		return ( *this )[ i ];
+	}
+
+	/** element j of vector i */
+	T operator()( std::size_t i, std::size_t j ) const
+	{ return data()[ i * N + j ]; }
+
+	/** sets vector i, copies the storage if it is shared */
+	template< class VT >
+	void set( std::size_t i, const VT& v )
+	{
+		T* p = data() + i * N;
+		for ( std::size_t j = 0; j < N; j++ )
+			p[ j ] = v( j );
+	}
+
+	/** appends a vector, copies the storage if it is shared */
+	template< class VT >
+	void push_back( const VT& v )
+	{
+		detach();
+		if ( !m_pStorage )
+			m_pStorage.reset( new std::vector< T >() );
+		for ( std::size_t j = 0; j < N; j++ )
+			m_pStorage->push_back( v( j ) );
+		m_size++;
+	}
+
+	/** reserves storage for \c size vectors */
+	void reserve( std::size_t size )
+	{
+		detach();
+		if ( !m_pStorage )
+			m_pStorage.reset( new std::vector< T >() );
+		m_pStorage->reserve( size * N );
+	}
+
+	/** changes the number of vectors, new vectors are zero */
+	void resize( std::size_t size )
+	{
+		detach();
+		if ( !m_pStorage )
+			m_pStorage.reset( new std::vector< T >() );
+		m_pStorage->resize( size * N, T( 0 ) );
+		m_size = size;
+	}
+
+	void clear()
+	{
+		m_pStorage.reset();
+		m_offset = 0;
+		m_size = 0;
+	}
+
+	const_iterator begin() const
+	{ return const_iterator( data() ); }
+
+	const_iterator end() const
+	{ return const_iterator( data() + m_size * N ); }
+
+	/** list of the vectors [ iBegin, iEnd ) that shares the storage with this list */
+	VectorList slice( std::size_t iBegin, std::size_t iEnd ) const
+	{
+		VectorList result( *this );
+		result.m_offset = m_offset + iBegin * N;
+		result.m_size = iEnd - iBegin;
+		return result;
+	}
+
+	/** view on all vectors, valid as long as this list is neither changed nor destroyed */
+	VectorListView< T, N > view() const
+	{ return VectorListView< T, N >( data(), m_size ); }
+
+	/** true if the storage is shared with other lists */
+	bool shared() const
+	{ return m_pStorage && !m_pStorage.unique(); }
+
+	/** copies the vectors to a \c std::vector, e.g. for algorithms that have no view interface */
+	std::vector< value_type > toVector() const
+	{ return std::vector< value_type >( begin(), end() ); }
+
+protected:
+	/** makes the storage exclusive and removes elements outside the slice */
+	void detach()
+	{
+		if ( !m_pStorage )
+			return;
+		if ( m_pStorage.unique() && m_offset == 0 && m_pStorage->size() == m_size * N )
+			return;
+
+		if ( m_size == 0 )
+		{
+			m_pStorage.reset( new std::vector< T >() );
+			m_offset = 0;
+			return;
+		}
+
+		const T* p = &( *m_pStorage )[ 0 ] + m_offset;
+		boost::shared_ptr< std::vector< T > > pCopy( new std::vector< T >( p, p + m_size * N ) );
+		m_pStorage.swap( pCopy );
+		m_offset = 0;
+	}
+
+	friend class ::boost::serialization::access;
+
+	template< class Archive >
+	void save( Archive& ar, const unsigned int ) const
+	{
+		std::size_t size = m_size;
+		ar & size;
+		const T* p = data();
+		for ( std::size_t i = 0; i < size * N; i++ )
+		{
+			T v = p[ i ];
+			ar & v;
+		}
+	}
+
+	template< class Archive >
+	void load( Archive& ar, const unsigned int )
+	{
+		std::size_t size;
+		ar & size;
+		clear();
+		resize( size );
+		T* p = data();
+		for ( std::size_t i = 0; i < size * N; i++ )
+			ar & p[ i ];
+	}
+
+	BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+	boost::shared_ptr< std::vector< T > > m_pStorage;
+	std::size_t m_offset;
+	std::size_t m_size;
+};
+
+
+/** stream output of a list of vectors */
+template< typename T, std::size_t N >
+std::ostream& operator<<( std::ostream& s, const VectorListView< T, N >& list )
+{
+	s << "{\n";
+	for ( std::size_t i = 0; i < list.size(); i++ )
+		s << list[ i ] << "\n";
+	s << "}";
+	return s;
+}
+
+/** stream output of a list of vectors */
+template< typename T, std::size_t N >
+std::ostream& operator<<( std::ostream& s, const VectorList< T, N >& list )
+{
+	return s << list.view();
+}
+
+} } // namespace Ubitrack::Math
+
+#endif // __UBITRACK_MATH_VECTORLIST_H_INCLUDED__
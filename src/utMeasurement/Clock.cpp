@@ -0,0 +1,407 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Implementation of the clock sources
+ */
+
+#include "Clock.h"
+
+#ifdef __linux__
+
+	#include <time.h>
+	#include <algorithm>
+
+	#if ( defined( __i386__ ) || defined( __x86_64__ ) ) && defined( __GNUC__ )
+		#define UBITRACK_HAVE_TSC
+		#include <cpuid.h>
+		#include <x86intrin.h>
+		#include "TimestampSync.h"
+	#endif
+
+	#include <log4cpp/Category.hh>
+	static log4cpp::Category& logger( log4cpp::Category::getInstance( "Ubitrack.Measurement.Clock" ) );
+
+#endif
+
+namespace Ubitrack { namespace Measurement {
+
+#ifdef __linux__
+
+namespace {
+
+/** the clock source used by now() */
+int g_clockSource = clockRealtime;
+
+
+Timestamp readClockGettime( clockid_t id )
+{
+	timespec ts;
+	clock_gettime( id, &ts );
+	return Timestamp( ts.tv_sec ) * 1000000000 + Timestamp( ts.tv_nsec );
+}
+
+
+/** offset from CLOCK_MONOTONIC to the wall clock, measured once */
+long long computeMonotonicOffset()
+{
+	// take the realtime clock between two readings of the monotonic clock and keep the tightest bracket
+	long long bestOffset = 0;
+	Timestamp bestWidth = ~Timestamp( 0 );
+	for ( int i = 0; i < 5; i++ )
+	{
+		const Timestamp m0 = readClockGettime( CLOCK_MONOTONIC );
+		const Timestamp r = readClockGettime( CLOCK_REALTIME );
+		const Timestamp m1 = readClockGettime( CLOCK_MONOTONIC );
+		if ( m1 - m0 < bestWidth )
+		{
+			bestWidth = m1 - m0;
+			bestOffset = static_cast< long long >( r - ( m0 + ( m1 - m0 ) / 2 ) );
+		}
+	}
+	return bestOffset;
+}
+
+
+Timestamp readMonotonic()
+{
+	static const long long offset( computeMonotonicOffset() );
+	return readClockGettime( CLOCK_MONOTONIC ) + offset;
+}
+
+
+#ifdef UBITRACK_HAVE_TSC
+
+/** checks for a TSC with constant rate in all power states */
+bool hasInvariantTsc()
+{
+	unsigned a, b, c, d;
+	if ( !__get_cpuid( 0x80000000, &a, &b, &c, &d ) || a < 0x80000007 )
+		return false;
+	__get_cpuid( 0x80000007, &a, &b, &c, &d );
+	return ( d & ( 1u << 8 ) ) != 0;
+}
+
+
+/** approximate TSC frequency in Hz, measured against the monotonic clock */
+double calibrateTscFrequency()
+{
+	const Timestamp t0 = readClockGettime( CLOCK_MONOTONIC );
+	const unsigned long long tsc0 = __rdtsc();
+
+	timespec wait;
+	wait.tv_sec = 0;
+	wait.tv_nsec = 5000000;
+	nanosleep( &wait, 0 );
+
+	const Timestamp t1 = readClockGettime( CLOCK_MONOTONIC );
+	const unsigned long long tsc1 = __rdtsc();
+	return double( tsc1 - tsc0 ) * 1e9 / double( t1 - t0 );
+}
+
+
+/**
+ * Converts TSC values to wall clock time.
+ *
+ * The conversion is a linear function that is updated every \c resyncTime nanoseconds by
+ * relating the TSC to the realtime clock with a \c TimestampSync. Between updates, a read
+ * only costs the TSC instruction, the evaluation of the linear function and an update of the
+ * last issued timestamp. The function is published with a sequence lock, so readers never block.
+ *
+ * If the synchronized time is ahead, the clock jumps forward. If it is behind by at most
+ * \c maxSlewOffset, the clock is slowed down to at most half speed, so it catches up within
+ * twice that time. Larger steps back are taken at once. No reader ever returns less than the
+ * last timestamp issued to any thread, so the clock stays monotonic across threads even while
+ * other threads still use an old mapping, and it stands still after a large step back until
+ * the wall clock has caught up.
+ */
+class TscClock
+{
+public:
+	TscClock()
+		: m_frequency( calibrateTscFrequency() )
+		, m_sync( m_frequency )
+		, m_origin( __rdtsc() )
+		, m_resyncTicks( static_cast< long long >( m_frequency * ( resyncTime * 1e-9 ) ) )
+		, m_sequence( 0 )
+		, m_lock( 0 )
+	{
+		LOG4CPP_INFO( logger, "Using TSC with approximately " << m_frequency * 1e-6 << " MHz" );
+
+		const unsigned long long tsc = __rdtsc();
+		m_mapping.tsc = tsc;
+		m_mapping.local = m_sync.convertNativeToLocal( double( tsc - m_origin ), readClockGettime( CLOCK_REALTIME ) );
+		m_mapping.gain = 1e9 / m_frequency;
+		m_lastIssued = m_mapping.local;
+	}
+
+	Timestamp read()
+	{
+		const unsigned long long tsc = __rdtsc();
+		Mapping m;
+		loadMapping( m );
+		if ( static_cast< long long >( tsc - m.tsc ) > m_resyncTicks )
+		{
+			resync( m );
+			loadMapping( m );
+		}
+
+		return issue( m.local + static_cast< long long >( double( static_cast< long long >( tsc - m.tsc ) ) * m.gain ) );
+	}
+
+protected:
+	/** time between synchronizations in nanoseconds */
+	static const long long resyncTime = 50000000;
+
+	/** largest step back of the wall clock in nanoseconds that is slewed instead of taken at once */
+	static const long long maxSlewOffset = 100000000;
+
+	/** local = mapping.local + ( tsc - mapping.tsc ) * mapping.gain */
+	struct Mapping
+	{
+		unsigned long long tsc;
+		Timestamp local;
+		double gain;
+	};
+
+	void loadMapping( Mapping& m ) const
+	{
+		for ( ;; )
+		{
+			const unsigned s = __atomic_load_n( &m_sequence, __ATOMIC_ACQUIRE );
+			__atomic_load( &m_mapping.tsc, &m.tsc, __ATOMIC_RELAXED );
+			__atomic_load( &m_mapping.local, &m.local, __ATOMIC_RELAXED );
+			__atomic_load( &m_mapping.gain, &m.gain, __ATOMIC_RELAXED );
+			__atomic_thread_fence( __ATOMIC_ACQUIRE );
+			if ( !( s & 1 ) && s == __atomic_load_n( &m_sequence, __ATOMIC_RELAXED ) )
+				return;
+		}
+	}
+
+	/** returns the larger of t and the last timestamp issued to any thread */
+	Timestamp issue( const Timestamp t )
+	{
+		Timestamp last = __atomic_load_n( &m_lastIssued, __ATOMIC_RELAXED );
+		while ( t > last )
+			if ( __atomic_compare_exchange_n( &m_lastIssued, &last, t, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+				return t;
+		return last;
+	}
+
+	void resync( const Mapping& old )
+	{
+		// only one thread synchronizes, the others continue with the old mapping, issue() keeps
+		// their timestamps consistent with the new one
+		if ( __atomic_exchange_n( &m_lock, 1, __ATOMIC_ACQUIRE ) )
+			return;
+
+		// some other thread may have finished a synchronization in between
+		Mapping current;
+		loadMapping( current );
+		if ( current.tsc == old.tsc )
+		{
+			// read the realtime clock between two TSC values
+			const unsigned long long tsc0 = __rdtsc();
+			const Timestamp realtime = readClockGettime( CLOCK_REALTIME );
+			const unsigned long long tsc1 = __rdtsc();
+			const unsigned long long tsc = tsc0 + ( tsc1 - tsc0 ) / 2;
+
+			const Timestamp synced = m_sync.convertNativeToLocal( double( tsc - m_origin ), realtime );
+			const double gain = m_sync.getGain();
+			const Timestamp predicted = old.local + static_cast< long long >( double( tsc - old.tsc ) * old.gain );
+
+			Mapping m;
+			m.tsc = tsc;
+			if ( synced >= predicted )
+			{
+				m.local = synced;
+				m.gain = gain;
+			}
+			else if ( predicted - synced <= Timestamp( maxSlewOffset ) )
+			{
+				// slew towards the synchronized time, at most by half the time until the next update
+				m.local = predicted;
+				m.gain = std::max( gain - double( predicted - synced ) / double( m_resyncTicks ), 0.5 * gain );
+			}
+			else
+			{
+				// step back, issue() holds the clock until it has passed the last timestamp again
+				LOG4CPP_INFO( logger, "Wall clock stepped back by " << ( predicted - synced ) * 1e-6 << " ms" );
+				m.local = synced;
+				m.gain = gain;
+			}
+
+			const unsigned s = m_sequence;
+			__atomic_store_n( &m_sequence, s + 1, __ATOMIC_RELAXED );
+			__atomic_thread_fence( __ATOMIC_RELEASE );
+			__atomic_store( &m_mapping.tsc, &m.tsc, __ATOMIC_RELAXED );
+			__atomic_store( &m_mapping.local, &m.local, __ATOMIC_RELAXED );
+			__atomic_store( &m_mapping.gain, &m.gain, __ATOMIC_RELAXED );
+			__atomic_store_n( &m_sequence, s + 2, __ATOMIC_RELEASE );
+		}
+
+		__atomic_store_n( &m_lock, 0, __ATOMIC_RELEASE );
+	}
+
+	double m_frequency;
+	TimestampSync m_sync;
+	unsigned long long m_origin;
+	long long m_resyncTicks;
+
+	Mapping m_mapping;
+	unsigned m_sequence;
+	int m_lock;
+
+	/** largest timestamp returned by read() so far */
+	Timestamp m_lastIssued;
+};
+
+
+bool tscAvailable()
+{
+	static const bool bAvailable( hasInvariantTsc() );
+	return bAvailable;
+}
+
+
+Timestamp readTsc()
+{
+	static TscClock clock;
+	return clock.read();
+}
+
+#else // UBITRACK_HAVE_TSC
+
+bool tscAvailable()
+{
+	return false;
+}
+
+
+Timestamp readTsc()
+{
+	return readClockGettime( CLOCK_REALTIME );
+}
+
+#endif // UBITRACK_HAVE_TSC
+
+} // anonymous namespace
+
+
+bool setClockSource( ClockSource source )
+{
+	if ( !isClockSourceAvailable( source ) )
+		return false;
+
+	LOG4CPP_INFO( logger, "Using clock source " << clockSourceName( source ) );
+	__atomic_store_n( &g_clockSource, static_cast< int >( source ), __ATOMIC_RELAXED );
+	return true;
+}
+
+
+ClockSource getClockSource()
+{
+	return static_cast< ClockSource >( __atomic_load_n( &g_clockSource, __ATOMIC_RELAXED ) );
+}
+
+
+bool isClockSourceAvailable( ClockSource source )
+{
+	return source != clockTsc || tscAvailable();
+}
+
+
+Timestamp readClock( ClockSource source )
+{
+	switch ( source )
+	{
+		case clockMonotonic:
+			return readMonotonic();
+		case clockTsc:
+			if ( tscAvailable() )
+				return readTsc();
+			// fall through
+		default:
+			return readClockGettime( CLOCK_REALTIME );
+	}
+}
+
+
+Timestamp nowFast()
+{
+	// independent of the source selected for now()
+	return tscAvailable() ? readTsc() : readMonotonic();
+}
+
+#else // __linux__
+
+bool setClockSource( ClockSource source )
+{
+	return source == clockRealtime;
+}
+
+
+ClockSource getClockSource()
+{
+	return clockRealtime;
+}
+
+
+bool isClockSourceAvailable( ClockSource source )
+{
+	return source == clockRealtime;
+}
+
+
+Timestamp readClock( ClockSource )
+{
+	return now();
+}
+
+
+Timestamp nowFast()
+{
+	return now();
+}
+
+#endif // __linux__
+
+
+const char* clockSourceName( ClockSource source )
+{
+	switch ( source )
+	{
+		case clockRealtime:
+			return "realtime";
+		case clockMonotonic:
+			return "monotonic";
+		case clockTsc:
+			return "tsc";
+	}
+	return "unknown";
+}
+
+} } // namespace Ubitrack::Measurement
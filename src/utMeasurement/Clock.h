@@ -0,0 +1,87 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Selection of the clock source behind \c Measurement::now() and \c Measurement::nowFast()
+ */
+
+
+#ifndef _Ubitrack_Measurement_Clock_INCLUDED_
+#define _Ubitrack_Measurement_Clock_INCLUDED_
+
+#include <utCore.h>
+#include <utMeasurement/Timestamp.h>
+
+namespace Ubitrack { namespace Measurement {
+
+/**
+ * Clock sources for timestamps.
+ *
+ * All sources return nanoseconds since epoch, but differ in resolution, cost and behaviour
+ * when the system time is changed (e.g. by NTP):
+ * - \c clockRealtime: the system wall clock (\c CLOCK_REALTIME via vDSO on Linux). Follows
+ *   every change of the system time, so it can jump backwards.
+ * - \c clockMonotonic: \c CLOCK_MONOTONIC plus the offset to the wall clock taken at the first
+ *   use. Never jumps, but does not follow later steps of the system time.
+ * - \c clockTsc: the CPU time stamp counter, continuously synchronized to the wall clock by a
+ *   \c TimestampSync. Cheap to read and monotonic across threads. Small steps of the system
+ *   time are smoothed out, after larger steps back the clock stands still until the wall clock
+ *   has caught up. Only available on x86 CPUs with an invariant TSC.
+ *
+ * The default is \c clockRealtime, so \c now() stays comparable to timestamps of other
+ * processes and machines. The other sources have to be selected with \c setClockSource. On
+ * other systems than Linux only \c clockRealtime is available, which is the platform specific
+ * implementation of \c now().
+ *
+ * \c nowFast() does not depend on the selected source: it reads \c clockTsc if available and
+ * \c clockMonotonic otherwise (\c now() on other systems than Linux).
+ */
+enum ClockSource { clockRealtime, clockMonotonic, clockTsc };
+
+/**
+ * Selects the clock used by \c now().
+ * @return false if the source is not available on this system, the clock is not changed then
+ */
+UBITRACK_EXPORT bool setClockSource( ClockSource source );
+
+/** returns the clock currently used by \c now() */
+UBITRACK_EXPORT ClockSource getClockSource();
+
+/** checks if a clock source is available on this system */
+UBITRACK_EXPORT bool isClockSourceAvailable( ClockSource source );
+
+/**
+ * reads a specific clock, independently of the clock selected for \c now().
+ * Unavailable sources fall back to \c clockRealtime.
+ */
+UBITRACK_EXPORT Timestamp readClock( ClockSource source );
+
+/** returns the name of a clock source, e.g. for log messages */
+UBITRACK_EXPORT const char* clockSourceName( ClockSource source );
+
+} } // namespace Ubitrack::Measurement
+
+#endif // _Ubitrack_Measurement_Clock_INCLUDED_
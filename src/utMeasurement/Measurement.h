@@ -43,6 +43,7 @@
 #include <utMath/Scalar.h>
 #include <utMath/RotationVelocity.h>
 #include <utMath/CameraIntrinsics.h>
+#include <utMath/VectorList.h>
 
 // std
 #include <vector>
@@ -93,6 +94,11 @@ typedef Measurement< std::vector < Math::ErrorPose > > ErrorPoseList;
 typedef Measurement< std::vector < Math::ErrorVector< double, 2 > > > ErrorPositionList2;
 typedef Measurement< std::vector < Math::ErrorVector< double, 3 > > > ErrorPositionList;
 
+//multiple measurements in contiguous storage, see Math::VectorList
+typedef Measurement< Math::VectorList< double, 2 > > PackedPositionList2;
+typedef Measurement< Math::VectorList< double, 3 > > PackedPositionList;
+typedef Measurement< Math::VectorList< double, 7 > > PackedPoseList; // tx, ty, tz, qx, qy, qz, qw as in Math::Pose::toVector
+
 
 //typedef Measurement< Math::ErrorFeaturePosition< 3 > > ErrorFeaturePosition;
 //typedef Measurement< std::vector < Math::ErrorFeaturePosition< 3 , FeatureDescriptor> > > ErrorFeaturePositionList3D<class FeatureDescriptor> ;
@@ -0,0 +1,352 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Pooled allocation of measurements
+ */
+
+
+#ifndef _Ubitrack_Measurement_PoolAllocator_INCLUDED_
+#define _Ubitrack_Measurement_PoolAllocator_INCLUDED_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "Measurement.h"
+
+// native thread local storage for the thread caches, much faster than boost::thread_specific_ptr
+#if defined( __GNUC__ )
+	#define UBITRACK_POOL_THREAD_LOCAL __thread
+#elif defined( COMPILER_USE_CXX11 )
+	#define UBITRACK_POOL_THREAD_LOCAL thread_local
+#endif
+
+namespace Ubitrack { namespace Measurement {
+
+namespace detail {
+
+/**
+ * Free lists of memory blocks of one size.
+ *
+ * Every thread keeps a cache of free blocks, so allocating and releasing usually neither
+ * locks nor calls the system allocator. The global free list is only locked to exchange
+ * batches of blocks with the thread caches. Blocks released by a different thread than the
+ * one that allocated them (e.g. the consumer of a measurement) go to the cache of the
+ * releasing thread. Memory is taken in batches from the \c Upstream allocator of \c char
+ * and never returned.
+ */
+template< std::size_t Size, class Upstream >
+class FixedSizePool
+{
+public:
+	/** returns the pool of this block size */
+	static FixedSizePool& instance()
+	{
+		// never destroyed, measurements may still be released during static destruction
+		static FixedSizePool* pPool = new FixedSizePool;
+		return *pPool;
+	}
+
+	void* allocate()
+	{
+		Cache& cache( threadCache() );
+		if ( !cache.pFree )
+			acquire( cache );
+
+		Node* pNode = cache.pFree;
+		cache.pFree = pNode->pNext;
+		cache.nFree--;
+		return pNode;
+	}
+
+	void deallocate( void* p )
+	{
+		Cache& cache( threadCache() );
+		Node* pNode = static_cast< Node* >( p );
+		pNode->pNext = cache.pFree;
+		cache.pFree = pNode;
+		if ( ++cache.nFree > 2 * batchSize )
+			release( cache, batchSize );
+	}
+
+protected:
+	/** number of blocks exchanged between thread caches and the global list */
+	static const std::size_t batchSize = 32;
+
+	/** a free block */
+	struct Node
+	{
+		Node* pNext;
+	};
+
+	/** size of a block, rounded up to keep all blocks aligned */
+	static const std::size_t nodeSize = ( ( Size > sizeof( Node ) ? Size : sizeof( Node ) ) + 15 ) & ~std::size_t( 15 );
+
+	struct Cache
+	{
+		Cache()
+			: pFree( 0 )
+			, nFree( 0 )
+		{}
+
+		Node* pFree;
+		std::size_t nFree;
+	};
+
+	FixedSizePool()
+		: m_pFree( 0 )
+		, m_cache( &FixedSizePool::releaseCache )
+	{}
+
+	Cache& threadCache()
+	{
+	#ifdef UBITRACK_POOL_THREAD_LOCAL
+		// fast path, the thread_specific_ptr is only needed to release the cache at thread exit
+		if ( Cache* pCache = cachePointer() )
+			return *pCache;
+	#endif
+
+		Cache* pCache = m_cache.get();
+		if ( !pCache )
+		{
+			pCache = new Cache;
+			m_cache.reset( pCache );
+		}
+
+	#ifdef UBITRACK_POOL_THREAD_LOCAL
+		cachePointer() = pCache;
+	#endif
+		return *pCache;
+	}
+
+#ifdef UBITRACK_POOL_THREAD_LOCAL
+	/** the cache of the calling thread in native thread local storage */
+	static Cache*& cachePointer()
+	{
+		static UBITRACK_POOL_THREAD_LOCAL Cache* s_pCache = 0;
+		return s_pCache;
+	}
+#endif
+
+	/** moves a batch of blocks from the global list to a cache, allocates new blocks if necessary */
+	void acquire( Cache& cache )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		if ( !m_pFree )
+		{
+			char* pChunk = Upstream().allocate( batchSize * nodeSize );
+			for ( std::size_t i = 0; i < batchSize; i++ )
+			{
+				Node* pNode = reinterpret_cast< Node* >( pChunk + i * nodeSize );
+				pNode->pNext = m_pFree;
+				m_pFree = pNode;
+			}
+		}
+
+		for ( std::size_t i = 0; i < batchSize && m_pFree; i++ )
+		{
+			Node* pNode = m_pFree;
+			m_pFree = pNode->pNext;
+			pNode->pNext = cache.pFree;
+			cache.pFree = pNode;
+			cache.nFree++;
+		}
+	}
+
+	/** moves n blocks from a cache to the global list */
+	void release( Cache& cache, std::size_t n )
+	{
+		boost::mutex::scoped_lock lock( m_mutex );
+		for ( ; n > 0 && cache.pFree; n-- )
+		{
+			Node* pNode = cache.pFree;
+			cache.pFree = pNode->pNext;
+			cache.nFree--;
+			pNode->pNext = m_pFree;
+			m_pFree = pNode;
+		}
+	}
+
+	/** called when a thread terminates */
+	static void releaseCache( Cache* pCache )
+	{
+		instance().release( *pCache, pCache->nFree );
+		delete pCache;
+	#ifdef UBITRACK_POOL_THREAD_LOCAL
+		cachePointer() = 0;
+	#endif
+	}
+
+	boost::mutex m_mutex;
+	Node* m_pFree;
+	boost::thread_specific_ptr< Cache > m_cache;
+};
+
+} // namespace detail
+
+
+/**
+ * @ingroup datastructures
+ * Standard allocator that takes single objects from a \c detail::FixedSizePool.
+ *
+ * Used with \c boost::allocate_shared, the control block and the payload of a
+ * \c boost::shared_ptr are one pooled block. The pools and arrays get their memory from
+ * \c Upstream, e.g. to count the allocations in tests. Every upstream type has its own pools.
+ */
+template< class T, class Upstream = std::allocator< char > >
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef std::size_t size_type;
+	typedef std::ptrdiff_t difference_type;
+
+	template< class U >
+	struct rebind
+	{ typedef PoolAllocator< U, Upstream > other; };
+
+	PoolAllocator()
+	{}
+
+	template< class U >
+	PoolAllocator( const PoolAllocator< U, Upstream >& )
+	{}
+
+	pointer allocate( size_type n, const void* = 0 )
+	{
+		if ( n != 1 )
+			return ArrayAllocator().allocate( n );
+		return static_cast< pointer >( detail::FixedSizePool< sizeof( T ), Upstream >::instance().allocate() );
+	}
+
+	void deallocate( pointer p, size_type n )
+	{
+		if ( n != 1 )
+			ArrayAllocator().deallocate( p, n );
+		else
+			detail::FixedSizePool< sizeof( T ), Upstream >::instance().deallocate( p );
+	}
+
+	void construct( pointer p, const T& value )
+	{ new( p ) T( value ); }
+
+	void destroy( pointer p )
+	{ p->~T(); }
+
+	pointer address( reference r ) const
+	{ return &r; }
+
+	const_pointer address( const_reference r ) const
+	{ return &r; }
+
+	size_type max_size() const
+	{ return std::size_t( -1 ) / sizeof( T ); }
+
+protected:
+	typedef typename Upstream::template rebind< T >::other ArrayAllocator;
+};
+
+template< class T, class U, class Upstream >
+bool operator==( const PoolAllocator< T, Upstream >&, const PoolAllocator< U, Upstream >& )
+{ return true; }
+
+template< class T, class U, class Upstream >
+bool operator!=( const PoolAllocator< T, Upstream >&, const PoolAllocator< U, Upstream >& )
+{ return false; }
+
+
+/**
+ * @ingroup datastructures
+ * Creates a measurement whose payload and reference count share one block from a pool,
+ * instead of the two heap allocations of \c Measurement( t, value ).
+ *
+ * The result is an ordinary \c Measurement, i.e. a \c boost::shared_ptr, and can be copied,
+ * cloned and released in any thread. The payload is constructed from the given arguments:
+ * @verbatim
+Measurement::Pose a( Measurement::make< Measurement::Pose >( t, pose ) );
+Measurement::Pose b( Measurement::make< Measurement::Pose >( t, rotation, translation ) );
+@endverbatim
+ * Memory that the payload allocates itself (e.g. the elements of a \c std::vector) is not pooled.
+ *
+ * @param M measurement type, e.g. \c Measurement::Pose
+ */
+template< class M >
+M make( Timestamp t )
+{
+	typedef typename M::value_type Type;
+	boost::shared_ptr< Type > p( boost::allocate_shared< Type >( PoolAllocator< Type >() ) );
+
+	// swapping instead of copying the pointer saves two atomic reference count operations
+	M m( t );
+	m.swap( p );
+	return m;
+}
+
+/** @see make( Timestamp ) */
+template< class M, class A1 >
+M make( Timestamp t, const A1& a1 )
+{
+	typedef typename M::value_type Type;
+	boost::shared_ptr< Type > p( boost::allocate_shared< Type >( PoolAllocator< Type >(), a1 ) );
+	M m( t );
+	m.swap( p );
+	return m;
+}
+
+/** @see make( Timestamp ) */
+template< class M, class A1, class A2 >
+M make( Timestamp t, const A1& a1, const A2& a2 )
+{
+	typedef typename M::value_type Type;
+	boost::shared_ptr< Type > p( boost::allocate_shared< Type >( PoolAllocator< Type >(), a1, a2 ) );
+	M m( t );
+	m.swap( p );
+	return m;
+}
+
+/** @see make( Timestamp ) */
+template< class M, class A1, class A2, class A3 >
+M make( Timestamp t, const A1& a1, const A2& a2, const A3& a3 )
+{
+	typedef typename M::value_type Type;
+	boost::shared_ptr< Type > p( boost::allocate_shared< Type >( PoolAllocator< Type >(), a1, a2, a3 ) );
+	M m( t );
+	m.swap( p );
+	return m;
+}
+
+} } // namespace Ubitrack::Measurement
+
+#endif // _Ubitrack_Measurement_PoolAllocator_INCLUDED_
@@ -39,6 +39,8 @@
 
 	#include <sys/time.h>
 
+	#include "Clock.h"
+
 #endif
 
 namespace Ubitrack { namespace Measurement {
@@ -95,6 +97,11 @@ Timestamp now()
 	else
 		return rtc;
 	
+#elif defined( __linux__ )
+
+	// selectable clock source, see Clock.cpp
+	return readClock( getClockSource() );
+
 #else
 
 	// Unix time
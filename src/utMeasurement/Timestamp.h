@@ -41,9 +41,12 @@ namespace Ubitrack { namespace Measurement {
 /// Timestamp: nanoseconds since epoch (UNIX birth)
 typedef unsigned long long int Timestamp;
 
-/// retrieve the current system time as Timestamp
+/// retrieve the current system time as Timestamp, see Clock.h for the available clock sources
 UBITRACK_EXPORT Timestamp now();
 
+/// retrieve the current time cheaply and monotonically for hot paths (CPU time stamp counter or monotonic clock), not tied to the wall clock like now()
+UBITRACK_EXPORT Timestamp nowFast();
+
 /// convert a Timestamp to a string (returns something like "Fri Mar 02 11:41:41 2007 UTC")
 UBITRACK_EXPORT std::string timestampToString( Timestamp );
 
@@ -135,4 +135,11 @@ Timestamp TimestampSync::convertNativeToLocal( double native, Timestamp local )
 }
 
 
+void TimestampSync::convertNativeToLocal( std::size_t n, const double* native, const Timestamp* local, Timestamp* result )
+{
+	for ( std::size_t i = 0; i < n; i++ )
+		result[ i ] = convertNativeToLocal( native[ i ], local[ i ] );
+}
+
+
 } } // namespace Ubitrack::Measurement
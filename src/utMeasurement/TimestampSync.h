@@ -35,6 +35,8 @@
 #include <utCore.h>
 #include <utMeasurement/Timestamp.h>
 
+#include <cstddef>
+
 namespace Ubitrack { namespace Measurement {
 
 /**
@@ -88,12 +90,43 @@ public:
 	 */
 	Timestamp convertNativeToLocal( double native, Timestamp local );
 
+	/**
+	 * Add a buffer of sensor timestamps, e.g. all samples delivered by one driver callback,
+	 * with the corresponding system clock values. Gives the same results as converting them
+	 * one after the other.
+	 *
+	 * @param n number of timestamps
+	 * @param native native sensor clock values
+	 * @param local corresponding system clock values
+	 * @param result receives the sensor times converted to local times, may be the same buffer as \c local
+	 */
+	void convertNativeToLocal( std::size_t n, const double* native, const Timestamp* local, Timestamp* result );
+
+	/**
+	 * Convert a sensor timestamp with the current estimate, without updating it.
+	 *
+	 * @param native native sensor clock value
+	 * @return the sensor time converted to a local time
+	 */
+	Timestamp predictNativeToLocal( double native ) const
+	{
+		if ( m_events == 0 )
+			return 0;
+		return m_estLocal + static_cast< long long >( ( native - m_lastNative ) * m_estGain );
+	}
+
 	/**
 	 * returns the number of timestamps processed
 	 */
 	unsigned getEventCount() const
 	{ return m_events; }
-	
+
+	/**
+	 * returns the currently estimated gain, i.e. local clock units per native clock unit
+	 */
+	double getGain() const
+	{ return m_estGain; }
+
 protected:
 
 	// number of treated events
@@ -32,12 +32,12 @@
 #ifndef _Ubitrack_Measurement_TimestampSyncLS_INCLUDED_
 #define _Ubitrack_Measurement_TimestampSyncLS_INCLUDED_
 
-#define DEBUG_TIMESTAMP_SYNC
+//#define DEBUG_TIMESTAMP_SYNC
 
 #ifdef DEBUG_TIMESTAMP_SYNC
 #include <iostream>
 #include <iomanip>
-// #include <cmath>
+#include <cmath>
 #endif
 
 #include <algorithm>
@@ -138,6 +138,13 @@ public:
 		return m_firstLocal + static_cast< Timestamp >( fExtrapolated );
 	}
 
+	/** converts a buffer of timestamps, see \c TimestampSync */
+	void convertNativeToLocal( std::size_t n, const double* native, const Timestamp* local, Timestamp* result )
+	{
+		for ( std::size_t i = 0; i < n; i++ )
+			result[ i ] = convertNativeToLocal( native[ i ], local[ i ] );
+	}
+
 	unsigned getEventCount() const
 	{ return m_events; }
 	
@@ -0,0 +1,107 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup datastructures
+ * @file implementation of offline timestamp synchronization
+ */
+
+#include "TimestampSyncOffline.h"
+
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Ubitrack { namespace Measurement {
+
+namespace {
+
+	/** median of a buffer, reorders the buffer */
+	double median( std::vector< double >& values )
+	{
+		const std::size_t half = values.size() / 2;
+		std::nth_element( values.begin(), values.begin() + half, values.end() );
+		const double upper = values[ half ];
+		if ( values.size() % 2 )
+			return upper;
+		return 0.5 * ( upper + *std::max_element( values.begin(), values.begin() + half ) );
+	}
+
+	/** signed difference of two timestamps as double */
+	double difference( Timestamp a, Timestamp b )
+	{
+		return static_cast< double >( static_cast< long long >( a - b ) );
+	}
+
+} // anonymous namespace
+
+
+void TimestampSyncOffline::fit( std::size_t n, const double* native, const Timestamp* local )
+{
+	if ( n < 2 )
+		UBITRACK_THROW( "Offline timestamp synchronization needs at least two timestamps" );
+
+	const double nativeReference = native[ 0 ];
+	const Timestamp localReference = local[ 0 ];
+
+	// slopes between the two halves of the recording
+	const std::size_t half = ( n + 1 ) / 2;
+	std::vector< double > values;
+	values.reserve( n );
+	for ( std::size_t i = 0; i + half < n; i++ )
+	{
+		const double deltaNative = native[ i + half ] - native[ i ];
+		if ( deltaNative != 0.0 )
+			values.push_back( difference( local[ i + half ], local[ i ] ) / deltaNative );
+	}
+	if ( values.empty() )
+		UBITRACK_THROW( "Offline timestamp synchronization needs different native timestamps" );
+	const double gain = median( values );
+
+	// offset and spread of the residuals
+	values.resize( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		values[ i ] = difference( local[ i ], localReference ) - gain * ( native[ i ] - nativeReference );
+	const double offset = median( values );
+
+	for ( std::size_t i = 0; i < n; i++ )
+		values[ i ] = std::fabs( values[ i ] - offset );
+
+	m_nativeReference = nativeReference;
+	m_localReference = localReference;
+	m_gain = gain;
+	m_offset = offset;
+	m_deviation = 1.4826 * median( values );
+	m_events = n;
+}
+
+
+void TimestampSyncOffline::convertNativeToLocal( std::size_t n, const double* native, Timestamp* result ) const
+{
+	for ( std::size_t i = 0; i < n; i++ )
+		result[ i ] = convertNativeToLocal( native[ i ] );
+}
+
+} } // namespace Ubitrack::Measurement
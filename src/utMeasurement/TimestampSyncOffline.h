@@ -0,0 +1,122 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup datastructures
+ * @file
+ * Robust offline synchronization of recorded sensor timestamps.
+ */
+
+#ifndef _Ubitrack_Measurement_TimestampSyncOffline_INCLUDED_
+#define _Ubitrack_Measurement_TimestampSyncOffline_INCLUDED_
+
+#include <utCore.h>
+#include <utMeasurement/Timestamp.h>
+
+#include <cstddef>
+
+namespace Ubitrack { namespace Measurement {
+
+/**
+ * see class TimestampSync.
+ * This fits a single line local = offset + gain * native to a complete recording instead of
+ * filtering online, for post-processing logs where all timestamps are known in advance.
+ *
+ * The gain is Theil's estimator: the median of the slopes between each sample of the first
+ * half of the recording and the sample half a recording later. All these pairs have long
+ * baselines, so the jitter of the local clock hardly affects the slopes, and up to half of the
+ * samples can be outliers, e.g. from scheduling delays. The offset is the median of the
+ * remaining differences, so the converted times include the median latency of the local
+ * timestamps. The fit runs in O(n) time.
+ */
+class UBITRACK_EXPORT TimestampSyncOffline
+{
+public:
+	TimestampSyncOffline()
+		: m_nativeReference( 0.0 )
+		, m_localReference( 0 )
+		, m_offset( 0.0 )
+		, m_gain( 1.0 )
+		, m_deviation( 0.0 )
+		, m_events( 0 )
+	{}
+
+	/**
+	 * Fits the clock model to a recording.
+	 *
+	 * @param n number of timestamps, at least 2
+	 * @param native native sensor clock values
+	 * @param local corresponding system clock values
+	 * @throws Util::Exception if there are less than two timestamps or all native values are equal
+	 */
+	void fit( std::size_t n, const double* native, const Timestamp* local );
+
+	/**
+	 * Converts a sensor timestamp with the fitted model.
+	 *
+	 * @param native native sensor clock value
+	 * @return the sensor time converted to a local time
+	 */
+	Timestamp convertNativeToLocal( double native ) const
+	{
+		const double local = m_offset + m_gain * ( native - m_nativeReference );
+		return m_localReference + static_cast< long long >( local < 0 ? local - 0.5 : local + 0.5 );
+	}
+
+	/**
+	 * Converts a buffer of sensor timestamps with the fitted model.
+	 *
+	 * @param n number of timestamps
+	 * @param native native sensor clock values
+	 * @param result receives the sensor times converted to local times
+	 */
+	void convertNativeToLocal( std::size_t n, const double* native, Timestamp* result ) const;
+
+	/** returns the number of timestamps used in the last fit */
+	std::size_t getEventCount() const
+	{ return m_events; }
+
+	/** returns the estimated gain, i.e. local clock units per native clock unit */
+	double getGain() const
+	{ return m_gain; }
+
+	/** returns the robust standard deviation of the local timestamps from the fitted line (scaled median absolute deviation) */
+	double getDeviation() const
+	{ return m_deviation; }
+
+protected:
+	/** differences are computed relative to the first sample to keep the precision of the doubles */
+	double m_nativeReference;
+	Timestamp m_localReference;
+
+	/** local = m_localReference + m_offset + m_gain * ( native - m_nativeReference ) */
+	double m_offset;
+	double m_gain;
+
+	double m_deviation;
+	std::size_t m_events;
+};
+
+} } // namespace Ubitrack::Measurement
+
+#endif // _Ubitrack_Measurement_TimestampSyncOffline_INCLUDED_
@@ -72,6 +72,54 @@ struct PoseMeasurement
 	}
 };
 
+/**
+ * Measurement update for measurements that select elements of the state.
+ * Uses the allocation-free fixed-size update if the state size is that of one of the
+ * common motion models (position and orientation with up to two derivatives).
+ * @return false if the state size is not supported, nothing is changed in this case
+ */
+template< std::size_t M, class VMeas, class MMeasCov >
+bool fixedSizeSelectionUpdate( Ubitrack::Tracking::PoseKalmanFilter::StateType& state, 
+	Ubitrack::Tracking::PoseKalmanFilter::CovarianceType& covariance,
+	const VMeas& measurement, const MMeasCov& measurementCov, const std::size_t ( &indices )[ M ] )
+{
+	using namespace Ubitrack::Math::Stochastic;
+	switch ( state.size() )
+	{
+	case 7:
+		kalmanMeasurementUpdateSelection< 7, M >( state, covariance, measurement, measurementCov, indices );
+		return true;
+	case 10:
+		kalmanMeasurementUpdateSelection< 10, M >( state, covariance, measurement, measurementCov, indices );
+		return true;
+	case 13:
+		kalmanMeasurementUpdateSelection< 13, M >( state, covariance, measurement, measurementCov, indices );
+		return true;
+	case 16:
+		kalmanMeasurementUpdateSelection< 16, M >( state, covariance, measurement, measurementCov, indices );
+		return true;
+	case 19:
+		kalmanMeasurementUpdateSelection< 19, M >( state, covariance, measurement, measurementCov, indices );
+		return true;
+	default:
+		return false;
+	}
+}
+
+/** identity measurement update of the elements [ iBegin, iBegin + M ) of the state */
+template< std::size_t M, class VMeas, class MMeasCov >
+void identityUpdate( Ubitrack::Tracking::PoseKalmanFilter::StateType& state, 
+	Ubitrack::Tracking::PoseKalmanFilter::CovarianceType& covariance,
+	const VMeas& measurement, const MMeasCov& measurementCov, const std::size_t iBegin )
+{
+	std::size_t indices[ M ];
+	for ( std::size_t k = 0; k < M; k++ )
+		indices[ k ] = iBegin + k;
+
+	if ( !fixedSizeSelectionUpdate( state, covariance, measurement, measurementCov, indices ) )
+		Ubitrack::Math::Stochastic::kalmanMeasurementUpdateIdentity( state, covariance, measurement, measurementCov, iBegin, iBegin + M );
+}
+
 }
 
 namespace Ubitrack { namespace Tracking {
@@ -119,8 +167,11 @@ void PoseKalmanFilter::addPoseMeasurement( const Measurement::ErrorPose& m )
 	if ( ublas::inner_prod( rotSubState, ublas::subrange( v.value, 3, 7 ) ) < 0 )
 		ublas::subrange( v.value, 3, 7 ) *= -1;
 	
-	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, PoseMeasurement( iR ), v.value, v.covariance, 0, iR + 4 );
+	// measurement update, the jacobian only selects position and orientation
+	const std::size_t r( iR );
+	const std::size_t indices[ 7 ] = { 0, 1, 2, r, r + 1, r + 2, r + 3 };
+	if ( !fixedSizeSelectionUpdate( m_state, m_covariance, v.value, v.covariance, indices ) )
+		Math::Stochastic::kalmanMeasurementUpdate( m_state, m_covariance, PoseMeasurement( iR ), v.value, v.covariance, 0, iR + 4 );
 
 	// normalize quaternion
 	normalize();
@@ -150,7 +201,7 @@ void PoseKalmanFilter::addRotationMeasurement( const Measurement::Rotation& m )
 		v.value *= -1;
 	
 	// measurement update:
-	Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iR, iR + 4 );
+	identityUpdate< 4 >( m_state, m_covariance, v.value, v.covariance, iR );
 
 	// normalize quaternion
 	normalize();
@@ -174,7 +225,7 @@ void PoseKalmanFilter::addRotationVelocityMeasurement( const Measurement::Rotati
 	
 	// measurement update:
 	int iV = 4 + 3 * ( m_motionModel.posOrder() + 1 ); // shortcut for first index of rotation velocity
-	Math::Stochastic::kalmanMeasurementUpdateIdentity( m_state, m_covariance, v.value, v.covariance, iV, iV + 3 );
+	identityUpdate< 3 >( m_state, m_covariance, v.value, v.covariance, iV );
 
 	// normalize quaternion
 	normalize();
@@ -239,8 +290,8 @@ void PoseKalmanFilter::normalize()
 	if ( m_motionModel.oriOrder() >= 0 )
 	{
 		// normalize quaternion
-		Math::Stochastic::transformRangeInternalWithCovariance( Math::Optimization::Function::VectorNormalize( 4 ), 
-			m_state, m_covariance, iR, iR + 4, iR, iR + 4 );
+		Math::Stochastic::transformRangeInternalWithCovariance< 4, 4 >( Math::Optimization::Function::VectorNormalize( 4 ), 
+			m_state, m_covariance, iR, iR );
 	}
 
 	if ( m_motionModel.oriOrder() >= 1 )
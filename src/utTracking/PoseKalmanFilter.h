@@ -134,6 +134,7 @@ public:
 	void timeUpdate( Measurement::Timestamp t );
 
 protected:
+	friend class PoseKalmanFilterBank;
 	
 	/** normalizes the state */
 	void normalize();
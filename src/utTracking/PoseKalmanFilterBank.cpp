@@ -0,0 +1,667 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+
+/**
+ * @ingroup tracking
+ * @file
+ * implementation of batched kalman filtering of many poses
+ *
+ * The structure-of-arrays kernels below mirror the operations of the scalar code path of
+ * \c PoseKalmanFilter (\c transformWithCovariance with \c PoseTimeUpdate,
+ * \c kalmanMeasurementUpdateSelection and \c transformRangeInternalWithCovariance with
+ * \c VectorNormalize) element by element and in the same order of summation. Only products
+ * with jacobian elements that are structurally zero are skipped, which does not change any
+ * result. Bodies that are not updated run through the same kernels with identity jacobians and
+ * zero gains, which leaves them unchanged.
+ */
+
+#include "PoseKalmanFilterBank.h"
+#ifdef HAVE_LAPACK
+
+#include <cmath>
+#include <algorithm>
+
+#include <utMath/Cholesky.h>
+#include <utMath/Optimization/Function/VectorNormalize.h>
+#include <utUtil/Exception.h>
+#include <utUtil/ThreadPool.h>
+#include <utMath/Stochastic/Kalman.h>
+#include "Function/PoseTimeUpdate.h"
+
+namespace ublas = boost::numeric::ublas;
+
+namespace Ubitrack { namespace Tracking {
+
+namespace {
+
+/** number of elements of a pose measurement */
+const std::size_t poseSize = 7;
+
+/** scalar measurement update of a single body, same as in \c PoseKalmanFilter */
+void scalarSelectionUpdate( PoseKalmanFilter::StateType& state, PoseKalmanFilter::CovarianceType& covariance,
+	const Math::Vector< double, 7 >& measurement, const Math::Matrix< double, 7, 7 >& measurementCov,
+	const std::size_t ( &indices )[ 7 ] )
+{
+	using namespace Math::Stochastic;
+	switch ( state.size() )
+	{
+	case 7:
+		kalmanMeasurementUpdateSelection< 7, 7 >( state, covariance, measurement, measurementCov, indices );
+		break;
+	case 10:
+		kalmanMeasurementUpdateSelection< 10, 7 >( state, covariance, measurement, measurementCov, indices );
+		break;
+	case 13:
+		kalmanMeasurementUpdateSelection< 13, 7 >( state, covariance, measurement, measurementCov, indices );
+		break;
+	case 16:
+		kalmanMeasurementUpdateSelection< 16, 7 >( state, covariance, measurement, measurementCov, indices );
+		break;
+	case 19:
+		kalmanMeasurementUpdateSelection< 19, 7 >( state, covariance, measurement, measurementCov, indices );
+		break;
+	}
+}
+
+} // anonymous namespace
+
+
+struct PoseKalmanFilterBank::Batch
+{
+	Batch( PoseKalmanFilterBank& bank, const std::vector< Measurement::ErrorPose >* pMeasurements, std::size_t nChunks )
+		: m_bank( bank )
+		, m_pMeasurements( pMeasurements )
+		, m_chunkSize( ( bank.size() + nChunks - 1 ) / nChunks )
+	{}
+
+	void operator()( std::size_t chunk )
+	{
+		const std::size_t b0 = chunk * m_chunkSize;
+		const std::size_t b1 = std::min( b0 + m_chunkSize, m_bank.size() );
+		if ( b0 >= b1 )
+			return;
+
+		if ( !m_pMeasurements )
+		{
+			m_bank.timeUpdate( b0, b1 );
+			return;
+		}
+
+		const std::vector< Measurement::ErrorPose >& m( *m_pMeasurements );
+		const std::size_t iR = m_bank.m_iR;
+
+		// on first update, set pose
+		for ( std::size_t b = b0; b < b1; b++ )
+		{
+			m_bank.m_bUpdate[ b ] = m[ b ].get() != 0;
+			m_bank.m_updateTime[ b ] = m_bank.m_bUpdate[ b ] ? m[ b ].time() : 0;
+			if ( m_bank.m_bUpdate[ b ] && m_bank.m_time[ b ] == 0 )
+			{
+				Math::Vector< double, 4 > q;
+				m[ b ]->rotation().toVector( q );
+				for ( std::size_t i = 0; i < 3; i++ )
+					m_bank.soa( m_bank.m_state, i )[ b ] = m[ b ]->translation()( i );
+				for ( std::size_t i = 0; i < 4; i++ )
+					m_bank.soa( m_bank.m_state, iR + i )[ b ] = q( i );
+			}
+		}
+
+		// time update: forward filters to requested timestamps
+		m_bank.timeUpdate( b0, b1 );
+
+		// create measurements as ErrorVector
+		for ( std::size_t b = b0; b < b1; b++ )
+		{
+			if ( !m_bank.m_bUpdate[ b ] )
+				continue;
+
+			Math::ErrorVector< double, 7 > v;
+			m[ b ]->toAdditiveErrorVector( v );
+
+			// negate quaternion
+			Math::Vector< double, 4 > rotSubState;
+			for ( std::size_t i = 0; i < 4; i++ )
+				rotSubState( i ) = m_bank.soa( m_bank.m_state, iR + i )[ b ];
+			if ( ublas::inner_prod( rotSubState, ublas::subrange( v.value, 3, 7 ) ) < 0 )
+				ublas::subrange( v.value, 3, 7 ) *= -1;
+
+			for ( std::size_t k = 0; k < poseSize; k++ )
+			{
+				m_bank.soa( m_bank.m_measurement, k )[ b ] = v.value( k );
+				for ( std::size_t l = 0; l < poseSize; l++ )
+					m_bank.soa( m_bank.m_measurementCov, k * poseSize + l )[ b ] = v.covariance( k, l );
+			}
+		}
+
+		// measurement update and quaternion normalization
+		m_bank.poseUpdate( b0, b1 );
+		m_bank.normalize( b0, b1 );
+	}
+
+	PoseKalmanFilterBank& m_bank;
+	const std::vector< Measurement::ErrorPose >* m_pMeasurements;
+	std::size_t m_chunkSize;
+};
+
+
+PoseKalmanFilterBank::PoseKalmanFilterBank( const LinearPoseMotionModel& motionModel, std::size_t nBodies )
+	: m_motionModel( motionModel )
+	, m_nBodies( nBodies )
+	, m_n( motionModel.stateSize() )
+	, m_iR( 3 * ( motionModel.posOrder() + 1 ) )
+	, m_pThreadPool( 0 )
+{
+	if ( m_motionModel.posOrder() < 0 || m_motionModel.posOrder() > 2 || m_motionModel.oriOrder() < 0 || m_motionModel.oriOrder() > 2 )
+		UBITRACK_THROW( "PoseKalmanFilterBank needs 0 <= posOrder <= 2 and 0 <= oriOrder <= 2" );
+
+	const std::size_t n = m_n;
+
+	// initialize states like PoseKalmanFilter
+	m_state.resize( n * nBodies, 0.0 );
+	m_covariance.resize( n * n * nBodies, 0.0 );
+	m_time.resize( nBodies, 0 );
+	for ( std::size_t b = 0; b < nBodies; b++ )
+	{
+		soa( m_state, m_iR + 3 )[ b ] = 1;
+		for ( std::size_t i = 0; i < n; i++ )
+			soa( m_covariance, i * n + i )[ b ] = 1;
+	}
+
+	// extract process noise
+	Math::Matrix< double > noise( Math::Matrix< double >::zeros( n, n ) );
+	m_motionModel.addNoise( noise, 1.0 );
+	for ( std::size_t i = 0; i < n; i++ )
+		m_processNoise.push_back( noise( i, i ) );
+
+	// find the structure of the time update jacobian using a generic state
+	Math::Vector< double > state( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		state( i ) = 0.5 + 0.1 * i;
+	Math::Vector< double > result( n );
+	Math::Matrix< double > jacobian( n, n );
+	Function::PoseTimeUpdate( 0.5, m_motionModel.posOrder(), m_motionModel.oriOrder() )
+		.evaluateWithJacobian( result, state, jacobian );
+	m_jacobianRows.resize( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t k = 0; k < n; k++ )
+			if ( i == k || jacobian( i, k ) != 0 )
+				m_jacobianRows[ i ].push_back( k );
+
+	// per-update data and scratch buffers
+	m_updateTime.resize( nBodies );
+	m_bUpdate.resize( nBodies );
+	m_bFallback.resize( nBodies );
+	m_dt.resize( nBodies );
+	m_measurement.resize( poseSize * nBodies );
+	m_measurementCov.resize( poseSize * poseSize * nBodies );
+	m_jacobian.resize( n * n * nBodies );
+	m_temp.resize( n * n * nBodies );
+	m_selected.resize( n * poseSize * nBodies );
+	m_gain.resize( poseSize * n * nBodies );
+	m_gainCov.resize( poseSize * n * nBodies );
+	m_innovationCov.resize( poseSize * poseSize * nBodies );
+	m_factor.resize( poseSize * poseSize * nBodies );
+	m_innovation.resize( poseSize * nBodies );
+	m_sum.resize( nBodies );
+	m_fallbackState.resize( nBodies );
+	m_fallbackCovariance.resize( nBodies );
+}
+
+
+void PoseKalmanFilterBank::addPoseMeasurements( const std::vector< Measurement::ErrorPose >& m )
+{
+	if ( m.size() != m_nBodies )
+		UBITRACK_THROW( "PoseKalmanFilterBank needs one measurement per body" );
+
+	Batch batch( *this, &m, m_pThreadPool ? 4 * m_pThreadPool->size() : 1 );
+	run( batch );
+}
+
+
+void PoseKalmanFilterBank::timeUpdate( const std::vector< Measurement::Timestamp >& t )
+{
+	if ( t.size() != m_nBodies )
+		UBITRACK_THROW( "PoseKalmanFilterBank needs one timestamp per body" );
+
+	m_updateTime = t;
+	Batch batch( *this, 0, m_pThreadPool ? 4 * m_pThreadPool->size() : 1 );
+	run( batch );
+}
+
+
+void PoseKalmanFilterBank::run( Batch& batch )
+{
+	const std::size_t nChunks = ( m_nBodies + batch.m_chunkSize - 1 ) / std::max< std::size_t >( batch.m_chunkSize, 1 );
+	if ( m_pThreadPool )
+		m_pThreadPool->parallelFor( nChunks, batch );
+	else
+		for ( std::size_t i = 0; i < nChunks; i++ )
+			batch( i );
+}
+
+
+void PoseKalmanFilterBank::timeUpdate( std::size_t b0, std::size_t b1 )
+{
+	const std::size_t n = m_n;
+	Math::Vector< double > in( n );
+	Math::Vector< double > out( n );
+	Math::Matrix< double > jacobian( n, n );
+
+	// new state and jacobian of the bodies, identity for those without update
+	for ( std::size_t b = b0; b < b1; b++ )
+	{
+		const Measurement::Timestamp t = m_updateTime[ b ];
+		const bool bActive = t != 0 && m_time[ b ] != 0 && m_time[ b ] != t;
+		if ( bActive )
+		{
+			const double dt = ( (long long int)( t - m_time[ b ] ) ) * 1e-9;
+			for ( std::size_t i = 0; i < n; i++ )
+				in( i ) = soa( m_state, i )[ b ];
+			Function::PoseTimeUpdate( dt, m_motionModel.posOrder(), m_motionModel.oriOrder() )
+				.evaluateWithJacobian( out, in, jacobian );
+			for ( std::size_t i = 0; i < n; i++ )
+				soa( m_state, i )[ b ] = out( i );
+			m_dt[ b ] = std::fabs( dt );
+		}
+		else
+		{
+			jacobian = Math::Matrix< double >::identity( n );
+			m_dt[ b ] = 0.0;
+		}
+
+		for ( std::size_t i = 0; i < n; i++ )
+			for ( std::vector< std::size_t >::const_iterator it = m_jacobianRows[ i ].begin(); it != m_jacobianRows[ i ].end(); ++it )
+				soa( m_jacobian, i * n + *it )[ b ] = jacobian( i, *it );
+
+		if ( t != 0 )
+			m_time[ b ] = t;
+	}
+
+	// temp = J * P
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = 0; j < n; j++ )
+		{
+			double* pT = soa( m_temp, i * n + j );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pT[ b ] = 0.0;
+
+			for ( std::vector< std::size_t >::const_iterator it = m_jacobianRows[ i ].begin(); it != m_jacobianRows[ i ].end(); ++it )
+			{
+				const double* pJ = soa( m_jacobian, i * n + *it );
+				const double* pP = soa( m_covariance, *it * n + j );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pT[ b ] += pJ[ b ] * pP[ b ];
+			}
+		}
+
+	// P = temp * J^T, lower triangle copied to the upper one like Math::Stochastic::transformCovariance
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = 0; j <= i; j++ )
+		{
+			double* pP = soa( m_covariance, i * n + j );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pP[ b ] = 0.0;
+
+			for ( std::vector< std::size_t >::const_iterator it = m_jacobianRows[ j ].begin(); it != m_jacobianRows[ j ].end(); ++it )
+			{
+				const double* pT = soa( m_temp, i * n + *it );
+				const double* pJ = soa( m_jacobian, j * n + *it );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pP[ b ] += pT[ b ] * pJ[ b ];
+			}
+
+			// bodies without update keep their upper triangle, it need not be exactly symmetric
+			if ( j < i )
+			{
+				double* pPT = soa( m_covariance, j * n + i );
+				for ( std::size_t b = b0; b < b1; b++ )
+					if ( m_dt[ b ] != 0.0 )
+						pPT[ b ] = pP[ b ];
+			}
+		}
+
+	// add process noise
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		double* pP = soa( m_covariance, i * n + i );
+		const double noise = m_processNoise[ i ];
+		for ( std::size_t b = b0; b < b1; b++ )
+			pP[ b ] += m_dt[ b ] * noise;
+	}
+}
+
+
+void PoseKalmanFilterBank::poseUpdate( std::size_t b0, std::size_t b1 )
+{
+	const std::size_t n = m_n;
+	const std::size_t m = poseSize;
+	const std::size_t indices[ 7 ] = { 0, 1, 2, m_iR, m_iR + 1, m_iR + 2, m_iR + 3 };
+	const char* bUpdate = &m_bUpdate[ 0 ];
+
+	// C = P * H^T, zero for bodies without update
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t k = 0; k < m; k++ )
+		{
+			const double* pP = soa( m_covariance, i * n + indices[ k ] );
+			double* pC = soa( m_selected, i * m + k );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pC[ b ] = bUpdate[ b ] ? pP[ b ] : 0.0;
+		}
+
+	// innovation
+	for ( std::size_t k = 0; k < m; k++ )
+	{
+		const double* pZ = soa( m_measurement, k );
+		const double* pX = soa( m_state, indices[ k ] );
+		double* pI = soa( m_innovation, k );
+		for ( std::size_t b = b0; b < b1; b++ )
+			pI[ b ] = bUpdate[ b ] ? pZ[ b ] - pX[ b ] : 0.0;
+	}
+
+	// S = H * P * H^T + R and its Cholesky factor, identity for bodies without update
+	Math::Matrix< double, 7, 7 > s;
+	Math::Matrix< double, 7, 7 > factor;
+	for ( std::size_t b = b0; b < b1; b++ )
+	{
+		m_bFallback[ b ] = false;
+		if ( bUpdate[ b ] )
+		{
+			for ( std::size_t k = 0; k < m; k++ )
+				for ( std::size_t l = 0; l < m; l++ )
+					s( k, l ) = soa( m_selected, indices[ k ] * m + l )[ b ] + soa( m_measurementCov, k * m + l )[ b ];
+
+			factor = s;
+			if ( !Math::cholesky_factor( factor ) )
+			{
+				// not positive definite, compute this body separately with the fallback of the scalar update
+				m_bFallback[ b ] = true;
+				getState( b, m_fallbackState[ b ] );
+				getCovariance( b, m_fallbackCovariance[ b ] );
+				Math::Vector< double, 7 > z;
+				Math::Matrix< double, 7, 7 > r;
+				for ( std::size_t k = 0; k < m; k++ )
+				{
+					z( k ) = soa( m_measurement, k )[ b ];
+					for ( std::size_t l = 0; l < m; l++ )
+						r( k, l ) = soa( m_measurementCov, k * m + l )[ b ];
+				}
+				scalarSelectionUpdate( m_fallbackState[ b ], m_fallbackCovariance[ b ], z, r, indices );
+				factor = Math::Matrix< double, 7, 7 >::identity();
+			}
+		}
+		else
+		{
+			s = Math::Matrix< double, 7, 7 >::identity();
+			factor = s;
+		}
+
+		for ( std::size_t k = 0; k < m; k++ )
+			for ( std::size_t l = 0; l < m; l++ )
+			{
+				soa( m_innovationCov, k * m + l )[ b ] = s( k, l );
+				soa( m_factor, k * m + l )[ b ] = factor( k, l );
+			}
+	}
+
+	// K^T = S^-1 * C^T, see Math::cholesky_solve_matrix
+	for ( std::size_t k = 0; k < m; k++ )
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			const double* pC = soa( m_selected, i * m + k );
+			double* pG = soa( m_gain, k * n + i );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pG[ b ] = pC[ b ];
+		}
+
+	for ( std::size_t c = 0; c < n; c++ )
+	{
+		for ( std::size_t i = 0; i < m; i++ )
+		{
+			double* pG = soa( m_gain, i * n + c );
+			for ( std::size_t k = 0; k < i; k++ )
+			{
+				const double* pL = soa( m_factor, i * m + k );
+				const double* pGk = soa( m_gain, k * n + c );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pG[ b ] -= pL[ b ] * pGk[ b ];
+			}
+			const double* pD = soa( m_factor, i * m + i );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pG[ b ] = pG[ b ] / pD[ b ];
+		}
+
+		for ( std::size_t i = m; i-- > 0; )
+		{
+			double* pG = soa( m_gain, i * n + c );
+			for ( std::size_t k = i + 1; k < m; k++ )
+			{
+				const double* pL = soa( m_factor, k * m + i );
+				const double* pGk = soa( m_gain, k * n + c );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pG[ b ] -= pL[ b ] * pGk[ b ];
+			}
+			const double* pD = soa( m_factor, i * m + i );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pG[ b ] = pG[ b ] / pD[ b ];
+		}
+	}
+
+	// update state
+	double* pSum = &m_sum[ 0 ];
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		for ( std::size_t b = b0; b < b1; b++ )
+			pSum[ b ] = 0.0;
+		for ( std::size_t k = 0; k < m; k++ )
+		{
+			const double* pG = soa( m_gain, k * n + i );
+			const double* pI = soa( m_innovation, k );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pSum[ b ] += pG[ b ] * pI[ b ];
+		}
+		double* pX = soa( m_state, i );
+		for ( std::size_t b = b0; b < b1; b++ )
+			pX[ b ] += pSum[ b ];
+	}
+
+	// S * K^T
+	for ( std::size_t k = 0; k < m; k++ )
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			double* pSG = soa( m_gainCov, k * n + i );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pSG[ b ] = 0.0;
+			for ( std::size_t l = 0; l < m; l++ )
+			{
+				const double* pS = soa( m_innovationCov, k * m + l );
+				const double* pG = soa( m_gain, l * n + i );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pSG[ b ] += pS[ b ] * pG[ b ];
+			}
+		}
+
+	// update covariance in Joseph form, see Math::Stochastic::detail::kalmanJosephUpdate
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = i; j < n; j++ )
+		{
+			for ( std::size_t b = b0; b < b1; b++ )
+				pSum[ b ] = 0.0;
+			for ( std::size_t k = 0; k < m; k++ )
+			{
+				const double* pGi = soa( m_gain, k * n + i );
+				const double* pGj = soa( m_gain, k * n + j );
+				const double* pSGj = soa( m_gainCov, k * n + j );
+				const double* pCi = soa( m_selected, i * m + k );
+				const double* pCj = soa( m_selected, j * m + k );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pSum[ b ] += pGi[ b ] * ( pSGj[ b ] - pCj[ b ] ) - pCi[ b ] * pGj[ b ];
+			}
+			double* pPij = soa( m_covariance, i * n + j );
+			double* pPji = soa( m_covariance, j * n + i );
+			// bodies without update keep their covariance untouched, it need not be exactly symmetric
+			for ( std::size_t b = b0; b < b1; b++ )
+			{
+				const double v = pPij[ b ] + pSum[ b ];
+				pPij[ b ] = bUpdate[ b ] ? v : pPij[ b ];
+				pPji[ b ] = bUpdate[ b ] ? v : pPji[ b ];
+			}
+		}
+
+	// bodies computed separately
+	for ( std::size_t b = b0; b < b1; b++ )
+		if ( m_bFallback[ b ] )
+			for ( std::size_t i = 0; i < n; i++ )
+			{
+				soa( m_state, i )[ b ] = m_fallbackState[ b ]( i );
+				for ( std::size_t j = 0; j < n; j++ )
+					soa( m_covariance, i * n + j )[ b ] = m_fallbackCovariance[ b ]( i, j );
+			}
+}
+
+
+void PoseKalmanFilterBank::normalize( std::size_t b0, std::size_t b1 )
+{
+	const std::size_t n = m_n;
+	const std::size_t iR = m_iR;
+	const Math::Optimization::Function::VectorNormalize normalize( 4 );
+	Math::Vector< double, 4 > q;
+	Math::Vector< double > result( 4 );
+	Math::Matrix< double > jacobian( 4, 4 );
+	const char* bUpdate = &m_bUpdate[ 0 ];
+
+	// normalized quaternion and jacobian, identity for bodies without update
+	for ( std::size_t b = b0; b < b1; b++ )
+	{
+		if ( bUpdate[ b ] )
+		{
+			for ( std::size_t i = 0; i < 4; i++ )
+				q( i ) = soa( m_state, iR + i )[ b ];
+			normalize.evaluateWithJacobian( result, q, jacobian );
+			for ( std::size_t i = 0; i < 4; i++ )
+				soa( m_state, iR + i )[ b ] = result( i );
+		}
+		else
+			jacobian = Math::Matrix< double >::identity( 4 );
+
+		for ( std::size_t i = 0; i < 4; i++ )
+			for ( std::size_t k = 0; k < 4; k++ )
+				soa( m_jacobian, i * 4 + k )[ b ] = jacobian( i, k );
+	}
+
+	// transform covariance in a block-matrix fashion, see Math::Stochastic::transformRangeInternalWithCovariance
+	for ( std::size_t a = 0; a < 4; a++ )
+		for ( std::size_t j = 0; j < n; j++ )
+		{
+			double* pT = soa( m_temp, a * n + j );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pT[ b ] = 0.0;
+			for ( std::size_t k = 0; k < 4; k++ )
+			{
+				const double* pJ = soa( m_jacobian, a * 4 + k );
+				const double* pP = soa( m_covariance, ( iR + k ) * n + j );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pT[ b ] += pJ[ b ] * pP[ b ];
+			}
+		}
+
+	for ( std::size_t a = 0; a < 4; a++ )
+	{
+		// the left/upper and right/lower row/column
+		for ( std::size_t j = 0; j < n; j++ )
+		{
+			if ( j >= iR && j < iR + 4 )
+				continue;
+
+			const double* pT = soa( m_temp, a * n + j );
+			double* pRow = soa( m_covariance, ( iR + a ) * n + j );
+			double* pCol = soa( m_covariance, j * n + iR + a );
+			for ( std::size_t b = b0; b < b1; b++ )
+			{
+				pRow[ b ] = pT[ b ];
+				pCol[ b ] = bUpdate[ b ] ? pT[ b ] : pCol[ b ];
+			}
+		}
+
+		// the diagonal part
+		for ( std::size_t c = 0; c < 4; c++ )
+		{
+			double* pP = soa( m_covariance, ( iR + a ) * n + iR + c );
+			for ( std::size_t b = b0; b < b1; b++ )
+				pP[ b ] = 0.0;
+			for ( std::size_t k = 0; k < 4; k++ )
+			{
+				const double* pT = soa( m_temp, a * n + iR + k );
+				const double* pJ = soa( m_jacobian, c * 4 + k );
+				for ( std::size_t b = b0; b < b1; b++ )
+					pP[ b ] += pT[ b ] * pJ[ b ];
+			}
+		}
+	}
+
+	// check if rotation velocity is too big and reset it in this case
+	if ( m_motionModel.oriOrder() >= 1 )
+		for ( std::size_t b = b0; b < b1; b++ )
+		{
+			if ( !bUpdate[ b ] )
+				continue;
+
+			Math::Vector< double, 3 > v;
+			for ( std::size_t i = 0; i < 3; i++ )
+				v( i ) = soa( m_state, iR + 4 + i )[ b ];
+			if ( ublas::norm_2( v ) > 10.0 )
+				for ( std::size_t i = iR + 4; i < n; i++ )
+					soa( m_state, i )[ b ] = 0.0;
+		}
+}
+
+
+void PoseKalmanFilterBank::getState( std::size_t body, PoseKalmanFilter::StateType& state ) const
+{
+	state.resize( m_n );
+	for ( std::size_t i = 0; i < m_n; i++ )
+		state( i ) = soa( m_state, i )[ body ];
+}
+
+
+void PoseKalmanFilterBank::getCovariance( std::size_t body, PoseKalmanFilter::CovarianceType& covariance ) const
+{
+	covariance.resize( m_n, m_n );
+	for ( std::size_t i = 0; i < m_n; i++ )
+		for ( std::size_t j = 0; j < m_n; j++ )
+			covariance( i, j ) = soa( m_covariance, i * m_n + j )[ body ];
+}
+
+
+PoseKalmanFilter PoseKalmanFilterBank::filter( std::size_t body ) const
+{
+	PoseKalmanFilter f( m_motionModel );
+	getState( body, f.m_state );
+	getCovariance( body, f.m_covariance );
+	f.m_time = m_time[ body ];
+	return f;
+}
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
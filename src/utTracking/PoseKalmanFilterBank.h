@@ -0,0 +1,208 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @ingroup tracking
+ * @file
+ * Batched kalman filtering of many independent poses
+ */
+
+#ifndef __UBITRACK_TRACKING_POSEKALMANFILTERBANK_H_INCLUDED__
+#define __UBITRACK_TRACKING_POSEKALMANFILTERBANK_H_INCLUDED__
+
+
+#ifdef HAVE_LAPACK
+
+#include <vector>
+
+#include <utCore.h>
+#include <utMeasurement/Measurement.h>
+#include "LinearPoseMotionModel.h"
+#include "PoseKalmanFilter.h"
+
+namespace Ubitrack { namespace Util {
+	class ThreadPool;
+} } // namespace Ubitrack::Util
+
+namespace Ubitrack { namespace Tracking {
+
+/**
+ * A set of independent \c PoseKalmanFilter instances with the same motion model, e.g. one per
+ * tracked rigid body, that are updated together.
+ *
+ * States and covariances of all bodies are stored in structure-of-arrays layout, i.e. element
+ * ( i, j ) of all covariance matrices is contiguous in memory. The time update and the
+ * measurement update process all bodies of a batch in loops over the bodies, which the
+ * compiler vectorizes. Batches can additionally be split across the threads of a
+ * \c Util::ThreadPool.
+ *
+ * Every body is processed with exactly the same sequence of floating point operations as a
+ * \c PoseKalmanFilter with the same motion model (outside-in), so the results are bit-identical
+ * to those of the scalar filter as long as the compiler does not contract multiplications and
+ * additions differently in vectorized and scalar code (no FMA code generation).
+ *
+ * Only position and orientation with up to two derivatives each are supported
+ * (7 to 19 states).
+ */
+class UBITRACK_EXPORT PoseKalmanFilterBank
+{
+public:
+	/**
+	 * Constructor.
+	 * @param motionModel motion model used for all bodies
+	 * @param nBodies number of filters in the bank
+	 */
+	PoseKalmanFilterBank( const LinearPoseMotionModel& motionModel, std::size_t nBodies );
+
+	/** number of filters in the bank */
+	std::size_t size() const
+	{ return m_nBodies; }
+
+	/**
+	 * Distributes the work of following updates over the threads of a pool.
+	 * @param pPool thread pool to use, 0 processes all bodies in the calling thread
+	 */
+	void setThreadPool( Util::ThreadPool* pPool )
+	{ m_pThreadPool = pPool; }
+
+	/**
+	 * integrates one absolute pose measurement per body.
+	 * Equivalent to calling \c PoseKalmanFilter::addPoseMeasurement for every body.
+	 * @param m one measurement for every body. Bodies with an empty measurement (no payload) are not changed.
+	 */
+	void addPoseMeasurements( const std::vector< Measurement::ErrorPose >& m );
+
+	/**
+	 * Performs a time update of the bodies.
+	 * Equivalent to calling \c PoseKalmanFilter::timeUpdate for every body.
+	 * @param t one timestamp for every body, bodies with timestamp 0 are not changed
+	 */
+	void timeUpdate( const std::vector< Measurement::Timestamp >& t );
+
+	/** timestamp of the current state of a body */
+	Measurement::Timestamp time( std::size_t body ) const
+	{ return m_time[ body ]; }
+
+	/** returns the state of a body */
+	void getState( std::size_t body, PoseKalmanFilter::StateType& state ) const;
+
+	/** returns the covariance of a body */
+	void getCovariance( std::size_t body, PoseKalmanFilter::CovarianceType& covariance ) const;
+
+	/**
+	 * returns a copy of the filter of one body, e.g. to predict its pose with
+	 * \c PoseKalmanFilter::predictPose or to continue filtering it separately.
+	 */
+	PoseKalmanFilter filter( std::size_t body ) const;
+
+	/** returns the motion model */
+	const LinearPoseMotionModel& getMotionModel() const
+	{ return m_motionModel; }
+
+protected:
+	/** @internal processes the bodies [ b0, b1 ) of a batch */
+	struct Batch;
+
+	/** @internal time update of the bodies [ b0, b1 ) to the timestamps in \c m_updateTime */
+	void timeUpdate( std::size_t b0, std::size_t b1 );
+
+	/** @internal pose measurement update of the bodies [ b0, b1 ), measurements converted to \c m_measurement */
+	void poseUpdate( std::size_t b0, std::size_t b1 );
+
+	/** @internal quaternion normalization of the bodies [ b0, b1 ) */
+	void normalize( std::size_t b0, std::size_t b1 );
+
+	/** @internal runs a batch over all bodies, possibly in parallel */
+	void run( Batch& batch );
+
+	/** @internal element e of a structure-of-arrays buffer */
+	double* soa( std::vector< double >& buffer, std::size_t e )
+	{ return &buffer[ e * m_nBodies ]; }
+
+	/** @internal element e of a structure-of-arrays buffer */
+	const double* soa( const std::vector< double >& buffer, std::size_t e ) const
+	{ return &buffer[ e * m_nBodies ]; }
+
+	/** the motion model */
+	LinearPoseMotionModel m_motionModel;
+
+	/** number of bodies */
+	std::size_t m_nBodies;
+
+	/** size of the state vector */
+	std::size_t m_n;
+
+	/** first index of orientation */
+	std::size_t m_iR;
+
+	/** states, element i of body b at [ i * nBodies + b ] */
+	std::vector< double > m_state;
+
+	/** covariances, element ( i, j ) of body b at [ ( i * n + j ) * nBodies + b ] */
+	std::vector< double > m_covariance;
+
+	/** timestamps of the current states */
+	std::vector< Measurement::Timestamp > m_time;
+
+	/** diagonal process noise per second */
+	std::vector< double > m_processNoise;
+
+	/** column indices of the structurally non-zero jacobian elements of the time update per row */
+	std::vector< std::vector< std::size_t > > m_jacobianRows;
+
+	/** optional thread pool */
+	Util::ThreadPool* m_pThreadPool;
+
+	/** @name per-update data of all bodies */
+	//@{
+	std::vector< Measurement::Timestamp > m_updateTime;
+	std::vector< char > m_bUpdate;
+	std::vector< char > m_bFallback;
+	std::vector< double > m_dt;
+	std::vector< double > m_measurement;
+	std::vector< double > m_measurementCov;
+	//@}
+
+	/** @name structure-of-arrays scratch buffers */
+	//@{
+	std::vector< double > m_jacobian;
+	std::vector< double > m_temp;
+	std::vector< double > m_selected;
+	std::vector< double > m_gain;
+	std::vector< double > m_gainCov;
+	std::vector< double > m_innovationCov;
+	std::vector< double > m_factor;
+	std::vector< double > m_innovation;
+	std::vector< double > m_sum;
+	//@}
+
+	/** results of bodies that needed the scalar fallback of the measurement update */
+	std::vector< PoseKalmanFilter::StateType > m_fallbackState;
+	std::vector< PoseKalmanFilter::CovarianceType > m_fallbackCovariance;
+};
+
+} } // namespace Ubitrack::Tracking
+
+#endif // HAVE_LAPACK
+
+#endif // __UBITRACK_TRACKING_POSEKALMANFILTERBANK_H_INCLUDED__
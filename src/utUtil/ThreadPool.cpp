@@ -0,0 +1,181 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * Implementation of a simple pool of worker threads
+ */
+
+#include "ThreadPool.h"
+#include "Exception.h"
+
+#include <exception>
+#include <boost/bind.hpp>
+
+namespace Ubitrack { namespace Util {
+
+
+ThreadPool::ThreadPool( std::size_t nThreads )
+	: m_pTask( 0 )
+	, m_nTasks( 0 )
+	, m_nextTask( 0 )
+	, m_nFinished( 0 )
+	, m_bStop( false )
+	, m_bError( false )
+{
+	if ( nThreads == 0 )
+		nThreads = boost::thread::hardware_concurrency();
+
+	// the calling thread is the first one
+	for ( std::size_t i = 1; i < nThreads; i++ )
+		m_workers.push_back( new boost::thread( boost::bind( &ThreadPool::workerLoop, this ) ) );
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		boost::lock_guard< boost::mutex > lock( m_mutex );
+		m_bStop = true;
+	}
+	m_workAvailable.notify_all();
+
+	for ( std::size_t i = 0; i < m_workers.size(); i++ )
+	{
+		m_workers[ i ]->join();
+		delete m_workers[ i ];
+	}
+}
+
+
+ThreadPool& ThreadPool::global()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+
+void ThreadPool::run( std::size_t nTasks, Task& task )
+{
+	if ( nTasks == 0 )
+		return;
+
+	bool bSequential = m_workers.empty() || nTasks == 1 || isWorker();
+	if ( !bSequential )
+	{
+		boost::lock_guard< boost::mutex > lock( m_mutex );
+		bSequential = m_pTask != 0 && m_runningThread == boost::this_thread::get_id();
+	}
+
+	if ( bSequential )
+	{
+		for ( std::size_t i = 0; i < nTasks; i++ )
+			task( i );
+		return;
+	}
+
+	boost::lock_guard< boost::mutex > runLock( m_runMutex );
+	boost::unique_lock< boost::mutex > lock( m_mutex );
+	m_pTask = &task;
+	m_nTasks = nTasks;
+	m_nextTask = 0;
+	m_nFinished = 0;
+	m_runningThread = boost::this_thread::get_id();
+	m_bError = false;
+	m_sError.clear();
+	m_workAvailable.notify_all();
+
+	work( lock );
+	while ( m_nFinished < m_nTasks )
+		m_workDone.wait( lock );
+
+	m_pTask = 0;
+	m_runningThread = boost::thread::id();
+	if ( m_bError )
+		UBITRACK_THROW( "Exception in parallel loop: " + m_sError );
+}
+
+
+void ThreadPool::workerLoop()
+{
+	boost::unique_lock< boost::mutex > lock( m_mutex );
+	while ( true )
+	{
+		while ( !m_bStop && !( m_pTask && m_nextTask < m_nTasks ) )
+			m_workAvailable.wait( lock );
+
+		if ( m_bStop )
+			return;
+
+		work( lock );
+	}
+}
+
+
+void ThreadPool::work( boost::unique_lock< boost::mutex >& lock )
+{
+	while ( m_pTask && m_nextTask < m_nTasks )
+	{
+		const std::size_t i = m_nextTask++;
+		Task* pTask = m_pTask;
+		lock.unlock();
+
+		bool bError = false;
+		std::string sError;
+		try
+		{
+			( *pTask )( i );
+		}
+		catch ( const std::exception& e )
+		{
+			bError = true;
+			sError = e.what();
+		}
+		catch ( ... )
+		{
+			bError = true;
+			sError = "unknown exception";
+		}
+
+		lock.lock();
+		if ( bError && !m_bError )
+		{
+			m_bError = true;
+			m_sError = sError;
+		}
+		if ( ++m_nFinished == m_nTasks )
+			m_workDone.notify_all();
+	}
+}
+
+
+bool ThreadPool::isWorker() const
+{
+	const boost::thread::id self = boost::this_thread::get_id();
+	for ( std::size_t i = 0; i < m_workers.size(); i++ )
+		if ( m_workers[ i ]->get_id() == self )
+			return true;
+	return false;
+}
+
+} } // namespace Ubitrack::Util
@@ -0,0 +1,150 @@
+/*
+ * Ubitrack - Library for Ubiquitous Tracking
+ * Copyright 2006, Technische Universitaet Muenchen, and individual
+ * contributors as indicated by the @authors tag. See the
+ * copyright.txt in the distribution for a full listing of individual
+ * contributors.
+ *
+ * This is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this software; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA, or see the FSF site: http://www.fsf.org.
+ */
+
+/**
+ * @file
+ * A simple pool of worker threads for data parallel loops
+ */
+
+#ifndef __UBITRACK_UTIL_THREADPOOL_H_INCLUDED__
+#define __UBITRACK_UTIL_THREADPOOL_H_INCLUDED__
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <utCore.h>
+
+namespace Ubitrack { namespace Util {
+
+/**
+ * A fixed set of worker threads that execute the iterations of a loop in parallel.
+ *
+ * \c parallelFor( n, f ) calls \c f( i ) for all i in [0, n) and returns when all calls are
+ * finished. The calling thread takes part in the work, so a pool of size 1 does not start
+ * any thread at all and simply runs the loop.
+ *
+ * Loops are executed one after another: concurrent calls from different threads are
+ * serialized, and calls from within a running loop (nested parallelism) are executed
+ * sequentially by the calling worker.
+ *
+ * If an iteration throws, the remaining iterations are still executed and the first
+ * exception is rethrown as a \c Util::Exception by \c parallelFor.
+ */
+class UBITRACK_EXPORT ThreadPool
+	: private boost::noncopyable
+{
+public:
+	/**
+	 * Starts the worker threads.
+	 * @param nThreads degree of parallelism including the calling thread, 0 uses the number of hardware threads
+	 */
+	explicit ThreadPool( std::size_t nThreads = 0 );
+
+	/** stops and joins all worker threads */
+	~ThreadPool();
+
+	/** degree of parallelism including the calling thread */
+	std::size_t size() const
+	{ return m_workers.size() + 1; }
+
+	/**
+	 * Calls \c f( i ) for all i in [0, nTasks), distributed over the threads of the pool.
+	 * @param nTasks number of iterations
+	 * @param f function object with \c operator()( std::size_t )
+	 */
+	template< class F >
+	void parallelFor( std::size_t nTasks, F& f )
+	{
+		TaskAdaptor< F > task( f );
+		run( nTasks, task );
+	}
+
+	/** a process-wide pool using all hardware threads, created on first use */
+	static ThreadPool& global();
+
+protected:
+	/** @internal type erasure for the loop body */
+	struct Task
+	{
+		virtual ~Task()
+		{}
+
+		virtual void operator()( std::size_t i ) = 0;
+	};
+
+	/** @internal calls a function object */
+	template< class F >
+	struct TaskAdaptor
+		: public Task
+	{
+		TaskAdaptor( F& f )
+			: m_f( f )
+		{}
+
+		void operator()( std::size_t i )
+		{ m_f( i ); }
+
+		F& m_f;
+	};
+
+	/** executes a loop */
+	void run( std::size_t nTasks, Task& task );
+
+	/** main loop of the worker threads */
+	void workerLoop();
+
+	/** executes iterations of the current loop until none are left */
+	void work( boost::unique_lock< boost::mutex >& lock );
+
+	/** is the calling thread a worker of this pool? */
+	bool isWorker() const;
+
+	std::vector< boost::thread* > m_workers;
+
+	/** serializes concurrent calls to \c run */
+	boost::mutex m_runMutex;
+
+	/** protects the state of the current loop */
+	boost::mutex m_mutex;
+	boost::condition_variable m_workAvailable;
+	boost::condition_variable m_workDone;
+
+	Task* m_pTask;
+	std::size_t m_nTasks;
+	std::size_t m_nextTask;
+	std::size_t m_nFinished;
+	boost::thread::id m_runningThread;
+	bool m_bStop;
+
+	bool m_bError;
+	std::string m_sError;
+};
+
+} } // namespace Ubitrack::Util
+
+#endif // __UBITRACK_UTIL_THREADPOOL_H_INCLUDED__
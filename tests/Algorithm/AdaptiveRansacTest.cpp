@@ -0,0 +1,230 @@
+#include <utMath/Pose.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Geometry/PointTransformation.h>
+#include <utMath/Optimization/AdaptiveRansac.h>
+#include <utAlgorithm/PoseEstimation3D3D/Ransac.h>
+#include <utAlgorithm/ToolTip/Ransac.h>
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include "../tools.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include <utUtil/Exception.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.AdaptiveRansac" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** corresponding point sets, the first nInlier are related by the pose, the rest are outliers */
+template< typename T >
+void createCorrespondences( const std::size_t n, const std::size_t nInlier, const Pose& pose,
+	std::vector< Vector< T, 3 > >& leftFrame, std::vector< Vector< T, 3 > >& rightFrame )
+{
+	typename Random::Vector< T, 3 >::Uniform randVector( -100, 100 );
+	rightFrame.clear();
+	std::generate_n( std::back_inserter( rightFrame ), n, randVector );
+
+	leftFrame.clear();
+	for ( std::size_t i = 0; i < n; i++ )
+		leftFrame.push_back( i < nInlier ? Vector< T, 3 >( pose * Vector< double, 3 >( rightFrame[ i ] ) ) : randVector() );
+}
+
+template< typename T >
+void testAdaptiveRansacAbsoluteOrientation( const std::size_t nRuns, const T epsilon )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randTrans( -100, 100 );
+	Ubitrack::Util::ThreadPool pool( 4 );
+
+	for ( std::size_t iRun = 0; iRun < nRuns; iRun++ )
+	{
+		const std::size_t n = 20 + iRun % 200;
+		const std::size_t nInlier = n - ( 4 * n ) / 10;
+		const Pose pose( randQuat(), randTrans() );
+		std::vector< Vector< T, 3 > > leftFrame;
+		std::vector< Vector< T, 3 > > rightFrame;
+		createCorrespondences( n, nInlier, pose, leftFrame, rightFrame );
+
+		// 50% expected outliers, up to 1000 iterations, but terminates much earlier
+		const Optimization::RansacParameter< T > params( T( 0.05 ), 3, n / 2, std::size_t( 1000 ) );
+		Optimization::RansacOptions options;
+		options.seed = iRun;
+		options.nWorkers = 4;
+
+		Pose estimated;
+		std::vector< std::size_t > inliers;
+		const std::size_t nFound = Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options, &inliers );
+
+		BOOST_CHECK_EQUAL( nFound, nInlier );
+		BOOST_CHECK_EQUAL( inliers.size(), nFound );
+		BOOST_CHECK_MESSAGE( quaternionDiff( estimated.rotation(), pose.rotation() ) < epsilon, "rotation " << estimated.rotation() << " vs. " << pose.rotation() );
+		BOOST_CHECK_MESSAGE( vectorDiff( estimated.translation(), pose.translation() ) < epsilon * 100, "translation " << estimated.translation() << " vs. " << pose.translation() );
+
+		// the same seed and number of workers gives the same result on a thread pool
+		options.pThreadPool = &pool;
+		Pose estimatedParallel;
+		std::vector< std::size_t > inliersParallel;
+		Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimatedParallel, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options, &inliersParallel );
+		BOOST_CHECK( inliersParallel == inliers );
+
+		// preemptive T(1,1) test
+		options.nPreemptiveTests = 1;
+		const std::size_t nFoundPreemptive = Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options );
+		BOOST_CHECK_EQUAL( nFoundPreemptive, nInlier );
+	}
+
+	// zero hypotheses per round are treated as one
+	std::vector< Vector< T, 3 > > leftFrame;
+	std::vector< Vector< T, 3 > > rightFrame;
+	createCorrespondences( 50, 30, Pose( randQuat(), randTrans() ), leftFrame, rightFrame );
+	Optimization::RansacOptions options;
+	options.nWorkers = 2;
+	options.nHypothesesPerRound = 1;
+	const Optimization::RansacParameter< T > roundParams( T( 0.05 ), 3, 25, std::size_t( 200 ) );
+	Pose estimated;
+	std::vector< std::size_t > inliers;
+	const std::size_t nFound = Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+		estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), roundParams, options, &inliers );
+	BOOST_CHECK_EQUAL( nFound, std::size_t( 30 ) );
+
+	options.nHypothesesPerRound = 0;
+	std::vector< std::size_t > inliersZero;
+	BOOST_CHECK_EQUAL( Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+		estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), roundParams, options, &inliersZero ), nFound );
+	BOOST_CHECK( inliersZero == inliers );
+
+	// not enough inliers
+	createCorrespondences( 50, 10, Pose( randQuat(), randTrans() ), leftFrame, rightFrame );
+	const Optimization::RansacParameter< T > params( T( 0.05 ), 3, 25, std::size_t( 200 ) );
+	BOOST_CHECK_EQUAL( Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+		estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params ), std::size_t( 0 ) );
+}
+
+template< typename T >
+void testAdaptiveRansacTipCalibration( const std::size_t nRuns, const T epsilon )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randVector( -0.5, 0.5 );
+
+	for ( std::size_t iRun = 0; iRun < nRuns; iRun++ )
+	{
+		// poses of a tracked pointer rotating around its tip, 30% outliers
+		const Vector< T, 3 > pw( randVector() );
+		const Vector< T, 3 > pm( randVector() );
+		const std::size_t n = 50;
+		std::vector< Pose > poses;
+		for ( std::size_t i = 0; i < n; i++ )
+		{
+			const Quaternion q( randQuat() );
+			const Vector< double, 3 > tip( i % 10 < 3 ? Vector< double, 3 >( randVector() ) : Vector< double, 3 >( pw ) );
+			poses.push_back( Pose( q, tip - q * Vector< double, 3 >( pm ) ) );
+		}
+
+		const Optimization::RansacParameter< T > params( T( 0.01 ), 3, n / 2, std::size_t( 500 ) );
+		Optimization::RansacOptions options;
+		options.seed = iRun;
+		Vector< T, 6 > result;
+		const std::size_t nFound = Optimization::adaptiveRansac( poses.begin(), poses.end(), result, Algorithm::ToolTip::Ransac< T >(), params, options );
+
+		BOOST_CHECK_EQUAL( nFound, ( 7 * n ) / 10 );
+		BOOST_CHECK_SMALL( vectorDiff( Vector< T, 3 >( result( 0 ), result( 1 ), result( 2 ) ), pw ), epsilon );
+		BOOST_CHECK_SMALL( vectorDiff( Vector< T, 3 >( result( 3 ), result( 4 ), result( 5 ) ), pm ), epsilon );
+	}
+}
+
+template< typename T >
+void benchmarkAdaptiveRansac( const std::size_t n, const T outlierRatio, const std::size_t nRuns )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randTrans( -100, 100 );
+	const std::size_t nInlier = n - static_cast< std::size_t >( outlierRatio * n );
+	std::vector< Vector< T, 3 > > leftFrame;
+	std::vector< Vector< T, 3 > > rightFrame;
+	createCorrespondences( n, nInlier, Pose( randQuat(), randTrans() ), leftFrame, rightFrame );
+
+	// the original ransac stops at nMinInlier, require all inliers to find the best hypothesis
+	const Optimization::RansacParameter< T > params( T( 0.05 ), 3, nInlier, std::size_t( 2000 ) );
+	Pose estimated;
+
+	std::ostringstream name;
+	name << "ransac, " << n << " values, " << outlierRatio * 100 << "% outliers";
+	Ubitrack::Util::BlockTimer timer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( timer );
+		Optimization::ransac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params );
+	}
+
+	Optimization::RansacOptions options;
+	name.str( "" );
+	name << "adaptive ransac, " << n << " values, " << outlierRatio * 100 << "% outliers";
+	Ubitrack::Util::BlockTimer adaptiveTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( adaptiveTimer );
+		Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options );
+	}
+
+	options.nPreemptiveTests = 1;
+	name.str( "" );
+	name << "adaptive ransac T(1,1), " << n << " values, " << outlierRatio * 100 << "% outliers";
+	Ubitrack::Util::BlockTimer preemptiveTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( preemptiveTimer );
+		Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options );
+	}
+
+	options.nWorkers = Ubitrack::Util::ThreadPool::global().size();
+	options.pThreadPool = &Ubitrack::Util::ThreadPool::global();
+	name.str( "" );
+	name << "adaptive ransac T(1,1), " << options.nWorkers << " threads, " << n << " values, " << outlierRatio * 100 << "% outliers";
+	Ubitrack::Util::BlockTimer parallelTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( parallelTimer );
+		Optimization::adaptiveRansac( leftFrame.begin(), leftFrame.end(), rightFrame.begin(), rightFrame.end(),
+			estimated, Algorithm::PoseEstimation3D3D::Ransac< T >(), params, options );
+	}
+}
+
+} // anonymous namespace
+
+#ifndef HAVE_LAPACK
+void TestAdaptiveRansac()
+{
+	// Absolute Orientation and tip calibration do not work without lapack
+}
+
+#else // HAVE_LAPACK
+
+void TestAdaptiveRansac()
+{
+	testAdaptiveRansacAbsoluteOrientation< double >( 100, 1e-6 );
+	testAdaptiveRansacAbsoluteOrientation< float >( 20, 1e-2f );
+	testAdaptiveRansacTipCalibration< double >( 50, 1e-6 );
+
+	benchmarkAdaptiveRansac< double >( 100, 0.3, 100 );
+	benchmarkAdaptiveRansac< double >( 1000, 0.5, 20 );
+}
+
+#endif // HAVE_LAPACK
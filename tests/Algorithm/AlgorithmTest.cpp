@@ -9,6 +9,7 @@ void TestAbsOrientScale();
 void TestAbsOrientRotation3D();
 void TestAbsoluteOrientation();
 void TestRobustAbsoluteOrientation();
+void TestAdaptiveRansac();
 void TestOptimizedAbsoluteOrientation();
 void TestCovarianceAbsoluteOrientation();
 
@@ -16,6 +17,8 @@ void TestCovarianceAbsoluteOrientation();
 void Test2D3DPoseEstimation();
 void Test3DPointReconstruction();
 void TestBundleAdjustment();
+void TestSparseBundleAdjustment();
+void TestUndistortionMap();
 void TestDecomposeProjection();
 void TestFundamentalMatrix();
 void TestHomography();
@@ -24,6 +27,10 @@ void TestCorrelation();
 void TestTsaiLenzHandEye();
 void TestDualHandEye();
 void TestHandEyeDataSelection();
+void TestStreamingDLT();
+void TestEpipolarGrid();
+void TestTriangulatePoints();
+void TestMultipleCameraPose();
 
 AlgorithmTest::AlgorithmTest()
 	: boost::unit_test::test_suite( "AlgorithmTests" )
@@ -35,17 +42,24 @@ AlgorithmTest::AlgorithmTest()
 	add( BOOST_TEST_CASE( &TestAbsOrientRotation3D ) );
 	add( BOOST_TEST_CASE( &TestAbsoluteOrientation ) );
 	add( BOOST_TEST_CASE( &TestRobustAbsoluteOrientation ) );
+	add( BOOST_TEST_CASE( &TestAdaptiveRansac ) );
 	add( BOOST_TEST_CASE( &TestOptimizedAbsoluteOrientation ) );
 	add( BOOST_TEST_CASE( &TestCovarianceAbsoluteOrientation ) );
 	
 	// old tests...
 	add( BOOST_TEST_CASE( &Test2D3DPoseEstimation ) );
 	add( BOOST_TEST_CASE( &Test3DPointReconstruction ) );
+	add( BOOST_TEST_CASE( &TestEpipolarGrid ) );
+	add( BOOST_TEST_CASE( &TestTriangulatePoints ) );
+	add( BOOST_TEST_CASE( &TestMultipleCameraPose ) );
 	add( BOOST_TEST_CASE( &TestBundleAdjustment ) );
+	add( BOOST_TEST_CASE( &TestSparseBundleAdjustment ) );
+	add( BOOST_TEST_CASE( &TestUndistortionMap ) );
 	add( BOOST_TEST_CASE( &TestDecomposeProjection ) );
 	add( BOOST_TEST_CASE( &TestFundamentalMatrix ) );
 	add( BOOST_TEST_CASE( &TestHomography ) );
 	add( BOOST_TEST_CASE( &TestProjectionDLT ) );
+	add( BOOST_TEST_CASE( &TestStreamingDLT ) );
 	add( BOOST_TEST_CASE( &TestTsaiLenzHandEye ) );
 	add( BOOST_TEST_CASE( &TestDualHandEye ) );
 	add( BOOST_TEST_CASE( &TestHandEyeDataSelection ) );
@@ -0,0 +1,171 @@
+
+#include <utAlgorithm/EpipolarGrid.h>
+#include <utAlgorithm/3DPointReconstruction.h>
+#include <utAlgorithm/FundamentalMatrix.h>
+#include <utMath/Geometry/PointProjection.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMeasurement/Clock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+#ifndef M_PI
+#define _USE_MATH_DEFINES //for having PI
+#include <math.h>
+#endif
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.EpipolarGrid" ) );
+
+using namespace Ubitrack;
+
+namespace {
+
+/** compares the candidates of random lines to an exhaustive search */
+template< typename T >
+void testCandidates( const std::vector< Math::Vector< T, 2 > >& points, const T maxDistance )
+{
+	const Algorithm::EpipolarGrid< T > grid( points, maxDistance );
+	std::vector< std::size_t > result;
+
+	for ( std::size_t iLine = 0; iLine < 50; iLine++ )
+	{
+		// random direction through a random point, including axis-parallel lines
+		const T angle = iLine < 4 ? iLine * T( M_PI / 4 ) : Math::Random::distribute_uniform< T >( 0, T( M_PI ) );
+		const T x = Math::Random::distribute_uniform< T >( 0, 640 );
+		const T y = Math::Random::distribute_uniform< T >( 0, 480 );
+		const T scale = Math::Random::distribute_uniform< T >( T( 0.01 ), 100 );
+		const Math::Vector< T, 3 > line( scale * std::sin( angle ), -scale * std::cos( angle ),
+			scale * ( y * std::cos( angle ) - x * std::sin( angle ) ) );
+
+		std::vector< std::size_t > expected;
+		for ( std::size_t i = 0; i < points.size(); i++ )
+		{
+			const T d = line( 0 ) * points[ i ]( 0 ) + line( 1 ) * points[ i ]( 1 ) + line( 2 );
+			if ( d * d <= maxDistance * maxDistance * ( line( 0 ) * line( 0 ) + line( 1 ) * line( 1 ) ) )
+				expected.push_back( i );
+		}
+
+		grid.candidates( line, result );
+		std::sort( result.begin(), result.end() );
+		BOOST_CHECK( result == expected );
+	}
+
+	// degenerate line
+	grid.candidates( Math::Vector< T, 3 >( 0, 0, 1 ), result );
+	BOOST_CHECK( result.empty() );
+}
+
+template< typename T >
+void testGrid()
+{
+	typename Math::Random::Vector< T, 2 >::Uniform randPoint( 0, 480 );
+	const std::size_t sizes[] = { 1, 10, 200, 2000 };
+	for ( std::size_t iSize = 0; iSize < 4; iSize++ )
+	{
+		std::vector< Math::Vector< T, 2 > > points;
+		std::generate_n( std::back_inserter( points ), sizes[ iSize ], randPoint );
+		testCandidates( points, T( 2 ) );
+		testCandidates( points, T( 50 ) );
+	}
+
+	// all points on a horizontal line, and all points equal
+	std::vector< Math::Vector< T, 2 > > points;
+	for ( std::size_t i = 0; i < 100; i++ )
+		points.push_back( Math::Vector< T, 2 >( T( 3 * i ), 100 ) );
+	testCandidates( points, T( 2 ) );
+	points.assign( 20, Math::Vector< T, 2 >( 5, 5 ) );
+	testCandidates( points, T( 0 ) );
+
+	// no points
+	const Algorithm::EpipolarGrid< T > empty( std::vector< Math::Vector< T, 2 > >(), T( 1 ) );
+	std::vector< std::size_t > result( 1 );
+	empty.candidates( Math::Vector< T, 3 >( 1, 0, 0 ), result );
+	BOOST_CHECK( result.empty() );
+}
+
+#ifdef HAVE_LAPACK
+
+/** two cameras observing the same marker cloud, the points of the second image are shuffled */
+void stereoMarkers( const std::size_t n, std::vector< Math::Vector< double, 2 > >& points1,
+	std::vector< Math::Vector< double, 2 > >& points2, Math::Matrix< double, 3, 4 >& P1,
+	Math::Matrix< double, 3, 4 >& P2, Math::Matrix< double, 3, 3 >& F )
+{
+	Math::Matrix< double, 3, 3 > K( Math::Matrix< double, 3, 3 >::identity() );
+	K( 0, 0 ) = K( 1, 1 ) = 500;
+	K( 0, 2 ) = 320;
+	K( 1, 2 ) = 240;
+
+	// cameras at 5m distance with a baseline of 1m, looking at the origin
+	const Math::Pose cam1( Math::Quaternion(), Math::Vector< double, 3 >( 0.5, 0, 5 ) );
+	const Math::Pose cam2( Math::Quaternion( Math::Vector< double, 3 >( 0, 1, 0 ), 0.2 ), Math::Vector< double, 3 >( -0.5, 0.1, 5 ) );
+	P1 = boost::numeric::ublas::prod( K, Math::Matrix< double, 3, 4 >( cam1 ) );
+	P2 = boost::numeric::ublas::prod( K, Math::Matrix< double, 3, 4 >( cam2 ) );
+	F = Algorithm::fundamentalMatrixFromPoses( cam1, cam2, K, K );
+
+	Math::Random::Vector< double, 3 >::Uniform randPoint( -1, 1 );
+	std::vector< Math::Vector< double, 3 > > objPoints;
+	std::generate_n( std::back_inserter( objPoints ), n, randPoint );
+
+	points1.clear();
+	points2.clear();
+	Math::Geometry::project_points( P1, objPoints.begin(), objPoints.end(), std::back_inserter( points1 ) );
+	Math::Geometry::project_points( P2, objPoints.begin(), objPoints.end(), std::back_inserter( points2 ) );
+	std::random_shuffle( points2.begin(), points2.end() );
+}
+
+bool lessX( const Math::Vector< double, 3 >& a, const Math::Vector< double, 3 >& b )
+{
+	return a( 0 ) < b( 0 );
+}
+
+/** the gated reconstruction gives the same points as the dense one, the times are logged */
+void testReconstruction( const std::size_t n )
+{
+	std::vector< Math::Vector< double, 2 > > points1;
+	std::vector< Math::Vector< double, 2 > > points2;
+	Math::Matrix< double, 3, 4 > P1;
+	Math::Matrix< double, 3, 4 > P2;
+	Math::Matrix< double, 3, 3 > F;
+	stereoMarkers( n, points1, points2, P1, P2, F );
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	std::vector< Math::Vector< double, 3 > > dense( Algorithm::reconstruct3DPoints( points1, points2, P1, P2, F ) );
+	const double tDense = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	std::vector< Math::Vector< double, 3 > > gated( Algorithm::reconstruct3DPoints( points1, points2, P1, P2, F, 1.0 ) );
+	const double tGated = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	BOOST_REQUIRE_EQUAL( dense.size(), n );
+	BOOST_REQUIRE_EQUAL( gated.size(), n );
+	std::sort( dense.begin(), dense.end(), lessX );
+	std::sort( gated.begin(), gated.end(), lessX );
+	for ( std::size_t i = 0; i < n; i++ )
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_2( dense[ i ] - gated[ i ] ) ), 1e-6 );
+
+	LOG4CPP_INFO( timeLogger, "reconstruction of " << n << " markers: dense " << tDense << " ms, gated " << tGated << " ms" );
+}
+
+#endif // HAVE_LAPACK
+
+} // anonymous namespace
+
+
+void TestEpipolarGrid()
+{
+	testGrid< float >();
+	testGrid< double >();
+
+#ifdef HAVE_LAPACK
+	const std::size_t sizes[] = { 100, 500, 1000, 2000 };
+	for ( std::size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+		testReconstruction( sizes[ i ] );
+#endif
+}
@@ -8,11 +8,17 @@
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
 #include <utMath/Random/Rotation.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/Exception.h>
+#include <utUtil/ThreadPool.h>
 #include "../../tools.h"
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
+#include <boost/numeric/bindings/lapack/gels.hpp>
 
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.TsaiLenz" ) );
 
 using namespace Ubitrack::Math;
 
@@ -124,11 +130,194 @@ void testHandEyePoseRandom( const std::size_t n_runs, const T epsilon )
 	}
 }
 
+/** random hand poses and the corresponding eye poses for a random hand-eye transformation */
+void handEyePoses( const std::size_t n, const Pose& handEye, std::vector< Pose >& hands, std::vector< Pose >& eyes )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -10., 10. );
+	hands.clear();
+	eyes.clear();
+	for( std::size_t i = 0; i<n; ++i )
+	{
+		eyes.push_back( Pose( randQuat(), randVector() ) );
+		hands.push_back( ~( handEye * eyes.back() ) );
+	}
+}
+
+/** vector part of a rotation, sin( angle / 2 ) * axis with non-negative w */
+Vector< double, 3 > rotationVector( const Quaternion& q )
+{
+	const double s = q.w() < 0 ? -1 : 1;
+	return Vector< double, 3 >( s * q.x(), s * q.y(), s * q.z() );
+}
+
+/**
+ * reference solution: the Tsai-Lenz closed form with all pair equations stacked into one
+ * dense system each for rotation and translation, solved with lapack
+ */
+Pose referenceHandEye( const std::vector< Pose >& hands, const std::vector< Pose >& eyes, const bool bUseAllPairs )
+{
+	std::vector< Pose > hg;
+	std::vector< Pose > hc;
+	for( std::size_t i = 0; i + 1<hands.size(); ++i )
+		for( std::size_t k = i + 1; k<( bUseAllPairs ? hands.size() : i + 2 ); ++k )
+		{
+			hg.push_back( ~hands[ k ] * hands[ i ] );
+			hc.push_back( eyes[ k ] * ~eyes[ i ] );
+		}
+
+	// skew( Pgij + Pcij ) * Pcg' = Pcij - Pgij
+	Matrix< double, 0, 0 > a( 3 * hg.size(), 3 );
+	Matrix< double, 0, 0 > b( 3 * hg.size(), 1 );
+	for( std::size_t i = 0; i<hg.size(); ++i )
+	{
+		const Vector< double, 3 > pg( rotationVector( hg[ i ].rotation() ) );
+		const Vector< double, 3 > pc( rotationVector( hc[ i ].rotation() ) );
+		const Vector< double, 3 > sum( pg + pc );
+		a( 3 * i, 0 ) = 0;
+		a( 3 * i, 1 ) = -sum( 2 );
+		a( 3 * i, 2 ) = sum( 1 );
+		a( 3 * i + 1, 0 ) = sum( 2 );
+		a( 3 * i + 1, 1 ) = 0;
+		a( 3 * i + 1, 2 ) = -sum( 0 );
+		a( 3 * i + 2, 0 ) = -sum( 1 );
+		a( 3 * i + 2, 1 ) = sum( 0 );
+		a( 3 * i + 2, 2 ) = 0;
+		for( std::size_t r = 0; r<3; ++r )
+			b( 3 * i + r, 0 ) = pc( r ) - pg( r );
+	}
+	boost::numeric::bindings::lapack::gels( 'N', a, b );
+
+	// Pcg = 2 * Pcg' / sqrt( 1 + |Pcg'|^2 ) = 2 * sin( angle / 2 ) * axis
+	const Vector< double, 3 > pcg_( b( 0, 0 ), b( 1, 0 ), b( 2, 0 ) );
+	const Vector< double, 3 > v( pcg_ / std::sqrt( 1 + boost::numeric::ublas::inner_prod( pcg_, pcg_ ) ) );
+	const Quaternion rcg( v( 0 ), v( 1 ), v( 2 ), std::sqrt( 1 - boost::numeric::ublas::inner_prod( v, v ) ) );
+
+	// ( Rgij - I ) * Tcg = Rcg * Tcij - Tgij
+	Matrix< double, 0, 0 > at( 3 * hg.size(), 3 );
+	Matrix< double, 0, 0 > bt( 3 * hg.size(), 1 );
+	for( std::size_t i = 0; i<hg.size(); ++i )
+	{
+		const Matrix< double, 3, 3 > rg( hg[ i ].rotation() );
+		const Vector< double, 3 > rhs( rcg * hc[ i ].translation() - hg[ i ].translation() );
+		for( std::size_t r = 0; r<3; ++r )
+		{
+			for( std::size_t c = 0; c<3; ++c )
+				at( 3 * i + r, c ) = rg( r, c ) - ( r == c ? 1 : 0 );
+			bt( 3 * i + r, 0 ) = rhs( r );
+		}
+	}
+	boost::numeric::bindings::lapack::gels( 'N', at, bt );
+
+	return Pose( rcg, Vector< double, 3 >( bt( 0, 0 ), bt( 1, 0 ), bt( 2, 0 ) ) );
+}
+
+/** the incremental estimator has a valid solution after every pose and agrees with the reference solution */
+void testAccumulator()
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -10., 10. );
+	const Pose handEye( randQuat(), randVector() );
+	std::vector< Pose > hands;
+	std::vector< Pose > eyes;
+	handEyePoses( 40, handEye, hands, eyes );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Ubitrack::Algorithm::PoseEstimation6D6D::TsaiLenzAccumulator allPairs;
+	Ubitrack::Algorithm::PoseEstimation6D6D::TsaiLenzAccumulator parallel( true, &pool );
+	Ubitrack::Algorithm::PoseEstimation6D6D::TsaiLenzAccumulator consecutive( false );
+	for( std::size_t i = 0; i<hands.size(); ++i )
+	{
+		allPairs.addPose( hands[ i ], eyes[ i ] );
+		parallel.addPose( hands[ i ], eyes[ i ] );
+		consecutive.addPose( hands[ i ], eyes[ i ] );
+		if( i < 2 )
+			continue;
+
+		const Pose estimated = allPairs.solve();
+		BOOST_CHECK_SMALL( quaternionDiff( estimated.rotation(), handEye.rotation() ), 1e-6 );
+		BOOST_CHECK_SMALL( vectorDiff( estimated.translation(), handEye.translation() ), 1e-6 );
+		BOOST_CHECK_SMALL( vectorDiff( parallel.solve().translation(), estimated.translation() ), 1e-9 );
+		BOOST_CHECK_SMALL( vectorDiff( consecutive.solve().translation(), handEye.translation() ), 1e-6 );
+	}
+	BOOST_CHECK_EQUAL( allPairs.size(), hands.size() );
+	BOOST_CHECK_EQUAL( allPairs.pairs(), hands.size() * ( hands.size() - 1 ) / 2 );
+	BOOST_CHECK_EQUAL( consecutive.pairs(), hands.size() - 1 );
+
+	// with noisy eye poses, the least-squares solution differs from the ground truth
+	Random::Vector< double, 3 >::Normal randNoise( 0, 0.01 );
+	allPairs.reset();
+	consecutive.reset();
+	for( std::size_t i = 0; i<hands.size(); ++i )
+	{
+		const Vector< double, 3 > axis( randVector() );
+		eyes[ i ] = Pose( Quaternion( axis / boost::numeric::ublas::norm_2( axis ), 0.01 ), randNoise() ) * eyes[ i ];
+		allPairs.addPose( hands[ i ], eyes[ i ] );
+		consecutive.addPose( hands[ i ], eyes[ i ] );
+	}
+
+	const Pose reference = referenceHandEye( hands, eyes, true );
+	const Pose estimated = allPairs.solve();
+	BOOST_CHECK_SMALL( quaternionDiff( reference.rotation(), estimated.rotation() ), 1e-9 );
+	BOOST_CHECK_SMALL( vectorDiff( reference.translation(), estimated.translation() ), 1e-9 );
+	BOOST_CHECK( vectorDiff( handEye.translation(), estimated.translation() ) > 1e-6 );
+
+	const Pose referenceConsecutive = referenceHandEye( hands, eyes, false );
+	const Pose estimatedConsecutive = consecutive.solve();
+	BOOST_CHECK_SMALL( quaternionDiff( referenceConsecutive.rotation(), estimatedConsecutive.rotation() ), 1e-9 );
+	BOOST_CHECK_SMALL( vectorDiff( referenceConsecutive.translation(), estimatedConsecutive.translation() ), 1e-9 );
+
+	const Pose batch = Ubitrack::Algorithm::PoseEstimation6D6D::performHandEyeCalibration( hands, eyes, true );
+	BOOST_CHECK_SMALL( quaternionDiff( reference.rotation(), batch.rotation() ), 1e-9 );
+	BOOST_CHECK_SMALL( vectorDiff( reference.translation(), batch.translation() ), 1e-9 );
+
+	// movements about parallel axes do not determine the rotation
+	allPairs.reset();
+	BOOST_CHECK_EQUAL( allPairs.pairs(), 0u );
+	for( std::size_t i = 0; i<5; ++i )
+	{
+		const Pose eye( Quaternion( Vector< double, 3 >( 0, 0, 1 ), 0.3 * i ), randVector() );
+		allPairs.addPose( ~( handEye * eye ), eye );
+	}
+	BOOST_CHECK_THROW( allPairs.solve(), Ubitrack::Util::Exception );
+}
+
+/** logs the time to process all pairs of a large number of poses */
+void benchmarkAllPairs( const std::size_t n )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -10., 10. );
+	const Pose handEye( randQuat(), randVector() );
+	std::vector< Pose > hands;
+	std::vector< Pose > eyes;
+	handEyePoses( n, handEye, hands, eyes );
+
+	Ubitrack::Measurement::Timestamp start = Ubitrack::Measurement::readClock( Ubitrack::Measurement::clockMonotonic );
+	const Pose estimated = Ubitrack::Algorithm::PoseEstimation6D6D::performHandEyeCalibration( hands, eyes, true );
+	const double tBatch = 1e-6 * ( Ubitrack::Measurement::readClock( Ubitrack::Measurement::clockMonotonic ) - start );
+	BOOST_CHECK_SMALL( vectorDiff( estimated.translation(), handEye.translation() ), 1e-6 );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Ubitrack::Algorithm::PoseEstimation6D6D::TsaiLenzAccumulator accumulator( true, &pool );
+	for( std::size_t i = 0; i + 1<n; ++i )
+		accumulator.addPose( hands[ i ], eyes[ i ] );
+	start = Ubitrack::Measurement::readClock( Ubitrack::Measurement::clockMonotonic );
+	accumulator.addPose( hands.back(), eyes.back() );
+	accumulator.solve();
+	const double tLast = 1e-6 * ( Ubitrack::Measurement::readClock( Ubitrack::Measurement::clockMonotonic ) - start );
+
+	LOG4CPP_INFO( timeLogger, n << " poses (" << accumulator.pairs() << " pairs): batch " << tBatch
+		<< " ms, adding the last pose and solving " << tLast << " ms" );
+}
+
 void TestTsaiLenzHandEye()
 {
 	testHandEyeMatrixRandom< float >( 100, 1e-2f );
 	testHandEyeMatrixRandom< double >( 100, 1e-6 );
 	testHandEyePoseRandom< double >( 100, 1e-6 );
+	testAccumulator();
+	benchmarkAllPairs( 500 );
+	benchmarkAllPairs( 2000 );
 }
 
 #endif // HAVE_LAPACK
@@ -0,0 +1,227 @@
+
+#include <utAlgorithm/MultipleCameraPoseOptimization.h>
+#include <utMath/Optimization/BlockLevenbergMarquardt.h>
+#include <utMath/Optimization/TukeyWeightFunction.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.MultipleCameraPose" ) );
+
+using namespace Ubitrack;
+namespace ublas = boost::numeric::ublas;
+
+#ifdef HAVE_LAPACK
+
+namespace {
+
+/**
+ * a target with random marker corners, observed by cameras on a sphere of radius 5 that look
+ * at the origin. Some of the observations are missing, the others have gaussian noise.
+ */
+struct Scene
+{
+	Scene( const std::size_t nCameras, const std::size_t nPoints, const double noise )
+		: pose( Math::Quaternion::fromLogarithm( Math::Vector< double, 3 >( 0.2, -0.1, 0.3 ) ), Math::Vector< double, 3 >( 0.1, 0.05, -0.1 ) )
+		, points3d( nPoints )
+		, points2d( nCameras, std::vector< Math::Vector< double, 2 > >( nPoints ) )
+		, weights( nCameras, std::vector< Math::Scalar< double > >( nPoints ) )
+		, camPoses( nCameras )
+		, camMatrices( nCameras )
+		, camRotations( nCameras )
+		, camTranslations( nCameras )
+	{
+		Math::Random::Vector< double, 3 >::Normal randDirection( 0, 1 );
+		for ( std::size_t i = 0; i < nPoints; i++ )
+			points3d[ i ] = Math::Vector< double, 3 >( Math::Random::distribute_uniform< double >( -0.3, 0.3 ),
+				Math::Random::distribute_uniform< double >( -0.3, 0.3 ), Math::Random::distribute_uniform< double >( -0.3, 0.3 ) );
+
+		for ( std::size_t c = 0; c < nCameras; c++ )
+		{
+			// rows of the rotation: the z axis points to the origin
+			const Math::Vector< double, 3 > d( randDirection() );
+			const Math::Vector< double, 3 > center( d * ( 5 / ublas::norm_2( d ) ) );
+			const Math::Vector< double, 3 > z( -center / 5 );
+			Math::Vector< double, 3 > x( z( 1 ), -z( 0 ), 0 );
+			x /= ublas::norm_2( x );
+			const Math::Vector< double, 3 > y( z( 1 ) * x( 2 ) - z( 2 ) * x( 1 ), z( 2 ) * x( 0 ) - z( 0 ) * x( 2 ), z( 0 ) * x( 1 ) - z( 1 ) * x( 0 ) );
+			for ( std::size_t k = 0; k < 3; k++ )
+			{
+				camRotations[ c ]( 0, k ) = x( k );
+				camRotations[ c ]( 1, k ) = y( k );
+				camRotations[ c ]( 2, k ) = z( k );
+			}
+			camTranslations[ c ] = -ublas::prod( camRotations[ c ], center );
+			camPoses[ c ] = Math::Pose( Math::Quaternion( camRotations[ c ] ), camTranslations[ c ] );
+
+			camMatrices[ c ] = Math::Matrix< double, 3, 3 >::identity();
+			camMatrices[ c ]( 0, 0 ) = camMatrices[ c ]( 1, 1 ) = 800;
+			camMatrices[ c ]( 0, 2 ) = 320;
+			camMatrices[ c ]( 1, 2 ) = 240;
+
+			for ( std::size_t i = 0; i < nPoints; i++ )
+			{
+				const Math::Vector< double, 3 > p( ublas::prod( camMatrices[ c ], camPoses[ c ] * ( pose * points3d[ i ] ) ) );
+				points2d[ c ][ i ] = Math::Vector< double, 2 >( p( 0 ) / p( 2 ) + Math::Random::distribute_normal< double >( 0, noise ),
+					p( 1 ) / p( 2 ) + Math::Random::distribute_normal< double >( 0, noise ) );
+				weights[ c ][ i ] = Math::Random::distribute_uniform< double >( 0, 1 ) < 0.9 ? 1.0 : 0.0;
+			}
+		}
+	}
+
+	/** the measurement vector and visibilities for \c Algorithm::ObjectiveFunction */
+	void observations( Math::Vector< double >& measurement, std::vector< std::pair< std::size_t, std::size_t > >& visibilities ) const
+	{
+		visibilities.clear();
+		for ( std::size_t c = 0; c < points2d.size(); c++ )
+			for ( std::size_t i = 0; i < points3d.size(); i++ )
+				if ( weights[ c ][ i ] != 0.0 )
+					visibilities.push_back( std::make_pair( i, c ) );
+
+		measurement.resize( 2 * visibilities.size() );
+		for ( std::size_t k = 0; k < visibilities.size(); k++ )
+			ublas::subrange( measurement, 2 * k, 2 * k + 2 ) = points2d[ visibilities[ k ].second ][ visibilities[ k ].first ];
+	}
+
+	/** perturbed pose as 6-vector of translation and exponential map rotation */
+	Math::Vector< double, 6 > initialParameters() const
+	{
+		Math::Vector< double, 6 > param;
+		ublas::subrange( param, 0, 3 ) = pose.translation() + Math::Vector< double, 3 >( 0.02, -0.03, 0.01 );
+		ublas::subrange( param, 3, 6 ) = Math::Quaternion( Math::Quaternion::fromLogarithm( Math::Vector< double, 3 >( 0.03, 0.02, -0.02 ) ) * pose.rotation() ).toLogarithm();
+		return param;
+	}
+
+	Math::Pose pose;
+	std::vector< Math::Vector< double, 3 > > points3d;
+	std::vector< std::vector< Math::Vector< double, 2 > > > points2d;
+	std::vector< std::vector< Math::Scalar< double > > > weights;
+	std::vector< Math::Pose > camPoses;
+	std::vector< Math::Matrix< double, 3, 3 > > camMatrices;
+	std::vector< Math::Matrix< double, 3, 3 > > camRotations;
+	std::vector< Math::Vector< double, 3 > > camTranslations;
+};
+
+
+/** the block optimizer gives the same result as the optimizer using the full jacobian, with and without threads */
+void testBlockOptimization()
+{
+	Scene scene( 16, 50, 0.5 );
+	Math::Vector< double > measurement;
+	std::vector< std::pair< std::size_t, std::size_t > > visibilities;
+	scene.observations( measurement, visibilities );
+	const Algorithm::ObjectiveFunction< double > f( scene.points3d, scene.camRotations, scene.camTranslations, scene.camMatrices, visibilities );
+	BOOST_CHECK_EQUAL( f.blockCount(), visibilities.size() );
+
+	Math::Vector< double, 6 > paramFull( scene.initialParameters() );
+	const double resFull = Math::Optimization::levenbergMarquardt( f, paramFull, measurement, Math::Optimization::OptTerminate( 10, 1e-6 ), Math::Optimization::OptNoNormalize() );
+
+	Math::Vector< double, 6 > paramBlock( scene.initialParameters() );
+	const double resBlock = Math::Optimization::blockLevenbergMarquardt( f, paramBlock, measurement, Math::Optimization::OptTerminate( 10, 1e-6 ),
+		Math::Optimization::OptNoNormalize() );
+	BOOST_CHECK_CLOSE( resBlock, resFull, 1e-6 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_2( paramBlock - paramFull ) ), 1e-9 );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Math::Vector< double, 6 > paramParallel( scene.initialParameters() );
+	const double resParallel = Math::Optimization::blockLevenbergMarquardt( f, paramParallel, measurement, Math::Optimization::OptTerminate( 10, 1e-6 ),
+		Math::Optimization::OptNoNormalize(), &pool );
+	BOOST_CHECK_CLOSE( resParallel, resFull, 1e-6 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_2( paramParallel - paramFull ) ), 1e-9 );
+
+	// noise of 0.5 pixels in about 1600 measurements
+	BOOST_CHECK( resFull < 0.5 * 0.5 * measurement.size() * 1.5 );
+
+	// weights are applied per block
+	const Math::TukeyWeightFunction tukey( 2, 3.0 );
+	Math::Vector< double, 6 > paramWeighted( scene.initialParameters() );
+	const double resWeighted = Math::Optimization::weightedLevenbergMarquardt( f, paramWeighted, measurement, Math::Optimization::OptTerminate( 10, 1e-6 ),
+		Math::Optimization::OptNoNormalize(), tukey );
+	Math::Vector< double, 6 > paramBlockWeighted( scene.initialParameters() );
+	const double resBlockWeighted = Math::Optimization::weightedBlockLevenbergMarquardt( f, paramBlockWeighted, measurement, Math::Optimization::OptTerminate( 10, 1e-6 ),
+		Math::Optimization::OptNoNormalize(), tukey, &pool );
+	BOOST_CHECK_CLOSE( resBlockWeighted, resWeighted, 1e-6 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_2( paramBlockWeighted - paramWeighted ) ), 1e-9 );
+}
+
+
+/** the pose estimation of the algorithm library recovers the target pose */
+void testPoseEstimation()
+{
+	Scene scene( 16, 50, 0.2 );
+	Math::Vector< double, 6 > param( scene.initialParameters() );
+	const Math::Pose initialPose( Math::Quaternion::fromLogarithm( ublas::subrange( param, 3, 6 ) ), ublas::subrange( param, 0, 3 ) );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Math::ErrorPose pose;
+	Math::Scalar< double > residual;
+	Algorithm::multipleCameraPoseEstimation( scene.points3d, scene.points2d, scene.weights, scene.camPoses, scene.camMatrices, 4,
+		pose, residual, true, initialPose, &pool );
+
+	BOOST_CHECK( residual >= 0.0 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_2( pose.translation() - scene.pose.translation() ) ), 1e-3 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_2( Math::Quaternion( pose.rotation() * ~scene.pose.rotation() ).toLogarithm() ) ), 1e-3 );
+}
+
+
+/** logs the time of one optimization with the full jacobian and with residual blocks on different numbers of threads */
+void benchmark( const std::size_t nCameras, const std::size_t nPoints, const std::size_t nRuns )
+{
+	Scene scene( nCameras, nPoints, 0.5 );
+	Math::Vector< double > measurement;
+	std::vector< std::pair< std::size_t, std::size_t > > visibilities;
+	scene.observations( measurement, visibilities );
+	const Algorithm::ObjectiveFunction< double > f( scene.points3d, scene.camRotations, scene.camTranslations, scene.camMatrices, visibilities );
+	const Math::Optimization::OptTerminate criteria( 10, 0.0 );
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	double resFull = 0;
+	for ( std::size_t r = 0; r < nRuns; r++ )
+	{
+		Math::Vector< double, 6 > param( scene.initialParameters() );
+		resFull += Math::Optimization::levenbergMarquardt( f, param, measurement, criteria, Math::Optimization::OptNoNormalize() );
+	}
+	const double tFull = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	double tBlock[ 4 ];
+	const std::size_t nThreads[ 4 ] = { 0, 1, 2, 4 };
+	for ( std::size_t t = 0; t < 4; t++ )
+	{
+		Ubitrack::Util::ThreadPool pool( std::max< std::size_t >( 1, nThreads[ t ] ) );
+		start = Measurement::readClock( Measurement::clockMonotonic );
+		double resBlock = 0;
+		for ( std::size_t r = 0; r < nRuns; r++ )
+		{
+			Math::Vector< double, 6 > param( scene.initialParameters() );
+			resBlock += Math::Optimization::blockLevenbergMarquardt( f, param, measurement, criteria, Math::Optimization::OptNoNormalize(),
+				nThreads[ t ] ? &pool : 0 );
+		}
+		tBlock[ t ] = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+		BOOST_CHECK_CLOSE( resBlock, resFull, 1e-6 );
+	}
+
+	LOG4CPP_INFO( timeLogger, nCameras << " cameras x " << nPoints << " points, " << measurement.size() << " measurements: full jacobian " << tFull
+		<< " us, residual blocks " << tBlock[ 0 ] << " us, with thread pool of 1/2/4 threads " << tBlock[ 1 ] << "/" << tBlock[ 2 ] << "/" << tBlock[ 3 ] << " us" );
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+
+void TestMultipleCameraPose()
+{
+#ifdef HAVE_LAPACK
+	testBlockOptimization();
+	testPoseEstimation();
+	benchmark( 4, 50, 100 );
+	benchmark( 16, 50, 20 );
+#endif
+}
@@ -0,0 +1,243 @@
+
+#include <utMath/Pose.h>
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+
+#include <utAlgorithm/SparseBundleAdjustment.h>
+
+#ifdef HAVE_LAPACK
+#include <utAlgorithm/Function/BundleAdjustment.h>
+#include <utMath/Optimization/LevenbergMarquardt.h>
+#endif
+
+#include <sstream>
+#include <cmath>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.SparseBundleAdjustment" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** projects a world point with the bundle adjustment camera model */
+template< typename T >
+Vector< T, 2 > projectBA( const Pose& image, const Matrix< T, 3, 3 >& K, const Vector< T, 4 >& d, const Vector< T, 3 >& world )
+{
+	const Vector< double, 3 > c( image * Vector< double, 3 >( world ) );
+	const T x = static_cast< T >( c( 0 ) / c( 2 ) );
+	const T y = static_cast< T >( c( 1 ) / c( 2 ) );
+	const T r2 = x * x + y * y;
+	const T f = 1 + d( 0 ) * r2 + d( 1 ) * r2 * r2;
+	const T dx = x * f + 2 * d( 2 ) * x * y + d( 3 ) * ( r2 + 2 * x * x );
+	const T dy = y * f + 2 * d( 3 ) * x * y + d( 2 ) * ( r2 + 2 * y * y );
+	return Vector< T, 2 >( -( K( 0, 0 ) * dx + K( 0, 1 ) * dy + K( 0, 2 ) ), -( K( 1, 1 ) * dy + K( 1, 2 ) ) );
+}
+
+/**
+ * creates a random network with free points (and optionally a rigid body), observed by
+ * images around the origin with some noise on the measurements and the initial parameters
+ */
+template< typename T >
+void createNetwork( Algorithm::BundleAdjustmentNetwork< T >& net, const std::size_t nPoints, const std::size_t nImages, const bool bBody, const T pixelNoise )
+{
+	Matrix< T, 3, 3 > K( Matrix< T, 3, 3 >::identity() );
+	K( 0, 0 ) = 500; K( 1, 1 ) = 500;
+	K( 0, 2 ) = -320; K( 1, 2 ) = -240; K( 2, 2 ) = -1;
+	net.intrinsics.push_back( K );
+	net.distortions.push_back( Vector< T, 4 >( T( 0.01 ), T( -0.001 ), T( 0 ), T( 0 ) ) );
+
+	Random::Quaternion< double >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randPoint( -1, 1 );
+
+	// ground truth images, the points are always in front of the camera
+	std::vector< Pose > images;
+	for ( std::size_t i = 0; i < nImages; i++ )
+		images.push_back( Pose( randQuat(), Vector< double, 3 >( Random::distribute_uniform< double >( -0.5, 0.5 ),
+			Random::distribute_uniform< double >( -0.5, 0.5 ), -6 ) ) );
+
+	// free points
+	std::vector< Vector< T, 3 > > points;
+	for ( std::size_t p = 0; p < nPoints; p++ )
+	{
+		points.push_back( randPoint() );
+		for ( std::size_t i = 0; i < nImages; i++ )
+			if ( i < 2 || Random::distribute_uniform< T >( 0, 1 ) < T( 0.7 ) )
+			{
+				typename Algorithm::BundleAdjustmentNetwork< T >::FreePointMeasurement m;
+				m.iPoint = p;
+				m.iCamera = 0;
+				m.iImage = i;
+				m.measurement = projectBA( images[ i ], K, net.distortions[ 0 ], points.back() );
+				m.measurement( 0 ) += Random::distribute_normal< T >( 0, pixelNoise );
+				m.measurement( 1 ) += Random::distribute_normal< T >( 0, pixelNoise );
+				net.freePointMeasurements.push_back( m );
+			}
+	}
+
+	// the first body defines the world, the second one is a moving rigid body
+	net.bodyPoses.push_back( Pose() );
+	if ( bBody )
+	{
+		std::vector< Vector< T, 3 > > body;
+		for ( std::size_t p = 0; p < 4; p++ )
+			body.push_back( randPoint() );
+		net.bodies.push_back( body );
+
+		const Pose bodyPose( randQuat(), Vector< double, 3 >( 0.1, -0.1, 0.2 ) );
+		net.bodyPoses.push_back( bodyPose );
+
+		for ( std::size_t iPose = 0; iPose < 2; iPose++ )
+			for ( std::size_t i = 0; i < nImages; i++ )
+				for ( std::size_t p = 0; p < body.size(); p++ )
+				{
+					typename Algorithm::BundleAdjustmentNetwork< T >::BodyPointMeasurement m;
+					m.iBody = 0;
+					m.iPoint = p;
+					m.iBodyPose = iPose;
+					m.iCamera = 0;
+					m.iImage = i;
+					m.measurement = projectBA( images[ i ], K, net.distortions[ 0 ],
+						iPose == 0 ? body[ p ] : Vector< T, 3 >( bodyPose * Vector< double, 3 >( body[ p ] ) ) );
+					net.bodyPointMeasurements.push_back( m );
+				}
+	}
+
+	// noisy initial values
+	typename Random::Vector< T, 3 >::Normal pointNoise( 0, T( 0.02 ) );
+	for ( std::size_t p = 0; p < points.size(); p++ )
+		net.points.push_back( points[ p ] + pointNoise() );
+
+	for ( std::size_t i = 0; i < images.size(); i++ )
+	{
+		Vector< double, 3 > rotNoise( Random::distribute_normal< double >( 0, 0.01 ),
+			Random::distribute_normal< double >( 0, 0.01 ), Random::distribute_normal< double >( 0, 0.01 ) );
+		Vector< double, 3 > transNoise( Random::distribute_normal< double >( 0, 0.02 ),
+			Random::distribute_normal< double >( 0, 0.02 ), Random::distribute_normal< double >( 0, 0.02 ) );
+		net.images.push_back( Pose( Quaternion::fromLogarithm( rotNoise ) * images[ i ].rotation(), images[ i ].translation() + transNoise ) );
+	}
+
+	for ( std::size_t i = 1; i < net.bodyPoses.size(); i++ )
+		net.bodyPoses[ i ] = Pose( net.bodyPoses[ i ].rotation(), net.bodyPoses[ i ].translation() + Vector< double, 3 >( 0.02, 0.01, -0.02 ) );
+}
+
+/** sum of squared reprojection errors of all observations */
+template< typename T >
+T reprojectionError( const Algorithm::BundleAdjustmentNetwork< T >& net )
+{
+	T err( 0 );
+	for ( std::size_t i = 0; i < net.freePointMeasurements.size(); i++ )
+	{
+		const typename Algorithm::BundleAdjustmentNetwork< T >::FreePointMeasurement& m( net.freePointMeasurements[ i ] );
+		const Vector< T, 2 > diff( m.measurement - projectBA( net.images[ m.iImage ], net.intrinsics[ m.iCamera ], net.distortions[ m.iCamera ], net.points[ m.iPoint ] ) );
+		err += diff( 0 ) * diff( 0 ) + diff( 1 ) * diff( 1 );
+	}
+	for ( std::size_t i = 0; i < net.bodyPointMeasurements.size(); i++ )
+	{
+		const typename Algorithm::BundleAdjustmentNetwork< T >::BodyPointMeasurement& m( net.bodyPointMeasurements[ i ] );
+		const Vector< T, 3 > world( net.bodyPoses[ m.iBodyPose ] * Vector< double, 3 >( net.bodies[ m.iBody ][ m.iPoint ] ) );
+		const Vector< T, 2 > diff( m.measurement - projectBA( net.images[ m.iImage ], net.intrinsics[ m.iCamera ], net.distortions[ m.iCamera ], world ) );
+		err += diff( 0 ) * diff( 0 ) + diff( 1 ) * diff( 1 );
+	}
+	return err;
+}
+
+template< typename T >
+void testSparseBundleAdjustment( const std::size_t nRuns, const T pixelNoise )
+{
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		Algorithm::BundleAdjustmentNetwork< T > net;
+		createNetwork( net, 30, 4, run % 2 == 0, pixelNoise );
+		const std::size_t nMeasurements = net.freePointMeasurements.size() + net.bodyPointMeasurements.size();
+
+		const T errBefore = reprojectionError( net );
+
+#ifdef HAVE_LAPACK
+		// the dense optimizer uses the same model, parametrization and damping
+		Algorithm::BundleAdjustmentNetwork< T > denseNet( net );
+		Algorithm::BundleAdjustmentFunction< T > denseFunction( denseNet );
+		Vector< T > measurements( denseFunction.measurementSize() );
+		Vector< T > parameters( denseFunction.parameterSize() );
+		denseFunction.buildMeasurementVector( measurements );
+		denseFunction.buildParameterVector( parameters );
+		const T denseResidual = Optimization::levenbergMarquardt( denseFunction, parameters, measurements,
+			Optimization::OptTerminate( 10, 1e-6 ), Optimization::OptNoNormalize() );
+#endif
+
+		const T sparseResidual = Algorithm::sparseBundleAdjustment( net, 10, 1e-6 );
+		const T errAfter = reprojectionError( net );
+
+		BOOST_CHECK_MESSAGE( errAfter < errBefore, "Reprojection error before: " << errBefore << ", after: " << errAfter );
+		BOOST_CHECK_CLOSE( sparseResidual, errAfter, T( 1 ) );
+		BOOST_CHECK_MESSAGE( std::sqrt( errAfter / nMeasurements ) < 3 * pixelNoise,
+			"RMS reprojection error " << std::sqrt( errAfter / nMeasurements ) << " for pixel noise " << pixelNoise );
+
+#ifdef HAVE_LAPACK
+		BOOST_CHECK_CLOSE( sparseResidual, denseResidual, T( 1 ) );
+#endif
+	}
+}
+
+template< typename T >
+void benchmarkSparseBundleAdjustment( const std::size_t nPoints, const std::size_t nImages )
+{
+	Algorithm::BundleAdjustmentNetwork< T > net;
+	createNetwork( net, nPoints, nImages, false, T( 0.5 ) );
+#ifdef HAVE_LAPACK
+	// the dense run starts from the same network
+	Algorithm::BundleAdjustmentNetwork< T > denseNet( net );
+#endif
+
+	std::ostringstream name;
+	name << "sparse BA (" << nPoints << " points, " << nImages << " images)";
+	Ubitrack::Util::BlockTimer timer( name.str(), timeLogger );
+	{
+		UBITRACK_TIME( timer );
+		Algorithm::sparseBundleAdjustment( net, 5, 0 );
+	}
+
+#ifdef HAVE_LAPACK
+	// the dense jacobian grows quadratically, only run it for small networks
+	if ( nPoints * nImages <= 500 )
+	{
+		Algorithm::BundleAdjustmentFunction< T > denseFunction( denseNet );
+		Vector< T > measurements( denseFunction.measurementSize() );
+		Vector< T > parameters( denseFunction.parameterSize() );
+		denseFunction.buildMeasurementVector( measurements );
+		denseFunction.buildParameterVector( parameters );
+
+		std::ostringstream denseName;
+		denseName << "dense BA (" << nPoints << " points, " << nImages << " images)";
+		Ubitrack::Util::BlockTimer denseTimer( denseName.str(), timeLogger );
+		{
+			UBITRACK_TIME( denseTimer );
+			Optimization::levenbergMarquardt( denseFunction, parameters, measurements,
+				Optimization::OptTerminate( 5, 0 ), Optimization::OptNoNormalize() );
+		}
+	}
+#endif
+}
+
+} // anonymous namespace
+
+void TestSparseBundleAdjustment()
+{
+	testSparseBundleAdjustment< double >( 6, 0.3 );
+	testSparseBundleAdjustment< float >( 2, 0.3f );
+
+	// scale points and images
+	benchmarkSparseBundleAdjustment< double >( 100, 5 );
+	benchmarkSparseBundleAdjustment< double >( 400, 5 );
+	benchmarkSparseBundleAdjustment< double >( 400, 20 );
+	benchmarkSparseBundleAdjustment< double >( 2000, 20 );
+}
@@ -0,0 +1,203 @@
+
+#include <utAlgorithm/StreamingDLT.h>
+#include <utAlgorithm/Homography.h>
+#include <utAlgorithm/Projection.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Geometry/PointProjection.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/Exception.h>
+
+#include "../tools.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.StreamingDLT" ) );
+
+#ifdef HAVE_LAPACK
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** random homography applied to random points, with optional noise on the image points */
+template< typename T >
+void homographyPoints( const std::size_t n, const T noise, Matrix< T, 3, 3 >& H,
+	std::vector< Vector< T, 2 > >& fromPoints, std::vector< Vector< T, 2 > >& toPoints )
+{
+	typename Random::Vector< T, 2 >::Uniform randVector( -100, 100 );
+	typename Random::Vector< T, 2 >::Normal randNoise( 0, noise );
+
+	randomMatrix( H );
+	fromPoints.clear();
+	std::generate_n( std::back_inserter( fromPoints ), n, randVector );
+	toPoints.clear();
+	Geometry::project_points( H, fromPoints.begin(), fromPoints.end(), std::back_inserter( toPoints ) );
+	if ( noise > 0 )
+		for ( std::size_t i = 0; i < n; i++ )
+			toPoints[ i ] += randNoise();
+}
+
+template< typename T >
+void testHomography( const T epsilon )
+{
+	for ( std::size_t iRun = 0; iRun < 100; iRun++ )
+	{
+		const std::size_t n( Random::distribute_uniform< std::size_t >( 10, 50 ) );
+		Matrix< T, 3, 3 > Htest;
+		std::vector< Vector< T, 2 > > fromPoints;
+		std::vector< Vector< T, 2 > > toPoints;
+
+		// exact correspondences
+		homographyPoints< T >( n, 0, Htest, fromPoints, toPoints );
+		Algorithm::StreamingDLT< T, 2 > dlt;
+		dlt.add( fromPoints.begin(), fromPoints.end(), toPoints.begin() );
+		BOOST_CHECK_EQUAL( dlt.size(), n );
+		BOOST_CHECK_SMALL( homMatrixDiff( dlt.compute(), Htest ), epsilon );
+
+		// noisy correspondences give the same least-squares solution as the SVD
+		homographyPoints< T >( n, 1, Htest, fromPoints, toPoints );
+		dlt.clear();
+		dlt.add( fromPoints.begin(), fromPoints.end(), toPoints.begin() );
+		BOOST_CHECK_SMALL( homMatrixDiff( dlt.compute(), Algorithm::homographyDLT( fromPoints, toPoints ) ), epsilon );
+	}
+}
+
+void testSlidingWindow()
+{
+	const std::size_t n = 500;
+	const std::size_t window = 40;
+	Matrix< double, 3, 3 > Htest;
+	std::vector< Vector< double, 2 > > fromPoints;
+	std::vector< Vector< double, 2 > > toPoints;
+	homographyPoints< double >( n, 0.5, Htest, fromPoints, toPoints );
+
+	// the first correspondence, which is the reference of all sums, is removed early on
+	Algorithm::StreamingDLT< double, 2 > dlt;
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		dlt.add( fromPoints[ i ], toPoints[ i ] );
+		if ( i >= window )
+			dlt.remove( fromPoints[ i - window ], toPoints[ i - window ] );
+
+		if ( i % 50 == 49 )
+		{
+			const std::size_t first = i + 1 - std::min( i + 1, window );
+			const std::vector< Vector< double, 2 > > from( fromPoints.begin() + first, fromPoints.begin() + i + 1 );
+			const std::vector< Vector< double, 2 > > to( toPoints.begin() + first, toPoints.begin() + i + 1 );
+			BOOST_CHECK_EQUAL( dlt.size(), from.size() );
+			BOOST_CHECK_SMALL( homMatrixDiff( dlt.compute(), Algorithm::homographyDLT( from, to ) ), 1e-8 );
+		}
+	}
+
+	// errors
+	Algorithm::StreamingDLT< double, 2 > empty;
+	BOOST_CHECK_THROW( empty.remove( fromPoints[ 0 ], toPoints[ 0 ] ), Ubitrack::Util::Exception );
+	empty.add( fromPoints.begin(), fromPoints.begin() + 3, toPoints.begin() );
+	BOOST_CHECK_THROW( empty.compute(), Ubitrack::Util::Exception );
+}
+
+/** random camera looking at random points in front of it */
+void projectionPoints( const std::size_t n, const double noise, Matrix< double, 3, 4 >& P,
+	std::vector< Vector< double, 3 > >& fromPoints, std::vector< Vector< double, 2 > >& toPoints )
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -1, 1 );
+	Random::Vector< double, 2 >::Normal randNoise( 0, noise );
+
+	Matrix< double, 3, 3 > cam( Matrix< double, 3, 3 >::identity() );
+	cam( 0, 0 ) = cam( 1, 1 ) = Random::distribute_uniform< double >( 400, 800 );
+	cam( 0, 2 ) = -320;
+	cam( 1, 2 ) = -240;
+	cam( 2, 2 ) = -1;
+	const Quaternion rot( randQuat() );
+	const Vector< double, 3 > trans( 0.1, -0.2, -Random::distribute_uniform< double >( 5, 10 ) );
+	P = boost::numeric::ublas::prod( cam, Matrix< double, 3, 4 >( rot, trans ) );
+
+	fromPoints.clear();
+	std::generate_n( std::back_inserter( fromPoints ), n, randVector );
+	toPoints.clear();
+	Geometry::project_points( P, fromPoints.begin(), fromPoints.end(), std::back_inserter( toPoints ) );
+	if ( noise > 0 )
+		for ( std::size_t i = 0; i < n; i++ )
+			toPoints[ i ] += randNoise();
+}
+
+void testProjection()
+{
+	for ( std::size_t iRun = 0; iRun < 100; iRun++ )
+	{
+		const std::size_t n( Random::distribute_uniform< std::size_t >( 20, 60 ) );
+		Matrix< double, 3, 4 > Ptest;
+		std::vector< Vector< double, 3 > > fromPoints;
+		std::vector< Vector< double, 2 > > toPoints;
+
+		projectionPoints( n, 0, Ptest, fromPoints, toPoints );
+		Algorithm::StreamingDLT< double, 3 > dlt;
+		dlt.add( fromPoints.begin(), fromPoints.end(), toPoints.begin() );
+		BOOST_CHECK_SMALL( homMatrixDiff( dlt.compute(), Ptest ), 1e-6 );
+
+		// same scale and sign as projectionDLT
+		projectionPoints( n, 1, Ptest, fromPoints, toPoints );
+		dlt.clear();
+		dlt.add( fromPoints.begin(), fromPoints.end(), toPoints.begin() );
+		BOOST_CHECK_SMALL( matrixDiff( dlt.compute(), Algorithm::projectionDLT( fromPoints, toPoints ) ), 1e-6 );
+	}
+}
+
+/** logs the time of the SVD and the normal equations for a large number of correspondences */
+void benchmarkHomography( const std::size_t n )
+{
+	Matrix< double, 3, 3 > Htest;
+	std::vector< Vector< double, 2 > > fromPoints;
+	std::vector< Vector< double, 2 > > toPoints;
+	homographyPoints< double >( n, 0.5, Htest, fromPoints, toPoints );
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	const Matrix< double, 3, 3 > Hsvd( Algorithm::homographyDLT( fromPoints, toPoints ) );
+	const double tSvd = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Algorithm::StreamingDLT< double, 2 > dlt;
+	dlt.add( fromPoints.begin(), fromPoints.end(), toPoints.begin() );
+	const Matrix< double, 3, 3 > Hstreaming( dlt.compute() );
+	const double tStreaming = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	// one update of a sliding window
+	const std::size_t nUpdates = 1000;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t i = 0; i < nUpdates; i++ )
+	{
+		dlt.remove( fromPoints[ i ], toPoints[ i ] );
+		dlt.add( fromPoints[ i ], toPoints[ i ] );
+	}
+	const double tUpdate = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nUpdates;
+
+	BOOST_CHECK_SMALL( homMatrixDiff( Hsvd, Hstreaming ), 1e-8 );
+	LOG4CPP_INFO( timeLogger, "homography of " << n << " correspondences: SVD " << tSvd << " ms, normal equations "
+		<< tStreaming << " ms, difference " << homMatrixDiff( Hsvd, Hstreaming ) << ", sliding window update " << tUpdate << " us" );
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+
+void TestStreamingDLT()
+{
+#ifdef HAVE_LAPACK
+	testHomography< double >( 1e-6 );
+	testHomography< float >( 1e-2f );
+	testSlidingWindow();
+	testProjection();
+	benchmarkHomography( 2000 );
+#endif
+}
@@ -0,0 +1,301 @@
+
+#include <utAlgorithm/3DPointReconstruction.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/Exception.h>
+#include <utUtil/ThreadPool.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.Triangulation" ) );
+
+using namespace Ubitrack;
+
+namespace {
+
+/** cameras on a sphere of radius 5 around the origin, looking at the origin */
+void camerasAroundOrigin( const std::size_t n, std::vector< Math::Matrix< double, 3, 4 > >& cameras )
+{
+	Math::Random::Vector< double, 3 >::Normal randDirection( 0, 1 );
+	cameras.clear();
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		const Math::Vector< double, 3 > d( randDirection() );
+		const Math::Vector< double, 3 > center( d * ( 5 / boost::numeric::ublas::norm_2( d ) ) );
+
+		// rows of the rotation: the z axis points to the origin
+		const Math::Vector< double, 3 > z( -center / 5 );
+		Math::Vector< double, 3 > x( z( 1 ), -z( 0 ), 0 );
+		x /= boost::numeric::ublas::norm_2( x );
+		const Math::Vector< double, 3 > y( z( 1 ) * x( 2 ) - z( 2 ) * x( 1 ), z( 2 ) * x( 0 ) - z( 0 ) * x( 2 ), z( 0 ) * x( 1 ) - z( 1 ) * x( 0 ) );
+
+		Math::Matrix< double, 3, 4 > E;
+		for ( std::size_t c = 0; c < 3; c++ )
+		{
+			E( 0, c ) = x( c );
+			E( 1, c ) = y( c );
+			E( 2, c ) = z( c );
+		}
+		E( 0, 3 ) = -boost::numeric::ublas::inner_prod( x, center );
+		E( 1, 3 ) = -boost::numeric::ublas::inner_prod( y, center );
+		E( 2, 3 ) = -boost::numeric::ublas::inner_prod( z, center );
+
+		Math::Matrix< double, 3, 3 > K( Math::Matrix< double, 3, 3 >::identity() );
+		K( 0, 0 ) = K( 1, 1 ) = 600;
+		K( 0, 2 ) = 320;
+		K( 1, 2 ) = 240;
+		Math::Matrix< double, 3, 4 > P;
+		P = boost::numeric::ublas::prod( K, E );
+		cameras.push_back( P );
+	}
+}
+
+Math::Vector< double, 2 > projectPoint( const Math::Matrix< double, 3, 4 >& P, const Math::Vector< double, 3 >& x )
+{
+	const Math::Vector< double, 3 > p( boost::numeric::ublas::prod( P, Math::Vector< double, 4 >( x( 0 ), x( 1 ), x( 2 ), 1 ) ) );
+	return Math::Vector< double, 2 >( p( 0 ) / p( 2 ), p( 1 ) / p( 2 ) );
+}
+
+/** random markers, each seen by a random subset of the cameras with noisy observations */
+void markerObservations( const std::vector< Math::Matrix< double, 3, 4 > >& cameras, const std::size_t nPoints,
+	const double noise, std::vector< Math::Vector< double, 3 > >& points,
+	std::vector< Math::Vector< double, 2 > >& observations, std::vector< unsigned char >& visibility )
+{
+	Math::Random::Vector< double, 3 >::Uniform randPoint( -1, 1 );
+	Math::Random::Vector< double, 2 >::Normal randNoise( 0, noise );
+	const std::size_t nCameras = cameras.size();
+
+	points.resize( nPoints );
+	observations.resize( nPoints * nCameras );
+	visibility.resize( nPoints * nCameras );
+	for ( std::size_t i = 0; i < nPoints; i++ )
+	{
+		points[ i ] = randPoint();
+		for ( std::size_t c = 0; c < nCameras; c++ )
+		{
+			visibility[ i * nCameras + c ] = Math::Random::distribute_uniform< double >( 0, 1 ) < 0.7;
+			observations[ i * nCameras + c ] = projectPoint( cameras[ c ], points[ i ] );
+			if ( noise > 0 )
+				observations[ i * nCameras + c ] += randNoise();
+		}
+	}
+}
+
+/** the batch gives the same results as get3DPosition on the visible cameras of each point */
+void testAgainstSinglePoint()
+{
+	std::vector< Math::Matrix< double, 3, 4 > > cameras;
+	camerasAroundOrigin( 8, cameras );
+	std::vector< Math::Vector< double, 3 > > points;
+	std::vector< Math::Vector< double, 2 > > observations;
+	std::vector< unsigned char > visibility;
+	markerObservations( cameras, 200, 0.5, points, observations, visibility );
+
+	Util::ThreadPool pool( 4 );
+	Algorithm::TriangulationOptions options;
+	options.pThreadPool = &pool;
+	std::vector< Algorithm::TriangulatedPoint > result;
+	Algorithm::triangulatePoints( cameras, observations, visibility, result, options );
+	BOOST_REQUIRE_EQUAL( result.size(), points.size() );
+
+	for ( std::size_t i = 0; i < points.size(); i++ )
+	{
+		std::vector< Math::Matrix< double, 3, 4 > > P;
+		std::vector< Math::Vector< double, 2 > > x;
+		for ( std::size_t c = 0; c < cameras.size(); c++ )
+			if ( visibility[ i * cameras.size() + c ] )
+			{
+				P.push_back( cameras[ c ] );
+				x.push_back( observations[ i * cameras.size() + c ] );
+			}
+
+		BOOST_CHECK_EQUAL( result[ i ].nViews, P.size() );
+		BOOST_CHECK_EQUAL( result[ i ].valid, P.size() >= 2 );
+		if ( P.size() < 2 )
+			continue;
+
+#ifdef HAVE_LAPACK
+		const Math::Vector< double, 3 > single( Algorithm::get3DPosition( P, x, 1 ) );
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_2( single - result[ i ].position ) ), 1e-6 );
+#endif
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_2( points[ i ] - result[ i ].position ) ), 0.05 );
+		BOOST_CHECK( result[ i ].residual < 2.0 );
+	}
+
+	// without noise, the linear solution is exact
+	markerObservations( cameras, 50, 0, points, observations, visibility );
+	options.nMaxIterations = 0;
+	Algorithm::triangulatePoints( cameras, observations, visibility, result, options );
+	for ( std::size_t i = 0; i < points.size(); i++ )
+		if ( result[ i ].valid )
+		{
+			BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_2( points[ i ] - result[ i ].position ) ), 1e-8 );
+			BOOST_CHECK_SMALL( result[ i ].residual, 1e-6 );
+		}
+
+	// errors
+	visibility.pop_back();
+	BOOST_CHECK_THROW( Algorithm::triangulatePoints( cameras, observations, visibility, result ), Ubitrack::Util::Exception );
+}
+
+/** the predicted covariance matches the scatter of repeated noisy triangulations */
+void testCovariance()
+{
+	std::vector< Math::Matrix< double, 3, 4 > > cameras;
+	camerasAroundOrigin( 4, cameras );
+	const Math::Vector< double, 3 > point( 0.2, -0.3, 0.1 );
+	const double noise = 0.5;
+	const std::size_t nRuns = 2000;
+
+	Math::Random::Vector< double, 2 >::Normal randNoise( 0, noise );
+	std::vector< Math::Vector< double, 2 > > observations( nRuns * cameras.size() );
+	for ( std::size_t i = 0; i < nRuns; i++ )
+		for ( std::size_t c = 0; c < cameras.size(); c++ )
+			observations[ i * cameras.size() + c ] = projectPoint( cameras[ c ], point ) + randNoise();
+	const std::vector< unsigned char > visibility( observations.size(), 1 );
+
+	Algorithm::TriangulationOptions options;
+	options.imageNoise = noise;
+	std::vector< Algorithm::TriangulatedPoint > result;
+	Algorithm::triangulatePoints( cameras, observations, visibility, result, options );
+
+	Math::Matrix< double, 3, 3 > scatter( Math::Matrix< double, 3, 3 >::zeros() );
+	for ( std::size_t i = 0; i < nRuns; i++ )
+	{
+		const Math::Vector< double, 3 > d( result[ i ].position - point );
+		scatter += boost::numeric::ublas::outer_prod( d, d ) / nRuns;
+	}
+
+	for ( std::size_t k = 0; k < 3; k++ )
+		BOOST_CHECK_CLOSE( scatter( k, k ), result[ 0 ].covariance( k, k ), 15.0 );
+}
+
+/** sum of squared reprojection errors of a point */
+double reprojectionCost( const std::vector< Math::Matrix< double, 3, 4 > >& cameras,
+	const std::vector< Math::Vector< double, 2 > >& observations, const Math::Vector< double, 3 >& x )
+{
+	double cost = 0;
+	for ( std::size_t c = 0; c < cameras.size(); c++ )
+	{
+		const Math::Vector< double, 2 > r( projectPoint( cameras[ c ], x ) - observations[ c ] );
+		cost += boost::numeric::ublas::inner_prod( r, r );
+	}
+	return cost;
+}
+
+/** a point whose first Levenberg-Marquardt step increases the cost is still refined to a minimum */
+void testRejectedStep()
+{
+	// camera 0 at (0, 0, -5) looking along +z, camera 1 at (5, 0, 0) looking along -x
+	Math::Matrix< double, 3, 4 > E0( Math::Matrix< double, 3, 4 >::zeros() );
+	Math::Matrix< double, 3, 4 > E1( Math::Matrix< double, 3, 4 >::zeros() );
+	E0( 0, 0 ) = E0( 1, 1 ) = E0( 2, 2 ) = 1;
+	E0( 2, 3 ) = 5;
+	E1( 0, 2 ) = E1( 1, 1 ) = 1;
+	E1( 2, 0 ) = -1;
+	E1( 2, 3 ) = 5;
+	Math::Matrix< double, 3, 3 > K( Math::Matrix< double, 3, 3 >::identity() );
+	K( 0, 0 ) = K( 1, 1 ) = 600;
+	K( 0, 2 ) = 320;
+	K( 1, 2 ) = 240;
+	std::vector< Math::Matrix< double, 3, 4 > > cameras( 2 );
+	cameras[ 0 ] = boost::numeric::ublas::prod( K, E0 );
+	cameras[ 1 ] = boost::numeric::ublas::prod( K, E1 );
+
+	// a point close to camera 0 with a gross error in camera 1: the undamped step from the
+	// linear solution overshoots and is rejected
+	const Math::Vector< double, 3 > point( 0.1, 0.2, -4 );
+	std::vector< Math::Vector< double, 2 > > observations( 2 );
+	observations[ 0 ] = projectPoint( cameras[ 0 ], point );
+	observations[ 1 ] = projectPoint( cameras[ 1 ], point );
+	observations[ 1 ]( 1 ) -= 1000;
+	const std::vector< unsigned char > visibility( 2, 1 );
+
+	Algorithm::TriangulationOptions options;
+	options.nMaxIterations = 0;
+	std::vector< Algorithm::TriangulatedPoint > linear;
+	Algorithm::triangulatePoints( cameras, observations, visibility, linear, options );
+
+	options.nMaxIterations = 50;
+	std::vector< Algorithm::TriangulatedPoint > refined;
+	Algorithm::triangulatePoints( cameras, observations, visibility, refined, options );
+	BOOST_REQUIRE( linear[ 0 ].valid && refined[ 0 ].valid );
+
+	const double cost = reprojectionCost( cameras, observations, refined[ 0 ].position );
+	BOOST_CHECK( cost < 0.5 * reprojectionCost( cameras, observations, linear[ 0 ].position ) );
+
+	// no small displacement decreases the cost any further
+	for ( std::size_t k = 0; k < 3; k++ )
+		for ( int sign = -1; sign <= 1; sign += 2 )
+		{
+			Math::Vector< double, 3 > x( refined[ 0 ].position );
+			x( k ) += sign * 1e-4;
+			BOOST_CHECK( reprojectionCost( cameras, observations, x ) >= cost * ( 1 - 1e-12 ) );
+		}
+}
+
+/** logs the time of the single-point function and of the batch with and without threads */
+void benchmark( const std::size_t nCameras, const std::size_t nPoints )
+{
+	std::vector< Math::Matrix< double, 3, 4 > > cameras;
+	camerasAroundOrigin( nCameras, cameras );
+	std::vector< Math::Vector< double, 3 > > points;
+	std::vector< Math::Vector< double, 2 > > observations;
+	std::vector< unsigned char > visibility;
+	markerObservations( cameras, nPoints, 0.3, points, observations, visibility );
+
+	double tSingle = 0;
+#ifdef HAVE_LAPACK
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	std::vector< Math::Matrix< double, 3, 4 > > P;
+	std::vector< Math::Vector< double, 2 > > x;
+	for ( std::size_t i = 0; i < nPoints; i++ )
+	{
+		P.clear();
+		x.clear();
+		for ( std::size_t c = 0; c < nCameras; c++ )
+			if ( visibility[ i * nCameras + c ] )
+			{
+				P.push_back( cameras[ c ] );
+				x.push_back( observations[ i * nCameras + c ] );
+			}
+		if ( P.size() >= 2 )
+			Algorithm::get3DPosition( P, x, 1 );
+	}
+	tSingle = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+#else
+	Measurement::Timestamp start;
+#endif
+
+	std::vector< Algorithm::TriangulatedPoint > result;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Algorithm::triangulatePoints( cameras, observations, visibility, result );
+	const double tBatch = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	Util::ThreadPool pool( 4 );
+	Algorithm::TriangulationOptions options;
+	options.pThreadPool = &pool;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Algorithm::triangulatePoints( cameras, observations, visibility, result, options );
+	const double tParallel = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	LOG4CPP_INFO( timeLogger, nPoints << " points, " << nCameras << " cameras: get3DPosition " << tSingle
+		<< " ms, batch " << tBatch << " ms, batch with 4 threads " << tParallel << " ms" );
+}
+
+} // anonymous namespace
+
+
+void TestTriangulatePoints()
+{
+	testAgainstSinglePoint();
+	testCovariance();
+	testRejectedStep();
+	benchmark( 8, 500 );
+	benchmark( 16, 500 );
+}
@@ -0,0 +1,170 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/CameraIntrinsics.h>
+#include <utMath/Random/Scalar.h>
+
+#include <utAlgorithm/CameraLens/Correction.h>
+#include <utAlgorithm/CameraLens/UndistortionMap.h>
+
+#include <vector>
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Algorithm.UndistortionMap" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+template< typename T >
+CameraIntrinsics< T > createIntrinsics()
+{
+	Matrix< T, 3, 3 > K( Matrix< T, 3, 3 >::identity() );
+	K( 0, 0 ) = 520; K( 1, 1 ) = 515;
+	K( 0, 2 ) = -322; K( 1, 2 ) = -236; K( 2, 2 ) = -1;
+
+	const T radialParams[ 6 ] = { T( -0.28 ), T( 0.09 ), T( -0.01 ), T( 0 ), T( 0 ), T( 0 ) };
+	Vector< T, 6 > radial( radialParams );
+	Vector< T, 2 > tangential( T( 0.001 ), T( -0.0005 ) );
+	return CameraIntrinsics< T >( K, radial, tangential, 640, 480 );
+}
+
+/** distorts random undistorted points and keeps those that end up in the image */
+template< typename T >
+void createPoints( const CameraIntrinsics< T >& intrinsics, const std::size_t n, std::vector< Vector< T, 2 > >& undistorted, std::vector< Vector< T, 2 > >& distorted )
+{
+	while ( undistorted.size() < n )
+	{
+		const Vector< T, 2 > p( Random::distribute_uniform< T >( -20, 660 ), Random::distribute_uniform< T >( -20, 500 ) );
+		Vector< T, 2 > d;
+		Algorithm::CameraLens::distort( intrinsics, p, d );
+		if ( d( 0 ) < 0 || d( 0 ) > 640 || d( 1 ) < 0 || d( 1 ) > 480 )
+			continue;
+		undistorted.push_back( p );
+		distorted.push_back( d );
+	}
+}
+
+template< typename T >
+T maxError( const std::vector< Vector< T, 2 > >& a, const std::vector< Vector< T, 2 > >& b )
+{
+	T err( 0 );
+	for ( std::size_t i = 0; i < a.size(); i++ )
+		err = std::max( err, static_cast< T >( ublas::norm_2( a[ i ] - b[ i ] ) ) );
+	return err;
+}
+
+template< typename T >
+void testUndistortionMap( const T interpolationTolerance, const T refinedTolerance )
+{
+	const CameraIntrinsics< T > intrinsics( createIntrinsics< T >() );
+	std::vector< Vector< T, 2 > > truth;
+	std::vector< Vector< T, 2 > > distorted;
+	createPoints( intrinsics, 1000, truth, distorted );
+
+	// interpolation only
+	Algorithm::CameraLens::UndistortionMap< T > map( intrinsics, 8, 0 );
+	std::vector< Vector< T, 2 > > result( distorted );
+	Algorithm::CameraLens::undistort( map, result );
+	const T errInterpolated = maxError( result, truth );
+	BOOST_CHECK_MESSAGE( errInterpolated < interpolationTolerance, "max. error of interpolated undistortion: " << errInterpolated );
+
+	// interpolation and Newton refinement, every step roughly squares the error
+	T tolerance( interpolationTolerance );
+	for ( std::size_t steps = 1; steps <= 2; steps++ )
+	{
+		tolerance = std::max( tolerance * tolerance, refinedTolerance );
+		map.setRefinementSteps( steps );
+		result = distorted;
+		Algorithm::CameraLens::undistort( map, result );
+		const T errRefined = maxError( result, truth );
+		BOOST_CHECK_MESSAGE( errRefined < tolerance, "max. error of undistortion with " << steps << " Newton steps: " << errRefined );
+	}
+
+	// Newton iterations without a map
+	result = distorted;
+	Algorithm::CameraLens::undistort( intrinsics, result );
+	const T errNewton = maxError( result, truth );
+	BOOST_CHECK_MESSAGE( errNewton < refinedTolerance, "max. error of undistortion without map: " << errNewton );
+
+	// single point version, other cell size
+	Algorithm::CameraLens::UndistortionMap< T > coarseMap( intrinsics, 640, 480, 32, 2 );
+	Vector< T, 2 > single;
+	coarseMap.undistort( distorted[ 0 ], single );
+	BOOST_CHECK_SMALL( static_cast< T >( ublas::norm_2( single - truth[ 0 ] ) ), refinedTolerance );
+
+#ifdef HAVE_LAPACK
+	// the map is at least as accurate as the levenberg-marquardt path
+	std::vector< Vector< T, 2 > > resultLM( distorted.size() );
+	Algorithm::CameraLens::undistort( intrinsics, distorted, resultLM );
+	map.setRefinementSteps( 2 );
+	result = distorted;
+	Algorithm::CameraLens::undistort( map, result );
+	const T errLM = maxError( resultLM, truth );
+	BOOST_CHECK_MESSAGE( maxError( result, truth ) <= std::max( errLM, refinedTolerance ), "max. error of LM undistortion: " << errLM );
+#endif
+}
+
+template< typename T >
+void benchmarkUndistortion( const std::size_t n )
+{
+	const CameraIntrinsics< T > intrinsics( createIntrinsics< T >() );
+	std::vector< Vector< T, 2 > > truth;
+	std::vector< Vector< T, 2 > > distorted;
+	createPoints( intrinsics, n, truth, distorted );
+
+	std::ostringstream name;
+	name << "undistortion map creation (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer mapTimer( name.str(), timeLogger );
+	{
+		UBITRACK_TIME( mapTimer );
+		Algorithm::CameraLens::UndistortionMap< T > map( intrinsics );
+	}
+
+	Algorithm::CameraLens::UndistortionMap< T > map( intrinsics );
+	std::vector< Vector< T, 2 > > result( distorted );
+	name.str( "" );
+	name << "undistortion map, " << n << " points (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer timer( name.str(), timeLogger );
+	{
+		UBITRACK_TIME( timer );
+		Algorithm::CameraLens::undistort( map, result );
+	}
+
+	result = distorted;
+	name.str( "" );
+	name << "undistortion newton, " << n << " points (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer newtonTimer( name.str(), timeLogger );
+	{
+		UBITRACK_TIME( newtonTimer );
+		Algorithm::CameraLens::undistort( intrinsics, result );
+	}
+
+#ifdef HAVE_LAPACK
+	name.str( "" );
+	name << "undistortion LM, " << n << " points (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer lmTimer( name.str(), timeLogger );
+	{
+		UBITRACK_TIME( lmTimer );
+		Algorithm::CameraLens::undistort( intrinsics, distorted, result );
+	}
+#endif
+}
+
+} // anonymous namespace
+
+void TestUndistortionMap()
+{
+	testUndistortionMap< double >( 0.1, 1e-6 );
+	testUndistortionMap< float >( 0.1f, 1e-3f );
+
+	benchmarkUndistortion< double >( 10000 );
+	benchmarkUndistortion< float >( 10000 );
+}
@@ -3,6 +3,7 @@
 // declare external tests here, to save us some trivial header files
 void TestPoints();
 void TestConic();
+void TestPointBatch();
 
 
 GeometryTest::GeometryTest()
@@ -10,4 +11,5 @@ GeometryTest::GeometryTest()
 {
 	add( BOOST_TEST_CASE( &TestPoints ) );
 	add( BOOST_TEST_CASE( &TestConic ) );
+	add( BOOST_TEST_CASE( &TestPointBatch ) );
 }
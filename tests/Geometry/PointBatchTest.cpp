@@ -0,0 +1,228 @@
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/VectorList.h>
+
+#include <utMath/Geometry/PointProjection.h>
+#include <utMath/Geometry/PointTransformation.h>
+#include <utMath/Geometry/PointBatch.h>
+#include <utMeasurement/Clock.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Geometry.PointBatch" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+template< typename T >
+T tolerance()
+{
+	return sizeof( T ) == sizeof( float ) ? T( 1e-5 ) : T( 1e-12 );
+}
+
+/** checks two lists of vectors for equality up to a relative tolerance */
+template< typename T, std::size_t N >
+void checkEqual( const std::vector< Vector< T, N > >& a, const std::vector< Vector< T, N > >& b )
+{
+	BOOST_REQUIRE_EQUAL( a.size(), b.size() );
+	for ( std::size_t i = 0; i < a.size(); i++ )
+		for ( std::size_t j = 0; j < N; j++ )
+			BOOST_CHECK_SMALL( ( a[ i ]( j ) - b[ i ]( j ) ) / std::max( T( 1 ), std::abs( a[ i ]( j ) ) ), tolerance< T >() );
+}
+
+/** applies a functor to every point individually */
+template< class F, class M, class VIn, class VOut >
+void reference( F f, const M& m, const std::vector< VIn >& in, std::vector< VOut >& out )
+{
+	out.clear();
+	for ( std::size_t i = 0; i < in.size(); i++ )
+		out.push_back( f( m, in[ i ] ) );
+}
+
+template< typename T >
+void testKernels( const std::size_t n )
+{
+	typename Random::Quaternion< T >::Uniform randQuat;
+	typename Random::Vector< T, 3 >::Uniform randPoints3D( -5, 5 );
+	typename Random::Vector< T, 2 >::Uniform randPoints2D( -5, 5 );
+
+	Quaternion rot( randQuat() );
+	Vector< T, 3 > trans( 0.5, -0.3, 20 );
+	Matrix< T, 3, 3 > cam( Matrix< T, 3, 3 >::identity() );
+	cam( 0, 0 ) = cam( 1, 1 ) = 600;
+	cam( 0, 2 ) = -320;
+	cam( 1, 2 ) = -240;
+	cam( 2, 2 ) = -1;
+	Matrix< T, 3, 4 > mat3x4( rot, trans );
+	Matrix< T, 3, 4 > projection( boost::numeric::ublas::prod( cam, mat3x4 ) );
+	Matrix< T, 4, 4 > mat4x4( rot, trans );
+	mat4x4( 3, 0 ) = T( 0.01 );
+	mat4x4( 3, 2 ) = T( -0.02 );
+	Matrix< T, 2, 3 > mat2x3;
+	mat2x3( 0, 0 ) = mat2x3( 1, 1 ) = 1;
+	mat2x3( 0, 1 ) = T( 0.5 );
+	mat2x3( 1, 0 ) = 0;
+	mat2x3( 0, 2 ) = trans( 0 );
+	mat2x3( 1, 2 ) = trans( 1 );
+
+	std::vector< Vector< T, 3 > > points;
+	std::generate_n( std::back_inserter( points ), n, randPoints3D );
+	std::vector< Vector< T, 2 > > points2D;
+	std::generate_n( std::back_inserter( points2D ), n, randPoints2D );
+	const VectorList< T, 3 > list( points );
+
+	// projection of std::vector, VectorList and arrays through project_points
+	std::vector< Vector< T, 2 > > expected2D;
+	reference( Geometry::ProjectPoint(), projection, points, expected2D );
+
+	std::vector< Vector< T, 2 > > result2D;
+	Geometry::project_points( projection, points.begin(), points.end(), std::back_inserter( result2D ) );
+	checkEqual( expected2D, result2D );
+
+	result2D.clear();
+	Geometry::project_points( projection, list.begin(), list.end(), std::back_inserter( result2D ) );
+	checkEqual( expected2D, result2D );
+
+	if ( n )
+	{
+		result2D.assign( n, Vector< T, 2 >() );
+		const Vector< T, 3 >* pBegin = &points[ 0 ];
+		Geometry::project_points( projection, pBegin, pBegin + n, result2D.begin() );
+		checkEqual( expected2D, result2D );
+	}
+
+	// packed and structure-of-arrays projection
+	VectorList< T, 2 > packed2D( n );
+	Geometry::project_points_packed( projection, list.data(), n, packed2D.data() );
+	checkEqual( expected2D, packed2D.toVector() );
+
+	// one spare element, so &x[ 0 ] is valid and the kernels also run with n = 0
+	std::vector< T > x( n + 1 ), y( n + 1 ), z( n + 1 ), u( n + 1 ), v( n + 1 );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		x[ i ] = points[ i ]( 0 );
+		y[ i ] = points[ i ]( 1 );
+		z[ i ] = points[ i ]( 2 );
+	}
+	Geometry::project_points_soa( projection, &x[ 0 ], &y[ 0 ], &z[ 0 ], n, &u[ 0 ], &v[ 0 ] );
+	for ( std::size_t i = 0; i < n; i++ )
+		result2D[ i ] = Vector< T, 2 >( u[ i ], v[ i ] );
+	checkEqual( expected2D, std::vector< Vector< T, 2 > >( result2D.begin(), result2D.begin() + n ) );
+
+	// homographies of 2D points
+	Matrix< T, 3, 3 > homography( cam );
+	homography( 0, 1 ) = T( 0.1 );
+	reference( Geometry::ProjectPoint(), homography, points2D, expected2D );
+	result2D.clear();
+	Geometry::project_points( homography, points2D.begin(), points2D.end(), std::back_inserter( result2D ) );
+	checkEqual( expected2D, result2D );
+
+	// rigid transformations
+	std::vector< Vector< T, 3 > > expected3D;
+	reference( Geometry::TransformPoint(), mat3x4, points, expected3D );
+	std::vector< Vector< T, 3 > > result3D;
+	Geometry::transform_points( mat3x4, points.begin(), points.end(), std::back_inserter( result3D ) );
+	checkEqual( expected3D, result3D );
+
+	VectorList< T, 3 > inPlace( list );
+	Geometry::transform_points_packed( mat3x4, inPlace.data(), n, inPlace.data() );
+	checkEqual( expected3D, inPlace.toVector() );
+	BOOST_CHECK( list.toVector() == points );
+
+	// homogeneous transformations, with and without dehomogenization
+	std::vector< Vector< T, 4 > > expected4D;
+	reference( Geometry::TransformPoint(), mat4x4, points, expected4D );
+	std::vector< Vector< T, 4 > > result4D;
+	Geometry::transform_points( mat4x4, list.begin(), list.end(), std::back_inserter( result4D ) );
+	checkEqual( expected4D, result4D );
+
+	expected3D.clear();
+	for ( std::size_t i = 0; i < n; i++ )
+		expected3D.push_back( Vector< T, 3 >( expected4D[ i ]( 0 ) / expected4D[ i ]( 3 ),
+			expected4D[ i ]( 1 ) / expected4D[ i ]( 3 ), expected4D[ i ]( 2 ) / expected4D[ i ]( 3 ) ) );
+	VectorList< T, 3 > dehomogenized( n );
+	Geometry::transform_points_packed( mat4x4, list.data(), n, dehomogenized.data() );
+	checkEqual( expected3D, dehomogenized.toVector() );
+
+	std::vector< T > ox( n + 1 ), oy( n + 1 ), oz( n + 1 );
+	Geometry::transform_points_soa( mat4x4, &x[ 0 ], &y[ 0 ], &z[ 0 ], n, &ox[ 0 ], &oy[ 0 ], &oz[ 0 ] );
+	for ( std::size_t i = 0; i < n; i++ )
+		result3D[ i ] = Vector< T, 3 >( ox[ i ], oy[ i ], oz[ i ] );
+	checkEqual( expected3D, std::vector< Vector< T, 3 > >( result3D.begin(), result3D.begin() + n ) );
+
+	// affine 2D transformations
+	reference( Geometry::TransformPoint(), mat2x3, points2D, expected2D );
+	result2D.clear();
+	Geometry::transform_points( mat2x3, points2D.begin(), points2D.end(), std::back_inserter( result2D ) );
+	checkEqual( expected2D, result2D );
+}
+
+
+/** logs the throughput of the functor path and of the batch kernels */
+template< typename T >
+void benchmarkProjection( const std::string& name, const std::size_t n, const std::size_t nRuns )
+{
+	typename Random::Vector< T, 3 >::Uniform randPoints3D( -5, 5 );
+	Matrix< T, 3, 4 > projection( Quaternion(), Vector< T, 3 >( 0, 0, 20 ) );
+	projection( 0, 0 ) = projection( 1, 1 ) = 600;
+
+	std::vector< Vector< T, 3 > > points;
+	std::generate_n( std::back_inserter( points ), n, randPoints3D );
+	const VectorList< T, 3 > list( points );
+	std::vector< Vector< T, 2 > > out( n );
+	VectorList< T, 2 > packedOut( n );
+
+	// reference: the functor applied to each point, as before the batch kernels
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t r = 0; r < nRuns; r++ )
+	{
+		Ubitrack::Util::identity< const Matrix< T, 3, 4 > > id_container( projection );
+		std::transform( points.begin(), points.end(), id_container.begin(), out.begin(), Geometry::ProjectPoint() );
+	}
+	const double tFunctor = double( Measurement::readClock( Measurement::clockMonotonic ) - start ) / ( n * nRuns );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t r = 0; r < nRuns; r++ )
+		Geometry::project_points( projection, points.begin(), points.end(), out.begin() );
+	const double tVector = double( Measurement::readClock( Measurement::clockMonotonic ) - start ) / ( n * nRuns );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t r = 0; r < nRuns; r++ )
+		Geometry::project_points( projection, list.begin(), list.end(), out.begin() );
+	const double tList = double( Measurement::readClock( Measurement::clockMonotonic ) - start ) / ( n * nRuns );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t r = 0; r < nRuns; r++ )
+		Geometry::project_points_packed( projection, list.data(), n, packedOut.data() );
+	const double tPacked = double( Measurement::readClock( Measurement::clockMonotonic ) - start ) / ( n * nRuns );
+
+	LOG4CPP_INFO( timeLogger, "project_points " << name << ", " << n << " points: functor " << tFunctor
+		<< " ns/point, std::vector " << tVector << " ns/point, VectorList " << tList << " ns/point, packed " << tPacked << " ns/point" );
+}
+
+} // anonymous namespace
+
+
+void TestPointBatch()
+{
+	const std::size_t sizes[] = { 0, 1, 3, 7, 64, 65, 1000 };
+	for ( std::size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+	{
+		testKernels< float >( sizes[ i ] );
+		testKernels< double >( sizes[ i ] );
+	}
+
+	benchmarkProjection< float >( "float", 50000, 100 );
+	benchmarkProjection< double >( "double", 50000, 100 );
+}
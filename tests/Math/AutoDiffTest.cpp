@@ -0,0 +1,405 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Pose.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Optimization/Function/AutoDiff.h>
+#include <utMath/Optimization/Function/DiscreteJacobianApproximation.h>
+#include <utAlgorithm/Function/MultiplePointProjection.h>
+#include <utAlgorithm/ToolTip/Optimization.h>
+#include <utMeasurement/Clock.h>
+
+#ifdef HAVE_LAPACK
+#include <utMath/Optimization/LevenbergMarquardt.h>
+#include <utAlgorithm/Function/ProjectivePoseNormalize.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Math.AutoDiff" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+typedef Optimization::Function::Jet< double, 2 > Jet2;
+
+/** projection of 3D points with the pose (tx, ty, tz, qx, qy, qz, qw), written for any value type */
+class PoseProjection
+{
+public:
+	PoseProjection( const std::vector< Vector< double, 3 > >& p3D, const Matrix< double, 3, 3 >& K )
+		: m_p3D( p3D )
+		, m_K( K )
+	{}
+
+	std::size_t size() const
+	{ return 2 * m_p3D.size(); }
+
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& input ) const
+	{
+		typedef typename VT2::value_type T;
+
+		// rotation matrix of r * p * r' for a quaternion that need not be normalized
+		const T x = input( 3 );
+		const T y = input( 4 );
+		const T z = input( 5 );
+		const T w = input( 6 );
+		Matrix< T, 3, 3 > R;
+		R( 0, 0 ) = w * w + x * x - y * y - z * z;
+		R( 0, 1 ) = 2 * ( x * y - w * z );
+		R( 0, 2 ) = 2 * ( x * z + w * y );
+		R( 1, 0 ) = 2 * ( x * y + w * z );
+		R( 1, 1 ) = w * w - x * x + y * y - z * z;
+		R( 1, 2 ) = 2 * ( y * z - w * x );
+		R( 2, 0 ) = 2 * ( x * z - w * y );
+		R( 2, 1 ) = 2 * ( y * z + w * x );
+		R( 2, 2 ) = w * w - x * x - y * y + z * z;
+		const Vector< T, 3 > t( input( 0 ), input( 1 ), input( 2 ) );
+
+		for ( std::size_t i = 0; i < m_p3D.size(); i++ )
+		{
+			const Vector< T, 3 > p( m_p3D[ i ]( 0 ), m_p3D[ i ]( 1 ), m_p3D[ i ]( 2 ) );
+			const Vector< T, 3 > rotated( ublas::prod( R, p ) + t );
+			const Vector< T, 3 > projected( ublas::prod( m_K, rotated ) );
+			result( 2 * i ) = projected( 0 ) / projected( 2 );
+			result( 2 * i + 1 ) = projected( 1 ) / projected( 2 );
+		}
+	}
+
+protected:
+	const std::vector< Vector< double, 3 > >& m_p3D;
+	const Matrix< double, 3, 3 >& m_K;
+};
+
+/** distance of the tip in world coordinates (0..2) to the tip offset (3..5) transformed by each pose */
+class TipDistance
+{
+public:
+	TipDistance( const std::vector< Pose >& poses )
+		: m_poses( poses )
+	{}
+
+	std::size_t size() const
+	{ return m_poses.size(); }
+
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& input ) const
+	{
+		typedef typename VT2::value_type T;
+		using std::sqrt;
+
+		const Vector< T, 3 > pw( input( 0 ), input( 1 ), input( 2 ) );
+		const Vector< T, 3 > pt( input( 3 ), input( 4 ), input( 5 ) );
+		for ( std::size_t i = 0; i < m_poses.size(); i++ )
+		{
+			const Matrix< double, 3, 3 > R( m_poses[ i ].rotation() );
+			const Vector< T, 3 > d( pw - ublas::prod( R, pt ) - m_poses[ i ].translation() );
+			result( i ) = sqrt( ublas::inner_prod( d, d ) );
+		}
+	}
+
+protected:
+	const std::vector< Pose >& m_poses;
+};
+
+void createPoseProblem( const std::size_t nPoints, std::vector< Vector< double, 3 > >& p3D, Matrix< double, 3, 3 >& K,
+	Vector< double >& measurements, Vector< double, 7 >& params )
+{
+	K = Matrix< double, 3, 3 >::identity();
+	K( 0, 0 ) = 500; K( 1, 1 ) = 500;
+	K( 0, 2 ) = -320; K( 1, 2 ) = -240; K( 2, 2 ) = -1;
+
+	Random::Quaternion< double >::Uniform randQuat;
+	const Pose pose( randQuat(), Vector< double, 3 >( 0.1, -0.2, -5 ) );
+	Random::Vector< double, 3 >::Uniform randPoint( -1, 1 );
+	p3D.clear();
+	for ( std::size_t i = 0; i < nPoints; i++ )
+		p3D.push_back( randPoint() );
+
+	Vector< double, 7 > truth;
+	pose.toVector( truth );
+	measurements.resize( 2 * nPoints );
+	PoseProjection( p3D, K ).evaluate( measurements, truth );
+	for ( std::size_t i = 0; i < measurements.size(); i++ )
+		measurements( i ) += Random::distribute_normal< double >( 0, 0.2 );
+
+	const Pose initial( Quaternion::fromLogarithm( Vector< double, 3 >( 0.02, -0.03, 0.01 ) ) * pose.rotation(),
+		pose.translation() + Vector< double, 3 >( 0.05, 0.02, -0.1 ) );
+	initial.toVector( params );
+}
+
+void createTipProblem( const std::size_t nPoses, std::vector< Pose >& poses, Vector< double, 6 >& params )
+{
+	const Vector< double, 3 > pw( 0.3, -0.1, 0.8 );
+	const Vector< double, 3 > pt( 0, 0, 0.15 );
+	Random::Vector< double, 3 >::Normal randAxis( 0, 1 );
+	Random::Vector< double, 3 >::Normal randNoise( 0, 0.0005 );
+	poses.clear();
+	for ( std::size_t i = 0; i < nPoses; i++ )
+	{
+		// the tool pivots around the tip
+		const Quaternion q( randAxis(), Random::distribute_uniform< double >( -0.6, 0.6 ) );
+		poses.push_back( Pose( q, pw - q * pt + randNoise() ) );
+	}
+	const double initial[ 6 ] = { pw( 0 ) + 0.01, pw( 1 ) - 0.02, pw( 2 ) + 0.01, 0.01, -0.01, 0.14 };
+	std::copy( initial, initial + 6, params.begin() );
+}
+
+double maxDifference( const Matrix< double >& A, const Matrix< double >& B )
+{
+	double result = 0;
+	for ( std::size_t r = 0; r < A.size1(); r++ )
+		for ( std::size_t c = 0; c < A.size2(); c++ )
+			result = std::max( result, std::fabs( A( r, c ) - B( r, c ) ) );
+	return result;
+}
+
+/** derivatives of the elementary functions against their closed forms */
+void testJet()
+{
+	using std::sqrt;
+	const Jet2 x( 0.3, 0 );
+	const Jet2 y( -1.7, 1 );
+
+	const Jet2 f( x * y + 2 * x - y / 3 + 1 );
+	BOOST_CHECK_CLOSE( f.a, 0.3 * -1.7 + 0.6 + 1.7 / 3 + 1, 1e-12 );
+	BOOST_CHECK_CLOSE( f.v[ 0 ], -1.7 + 2, 1e-12 );
+	BOOST_CHECK_CLOSE( f.v[ 1 ], 0.3 - 1.0 / 3, 1e-12 );
+
+	const Jet2 g( x / y );
+	BOOST_CHECK_CLOSE( g.v[ 0 ], 1 / -1.7, 1e-12 );
+	BOOST_CHECK_CLOSE( g.v[ 1 ], -0.3 / ( 1.7 * 1.7 ), 1e-12 );
+	const Jet2 h( 1.0 / y );
+	BOOST_CHECK_CLOSE( h.v[ 1 ], -1 / ( 1.7 * 1.7 ), 1e-12 );
+	BOOST_CHECK_CLOSE( ( 2.0 - y ).v[ 1 ], -1.0, 1e-12 );
+
+	BOOST_CHECK_CLOSE( sqrt( x ).v[ 0 ], 0.5 / std::sqrt( 0.3 ), 1e-12 );
+	BOOST_CHECK_CLOSE( exp( x ).v[ 0 ], std::exp( 0.3 ), 1e-12 );
+	BOOST_CHECK_CLOSE( log( x ).v[ 0 ], 1 / 0.3, 1e-12 );
+	BOOST_CHECK_CLOSE( sin( x ).v[ 0 ], std::cos( 0.3 ), 1e-12 );
+	BOOST_CHECK_CLOSE( cos( x ).v[ 0 ], -std::sin( 0.3 ), 1e-12 );
+	BOOST_CHECK_CLOSE( tan( x ).v[ 0 ], 1 / ( std::cos( 0.3 ) * std::cos( 0.3 ) ), 1e-12 );
+	BOOST_CHECK_CLOSE( asin( x ).v[ 0 ], 1 / std::sqrt( 1 - 0.09 ), 1e-12 );
+	BOOST_CHECK_CLOSE( acos( x ).v[ 0 ], -1 / std::sqrt( 1 - 0.09 ), 1e-12 );
+	BOOST_CHECK_CLOSE( atan( x ).v[ 0 ], 1 / 1.09, 1e-12 );
+	BOOST_CHECK_CLOSE( pow( x, 3 ).v[ 0 ], 3 * 0.09, 1e-12 );
+	BOOST_CHECK_CLOSE( pow( x, 0.5 ).v[ 0 ], 0.5 / std::sqrt( 0.3 ), 1e-12 );
+
+	// powers at 0
+	const Jet2 zero( 0.0, 0 );
+	BOOST_CHECK_EQUAL( pow( zero, 0 ).a, 1.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 0 ).v[ 0 ], 0.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 0.5 ).a, 0.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 1 ).a, 0.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 1 ).v[ 0 ], 1.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 2 ).a, 0.0 );
+	BOOST_CHECK_EQUAL( pow( zero, 2 ).v[ 0 ], 0.0 );
+	BOOST_CHECK_CLOSE( fabs( y ).v[ 1 ], -1.0, 1e-12 );
+
+	const Jet2 a( atan2( y, x ) );
+	BOOST_CHECK_CLOSE( a.a, std::atan2( -1.7, 0.3 ), 1e-12 );
+	BOOST_CHECK_CLOSE( a.v[ 0 ], 1.7 / ( 0.09 + 2.89 ), 1e-12 );
+	BOOST_CHECK_CLOSE( a.v[ 1 ], 0.3 / ( 0.09 + 2.89 ), 1e-12 );
+
+	BOOST_CHECK( x > y );
+	BOOST_CHECK( x < 1.0 );
+	BOOST_CHECK( 0.0 > y );
+}
+
+/** automatic and analytical jacobians agree, the finite differences are less accurate */
+void testJacobians()
+{
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	Vector< double > measurements;
+	Vector< double, 7 > params;
+	createPoseProblem( 10, p3D, K, measurements, params );
+
+	const PoseProjection projection( p3D, K );
+	Matrix< double > analytical( 20, 7 );
+	Algorithm::Function::MultiplePointProjection< double >( p3D, K ).jacobian( params, analytical );
+
+	Matrix< double > automatic( 20, 7 );
+	Vector< double > result( 20 );
+	Optimization::Function::AutoDiffJacobian< PoseProjection, 7 > autoDiff( projection );
+	autoDiff.evaluateWithJacobian( result, params, automatic );
+
+	Matrix< double > discrete( 20, 7 );
+	Optimization::Function::DiscreteJacobianApproximation< PoseProjection > finiteDifferences( projection, 1e-6 );
+	finiteDifferences.jacobian( params, discrete );
+
+	Vector< double > expected( 20 );
+	projection.evaluate( expected, params );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( result - expected ) ), 1e-12 );
+	BOOST_CHECK_SMALL( maxDifference( automatic, analytical ), 1e-8 );
+	BOOST_CHECK_SMALL( maxDifference( discrete, analytical ), 1e-1 );
+	LOG4CPP_INFO( timeLogger, "pose jacobian, largest error against the analytical one: automatic " << maxDifference( automatic, analytical )
+		<< ", finite differences " << maxDifference( discrete, analytical ) );
+
+	std::vector< Pose > poses;
+	Vector< double, 6 > tipParams;
+	createTipProblem( 30, poses, tipParams );
+	Matrix< double > tipAnalytical( 30, 6 );
+	Algorithm::ToolTip::MultiplePoseSinglePointTransformation< std::vector< Pose >::const_iterator >( poses.begin(), poses.end() ).jacobian( tipParams, tipAnalytical );
+	Matrix< double > tipAutomatic( 30, 6 );
+	Optimization::Function::AutoDiffJacobian< TipDistance, 6 >( TipDistance( poses ) ).jacobian( tipParams, tipAutomatic );
+	BOOST_CHECK_SMALL( maxDifference( tipAutomatic, tipAnalytical ), 1e-10 );
+
+	// wrong number of parameters
+	Vector< double > tooShort( 6 );
+	BOOST_CHECK_THROW( autoDiff.jacobian( tooShort, automatic ), Ubitrack::Util::Exception );
+}
+
+/** ns per jacobian of a functor computed analytically, automatically and by finite differences */
+template< class Analytical, class Generic, std::size_t N, class Params >
+void benchmarkJacobian( const std::string& name, const Analytical& analytical, const Generic& generic, const Params& params, const std::size_t nRuns )
+{
+	const std::size_t m = generic.size();
+	Matrix< double > J( m, N );
+	Vector< double > result( m );
+	double sink = 0;
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		analytical.evaluateWithJacobian( result, params, J );
+		sink += J( 0, N - 1 );
+	}
+	const double tAnalytical = static_cast< double >( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	const Optimization::Function::AutoDiffJacobian< Generic, N > autoDiff( generic );
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		autoDiff.evaluateWithJacobian( result, params, J );
+		sink += J( 0, N - 1 );
+	}
+	const double tAutomatic = static_cast< double >( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	const Optimization::Function::DiscreteJacobianApproximation< Generic > finiteDifferences( generic, 1e-6 );
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		finiteDifferences.evaluateWithJacobian( result, params, J );
+		sink += J( 0, N - 1 );
+	}
+	const double tDiscrete = static_cast< double >( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	BOOST_CHECK( sink == sink );
+	LOG4CPP_INFO( timeLogger, name << ", result and jacobian: analytical " << tAnalytical << " ns, automatic " << tAutomatic
+		<< " ns, finite differences " << tDiscrete << " ns" );
+}
+
+#ifdef HAVE_LAPACK
+
+/** levenberg-marquardt with automatic and with numerical jacobians */
+void benchmarkOptimization( const std::size_t nRuns )
+{
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	Vector< double > measurements;
+	Vector< double, 7 > initial;
+	createPoseProblem( 20, p3D, K, measurements, initial );
+	const PoseProjection projection( p3D, K );
+	Optimization::Function::AutoDiffJacobian< PoseProjection, 7 > autoDiff( projection );
+	Optimization::Function::DiscreteJacobianApproximation< PoseProjection > finiteDifferences( projection, 1e-6 );
+
+	double resAutomatic = 0;
+	Vector< double, 7 > paramsAutomatic;
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		paramsAutomatic = initial;
+		resAutomatic = Optimization::levenbergMarquardt( autoDiff, paramsAutomatic, measurements,
+			Optimization::OptTerminate( 10, 1e-8 ), Algorithm::Function::ProjectivePoseNormalize() );
+	}
+	const double tAutomatic = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	double resDiscrete = 0;
+	Vector< double, 7 > paramsDiscrete;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		paramsDiscrete = initial;
+		resDiscrete = Optimization::levenbergMarquardt( finiteDifferences, paramsDiscrete, measurements,
+			Optimization::OptTerminate( 10, 1e-8 ), Algorithm::Function::ProjectivePoseNormalize() );
+	}
+	const double tDiscrete = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+	BOOST_CHECK( resAutomatic <= resDiscrete * ( 1 + 1e-6 ) );
+
+	std::vector< Pose > poses;
+	Vector< double, 6 > tipInitial;
+	createTipProblem( 50, poses, tipInitial );
+	const TipDistance tipDistance( poses );
+	Optimization::Function::AutoDiffJacobian< TipDistance, 6 > tipAutoDiff( tipDistance );
+	Optimization::Function::DiscreteJacobianApproximation< TipDistance > tipFiniteDifferences( tipDistance, 1e-6 );
+	const Vector< double > zeros( Vector< double >::zeros( poses.size() ) );
+
+	Vector< double, 6 > tipAutomatic;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		tipAutomatic = tipInitial;
+		Optimization::levenbergMarquardt( tipAutoDiff, tipAutomatic, zeros, Optimization::OptTerminate( 10, 1e-8 ), Optimization::OptNoNormalize() );
+	}
+	const double tTipAutomatic = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+
+	Vector< double, 6 > tipDiscrete;
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		tipDiscrete = tipInitial;
+		Optimization::levenbergMarquardt( tipFiniteDifferences, tipDiscrete, zeros, Optimization::OptTerminate( 10, 1e-8 ), Optimization::OptNoNormalize() );
+	}
+	const double tTipDiscrete = 1e-3 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / nRuns;
+	const Vector< double, 3 > tipError( Vector< double, 3 >( ublas::subrange( tipAutomatic, 0, 3 ) ) - Vector< double, 3 >( 0.3, -0.1, 0.8 ) );
+	BOOST_CHECK_SMALL( static_cast< double >( norm_2( tipError ) ), 5e-3 );
+
+	LOG4CPP_INFO( timeLogger, "LM pose refinement (20 points): automatic " << tAutomatic << " us, residual " << resAutomatic
+		<< ", finite differences " << tDiscrete << " us, residual " << resDiscrete );
+	LOG4CPP_INFO( timeLogger, "LM tip calibration (50 poses): automatic " << tTipAutomatic << " us, finite differences " << tTipDiscrete << " us" );
+}
+
+#endif // HAVE_LAPACK
+
+} // anonymous namespace
+
+
+void TestAutoDiff()
+{
+	testJet();
+	testJacobians();
+
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	Vector< double > measurements;
+	Vector< double, 7 > params;
+	createPoseProblem( 20, p3D, K, measurements, params );
+	benchmarkJacobian< Algorithm::Function::MultiplePointProjection< double >, PoseProjection, 7 >( "pose, 20 points",
+		Algorithm::Function::MultiplePointProjection< double >( p3D, K ), PoseProjection( p3D, K ), params, 20000 );
+
+	std::vector< Pose > poses;
+	Vector< double, 6 > tipParams;
+	createTipProblem( 50, poses, tipParams );
+	typedef Algorithm::ToolTip::MultiplePoseSinglePointTransformation< std::vector< Pose >::const_iterator > TipFunction;
+	benchmarkJacobian< TipFunction, TipDistance, 6 >( "tip calibration, 50 poses",
+		TipFunction( poses.begin(), poses.end() ), TipDistance( poses ), tipParams, 20000 );
+
+#ifdef HAVE_LAPACK
+	benchmarkOptimization( 500 );
+#endif
+}
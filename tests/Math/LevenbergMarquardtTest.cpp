@@ -0,0 +1,358 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Pose.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+
+#ifdef HAVE_LAPACK
+#include <utMath/Optimization/LevenbergMarquardt.h>
+#include <utMath/Optimization/PowellDogleg.h>
+#include <utMath/Optimization/TukeyWeightFunction.h>
+#include <utAlgorithm/Function/MultiplePointProjection.h>
+#include <utAlgorithm/Function/ProjectivePoseNormalize.h>
+#include <utAlgorithm/CameraLens/Undistortion.h>
+#endif
+
+#include <sstream>
+#include <boost/numeric/ublas/vector_proxy.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <utMeasurement/Clock.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Math.LevenbergMarquardt" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+#ifdef HAVE_LAPACK
+
+namespace {
+
+/** random 2D-3D pose refinement problem with a perturbed initial pose */
+template< typename T >
+void createPoseProblem( const std::size_t nPoints, std::vector< Vector< T, 3 > >& p3D, Matrix< T, 3, 3 >& K, Vector< T >& measurements, Vector< T, 7 >& params )
+{
+	K = Matrix< T, 3, 3 >::identity();
+	K( 0, 0 ) = 500; K( 1, 1 ) = 500;
+	K( 0, 2 ) = -320; K( 1, 2 ) = -240; K( 2, 2 ) = -1;
+
+	Random::Quaternion< double >::Uniform randQuat;
+	const Pose pose( randQuat(), Vector< double, 3 >( 0.1, -0.2, -5 ) );
+
+	typename Random::Vector< T, 3 >::Uniform randPoint( -1, 1 );
+	p3D.clear();
+	for ( std::size_t i = 0; i < nPoints; i++ )
+		p3D.push_back( randPoint() );
+
+	Algorithm::Function::MultiplePointProjection< T > projection( p3D, K );
+	Vector< T, 7 > truth;
+	pose.toVector( truth );
+	measurements.resize( 2 * nPoints );
+	projection.evaluate( measurements, truth );
+	for ( std::size_t i = 0; i < measurements.size(); i++ )
+		measurements( i ) += Random::distribute_normal< T >( 0, T( 0.2 ) );
+
+	const Pose initial( Quaternion::fromLogarithm( Vector< double, 3 >( 0.02, -0.03, 0.01 ) ) * pose.rotation(),
+		pose.translation() + Vector< double, 3 >( 0.05, 0.02, -0.1 ) );
+	initial.toVector( params );
+}
+
+template< typename T >
+void testPoseRefinement( const T epsilon )
+{
+	std::vector< Vector< T, 3 > > p3D;
+	Matrix< T, 3, 3 > K;
+	Vector< T > measurements;
+	Vector< T, 7 > initial;
+	createPoseProblem( 8, p3D, K, measurements, initial );
+	Algorithm::Function::MultiplePointProjection< T > projection( p3D, K );
+
+	// reference: heap allocated path
+	Vector< T > paramsDynamic( initial );
+	const T resDynamic = Optimization::levenbergMarquardt( projection, paramsDynamic, measurements,
+		Optimization::OptTerminate( 10, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize() );
+
+	// fixed number of parameters, workspace reused between calls
+	Optimization::LMWorkspace< T, 0, 7 > workspace;
+	for ( std::size_t run = 0; run < 2; run++ )
+	{
+		Vector< T, 7 > params( initial );
+		const T res = Optimization::levenbergMarquardt( projection, params, measurements,
+			Optimization::OptTerminate( 10, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize(), workspace );
+		BOOST_CHECK_CLOSE( res, resDynamic, epsilon );
+		BOOST_CHECK_SMALL( static_cast< T >( ublas::norm_inf( params - paramsDynamic ) ), epsilon );
+	}
+
+	// everything on the stack
+	Vector< T, 16 > fixedMeasurements( measurements );
+	Vector< T, 7 > params( initial );
+	Optimization::LMWorkspace< T, 16, 7 > fixedWorkspace;
+	const T resFixed = Optimization::levenbergMarquardt( projection, params, fixedMeasurements,
+		Optimization::OptTerminate( 10, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize(), fixedWorkspace );
+	BOOST_CHECK_CLOSE( resFixed, resDynamic, epsilon );
+	BOOST_CHECK_SMALL( static_cast< T >( ublas::norm_inf( params - paramsDynamic ) ), epsilon );
+
+	// dynamic workspace adapts to other problem sizes
+	Optimization::LMWorkspace< T > dynamicWorkspace( 4, 7 );
+	params = initial;
+	const T resReused = Optimization::levenbergMarquardt( projection, params, measurements,
+		Optimization::OptTerminate( 10, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize(), dynamicWorkspace );
+	BOOST_CHECK_CLOSE( resReused, resDynamic, epsilon );
+
+	// fixed workspace of the wrong size
+	Optimization::LMWorkspace< T, 10, 7 > wrongWorkspace;
+	BOOST_CHECK_THROW( Optimization::levenbergMarquardt( projection, params, measurements,
+		Optimization::OptTerminate( 10, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize(), wrongWorkspace ), Ubitrack::Util::Exception );
+}
+
+template< typename T >
+void testUndistortion( const T epsilon )
+{
+	Vector< T, 6 > radial( ublas::zero_vector< T >( 6 ) );
+	radial( 0 ) = T( -0.25 );
+	radial( 1 ) = T( 0.08 );
+	const Vector< T, 2 > tangential( T( 0.001 ), T( -0.002 ) );
+	Algorithm::CameraLens::internal::PointUndistortion< T > distFunc( radial, tangential );
+
+	for ( std::size_t i = 0; i < 100; i++ )
+	{
+		const Vector< T, 2 > distorted( Random::distribute_uniform< T >( -0.6, 0.6 ), Random::distribute_uniform< T >( -0.45, 0.45 ) );
+
+		Vector< T > undistortedDynamic( distorted );
+		Optimization::levenbergMarquardt( distFunc, undistortedDynamic, distorted, Optimization::OptTerminate( 5, 1e-5 ), Optimization::OptNoNormalize() );
+
+		Vector< T, 2 > undistorted( distorted );
+		Optimization::LMWorkspace< T, 2, 2 > workspace;
+		Optimization::levenbergMarquardt( distFunc, undistorted, distorted, Optimization::OptTerminate( 5, 1e-5 ), Optimization::OptNoNormalize(), workspace );
+
+		BOOST_CHECK_SMALL( static_cast< T >( ublas::norm_inf( undistorted - undistortedDynamic ) ), epsilon );
+	}
+}
+
+/**
+ * ns per call of the heap allocated and the fixed-size path. Allocations are not counted: they
+ * happen in ublas storage through std::allocator, which only a replacement of the global
+ * operator new could observe. The fixed-size path allocates nothing by construction.
+ */
+template< typename T >
+void benchmarkLevenbergMarquardt( const std::size_t nRuns )
+{
+	std::vector< Vector< T, 3 > > p3D;
+	Matrix< T, 3, 3 > K;
+	Vector< T > measurements;
+	Vector< T, 7 > initial;
+	createPoseProblem( 8, p3D, K, measurements, initial );
+	Algorithm::Function::MultiplePointProjection< T > projection( p3D, K );
+	const Vector< T, 16 > fixedMeasurements( measurements );
+
+	std::ostringstream name;
+	name << "optimizePose LM, heap allocated (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer dynamicTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( dynamicTimer );
+		Vector< T > params( initial );
+		Optimization::levenbergMarquardt( projection, params, measurements,
+			Optimization::OptTerminate( 6, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize() );
+	}
+
+	name.str( "" );
+	name << "optimizePose LM, fixed size workspace (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer fixedTimer( name.str(), timeLogger );
+	Optimization::LMWorkspace< T, 16, 7 > workspace;
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( fixedTimer );
+		Vector< T, 7 > params( initial );
+		Optimization::levenbergMarquardt( projection, params, fixedMeasurements,
+			Optimization::OptTerminate( 6, 1e-6 ), Algorithm::Function::ProjectivePoseNormalize(), workspace );
+	}
+
+	Vector< T, 6 > radial( ublas::zero_vector< T >( 6 ) );
+	radial( 0 ) = T( -0.25 );
+	radial( 1 ) = T( 0.08 );
+	const Vector< T, 2 > tangential( T( 0.001 ), T( -0.002 ) );
+	const Vector< T, 2 > distorted( T( 0.4 ), T( -0.3 ) );
+	Algorithm::CameraLens::internal::PointUndistortion< T > distFunc( radial, tangential );
+
+	name.str( "" );
+	name << "undistortion LM, heap allocated (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer undistortDynamicTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( undistortDynamicTimer );
+		Vector< T > undistorted( distorted );
+		Optimization::levenbergMarquardt( distFunc, undistorted, distorted, Optimization::OptTerminate( 5, 1e-5 ), Optimization::OptNoNormalize() );
+	}
+
+	name.str( "" );
+	name << "undistortion LM, fixed size workspace (" << sizeof( T ) * 8 << " bit)";
+	Ubitrack::Util::BlockTimer undistortFixedTimer( name.str(), timeLogger );
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		UBITRACK_TIME( undistortFixedTimer );
+		Vector< T, 2 > undistorted( distorted );
+		Optimization::LMWorkspace< T, 2, 2 > undistortWorkspace;
+		Optimization::levenbergMarquardt( distFunc, undistorted, distorted, Optimization::OptTerminate( 5, 1e-5 ), Optimization::OptNoNormalize(), undistortWorkspace );
+	}
+}
+
+/** a pose refinement problem with a poor initial pose, which makes the optimizers reject many steps */
+void createDistantPoseProblem( const std::size_t nPoints, std::vector< Vector< double, 3 > >& p3D, Matrix< double, 3, 3 >& K,
+	Vector< double >& measurements, Vector< double, 7 >& params, const double distance = 1.0 )
+{
+	createPoseProblem( nPoints, p3D, K, measurements, params );
+	const Pose initial( Pose::fromVector( params ) );
+	const Pose distant( Quaternion::fromLogarithm( Vector< double, 3 >( 0.3, -0.2, 0.25 ) * distance ) * initial.rotation(),
+		initial.translation() + Vector< double, 3 >( 0.4, -0.3, 1.0 ) * distance );
+	distant.toVector( params );
+}
+
+/** the lazy variant takes the same steps as the eager one, but evaluates fewer jacobians */
+void testLazyJacobian()
+{
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	Vector< double > measurements;
+	Vector< double, 7 > initial;
+	createDistantPoseProblem( 20, p3D, K, measurements, initial );
+	Algorithm::Function::MultiplePointProjection< double > projection( p3D, K );
+
+	const Optimization::OptTerminateWithStatistics eagerCriteria( 20, 1e-9 );
+	Vector< double, 7 > eagerParams( initial );
+	const double resEager = Optimization::levenbergMarquardt( projection, eagerParams, measurements,
+		eagerCriteria, Algorithm::Function::ProjectivePoseNormalize() );
+
+	const Optimization::OptTerminateWithStatistics lazyCriteria( 20, 1e-9 );
+	Vector< double, 7 > lazyParams( initial );
+	const double resLazy = Optimization::lazyLevenbergMarquardt( projection, lazyParams, measurements,
+		lazyCriteria, Algorithm::Function::ProjectivePoseNormalize() );
+
+	BOOST_CHECK_EQUAL( resLazy, resEager );
+	BOOST_CHECK_SMALL( ublas::norm_inf( lazyParams - eagerParams ), 1e-12 );
+
+	const Optimization::OptStatistics& eager( eagerCriteria.statistics() );
+	const Optimization::OptStatistics& lazy( lazyCriteria.statistics() );
+	BOOST_CHECK_EQUAL( eager.iterations, lazy.iterations );
+	BOOST_CHECK_EQUAL( eager.evaluations, eager.iterations + 1 );
+	BOOST_CHECK_EQUAL( eager.jacobianEvaluations, eager.evaluations );
+	BOOST_CHECK( lazy.jacobianEvaluations <= eager.jacobianEvaluations );
+	BOOST_CHECK_EQUAL( lazy.evaluations, lazy.iterations + lazy.jacobianEvaluations );
+
+	// weights are applied to the jacobian of accepted steps
+	const Optimization::OptTerminate criteria( 20, 1e-9 );
+	Optimization::LMWorkspace< double > workspace;
+	eagerParams = initial;
+	const double resEagerWeighted = Optimization::weightedLevenbergMarquardt( projection, eagerParams, measurements,
+		criteria, Algorithm::Function::ProjectivePoseNormalize(), TukeyWeightFunction( 2, 5.0 ), workspace );
+	lazyParams = initial;
+	const double resLazyWeighted = Optimization::weightedLazyLevenbergMarquardt( projection, lazyParams, measurements,
+		criteria, Algorithm::Function::ProjectivePoseNormalize(), TukeyWeightFunction( 2, 5.0 ), workspace );
+	BOOST_CHECK_EQUAL( resLazyWeighted, resEagerWeighted );
+	BOOST_CHECK_SMALL( ublas::norm_inf( lazyParams - eagerParams ), 1e-12 );
+}
+
+/** the dogleg optimizer finds the same minimum as levenberg-marquardt */
+void testDogleg()
+{
+	for ( std::size_t run = 0; run < 10; run++ )
+	{
+		std::vector< Vector< double, 3 > > p3D;
+		Matrix< double, 3, 3 > K;
+		Vector< double > measurements;
+		Vector< double, 7 > initial;
+		createDistantPoseProblem( 20, p3D, K, measurements, initial );
+		Algorithm::Function::MultiplePointProjection< double > projection( p3D, K );
+
+		Vector< double, 7 > lmParams( initial );
+		const double resLM = Optimization::levenbergMarquardt( projection, lmParams, measurements,
+			Optimization::OptTerminate( 100, 1e-12 ), Algorithm::Function::ProjectivePoseNormalize() );
+
+		const Optimization::OptTerminateWithStatistics criteria( 100, 1e-12 );
+		Vector< double, 7 > doglegParams( initial );
+		const double resDogleg = Optimization::powellDogleg( projection, doglegParams, measurements,
+			criteria, Algorithm::Function::ProjectivePoseNormalize() );
+
+		BOOST_CHECK_CLOSE( resDogleg, resLM, 1e-4 );
+		BOOST_CHECK_SMALL( ublas::norm_inf( doglegParams - lmParams ), 1e-6 );
+		BOOST_CHECK( criteria.statistics().jacobianEvaluations <= criteria.statistics().iterations + 1 );
+	}
+}
+
+/** logs the evaluations and time per optimization of the eager, the lazy and the dogleg optimizer */
+void benchmarkTrustRegion( const std::size_t nPoints, const double distance, const std::size_t nRuns )
+{
+	const char* names[ 3 ] = { "eager LM", "lazy LM", "dogleg" };
+	double residual[ 3 ] = { 0, 0, 0 };
+	std::size_t evaluations[ 3 ] = { 0, 0, 0 };
+	std::size_t jacobians[ 3 ] = { 0, 0, 0 };
+	Measurement::Timestamp duration[ 3 ] = { 0, 0, 0 };
+
+	for ( std::size_t run = 0; run < nRuns; run++ )
+	{
+		std::vector< Vector< double, 3 > > p3D;
+		Matrix< double, 3, 3 > K;
+		Vector< double > measurements;
+		Vector< double, 7 > initial;
+		createDistantPoseProblem( nPoints, p3D, K, measurements, initial, distance );
+		Algorithm::Function::MultiplePointProjection< double > projection( p3D, K );
+		Optimization::LMWorkspace< double, 0, 7 > workspace;
+
+		for ( std::size_t method = 0; method < 3; method++ )
+		{
+			const Optimization::OptTerminateWithStatistics criteria( 50, 1e-9 );
+			Vector< double, 7 > params( initial );
+			const Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+			if ( method == 0 )
+				residual[ method ] += Optimization::levenbergMarquardt( projection, params, measurements,
+					criteria, Algorithm::Function::ProjectivePoseNormalize(), workspace );
+			else if ( method == 1 )
+				residual[ method ] += Optimization::weightedLazyLevenbergMarquardt( projection, params, measurements,
+					criteria, Algorithm::Function::ProjectivePoseNormalize(), Optimization::OptNoWeightFunction(), workspace );
+			else
+				residual[ method ] += Optimization::weightedPowellDogleg( projection, params, measurements,
+					criteria, Algorithm::Function::ProjectivePoseNormalize(), Optimization::OptNoWeightFunction(), workspace );
+			duration[ method ] += Measurement::readClock( Measurement::clockMonotonic ) - start;
+			evaluations[ method ] += criteria.statistics().evaluations;
+			jacobians[ method ] += criteria.statistics().jacobianEvaluations;
+		}
+	}
+
+	// the dogleg optimizer may end in different local minima if the initial pose is too far off
+	BOOST_CHECK_CLOSE( residual[ 1 ], residual[ 0 ], 1e-6 );
+	for ( std::size_t method = 0; method < 3; method++ )
+	{
+		LOG4CPP_INFO( timeLogger, "pose refinement with " << nPoints << " points, initial distance " << distance << ", " << names[ method ] << ": "
+			<< double( evaluations[ method ] ) / nRuns << " evaluations, " << double( jacobians[ method ] ) / nRuns << " jacobians, "
+			<< 1e-3 * duration[ method ] / nRuns << " us, mean residual " << residual[ method ] / nRuns );
+	}
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+void TestLevenbergMarquardt()
+{
+#ifdef HAVE_LAPACK
+	testPoseRefinement< double >( 1e-6 );
+	testUndistortion< double >( 1e-8 );
+	testUndistortion< float >( 1e-4f );
+	testLazyJacobian();
+	testDogleg();
+
+	benchmarkLevenbergMarquardt< double >( 2000 );
+	benchmarkLevenbergMarquardt< float >( 2000 );
+	benchmarkTrustRegion( 20, 1.0, 200 );
+	benchmarkTrustRegion( 200, 1.0, 50 );
+	benchmarkTrustRegion( 20, 3.0, 200 );
+	benchmarkTrustRegion( 200, 3.0, 50 );
+	benchmarkTrustRegion( 20, 6.0, 200 );
+#endif
+}
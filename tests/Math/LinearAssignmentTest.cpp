@@ -0,0 +1,195 @@
+
+#include <utMath/Graph/LinearAssignment.h>
+#include <utMath/Graph/Munkres.h>
+#include <utMath/Random/Scalar.h>
+#include <utMeasurement/Clock.h>
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Math.LinearAssignment" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+typedef Matrix< double, 0, 0 > CostMatrix;
+
+/** a negative entry marks a missing edge */
+const double noEdge = -1;
+
+/**
+ * exhaustive search for the assignment with the most pairs and then minimal cost,
+ * returns the cost and the number of pairs
+ */
+void bruteForce( const CostMatrix& cost, std::size_t row, std::vector< bool >& used, std::size_t pairs, double sum,
+	std::size_t& bestPairs, double& bestSum )
+{
+	if ( row == cost.size1() )
+	{
+		if ( pairs > bestPairs || ( pairs == bestPairs && sum < bestSum ) )
+		{
+			bestPairs = pairs;
+			bestSum = sum;
+		}
+		return;
+	}
+
+	// leave the row unassigned
+	bruteForce( cost, row + 1, used, pairs, sum, bestPairs, bestSum );
+	for ( std::size_t col = 0; col < cost.size2(); col++ )
+		if ( !used[ col ] && cost( row, col ) != noEdge )
+		{
+			used[ col ] = true;
+			bruteForce( cost, row + 1, used, pairs + 1, sum + cost( row, col ), bestPairs, bestSum );
+			used[ col ] = false;
+		}
+}
+
+/** checks that a row matching is a valid assignment and returns its cost */
+double checkMatching( const CostMatrix& cost, const std::vector< std::size_t >& rowMatch, std::size_t& pairs )
+{
+	BOOST_REQUIRE_EQUAL( rowMatch.size(), cost.size1() );
+	std::set< std::size_t > cols;
+	double sum = 0;
+	pairs = 0;
+	for ( std::size_t i = 0; i < rowMatch.size(); i++ )
+		if ( rowMatch[ i ] != Graph::unassigned )
+		{
+			BOOST_REQUIRE( rowMatch[ i ] < cost.size2() );
+			BOOST_CHECK( cost( i, rowMatch[ i ] ) != noEdge );
+			BOOST_CHECK( cols.insert( rowMatch[ i ] ).second );
+			sum += cost( i, rowMatch[ i ] );
+			pairs++;
+		}
+	return sum;
+}
+
+void testSmallProblems()
+{
+	for ( std::size_t iRun = 0; iRun < 300; iRun++ )
+	{
+		const std::size_t nRows = Random::distribute_uniform< std::size_t >( 1, 7 );
+		const std::size_t nCols = Random::distribute_uniform< std::size_t >( 1, 7 );
+		const double density = iRun < 100 ? 1.0 : Random::distribute_uniform< double >( 0.1, 0.8 );
+
+		CostMatrix cost( nRows, nCols );
+		Graph::SparseCostGraph< double > graph( nRows, nCols );
+		for ( std::size_t i = 0; i < nRows; i++ )
+			for ( std::size_t j = 0; j < nCols; j++ )
+				if ( Random::distribute_uniform< double >( 0, 1 ) <= density )
+				{
+					// some negative costs and many ties
+					cost( i, j ) = iRun % 2 ? Random::distribute_uniform< double >( 0, 100 ) : double( Random::distribute_uniform< int >( 0, 3 ) );
+					graph.addEdge( i, j, cost( i, j ) - 50 );
+				}
+				else
+					cost( i, j ) = noEdge;
+
+		std::vector< bool > used( nCols, false );
+		std::size_t bestPairs = 0;
+		double bestSum = std::numeric_limits< double >::max();
+		bruteForce( cost, 0, used, 0, 0, bestPairs, bestSum );
+
+		std::vector< std::size_t > rowMatch;
+		std::size_t pairs;
+		const double sparseSum = Graph::solveAssignment( graph, rowMatch );
+		BOOST_CHECK_SMALL( checkMatching( cost, rowMatch, pairs ) - bestSum, 1e-9 );
+		BOOST_CHECK_EQUAL( pairs, bestPairs );
+		BOOST_CHECK_SMALL( sparseSum + 50 * pairs - bestSum, 1e-9 );
+
+		if ( density == 1.0 )
+		{
+			const double denseSum = Graph::solveAssignment( cost, rowMatch );
+			BOOST_CHECK_SMALL( checkMatching( cost, rowMatch, pairs ) - bestSum, 1e-9 );
+			BOOST_CHECK_EQUAL( pairs, std::min( nRows, nCols ) );
+			BOOST_CHECK_SMALL( denseSum - bestSum, 1e-9 );
+		}
+	}
+
+	// empty problems
+	std::vector< std::size_t > rowMatch;
+	BOOST_CHECK_EQUAL( Graph::solveAssignment( CostMatrix( 0, 3 ), rowMatch ), 0.0 );
+	BOOST_CHECK( rowMatch.empty() );
+	BOOST_CHECK_EQUAL( Graph::solveAssignment( Graph::SparseCostGraph< double >( 2, 2 ), rowMatch ), 0.0 );
+	BOOST_CHECK( rowMatch[ 0 ] == Graph::unassigned && rowMatch[ 1 ] == Graph::unassigned );
+}
+
+
+/**
+ * blobs of a rectified stereo camera pair: the cost is the squared epipolar distance,
+ * which is the vertical offset of the blobs
+ */
+void stereoBlobs( const std::size_t n, CostMatrix& cost )
+{
+	std::vector< double > y1( n );
+	std::vector< double > y2( n );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		y1[ i ] = Random::distribute_uniform< double >( 0, 480 );
+		y2[ i ] = y1[ i ] + Random::distribute_normal< double >( 0, 0.3 );
+	}
+	std::random_shuffle( y2.begin(), y2.end() );
+
+	cost.resize( n, n, false );
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = 0; j < n; j++ )
+			cost( i, j ) = ( y1[ i ] - y2[ j ] ) * ( y1[ i ] - y2[ j ] );
+}
+
+/** compares the solvers on dense and gated blob correspondences and logs their times */
+void benchmarkBlobs( const std::size_t n )
+{
+	CostMatrix cost;
+	stereoBlobs( n, cost );
+	std::vector< std::size_t > rowMatch;
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	const double denseSum = Graph::solveAssignment( cost, rowMatch );
+	const double tDense = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	// 2 pixels gating threshold
+	const Graph::SparseCostGraph< double > graph( cost, 4.0 );
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	const double sparseSum = Graph::solveAssignment( graph, rowMatch );
+	const double tSparse = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	std::size_t pairs;
+	checkMatching( cost, rowMatch, pairs );
+	BOOST_CHECK_EQUAL( pairs, n );
+	BOOST_CHECK_CLOSE( sparseSum, denseSum, 1e-6 );
+
+	double tMunkres = 0;
+	if ( n <= 100 )
+	{
+		CostMatrix copy( cost );
+		start = Measurement::readClock( Measurement::clockMonotonic );
+		Graph::Munkres< double > munkres( copy );
+		munkres.solve();
+		const std::vector< std::size_t > munkresMatch( munkres.getRowMatchList() );
+		tMunkres = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+		BOOST_CHECK_CLOSE( checkMatching( cost, munkresMatch, pairs ), denseSum, 1e-6 );
+	}
+
+	LOG4CPP_INFO( timeLogger, n << " blob correspondences: dense " << tDense << " ms, gated (" << graph.size()
+		<< " edges) " << tSparse << " ms, Munkres " << tMunkres << " ms" );
+}
+
+} // anonymous namespace
+
+
+void TestLinearAssignment()
+{
+	testSmallProblems();
+
+	const std::size_t sizes[] = { 100, 500, 1000, 2000 };
+	for ( std::size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+		benchmarkBlobs( sizes[ i ] );
+}
@@ -6,6 +6,10 @@ void TestBlas2();
 void TestBlas3();
 void TestVectorFunctions();
 void TestLapack();
+void TestLevenbergMarquardt();
+void TestAutoDiff();
+void TestVectorList();
+void TestLinearAssignment();
 
 
 MathTest::MathTest()
@@ -16,4 +20,8 @@ MathTest::MathTest()
 	add( BOOST_TEST_CASE( &TestBlas3 ) );
 	add( BOOST_TEST_CASE( &TestVectorFunctions ) );
 	add( BOOST_TEST_CASE( &TestLapack ) );
+	add( BOOST_TEST_CASE( &TestLevenbergMarquardt ) );
+	add( BOOST_TEST_CASE( &TestAutoDiff ) );
+	add( BOOST_TEST_CASE( &TestVectorList ) );
+	add( BOOST_TEST_CASE( &TestLinearAssignment ) );
 }
@@ -0,0 +1,167 @@
+
+#include <utMath/VectorList.h>
+#include <utMath/Pose.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Geometry/PointProjection.h>
+#include <utMeasurement/Measurement.h>
+#include <utAlgorithm/Projection.h>
+#include <utAlgorithm/PoseEstimation2D3D/PlanarPoseEstimation.h>
+#include <utAlgorithm/PoseEstimation3D3D/AbsoluteOrientation.h>
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+typedef VectorList< double, 3 > List3;
+typedef std::vector< Vector< double, 3 > > Vector3List;
+
+/** storage of a list without detaching it */
+const double* storage( const List3& list )
+{
+	return list.data();
+}
+
+void testStorage()
+{
+	Vector3List points;
+	for ( std::size_t i = 0; i < 10; i++ )
+		points.push_back( Vector< double, 3 >( double( i ), i + 0.25, i + 0.5 ) );
+
+	// packed layout
+	List3 list( points );
+	BOOST_CHECK_EQUAL( list.size(), points.size() );
+	for ( std::size_t i = 0; i < points.size(); i++ )
+		for ( std::size_t j = 0; j < 3; j++ )
+		{
+			BOOST_CHECK_EQUAL( list.data()[ i * 3 + j ], points[ i ]( j ) );
+			BOOST_CHECK_EQUAL( list( i, j ), points[ i ]( j ) );
+		}
+	BOOST_CHECK( list.toVector() == points );
+	BOOST_CHECK( List3( points.begin(), points.end() ).toVector() == points );
+	BOOST_CHECK_THROW( list.at( 10 ), std::out_of_range );
+
+	// iterators
+	BOOST_CHECK_EQUAL( std::size_t( std::distance( list.begin(), list.end() ) ), points.size() );
+	BOOST_CHECK( std::equal( list.begin(), list.end(), points.begin() ) );
+	BOOST_CHECK( list.begin()[ 4 ] == points[ 4 ] );
+
+	// copies and slices share the storage until they are modified
+	const double* pData = storage( list );
+	List3 copy( list );
+	List3 slice( list.slice( 2, 5 ) );
+	BOOST_CHECK( list.shared() );
+	BOOST_CHECK_EQUAL( storage( copy ), pData );
+	BOOST_CHECK_EQUAL( storage( slice ), pData + 6 );
+	BOOST_CHECK_EQUAL( slice.size(), std::size_t( 3 ) );
+	BOOST_CHECK( slice[ 0 ] == points[ 2 ] );
+
+	copy.set( 0, Vector< double, 3 >( -1, -1, -1 ) );
+	BOOST_CHECK( storage( copy ) != pData );
+	BOOST_CHECK( list[ 0 ] == points[ 0 ] );
+	BOOST_CHECK_EQUAL( copy( 0, 2 ), -1.0 );
+
+	slice.push_back( Vector< double, 3 >( 7, 7, 7 ) );
+	BOOST_CHECK_EQUAL( slice.size(), std::size_t( 4 ) );
+	BOOST_CHECK( slice[ 0 ] == points[ 2 ] );
+	BOOST_CHECK_EQUAL( slice( 3, 1 ), 7.0 );
+	BOOST_CHECK( list[ 5 ] == points[ 5 ] );
+	BOOST_CHECK( !list.shared() );
+
+	// views
+	VectorListView< double, 3 > view( list );
+	BOOST_CHECK_EQUAL( view.data(), pData );
+	BOOST_CHECK( view.subview( 3, 6 )[ 1 ] == points[ 4 ] );
+	BOOST_CHECK( List3( view.subview( 3, 6 ) ).toVector() == Vector3List( points.begin() + 3, points.begin() + 6 ) );
+
+	// resizing and empty lists
+	List3 empty;
+	BOOST_CHECK( empty.empty() );
+	BOOST_CHECK( empty.begin() == empty.end() );
+	empty.resize( 2 );
+	BOOST_CHECK_EQUAL( empty( 1, 2 ), 0.0 );
+	list.clear();
+	BOOST_CHECK( list.empty() );
+	BOOST_CHECK( copy[ 1 ] == points[ 1 ] );
+
+	// measurements share the payload between copies and clones until it is modified
+	Measurement::PackedPositionList m( 1, List3( points ) );
+	Measurement::PackedPositionList c( m.clone() );
+	BOOST_CHECK_EQUAL( storage( *c ), storage( *m ) );
+	c->set( 0, Vector< double, 3 >( 1, 1, 1 ) );
+	BOOST_CHECK( ( *m )[ 0 ] == points[ 0 ] );
+}
+
+
+#ifdef HAVE_LAPACK
+
+void testAlgorithms()
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Uniform randVector( -0.5, 0.5 );
+
+	for ( std::size_t iRun = 0; iRun < 10; iRun++ )
+	{
+		Matrix< double, 3, 3 > cam( Matrix< double, 3, 3 >::identity() );
+		cam( 0, 0 ) = cam( 1, 1 ) = Random::distribute_uniform< double >( 200, 800 );
+		const Pose pose( randQuat(), Vector< double, 3 >( 0.1, -0.2, Random::distribute_uniform< double >( 5, 10 ) ) );
+		Matrix< double, 3, 4 > proj( pose.rotation(), pose.translation() );
+		proj = boost::numeric::ublas::prod( cam, proj );
+
+		std::vector< Vector< double, 3 > > p3D;
+		std::generate_n( std::back_inserter( p3D ), 20, randVector );
+		std::vector< Vector< double, 2 > > p2D;
+		Geometry::project_points( proj, p3D.begin(), p3D.end(), std::back_inserter( p2D ) );
+
+		const VectorList< double, 3 > list3D( p3D );
+		const VectorList< double, 2 > list2D( p2D );
+
+		// 3D-3D pose
+		std::vector< Vector< double, 3 > > p3DMoved;
+		for ( std::size_t i = 0; i < p3D.size(); i++ )
+			p3DMoved.push_back( pose * p3D[ i ] );
+		const VectorList< double, 3 > list3DMoved( p3DMoved );
+		Pose fromVector;
+		Pose fromList;
+		BOOST_CHECK( Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( p3DMoved, fromVector, p3D ) );
+		BOOST_CHECK( Algorithm::PoseEstimation3D3D::estimatePose6D_3D3D( list3DMoved, fromList, list3D ) );
+		BOOST_CHECK( fromVector == fromList );
+
+		// projection matrix
+		const Matrix< double, 3, 4 > pFromVector( Algorithm::projectionDLT( p3D, p2D ) );
+		const Matrix< double, 3, 4 > pFromList( Algorithm::projectionDLT( list3D, list2D ) );
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_inf( pFromVector - pFromList ) ), 1e-12 );
+
+		// 2D-3D pose
+		double resVector;
+		double resList;
+		const ErrorPose eVector( Algorithm::PoseEstimation2D3D::computePose( p2D, p3D, cam, resVector, true, Algorithm::PoseEstimation2D3D::NONPLANAR_PROJECTION ) );
+		const ErrorPose eList( Algorithm::PoseEstimation2D3D::computePose( list2D, list3D, cam, resList, true, Algorithm::PoseEstimation2D3D::NONPLANAR_PROJECTION ) );
+		BOOST_CHECK_SMALL( resVector - resList, 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_2( eVector.translation() - eList.translation() ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( boost::numeric::ublas::norm_inf( eVector.covariance() - eList.covariance() ) ), 1e-9 );
+	}
+}
+
+#endif // HAVE_LAPACK
+
+} // anonymous namespace
+
+
+void TestVectorList()
+{
+	testStorage();
+#ifdef HAVE_LAPACK
+	testAlgorithms();
+#endif
+}
@@ -0,0 +1,182 @@
+
+#include <utMeasurement/Timestamp.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
+
+#include <algorithm>
+
+#include <boost/thread/mutex.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Measurement.Clock" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Measurement;
+
+namespace {
+
+const ClockSource g_sources[ 3 ] = { clockRealtime, clockMonotonic, clockTsc };
+
+/** absolute difference of two timestamps */
+Timestamp distance( Timestamp a, Timestamp b )
+{
+	return a > b ? a - b : b - a;
+}
+
+void testSource( ClockSource source )
+{
+	// all sources return wall clock time
+	BOOST_CHECK_LT( distance( readClock( source ), readClock( clockRealtime ) ), Timestamp( 50000000 ) );
+
+	if ( source == clockRealtime )
+		return;
+
+	// monotonic over a longer period, including synchronizations of the TSC
+	const Timestamp start = readClock( clockRealtime );
+	Timestamp last = readClock( source );
+	std::size_t nBackwards = 0;
+	while ( readClock( clockRealtime ) - start < 200000000 )
+	{
+		const Timestamp t = readClock( source );
+		nBackwards += t < last;
+		last = t;
+	}
+	BOOST_CHECK_EQUAL( nBackwards, std::size_t( 0 ) );
+	BOOST_CHECK_LT( distance( readClock( source ), readClock( clockRealtime ) ), Timestamp( 1000000 ) );
+}
+
+/**
+ * reads a clock from several threads, counts the reads that return less than a read of another
+ * thread that finished before it started
+ */
+class ConcurrentReader
+{
+public:
+	ConcurrentReader( ClockSource source )
+		: m_source( source )
+		, m_last( 0 )
+		, m_nBackwards( 0 )
+	{}
+
+	void operator()( std::size_t )
+	{
+		const Timestamp start = readClock( clockRealtime );
+		while ( readClock( clockRealtime ) - start < 200000000 )
+		{
+			Timestamp before;
+			{
+				boost::mutex::scoped_lock lock( m_mutex );
+				before = m_last;
+			}
+
+			const Timestamp t = readClock( m_source );
+
+			boost::mutex::scoped_lock lock( m_mutex );
+			m_nBackwards += t < before;
+			m_last = std::max( m_last, t );
+		}
+	}
+
+	std::size_t backwards() const
+	{ return m_nBackwards; }
+
+protected:
+	ClockSource m_source;
+	boost::mutex m_mutex;
+	Timestamp m_last;
+	std::size_t m_nBackwards;
+};
+
+void testConcurrentSource( ClockSource source )
+{
+	Util::ThreadPool pool( 4 );
+	ConcurrentReader reader( source );
+	pool.parallelFor( 4, reader );
+	BOOST_CHECK_EQUAL( reader.backwards(), std::size_t( 0 ) );
+}
+
+/** logs the cost of a read and the smallest observed increment */
+void benchmarkSource( ClockSource source )
+{
+	const std::size_t nReads = 1000000;
+	Timestamp resolution = ~Timestamp( 0 );
+	Timestamp last = readClock( source );
+	const Timestamp start = readClock( clockMonotonic );
+	for ( std::size_t i = 0; i < nReads; i++ )
+	{
+		const Timestamp t = readClock( source );
+		if ( t > last )
+			resolution = std::min( resolution, t - last );
+		last = t;
+	}
+	const Timestamp duration = readClock( clockMonotonic ) - start;
+
+	LOG4CPP_INFO( timeLogger, "clock " << clockSourceName( source ) << ": " << double( duration ) / nReads
+		<< " ns/call, resolution " << resolution << " ns" );
+}
+
+void benchmarkNowFast()
+{
+	const std::size_t nReads = 1000000;
+	Timestamp sum = 0;
+	const Timestamp start = readClock( clockMonotonic );
+	for ( std::size_t i = 0; i < nReads; i++ )
+		sum += nowFast();
+	const Timestamp duration = readClock( clockMonotonic ) - start;
+
+	LOG4CPP_INFO( timeLogger, "nowFast: " << double( duration ) / nReads << " ns/call (" << sum % 2 << ")" );
+}
+
+} // anonymous namespace
+
+
+void TestClock()
+{
+	// now() uses the wall clock unless another source is selected
+	const ClockSource defaultSource = getClockSource();
+	BOOST_CHECK_EQUAL( defaultSource, clockRealtime );
+	BOOST_CHECK( isClockSourceAvailable( clockRealtime ) );
+
+	for ( std::size_t i = 0; i < 3; i++ )
+	{
+		const ClockSource source = g_sources[ i ];
+		if ( !isClockSourceAvailable( source ) )
+		{
+			BOOST_CHECK( !setClockSource( source ) );
+			continue;
+		}
+
+		testSource( source );
+		if ( source != clockRealtime )
+			testConcurrentSource( source );
+
+		// now() follows the selected source
+		BOOST_CHECK( setClockSource( source ) );
+		BOOST_CHECK_EQUAL( getClockSource(), source );
+		BOOST_CHECK_LT( distance( now(), readClock( source ) ), Timestamp( 1000000 ) );
+	}
+	setClockSource( defaultSource );
+
+	BOOST_CHECK_LT( distance( nowFast(), now() ), Timestamp( 50000000 ) );
+
+	// nowFast() keeps its own monotonic source while now() reads the wall clock
+	setClockSource( clockRealtime );
+	const Timestamp start = readClock( clockMonotonic );
+	Timestamp last = nowFast();
+	std::size_t nBackwards = 0;
+	while ( readClock( clockMonotonic ) - start < 100000000 )
+	{
+		const Timestamp t = nowFast();
+		nBackwards += t < last;
+		last = t;
+	}
+	BOOST_CHECK_EQUAL( nBackwards, std::size_t( 0 ) );
+	setClockSource( defaultSource );
+
+	for ( std::size_t i = 0; i < 3; i++ )
+		if ( isClockSourceAvailable( g_sources[ i ] ) )
+			benchmarkSource( g_sources[ i ] );
+	benchmarkNowFast();
+}
@@ -0,0 +1,16 @@
+#include "MeasurementTest.h"
+
+// declare external tests here, to save us some trivial header files
+void TestClock();
+void TestPoolAllocator();
+void TestTimestampSync();
+
+
+
+MeasurementTest::MeasurementTest()
+	: boost::unit_test::test_suite( "MeasurementTests" )
+{
+	add( BOOST_TEST_CASE( &TestClock ) );
+	add( BOOST_TEST_CASE( &TestPoolAllocator ) );
+	add( BOOST_TEST_CASE( &TestTimestampSync ) );
+}
@@ -0,0 +1,180 @@
+
+#include <utMeasurement/Measurement.h>
+#include <utMeasurement/PoolAllocator.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/detail/atomic_count.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Measurement.PoolAllocator" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** number of allocations of all \c CountingAllocator instances */
+boost::detail::atomic_count g_nAllocations( 0 );
+
+/** standard allocator that counts its allocations, used as upstream of the pools */
+template< class T >
+class CountingAllocator
+	: public std::allocator< T >
+{
+public:
+	template< class U >
+	struct rebind
+	{ typedef CountingAllocator< U > other; };
+
+	CountingAllocator()
+	{}
+
+	template< class U >
+	CountingAllocator( const CountingAllocator< U >& )
+	{}
+
+	T* allocate( std::size_t n, const void* = 0 )
+	{
+		++g_nAllocations;
+		return std::allocator< T >::allocate( n );
+	}
+};
+
+/** like \c Measurement::make, but with pools that count their allocations */
+template< class M >
+M makeCounted( Measurement::Timestamp t, const typename M::value_type& value )
+{
+	typedef typename M::value_type Type;
+	return M( t, boost::allocate_shared< Type >( Measurement::PoolAllocator< Type, CountingAllocator< char > >(), value ) );
+}
+
+Math::Pose randomPose( std::size_t i )
+{
+	return Math::Pose( Quaternion( Vector< double, 3 >( 0, 0, 1 ), 0.001 * i ), Vector< double, 3 >( 0.1 * i, 1, 2 ) );
+}
+
+Math::ErrorPose randomErrorPose( std::size_t i )
+{
+	return Math::ErrorPose( randomPose( i ), 1e-4 * Matrix< double, 6, 6 >::identity() );
+}
+
+std::vector< Vector< double, 3 > > randomPositionList( std::size_t i )
+{
+	return std::vector< Vector< double, 3 > >( 20, Vector< double, 3 >( 0.1 * i, 1, 2 ) );
+}
+
+/** creates measurements in several threads */
+struct ParallelMake
+{
+	std::vector< Measurement::Pose >& m_result;
+
+	ParallelMake( std::vector< Measurement::Pose >& result )
+		: m_result( result )
+	{}
+
+	void operator()( std::size_t i )
+	{
+		for ( std::size_t j = 0; j < 100; j++ )
+			m_result[ i * 100 + j ] = Measurement::make< Measurement::Pose >( i * 100 + j, randomPose( j ) );
+	}
+};
+
+/**
+ * Simulates a pipeline that keeps the last \c nLive measurements: creates \c nSamples
+ * measurements with and without the pool and logs the throughput. Checks that the pools
+ * reuse their blocks, i.e. hardly allocate from their upstream allocator after a warm-up.
+ */
+template< class M, class F >
+void benchmarkMake( const std::string& name, F create, std::size_t nSamples )
+{
+	const std::size_t nLive = 64;
+	const typename M::value_type value( create( 1 ) );
+
+	for ( int pooled = 0; pooled < 2; pooled++ )
+	{
+		std::vector< M > live( nLive );
+
+		// warm up the pool
+		for ( std::size_t i = 0; i < nLive; i++ )
+			live[ i ] = Measurement::make< M >( i + 1, value );
+
+		const Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+		for ( std::size_t i = 0; i < nSamples; i++ )
+			if ( pooled )
+				live[ i % nLive ] = Measurement::make< M >( i + 1, value );
+			else
+				live[ i % nLive ] = M( i + 1, value );
+		const Measurement::Timestamp duration = Measurement::readClock( Measurement::clockMonotonic ) - start;
+
+		LOG4CPP_INFO( timeLogger, name << ( pooled ? ", make<>: " : ", new: " ) << 1e9 * nSamples / duration << " samples/s" );
+	}
+
+	std::vector< M > live( nLive );
+	for ( std::size_t i = 0; i < nLive; i++ )
+		live[ i ] = makeCounted< M >( i + 1, value );
+
+	const long nAllocStart = g_nAllocations;
+	for ( std::size_t i = 0; i < nSamples; i++ )
+		live[ i % nLive ] = makeCounted< M >( i + 1, value );
+	const double allocPerSample = double( g_nAllocations - nAllocStart ) / nSamples;
+
+	LOG4CPP_INFO( timeLogger, name << ": " << allocPerSample << " pool allocations/sample" );
+	BOOST_CHECK_LT( allocPerSample, 0.01 );
+}
+
+} // anonymous namespace
+
+
+void TestPoolAllocator()
+{
+	// construction from values and from constructor arguments
+	const Math::Pose pose( randomPose( 3 ) );
+	Measurement::Pose a( Measurement::make< Measurement::Pose >( 12345, pose ) );
+	BOOST_CHECK_EQUAL( a.time(), Measurement::Timestamp( 12345 ) );
+	BOOST_CHECK( *a == pose );
+	Measurement::Pose b( Measurement::make< Measurement::Pose >( 12346, pose.rotation(), pose.translation() ) );
+	BOOST_CHECK( *b == pose );
+	Measurement::Position p( Measurement::make< Measurement::Position >( 1, Vector< double, 3 >( 1, 2, 3 ) ) );
+	BOOST_CHECK_EQUAL( ( *p )( 2 ), 3.0 );
+	Measurement::PositionList l( Measurement::make< Measurement::PositionList >( 1, randomPositionList( 1 ) ) );
+	BOOST_CHECK_EQUAL( l->size(), std::size_t( 20 ) );
+	Measurement::PositionList e( Measurement::make< Measurement::PositionList >( 1 ) );
+	BOOST_CHECK( e->empty() );
+
+	// shared_ptr semantics
+	Measurement::Pose c( a );
+	BOOST_CHECK_EQUAL( a.use_count(), 2 );
+	*a = randomPose( 4 );
+	BOOST_CHECK( *c == randomPose( 4 ) );
+	Measurement::Pose d( a.clone() );
+	*a = pose;
+	BOOST_CHECK( *d == randomPose( 4 ) );
+	BOOST_CHECK( *c == pose );
+	boost::shared_ptr< Math::Pose > sp( c );
+	a.reset();
+	c.reset();
+	BOOST_CHECK( *sp == pose );
+
+	// allocated in worker threads, released in this thread
+	{
+		Ubitrack::Util::ThreadPool pool( 4 );
+		std::vector< Measurement::Pose > poses( 1000 );
+		ParallelMake f( poses );
+		pool.parallelFor( 10, f );
+		for ( std::size_t i = 0; i < poses.size(); i++ )
+		{
+			BOOST_CHECK_EQUAL( poses[ i ].time(), Measurement::Timestamp( i ) );
+			BOOST_CHECK( *poses[ i ] == randomPose( i % 100 ) );
+		}
+	}
+
+	benchmarkMake< Measurement::Pose >( "Pose", &randomPose, 1000000 );
+	benchmarkMake< Measurement::ErrorPose >( "ErrorPose", &randomErrorPose, 1000000 );
+	benchmarkMake< Measurement::PositionList >( "PositionList", &randomPositionList, 1000000 );
+}
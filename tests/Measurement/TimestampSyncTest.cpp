@@ -0,0 +1,182 @@
+
+#include <utMeasurement/TimestampSync.h>
+#include <utMeasurement/TimestampSyncLS.h>
+#include <utMeasurement/TimestampSyncOffline.h>
+#include <utMeasurement/Clock.h>
+#include <utMath/Random/Scalar.h>
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Measurement.TimestampSync" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Measurement;
+
+namespace {
+
+/**
+ * a 100 Hz sensor with a 1 MHz clock that drifts by 50 ppm against the local clock. The local
+ * timestamps are taken after a latency of 0.5 ms plus exponential jitter, 5% of them are
+ * delayed by another 5 to 20 ms.
+ */
+void sensorRecording( const std::size_t n, std::vector< double >& native, std::vector< Timestamp >& local,
+	std::vector< Timestamp >& truth, double& gain )
+{
+	gain = 1000 * ( 1 + 50e-6 );
+	const Timestamp start = 1400000000000000000ULL;
+	native.resize( n );
+	local.resize( n );
+	truth.resize( n );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		native[ i ] = 12345.0 + 10000.0 * i;
+		truth[ i ] = start + static_cast< Timestamp >( gain * 10000.0 * i );
+		double latency = 500000 - 300000 * std::log( Math::Random::distribute_uniform< double >( 1e-9, 1 ) );
+		if ( Math::Random::distribute_uniform< double >( 0, 1 ) < 0.05 )
+			latency += Math::Random::distribute_uniform< double >( 5e6, 2e7 );
+		local[ i ] = truth[ i ] + static_cast< Timestamp >( latency );
+	}
+}
+
+/** mean and standard deviation of the difference of converted and true times, in ns */
+void errorStatistics( const std::vector< Timestamp >& converted, const std::vector< Timestamp >& truth, const std::size_t begin,
+	double& mean, double& deviation )
+{
+	double sum = 0;
+	double sum2 = 0;
+	for ( std::size_t i = begin; i < truth.size(); i++ )
+	{
+		const double e = static_cast< double >( static_cast< long long >( converted[ i ] - truth[ i ] ) );
+		sum += e;
+		sum2 += e * e;
+	}
+	const double n = static_cast< double >( truth.size() - begin );
+	mean = sum / n;
+	deviation = std::sqrt( std::max( 0.0, sum2 / n - mean * mean ) );
+}
+
+/** the batch conversions equal the single ones */
+void testBatch()
+{
+	std::vector< double > native;
+	std::vector< Timestamp > local;
+	std::vector< Timestamp > truth;
+	double gain;
+	sensorRecording( 2000, native, local, truth, gain );
+
+	TimestampSync single( 1e6 );
+	std::vector< Timestamp > expected( native.size() );
+	for ( std::size_t i = 0; i < native.size(); i++ )
+		expected[ i ] = single.convertNativeToLocal( native[ i ], local[ i ] );
+
+	TimestampSync batch( 1e6 );
+	std::vector< Timestamp > converted( native.size() );
+	batch.convertNativeToLocal( 500, &native[ 0 ], &local[ 0 ], &converted[ 0 ] );
+	batch.convertNativeToLocal( native.size() - 500, &native[ 500 ], &local[ 500 ], &converted[ 500 ] );
+	BOOST_CHECK( converted == expected );
+	BOOST_CHECK_EQUAL( batch.getEventCount(), native.size() );
+	BOOST_CHECK_EQUAL( batch.predictNativeToLocal( native.back() ), expected.back() );
+
+	// in place
+	TimestampSyncLS singleLS;
+	for ( std::size_t i = 0; i < native.size(); i++ )
+		expected[ i ] = singleLS.convertNativeToLocal( native[ i ], local[ i ] );
+	TimestampSyncLS batchLS;
+	converted = local;
+	batchLS.convertNativeToLocal( native.size(), &native[ 0 ], &converted[ 0 ], &converted[ 0 ] );
+	BOOST_CHECK( converted == expected );
+
+	double mean;
+	double deviation;
+	errorStatistics( expected, truth, native.size() / 2, mean, deviation );
+	LOG4CPP_INFO( timeLogger, "online least squares after convergence: error " << mean * 1e-3 << " +- " << deviation * 1e-3 << " us" );
+}
+
+/** the offline fit recovers drift and offset despite jitter and outliers */
+void testOffline()
+{
+	std::vector< double > native;
+	std::vector< Timestamp > local;
+	std::vector< Timestamp > truth;
+	double gain;
+	sensorRecording( 20000, native, local, truth, gain );
+
+	TimestampSyncOffline offline;
+	offline.fit( native.size(), &native[ 0 ], &local[ 0 ] );
+	BOOST_CHECK_EQUAL( offline.getEventCount(), native.size() );
+	BOOST_CHECK_CLOSE( offline.getGain(), gain, 1e-4 );
+
+	std::vector< Timestamp > converted( native.size() );
+	offline.convertNativeToLocal( native.size(), &native[ 0 ], &converted[ 0 ] );
+	double mean;
+	double deviation;
+	errorStatistics( converted, truth, 0, mean, deviation );
+
+	// the converted times are the true times plus a constant close to the median latency of about 0.7 ms
+	BOOST_CHECK_CLOSE( mean, 500000 + 300000 * std::log( 2.0 ), 10.0 );
+	BOOST_CHECK_SMALL( deviation, 5000.0 );
+	BOOST_CHECK_EQUAL( offline.convertNativeToLocal( native[ 10 ] ), converted[ 10 ] );
+	BOOST_CHECK( offline.getDeviation() > 1e5 && offline.getDeviation() < 1e6 );
+
+	TimestampSync online( 1e6 );
+	std::vector< Timestamp > onlineConverted( native.size() );
+	online.convertNativeToLocal( native.size(), &native[ 0 ], &local[ 0 ], &onlineConverted[ 0 ] );
+	double onlineMean;
+	double onlineDeviation;
+	errorStatistics( onlineConverted, truth, native.size() / 2, onlineMean, onlineDeviation );
+	LOG4CPP_INFO( timeLogger, "error of converted times: Kalman filter " << onlineMean * 1e-3 << " +- " << onlineDeviation * 1e-3
+		<< " us, offline fit " << mean * 1e-3 << " +- " << deviation * 1e-3 << " us" );
+
+	// errors
+	BOOST_CHECK_THROW( offline.fit( 1, &native[ 0 ], &local[ 0 ] ), Ubitrack::Util::Exception );
+	const std::vector< double > constant( 10, 5.0 );
+	BOOST_CHECK_THROW( offline.fit( constant.size(), &constant[ 0 ], &local[ 0 ] ), Ubitrack::Util::Exception );
+}
+
+/** logs the time per timestamp of the online filters and of the offline fit */
+void benchmark( const std::size_t n )
+{
+	std::vector< double > native;
+	std::vector< Timestamp > local;
+	std::vector< Timestamp > truth;
+	double gain;
+	sensorRecording( n, native, local, truth, gain );
+	std::vector< Timestamp > converted( n );
+
+	TimestampSync sync( 1e6 );
+	Timestamp start = readClock( clockMonotonic );
+	sync.convertNativeToLocal( n, &native[ 0 ], &local[ 0 ], &converted[ 0 ] );
+	const double tKalman = static_cast< double >( readClock( clockMonotonic ) - start ) / n;
+
+	TimestampSyncLS syncLS;
+	start = readClock( clockMonotonic );
+	syncLS.convertNativeToLocal( n, &native[ 0 ], &local[ 0 ], &converted[ 0 ] );
+	const double tLS = static_cast< double >( readClock( clockMonotonic ) - start ) / n;
+
+	TimestampSyncOffline offline;
+	start = readClock( clockMonotonic );
+	offline.fit( n, &native[ 0 ], &local[ 0 ] );
+	offline.convertNativeToLocal( n, &native[ 0 ], &converted[ 0 ] );
+	const double tOffline = static_cast< double >( readClock( clockMonotonic ) - start ) / n;
+
+	LOG4CPP_INFO( timeLogger, n << " timestamps: Kalman filter " << tKalman << " ns, least squares " << tLS
+		<< " ns, offline fit and conversion " << tOffline << " ns per timestamp" );
+}
+
+} // anonymous namespace
+
+
+void TestTimestampSync()
+{
+	testBatch();
+	testOffline();
+	benchmark( 100000 );
+	benchmark( 1000000 );
+}
@@ -0,0 +1,251 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/ErrorPose.h>
+#include <utMath/ErrorVector.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Stochastic/CovarianceTransform.h>
+#include <utMath/Optimization/Function/VectorNormalize.h>
+#include <utMeasurement/Measurement.h>
+#include <utMeasurement/Clock.h>
+
+#ifdef HAVE_LAPACK
+#include <utTracking/PoseKalmanFilter.h>
+#endif
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.CovarianceTransform" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+template< class MT >
+void randomMatrix( MT& m )
+{
+	for ( std::size_t i = 0; i < m.size1(); i++ )
+		for ( std::size_t j = 0; j < m.size2(); j++ )
+			m( i, j ) = Random::distribute_uniform< double >( -1, 1 );
+}
+
+template< class MT >
+void randomCovariance( MT& cov )
+{
+	MT a( cov.size1(), cov.size2() );
+	randomMatrix( a );
+	cov = ublas::prod( a, ublas::trans( a ) );
+}
+
+ErrorPose randomErrorPose()
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Matrix< double, 6, 6 > cov;
+	randomCovariance( cov );
+	return ErrorPose( randQuat(), Vector< double, 3 >( Random::distribute_uniform< double >( -1, 1 ),
+		Random::distribute_uniform< double >( -1, 1 ), Random::distribute_uniform< double >( -1, 1 ) ), 1e-3 * cov );
+}
+
+/** y = A * x */
+template< std::size_t M, std::size_t N >
+class LinearFunction
+{
+public:
+	LinearFunction( const Matrix< double, M, N >& a )
+		: m_a( a )
+	{}
+
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& j ) const
+	{
+		result = ublas::prod( m_a, input );
+		j = m_a;
+	}
+
+	template< class VT1, class VT2, class VT3, class MT1, class MT2 >
+	void evaluateWithJacobian( VT1& result, const VT2& input1, const VT3& input2, MT1& j1, MT2& j2 ) const
+	{
+		result = ublas::prod( m_a, input1 ) + ublas::prod( m_a, input2 );
+		j1 = m_a;
+		j2 = m_a;
+	}
+
+protected:
+	Matrix< double, M, N > m_a;
+};
+
+template< class MT1, class MT2 >
+std::size_t countDifferences( const MT1& a, const MT2& b )
+{
+	std::size_t n = 0;
+	for ( std::size_t i = 0; i < a.size1(); i++ )
+		for ( std::size_t j = 0; j < a.size2(); j++ )
+			if ( a( i, j ) != b( i, j ) )
+				n++;
+	return n;
+}
+
+void testTransform()
+{
+	Matrix< double, 3, 6 > a;
+	randomMatrix( a );
+	const LinearFunction< 3, 6 > f( a );
+
+	ErrorVector< double, 6 > in;
+	for ( std::size_t i = 0; i < 6; i++ )
+		in.value( i ) = Random::distribute_uniform< double >( -1, 1 );
+	randomCovariance( in.covariance );
+
+	const Matrix< double, 3, 3 > refCov( ublas::prod( Matrix< double, 3, 6 >( ublas::prod( a, in.covariance ) ), ublas::trans( a ) ) );
+
+	// fixed-size path
+	const ErrorVector< double, 3 > out( Stochastic::transformWithCovariance< 3, 6 >( f, in ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( out.covariance - refCov ) ), 1e-12 );
+	BOOST_CHECK_EQUAL( countDifferences( out.covariance, ublas::trans( out.covariance ) ), std::size_t( 0 ) );
+
+	// dynamic path
+	Vector< double > dynValue( 3 );
+	Matrix< double > dynCov( 3, 3 );
+	Stochastic::transformWithCovariance( f, dynValue, dynCov, Vector< double >( in.value ), Matrix< double >( in.covariance ) );
+	BOOST_CHECK_EQUAL( countDifferences( dynCov, out.covariance ), std::size_t( 0 ) );
+
+	// two inputs
+	const ErrorVector< double, 3 > outBinary( Stochastic::binarytransformWithCovariance< 3, 6, 6 >( f, in, in ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( outBinary.covariance - 2 * refCov ) ), 1e-12 );
+	BOOST_CHECK_EQUAL( countDifferences( outBinary.covariance, ublas::trans( outBinary.covariance ) ), std::size_t( 0 ) );
+
+	// in place
+	Matrix< double, 6, 6 > square;
+	randomMatrix( square );
+	ErrorVector< double, 6 > inPlace( in );
+	Stochastic::transformWithCovariance( LinearFunction< 6, 6 >( square ), inPlace.value, inPlace.covariance, inPlace.value, inPlace.covariance );
+	const Matrix< double, 6, 6 > refSquare( ublas::prod( Matrix< double, 6, 6 >( ublas::prod( square, in.covariance ) ), ublas::trans( square ) ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( inPlace.covariance - refSquare ) ), 1e-12 );
+}
+
+void testRangeTransform()
+{
+	ErrorVector< double, 7 > v;
+	for ( std::size_t i = 0; i < 7; i++ )
+		v.value( i ) = Random::distribute_uniform< double >( -1, 1 );
+	randomCovariance( v.covariance );
+
+	// the fixed range gives exactly the result of the runtime range
+	for ( unsigned iBegin = 0; iBegin < 4; iBegin++ )
+	{
+		ErrorVector< double, 7 > runtime( v );
+		Stochastic::transformRangeInternalWithCovariance( Optimization::Function::VectorNormalize( 4 ),
+			runtime.value, runtime.covariance, iBegin, iBegin + 4, iBegin, iBegin + 4 );
+
+		ErrorVector< double, 7 > fixed( v );
+		Stochastic::transformRangeInternalWithCovariance< 4, 4 >( Optimization::Function::VectorNormalize( 4 ),
+			fixed.value, fixed.covariance, iBegin, iBegin );
+
+		BOOST_CHECK_EQUAL( countDifferences( runtime.covariance, fixed.covariance ), std::size_t( 0 ) );
+		BOOST_CHECK_SMALL( double( ublas::norm_inf( runtime.value - fixed.value ) ), 0.0 );
+	}
+
+	// additive error conversion round trip of poses
+	const ErrorPose p( randomErrorPose() );
+	ErrorVector< double, 7 > additive;
+	ErrorPose( p ).toAdditiveErrorVector( additive );
+	const ErrorPose back( ErrorPose::fromAdditiveErrorVector( additive ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( back.covariance() - p.covariance() ) ), 1e-12 );
+}
+
+void testErrorPose()
+{
+	const ErrorPose a( randomErrorPose() );
+	const ErrorPose b( randomErrorPose() );
+
+	// covariances stay exactly symmetric
+	const ErrorPose ab( a * b );
+	const ErrorPose ai( ~a );
+	const ErrorPose aib( invertMultiply( a, b ) );
+	BOOST_CHECK_EQUAL( countDifferences( ab.covariance(), ublas::trans( ab.covariance() ) ), std::size_t( 0 ) );
+	BOOST_CHECK_EQUAL( countDifferences( ai.covariance(), ublas::trans( ai.covariance() ) ), std::size_t( 0 ) );
+	BOOST_CHECK_EQUAL( countDifferences( aib.covariance(), ublas::trans( aib.covariance() ) ), std::size_t( 0 ) );
+
+	// the covariance of a product is the sum of the transformed covariances
+	const ErrorPose aOnly( a * static_cast< const Pose& >( b ) );
+	const ErrorPose bOnly( static_cast< const Pose& >( a ) * b );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( ab.covariance() - aOnly.covariance() - bOnly.covariance() ) ), 1e-12 );
+}
+
+void benchmarkErrorPose( const int nRuns )
+{
+	std::vector< ErrorPose > poses;
+	for ( int i = 0; i < 100; i++ )
+		poses.push_back( randomErrorPose() );
+
+	ErrorPose result;
+	Measurement::Timestamp t0 = Measurement::readClock( Measurement::clockMonotonic );
+	for ( int run = 0; run < nRuns; run++ )
+		for ( std::size_t i = 1; i < poses.size(); i++ )
+			result = poses[ i - 1 ] * poses[ i ];
+	Measurement::Timestamp t1 = Measurement::readClock( Measurement::clockMonotonic );
+	for ( int run = 0; run < nRuns; run++ )
+		for ( std::size_t i = 0; i < poses.size(); i++ )
+			result = ~poses[ i ];
+	Measurement::Timestamp t2 = Measurement::readClock( Measurement::clockMonotonic );
+
+	const double nOps = double( nRuns ) * poses.size();
+	LOG4CPP_INFO( timeLogger, "ErrorPose * ErrorPose: " << ( t1 - t0 ) / nOps << "ns, ~ErrorPose: " << ( t2 - t1 ) / nOps << "ns" );
+}
+
+#ifdef HAVE_LAPACK
+
+void benchmarkKalmanTimeUpdate( const int posOrder, const int oriOrder, const int nRuns )
+{
+	Tracking::LinearPoseMotionModel motionModel( posOrder, oriOrder );
+	for ( int i = 0; i <= posOrder; i++ )
+		motionModel.setPosPN( i, 0.5 );
+	for ( int i = 0; i <= oriOrder; i++ )
+		motionModel.setOriPN( i, 0.5 );
+	Tracking::PoseKalmanFilter filter( motionModel );
+
+	Measurement::Timestamp t = 1000000000LL;
+	filter.addPoseMeasurement( Measurement::ErrorPose( t, randomErrorPose() ) );
+
+	Measurement::Timestamp t0 = Measurement::readClock( Measurement::clockMonotonic );
+	for ( int run = 0; run < nRuns; run++ )
+	{
+		t += 10000000LL;
+		filter.timeUpdate( t );
+	}
+	Measurement::Timestamp t1 = Measurement::readClock( Measurement::clockMonotonic );
+
+	BOOST_CHECK( filter.getCovariance()( 0, 0 ) > 0 );
+	LOG4CPP_INFO( timeLogger, "PoseKalmanFilter::timeUpdate, state size " << filter.getState().size() << ": "
+		<< ( t1 - t0 ) / double( nRuns ) << "ns" );
+}
+
+#endif // HAVE_LAPACK
+
+} // anonymous namespace
+
+
+void TestCovarianceTransform()
+{
+	for ( int i = 0; i < 10; i++ )
+	{
+		testTransform();
+		testRangeTransform();
+		testErrorPose();
+	}
+
+	benchmarkErrorPose( 2000 );
+
+	#ifdef HAVE_LAPACK
+	benchmarkKalmanTimeUpdate( 1, 1, 20000 );
+	benchmarkKalmanTimeUpdate( 2, 2, 20000 );
+	#endif
+}
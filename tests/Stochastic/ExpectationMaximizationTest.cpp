@@ -3,10 +3,16 @@
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
 #include <utMath/Stochastic/expectation_maximization.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.ExpectationMaximization" ) );
+
+using namespace Ubitrack;
 using namespace Ubitrack::Math;
 
 template< typename T >
@@ -80,8 +86,121 @@ void testBasicExpectationMaximization( const std::size_t n_runs, const std::size
 	BOOST_CHECK( 0 == 0 );
 }
 
+namespace {
+
+typedef Stochastic::Weighted< Stochastic::Gaussian< double, 6 >, double > Component6D;
+
+/** residuals drawn from a mixture of axis-aligned Gaussians */
+void mixtureSamples( const std::vector< Component6D >& mixture, const std::size_t n, std::vector< Vector< double, 6 > >& samples )
+{
+	samples.resize( n );
+	for ( std::size_t i = 0; i < n; i++ )
+	{
+		double u = Random::distribute_uniform< double >( 0, 1 );
+		std::size_t k = 0;
+		while ( k + 1 < mixture.size() && u > mixture[ k ].weight )
+			u -= mixture[ k++ ].weight;
+		for ( std::size_t d = 0; d < 6; d++ )
+			samples[ i ]( d ) = mixture[ k ].mean[ d ] + Random::distribute_normal< double >( 0, std::sqrt( mixture[ k ].covariance[ d * 7 ] ) );
+	}
+}
+
+Component6D component( const double weight, const double center, const double sigma )
+{
+	Component6D c;
+	c.weight = weight;
+	std::fill( c.mean, c.mean + 6, center );
+	std::fill( c.covariance, c.covariance + 36, 0.0 );
+	for ( std::size_t d = 0; d < 6; d++ )
+		c.covariance[ d * 7 ] = sigma * sigma;
+	return c;
+}
+
+/**
+ * a well separated mixture is recovered with and without threads, also when the raw
+ * densities underflow
+ */
+void testRecovery( const double scale )
+{
+	std::vector< Component6D > truth;
+	truth.push_back( component( 0.5, 0, 0.01 * scale ) );
+	truth.push_back( component( 0.3, 1 * scale, 0.02 * scale ) );
+	truth.push_back( component( 0.2, -1 * scale, 0.005 * scale ) );
+	std::vector< Vector< double, 6 > > samples;
+	mixtureSamples( truth, 20000, samples );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	double likelihood[ 2 ];
+	for ( std::size_t iRun = 0; iRun < 2; iRun++ )
+	{
+		// start from shifted means and much too wide covariances
+		std::vector< Component6D > mixture;
+		for ( std::size_t k = 0; k < truth.size(); k++ )
+			mixture.push_back( component( 1.0 / 3, truth[ k ].mean[ 0 ] + 0.2 * scale, 0.3 * scale ) );
+
+		Stochastic::ExpectationMaximizationOptions options;
+		options.pThreadPool = iRun ? &pool : 0;
+		likelihood[ iRun ] = Stochastic::expectation_maximization( samples.begin(), samples.end(), mixture.begin(), mixture.end(), options );
+
+		for ( std::size_t k = 0; k < truth.size(); k++ )
+		{
+			BOOST_CHECK_SMALL( mixture[ k ].weight - truth[ k ].weight, 0.02 );
+			for ( std::size_t d = 0; d < 6; d++ )
+			{
+				BOOST_CHECK_SMALL( mixture[ k ].mean[ d ] - truth[ k ].mean[ d ], 0.002 * scale );
+				BOOST_CHECK_CLOSE( mixture[ k ].covariance[ d * 7 ], truth[ k ].covariance[ d * 7 ], 10.0 );
+			}
+		}
+
+		// the result is consistent with the density based log-likelihood, as long as that does not underflow
+		if ( scale == 100 )
+			BOOST_CHECK_CLOSE( likelihood[ iRun ], Stochastic::log_likelihood< double >( mixture.begin(), mixture.end(), samples.begin(), samples.end() ), 1e-3 );
+	}
+	BOOST_CHECK_CLOSE( likelihood[ 0 ], likelihood[ 1 ], 1e-6 );
+}
+
+/** logs the time per iteration for large sets of 6D residuals */
+void benchmark( const std::size_t n )
+{
+	std::vector< Component6D > truth;
+	truth.push_back( component( 0.7, 0, 0.5 ) );
+	truth.push_back( component( 0.2, 0.5, 2 ) );
+	truth.push_back( component( 0.1, 0, 10 ) );
+	std::vector< Vector< double, 6 > > samples;
+	mixtureSamples( truth, n, samples );
+
+	Stochastic::ExpectationMaximizationOptions options;
+	options.nMaxIterations = 10;
+	options.threshold = 0;
+	Ubitrack::Util::ThreadPool pool( 4 );
+	double times[ 2 ];
+	for ( std::size_t iRun = 0; iRun < 2; iRun++ )
+	{
+		std::vector< Component6D > mixture;
+		mixture.push_back( component( 0.4, 0.1, 1 ) );
+		mixture.push_back( component( 0.3, 0.3, 3 ) );
+		mixture.push_back( component( 0.3, -0.1, 5 ) );
+		options.pThreadPool = iRun ? &pool : 0;
+		const Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+		Stochastic::expectation_maximization( samples.begin(), samples.end(), mixture.begin(), mixture.end(), options );
+		times[ iRun ] = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start ) / options.nMaxIterations;
+	}
+
+	LOG4CPP_INFO( timeLogger, n << " 6D residuals, 3 components: " << times[ 0 ] << " ms per iteration, with 4 threads " << times[ 1 ] << " ms" );
+}
+
+} // anonymous namespace
+
+
 void TestExpectationMaximization()
 {
 	testBasicExpectationMaximization< double >( 10, 10000, 5 );
 	testBasicExpectationMaximization< float >( 10, 10000, 5 );
+	testRecovery( 1 );
+	testRecovery( 100 );
+	testRecovery( 1e5 );
+
+	const std::size_t sizes[] = { 10000, 100000, 1000000 };
+	for ( std::size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+		benchmark( sizes[ i ] );
 }
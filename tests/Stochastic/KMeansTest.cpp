@@ -3,10 +3,16 @@
 #include <utMath/Random/Scalar.h>
 #include <utMath/Random/Vector.h>
 #include <utMath/Stochastic/k_means.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
 
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.KMeans" ) );
+
+using namespace Ubitrack;
 using namespace Ubitrack::Math;
 
 template< typename T >
@@ -56,8 +62,204 @@ void testBasicKMeans( const std::size_t n_runs, const std::size_t max_n, const s
 	}
 }
 
+typedef Vector< double, 6 > Pose6D;
+
+namespace {
+
+/** relative poses (rotation vector and translation) scattered around a few typical motions */
+void relativePoses( const std::size_t n, const std::size_t nMotions, std::vector< Pose6D >& poses )
+{
+	Random::Vector< double, 6 >::Uniform randMotion( -1, 1 );
+	Random::Vector< double, 6 >::Normal randNoise( 0, 0.1 );
+	std::vector< Pose6D > motions;
+	std::generate_n( std::back_inserter( motions ), nMotions, randMotion );
+
+	poses.resize( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		poses[ i ] = motions[ Random::distribute_uniform< std::size_t >( 0, nMotions - 1 ) ] + randNoise();
+}
+
+/** index of the nearest centroid */
+std::size_t nearestCentroid( const Pose6D& pose, const std::vector< Pose6D >& centroids )
+{
+	std::size_t best = 0;
+	for ( std::size_t j = 1; j < centroids.size(); j++ )
+		if ( Distance< Pose6D >()( pose, centroids[ j ] ) < Distance< Pose6D >()( pose, centroids[ best ] ) )
+			best = j;
+	return best;
+}
+
+/** plain Lloyd iterations without pruning and with the same stopping rule as k_means */
+void lloyd( const std::vector< Pose6D >& poses, std::vector< Pose6D >& centroids, std::vector< std::size_t >& indices )
+{
+	const std::size_t k = centroids.size();
+	indices.resize( poses.size() );
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+		indices[ i ] = nearestCentroid( poses[ i ], centroids );
+
+	for ( std::size_t iter = 0; iter < 100; iter++ )
+	{
+		std::vector< Pose6D > sums( k, Pose6D::zeros() );
+		std::vector< std::size_t > counts( k, 0 );
+		for ( std::size_t i = 0; i < poses.size(); i++ )
+		{
+			sums[ indices[ i ] ] += poses[ i ];
+			counts[ indices[ i ] ]++;
+		}
+
+		double diff = 0;
+		for ( std::size_t j = 0; j < k; j++ )
+			if ( counts[ j ] )
+			{
+				const Pose6D mean( sums[ j ] / double( counts[ j ] ) );
+				diff += Distance< Pose6D >()( mean, centroids[ j ] );
+				centroids[ j ] = mean;
+			}
+
+		std::size_t changes = 0;
+		for ( std::size_t i = 0; i < poses.size(); i++ )
+		{
+			const std::size_t best = nearestCentroid( poses[ i ], centroids );
+			changes += best != indices[ i ];
+			indices[ i ] = best;
+		}
+		if ( changes == 0 || diff / k < Stochastic::KMeansOptions().tolerance )
+			break;
+	}
+}
+
+/** mean distance of the poses to their centroids */
+double meanDistance( const std::vector< Pose6D >& poses, const std::vector< Pose6D >& centroids, const std::vector< std::size_t >& indices )
+{
+	double sum = 0;
+	for ( std::size_t i = 0; i < poses.size(); i++ )
+		sum += Distance< Pose6D >()( poses[ i ], centroids[ indices[ i ] ] );
+	return sum / poses.size();
+}
+
+/** the pruned iterations give the same clusters as plain Lloyd iterations, with and without threads */
+void testAgainstLloyd()
+{
+	std::vector< Pose6D > poses;
+	relativePoses( 3000, 8, poses );
+	const std::vector< Pose6D > seeds( poses.begin(), poses.begin() + 12 );
+
+	std::vector< Pose6D > expected( seeds );
+	std::vector< std::size_t > expectedIndices;
+	lloyd( poses, expected, expectedIndices );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	for ( std::size_t iRun = 0; iRun < 2; iRun++ )
+	{
+		Stochastic::KMeansOptions options;
+		options.pThreadPool = iRun ? &pool : 0;
+		std::vector< Pose6D > centroids( seeds );
+		std::vector< std::size_t > indices;
+		Stochastic::k_means( poses.begin(), poses.end(), centroids.begin(), centroids.end(), std::back_inserter( indices ), Distance< Pose6D >(), options );
+
+		BOOST_CHECK( indices == expectedIndices );
+		for ( std::size_t j = 0; j < seeds.size(); j++ )
+			BOOST_CHECK_SMALL( static_cast< double >( Norm_2()( Pose6D( centroids[ j ] - expected[ j ] ) ) ), 1e-9 );
+	}
+}
+
+/** a centroid without elements stays where it is */
+void testEmptyCluster()
+{
+	typedef Vector< double, 2 > Point;
+	Random::Vector< double, 2 >::Uniform randPoint( 0, 1 );
+	std::vector< Point > points;
+	std::generate_n( std::back_inserter( points ), 100, randPoint );
+
+	std::vector< Point > centroids;
+	centroids.push_back( Point( 0.2, 0.5 ) );
+	centroids.push_back( Point( 0.8, 0.5 ) );
+	centroids.push_back( Point( 100, 100 ) );
+	std::vector< std::size_t > indices;
+	Stochastic::k_means( points.begin(), points.end(), centroids.begin(), centroids.end(), std::back_inserter( indices ), Distance< Point >() );
+
+	BOOST_CHECK_EQUAL( centroids[ 2 ]( 0 ), 100.0 );
+	BOOST_CHECK_EQUAL( centroids[ 2 ]( 1 ), 100.0 );
+	BOOST_CHECK( std::count( indices.begin(), indices.end(), std::size_t( 2 ) ) == 0 );
+	BOOST_CHECK( centroids[ 0 ]( 0 ) < 0.5 && centroids[ 1 ]( 0 ) > 0.5 );
+}
+
+/** mini-batches come close to the full iterations, all poses are assigned to their nearest centroid */
+void testMiniBatch()
+{
+	std::vector< Pose6D > poses;
+	relativePoses( 20000, 10, poses );
+	std::vector< Pose6D > seeds;
+	Stochastic::copy_probability( poses.begin(), poses.end(), 10, std::back_inserter( seeds ), Distance< Pose6D >() );
+
+	std::vector< Pose6D > full( seeds );
+	std::vector< std::size_t > fullIndices;
+	Stochastic::k_means( poses.begin(), poses.end(), full.begin(), full.end(), std::back_inserter( fullIndices ), Distance< Pose6D >() );
+
+	Stochastic::KMeansOptions options;
+	options.batchSize = 500;
+	std::vector< Pose6D > batch( seeds );
+	std::vector< std::size_t > batchIndices;
+	Stochastic::k_means( poses.begin(), poses.end(), batch.begin(), batch.end(), std::back_inserter( batchIndices ), Distance< Pose6D >(), options );
+
+	BOOST_CHECK( meanDistance( poses, batch, batchIndices ) < 1.1 * meanDistance( poses, full, fullIndices ) );
+	for ( std::size_t i = 0; i < poses.size(); i += 97 )
+		BOOST_CHECK_EQUAL( batchIndices[ i ], nearestCentroid( poses[ i ], batch ) );
+}
+
+/** logs the times of plain Lloyd iterations, the pruned iterations with and without threads and mini-batches */
+void benchmark( const std::size_t n )
+{
+	std::vector< Pose6D > poses;
+	relativePoses( n, 20, poses );
+	const std::vector< Pose6D > seeds( poses.begin(), poses.begin() + 20 );
+	std::vector< Pose6D > centroids;
+	std::vector< std::size_t > indices;
+
+	double tLloyd = 0;
+	Measurement::Timestamp start;
+	if ( n <= 100000 )
+	{
+		centroids = seeds;
+		start = Measurement::readClock( Measurement::clockMonotonic );
+		lloyd( poses, centroids, indices );
+		tLloyd = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+	}
+
+	Stochastic::KMeansOptions options;
+	double times[ 3 ];
+	double distances[ 3 ];
+	Ubitrack::Util::ThreadPool pool( 4 );
+	for ( std::size_t iRun = 0; iRun < 3; iRun++ )
+	{
+		options.pThreadPool = iRun == 1 ? &pool : 0;
+		options.batchSize = iRun == 2 ? 1000 : 0;
+		centroids = seeds;
+		indices.clear();
+		start = Measurement::readClock( Measurement::clockMonotonic );
+		Stochastic::k_means( poses.begin(), poses.end(), centroids.begin(), centroids.end(), std::back_inserter( indices ), Distance< Pose6D >(), options );
+		times[ iRun ] = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+		distances[ iRun ] = meanDistance( poses, centroids, indices );
+	}
+	BOOST_CHECK_CLOSE( distances[ 0 ], distances[ 1 ], 1e-6 );
+
+	LOG4CPP_INFO( timeLogger, n << " relative poses, 20 clusters: Lloyd " << tLloyd << " ms, pruned " << times[ 0 ]
+		<< " ms, pruned with 4 threads " << times[ 1 ] << " ms, mini-batch " << times[ 2 ] << " ms (mean distance "
+		<< distances[ 0 ] << " vs. " << distances[ 2 ] << ")" );
+}
+
+} // anonymous namespace
+
+
 void TestKMeans()
 {
 	testBasicKMeans< double >( 10, 10000, 5 );
 	testBasicKMeans< float >( 10, 10000, 5 );
+	testAgainstLloyd();
+	testEmptyCluster();
+	testMiniBatch();
+
+	const std::size_t sizes[] = { 10000, 100000, 1000000 };
+	for ( std::size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+		benchmark( sizes[ i ] );
 }
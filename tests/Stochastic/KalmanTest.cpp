@@ -0,0 +1,263 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Rotation.h>
+
+#ifdef HAVE_LAPACK
+#include <utMath/Stochastic/Kalman.h>
+#include <utTracking/PoseKalmanFilter.h>
+#endif
+
+#include <cmath>
+#include <sstream>
+
+#include <boost/numeric/ublas/vector_proxy.hpp>
+#include <boost/numeric/ublas/matrix_proxy.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.Kalman" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+namespace ublas = boost::numeric::ublas;
+
+#ifdef HAVE_LAPACK
+
+namespace {
+
+/** selects position (0..2) and the quaternion at m_rotStart */
+struct SelectPose
+{
+	std::size_t m_rotStart;
+
+	SelectPose( std::size_t rotStart )
+		: m_rotStart( rotStart )
+	{}
+
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& jacobian ) const
+	{
+		for ( std::size_t i = 0; i < 7; i++ )
+			for ( std::size_t j = 0; j < jacobian.size2(); j++ )
+				jacobian( i, j ) = 0;
+
+		for ( std::size_t i = 0; i < 3; i++ )
+		{
+			result( i ) = input( i );
+			jacobian( i, i ) = 1;
+		}
+		for ( std::size_t i = 0; i < 4; i++ )
+		{
+			result( 3 + i ) = input( m_rotStart + i );
+			jacobian( 3 + i, m_rotStart + i ) = 1;
+		}
+	}
+};
+
+/** a nonlinear measurement function of three inputs */
+struct Nonlinear
+{
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& jacobian ) const
+	{
+		result( 0 ) = input( 0 ) * input( 1 );
+		result( 1 ) = std::sin( input( 2 ) ) + input( 0 );
+		jacobian( 0, 0 ) = input( 1 );
+		jacobian( 0, 1 ) = input( 0 );
+		jacobian( 0, 2 ) = 0;
+		jacobian( 1, 0 ) = 1;
+		jacobian( 1, 1 ) = 0;
+		jacobian( 1, 2 ) = std::cos( input( 2 ) );
+	}
+};
+
+/** random symmetric positive definite matrix */
+template< class M >
+void randomCovariance( M& cov, const std::size_t n )
+{
+	Matrix< double > a( n, n );
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = 0; j < n; j++ )
+			a( i, j ) = Random::distribute_uniform< double >( -1, 1 );
+	cov = ublas::prod( a, ublas::trans( a ) ) + 0.1 * Matrix< double >::identity( n );
+}
+
+template< std::size_t N >
+void testSelectionUpdate( const std::size_t iR )
+{
+	for ( std::size_t run = 0; run < 20; run++ )
+	{
+		Vector< double > state( N );
+		for ( std::size_t i = 0; i < N; i++ )
+			state( i ) = Random::distribute_uniform< double >( -1, 1 );
+		Matrix< double > cov;
+		randomCovariance( cov, N );
+
+		Vector< double, 7 > z;
+		for ( std::size_t i = 0; i < 7; i++ )
+			z( i ) = Random::distribute_uniform< double >( -1, 1 );
+		Matrix< double > measCov;
+		randomCovariance( measCov, 7 );
+		const Matrix< double, 7, 7 > measCovFixed( measCov );
+
+		// reference
+		Vector< double > stateDense( state );
+		Matrix< double > covDense( cov );
+		Stochastic::kalmanMeasurementUpdate( stateDense, covDense, SelectPose( iR ), z, measCov, 0, iR + 4 );
+
+		// selection on dynamic storage
+		const std::size_t indices[ 7 ] = { 0, 1, 2, iR, iR + 1, iR + 2, iR + 3 };
+		Vector< double > stateSel( state );
+		Matrix< double > covSel( cov );
+		Stochastic::kalmanMeasurementUpdateSelection< N, 7 >( stateSel, covSel, z, measCovFixed, indices );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( stateSel - stateDense ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( covSel - covDense ) ), 1e-9 );
+
+		// the Joseph form keeps the covariance exactly symmetric
+		BOOST_CHECK_EQUAL( static_cast< double >( ublas::norm_inf( covSel - ublas::trans( covSel ) ) ), 0.0 );
+
+		// selection on stack storage
+		Vector< double, N > stateFixed( state );
+		Matrix< double, N, N > covFixed( cov );
+		Stochastic::kalmanMeasurementUpdateSelection< N, 7 >( stateFixed, covFixed, z, measCovFixed, indices );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( stateFixed - stateDense ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( covFixed - covDense ) ), 1e-9 );
+
+		// general fixed size update with jacobian
+		Vector< double > stateGeneral( state );
+		Matrix< double > covGeneral( cov );
+		Stochastic::kalmanMeasurementUpdate< N, N, 7 >( stateGeneral, covGeneral, SelectPose( iR ), z, measCovFixed, 0, N );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( stateGeneral - stateDense ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( covGeneral - covDense ) ), 1e-9 );
+
+		// identity
+		Vector< double > stateId( state );
+		Matrix< double > covId( cov );
+		Stochastic::kalmanMeasurementUpdateIdentity( stateId, covId, ublas::subrange( z, 3, 7 ),
+			ublas::subrange( measCov, 3, 7, 3, 7 ), iR, iR + 4 );
+		Vector< double > stateIdFixed( state );
+		Matrix< double > covIdFixed( cov );
+		Stochastic::kalmanMeasurementUpdateIdentity< N, 4 >( stateIdFixed, covIdFixed, ublas::subrange( z, 3, 7 ),
+			ublas::subrange( measCov, 3, 7, 3, 7 ), iR, iR + 4 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( stateIdFixed - stateId ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( covIdFixed - covId ) ), 1e-9 );
+	}
+}
+
+void testNonlinearUpdate()
+{
+	for ( std::size_t run = 0; run < 20; run++ )
+	{
+		Vector< double > state( 10 );
+		for ( std::size_t i = 0; i < 10; i++ )
+			state( i ) = Random::distribute_uniform< double >( -1, 1 );
+		Matrix< double > cov;
+		randomCovariance( cov, 10 );
+		const Vector< double, 2 > z( Random::distribute_uniform< double >( -1, 1 ), Random::distribute_uniform< double >( -1, 1 ) );
+		const Matrix< double, 2, 2 > measCov( 0.01 * Matrix< double, 2, 2 >::identity() );
+
+		Vector< double > stateDense( state );
+		Matrix< double > covDense( cov );
+		Stochastic::kalmanMeasurementUpdate( stateDense, covDense, Nonlinear(), z, measCov, 4, 7 );
+
+		Stochastic::kalmanMeasurementUpdate< 10, 3, 2 >( state, cov, Nonlinear(), z, measCov, 4, 7 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( state - stateDense ) ), 1e-9 );
+		BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( cov - covDense ) ), 1e-9 );
+	}
+
+	// innovation covariance that is not positive definite uses the LU fallback
+	Vector< double > state( Vector< double >::zeros( 4 ) );
+	Matrix< double > cov( Matrix< double >::identity( 4 ) );
+	Vector< double > stateDense( state );
+	Matrix< double > covDense( cov );
+	const Vector< double, 2 > z( 1.0, 2.0 );
+	Matrix< double, 2, 2 > measCov( Matrix< double, 2, 2 >::identity() );
+	measCov( 0, 0 ) = -1.5;
+	const std::size_t indices[ 2 ] = { 1, 2 };
+	Stochastic::kalmanMeasurementUpdateSelection< 4, 2 >( state, cov, z, measCov, indices );
+	Stochastic::kalmanMeasurementUpdateIdentity( stateDense, covDense, z, measCov, 1, 3 );
+	BOOST_CHECK_SMALL( static_cast< double >( ublas::norm_inf( state - stateDense ) ), 1e-9 );
+}
+
+/** pose measurements at 100 Hz for a motion model, compared with the dense update */
+void benchmarkPoseKalmanFilter( const int order, const std::size_t nUpdates )
+{
+	Tracking::LinearPoseMotionModel motionModel( order, order );
+	for ( int i = 0; i <= order; i++ )
+	{
+		motionModel.setPosPN( i, 0.1 );
+		motionModel.setOriPN( i, 0.1 );
+	}
+
+	Random::Quaternion< double >::Uniform randQuat;
+	const Matrix< double, 6, 6 > poseCov( 1e-4 * Matrix< double, 6, 6 >::identity() );
+	std::vector< Measurement::ErrorPose > poses;
+	Measurement::Timestamp t( 1000000000LL );
+	for ( std::size_t i = 0; i < nUpdates; i++, t += 10000000LL )
+		poses.push_back( Measurement::ErrorPose( t, ErrorPose( randQuat(), Vector< double, 3 >( 0.01 * i, 0, 1 ), poseCov ) ) );
+
+	Tracking::PoseKalmanFilter filter( motionModel );
+	std::ostringstream name;
+	name << "PoseKalmanFilter::addPoseMeasurement, " << motionModel.stateSize() << " states";
+	Ubitrack::Util::BlockTimer timer( name.str(), timeLogger );
+	for ( std::size_t i = 0; i < nUpdates; i++ )
+	{
+		UBITRACK_TIME( timer );
+		filter.addPoseMeasurement( poses[ i ] );
+	}
+
+	// measurement update only, dense and fixed size
+	const std::size_t n = motionModel.stateSize();
+	const std::size_t iR = 3 * ( order + 1 );
+	const Vector< double > state( filter.getState() );
+	const Matrix< double > cov( filter.getCovariance() );
+	ErrorVector< double, 7 > v;
+	poses[ 0 ]->toAdditiveErrorVector( v );
+
+	name.str( "" );
+	name << "dense measurement update, " << n << " states";
+	Ubitrack::Util::BlockTimer denseTimer( name.str(), timeLogger );
+	for ( std::size_t i = 0; i < nUpdates; i++ )
+	{
+		Vector< double > s( state );
+		Matrix< double > c( cov );
+		UBITRACK_TIME( denseTimer );
+		Stochastic::kalmanMeasurementUpdate( s, c, SelectPose( iR ), v.value, v.covariance, 0, iR + 4 );
+	}
+
+	const std::size_t indices[ 7 ] = { 0, 1, 2, iR, iR + 1, iR + 2, iR + 3 };
+	name.str( "" );
+	name << "fixed size selection update, " << n << " states";
+	Ubitrack::Util::BlockTimer fixedTimer( name.str(), timeLogger );
+	for ( std::size_t i = 0; i < nUpdates; i++ )
+	{
+		Vector< double > s( state );
+		Matrix< double > c( cov );
+		UBITRACK_TIME( fixedTimer );
+		if ( n == 13 )
+			Stochastic::kalmanMeasurementUpdateSelection< 13, 7 >( s, c, v.value, v.covariance, indices );
+		else
+			Stochastic::kalmanMeasurementUpdateSelection< 19, 7 >( s, c, v.value, v.covariance, indices );
+	}
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+void TestKalman()
+{
+#ifdef HAVE_LAPACK
+	testSelectionUpdate< 13 >( 6 );
+	testSelectionUpdate< 19 >( 9 );
+	testNonlinearUpdate();
+
+	benchmarkPoseKalmanFilter( 1, 2000 );
+	benchmarkPoseKalmanFilter( 2, 2000 );
+#endif
+}
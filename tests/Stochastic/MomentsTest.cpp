@@ -0,0 +1,200 @@
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Stochastic/Average.h>
+#include <utMath/Stochastic/Moments.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.Moments" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** two-pass mean and covariance in long double */
+template< std::size_t N >
+void referenceMoments( const std::vector< Vector< double, N > >& values, long double* mean, long double* cov )
+{
+	for ( std::size_t i = 0; i < N; i++ )
+	{
+		mean[ i ] = 0;
+		for ( std::size_t k = 0; k < values.size(); k++ )
+			mean[ i ] += values[ k ]( i );
+		mean[ i ] /= values.size();
+	}
+	for ( std::size_t i = 0; i < N; i++ )
+		for ( std::size_t j = 0; j < N; j++ )
+		{
+			cov[ i * N + j ] = 0;
+			for ( std::size_t k = 0; k < values.size(); k++ )
+				cov[ i * N + j ] += ( values[ k ]( i ) - mean[ i ] ) * ( values[ k ]( j ) - mean[ j ] );
+			cov[ i * N + j ] /= values.size();
+		}
+}
+
+template< std::size_t N >
+void checkMoments( const Stochastic::Moments< double, N >& moments, const long double* mean, const long double* cov, const double tolerance )
+{
+	const Vector< double, N > m( moments.mean() );
+	const Matrix< double, N, N > c( moments.covariance() );
+	for ( std::size_t i = 0; i < N; i++ )
+	{
+		BOOST_CHECK_CLOSE( m( i ), static_cast< double >( mean[ i ] ), 1e-12 );
+		for ( std::size_t j = 0; j < N; j++ )
+			BOOST_CHECK_SMALL( c( i, j ) - static_cast< double >( cov[ i * N + j ] ), tolerance );
+	}
+}
+
+/** values far from the origin, single updates, merged parts and the batch reduction agree with the reference */
+void testAccuracy()
+{
+	const std::size_t n = 10007;
+	Random::Vector< double, 3 >::Normal randNoise( 0, 1 );
+	std::vector< Vector< double, 3 > > values( n );
+	for ( std::size_t k = 0; k < n; k++ )
+		values[ k ] = Vector< double, 3 >( 1e8, -1e8, 1e4 ) + randNoise();
+
+	long double mean[ 3 ];
+	long double cov[ 9 ];
+	referenceMoments( values, mean, cov );
+
+	// single updates
+	Stochastic::Moments< double, 3 > single = std::for_each( values.begin(), values.end(), Stochastic::Moments< double, 3 >() );
+	BOOST_CHECK_EQUAL( single.count(), n );
+	checkMoments( single, mean, cov, 1e-6 );
+
+	// raw sums lose the covariance completely at this offset
+	Stochastic::Average< ErrorVector< double, 3 > > average = std::for_each( values.begin(), values.end(), Stochastic::Average< ErrorVector< double, 3 > >() );
+	const ErrorVector< double, 3 > averageResult( average.getAverage() );
+	LOG4CPP_INFO( timeLogger, "covariance(0,0) of values at 1e8: reference " << static_cast< double >( cov[ 0 ] )
+		<< ", Average " << averageResult.covariance( 0, 0 ) << ", Moments " << single.covariance()( 0, 0 ) );
+
+	// merging parts of different sizes, including empty ones
+	const std::size_t splits[] = { 0, 0, 1, 100, 5000, 5001, n };
+	Stochastic::Moments< double, 3 > merged;
+	for ( std::size_t s = 0; s + 1 < sizeof( splits ) / sizeof( splits[ 0 ] ); s++ )
+		merged.merge( std::for_each( values.begin() + splits[ s ], values.begin() + splits[ s + 1 ], Stochastic::Moments< double, 3 >() ) );
+	BOOST_CHECK_EQUAL( merged.count(), n );
+	checkMoments( merged, mean, cov, 1e-6 );
+
+	// batch reduction with and without threads
+	Stochastic::Moments< double, 3 > batch;
+	Stochastic::accumulate_moments( values.begin(), values.end(), batch );
+	BOOST_CHECK_EQUAL( batch.count(), n );
+	checkMoments( batch, mean, cov, 1e-6 );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Stochastic::Moments< double, 3 > parallel;
+	Stochastic::accumulate_moments( values.begin(), values.end(), parallel, &pool );
+	BOOST_CHECK_EQUAL( parallel.count(), n );
+	checkMoments( parallel, mean, cov, 1e-6 );
+
+	// a single value has no spread
+	Stochastic::Moments< double, 3 > one;
+	Stochastic::accumulate_moments( values.begin(), values.begin() + 1, one, &pool );
+	BOOST_CHECK_EQUAL( one.count(), 1u );
+	BOOST_CHECK_SMALL( static_cast< double >( norm_2( one.mean() - values[ 0 ] ) ), 1e-6 );
+	BOOST_CHECK_EQUAL( one.covariance()( 1, 1 ), 0.0 );
+}
+
+double rotationDistance( const Quaternion& a, const Quaternion& b )
+{
+	const double d = a.x() * b.x() + a.y() * b.y() + a.z() * b.z() + a.w() * b.w();
+	return std::sqrt( std::max( 0.0, 2 - 2 * std::fabs( d ) ) );
+}
+
+/** the mean of noisy rotations around a center with random signs is the center */
+void testQuaternion()
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Normal randAxis( 0, 1 );
+	Ubitrack::Util::ThreadPool pool( 4 );
+
+	for ( std::size_t run = 0; run < 10; run++ )
+	{
+		const Quaternion center( randQuat() );
+		std::vector< Quaternion > rotations;
+		for ( std::size_t k = 0; k < 2000; k++ )
+		{
+			const Vector< double, 3 > axis( randAxis() );
+			const Quaternion q( center * Quaternion( axis, Random::distribute_uniform< double >( -0.3, 0.3 ) ) );
+			rotations.push_back( Random::distribute_uniform< double >( 0, 1 ) < 0.5 ? q : Quaternion( -q.x(), -q.y(), -q.z(), -q.w() ) );
+		}
+
+		Stochastic::QuaternionMoments single = std::for_each( rotations.begin(), rotations.end(), Stochastic::QuaternionMoments() );
+		const Quaternion mean( single.mean() );
+		BOOST_CHECK_SMALL( rotationDistance( mean, center ), 2e-2 );
+		BOOST_CHECK( mean.w() >= 0 );
+		BOOST_CHECK_CLOSE( mean.x() * mean.x() + mean.y() * mean.y() + mean.z() * mean.z() + mean.w() * mean.w(), 1.0, 1e-10 );
+
+		Stochastic::QuaternionMoments parallel;
+		Stochastic::accumulate_moments( rotations.begin(), rotations.end(), parallel, &pool );
+		BOOST_CHECK_EQUAL( parallel.count(), rotations.size() );
+		BOOST_CHECK_SMALL( rotationDistance( parallel.mean(), mean ), 1e-6 );
+	}
+
+	// identical rotations
+	const Quaternion q( randQuat() );
+	Stochastic::QuaternionMoments same;
+	for ( std::size_t k = 0; k < 10; k++ )
+		same( q );
+	BOOST_CHECK_SMALL( rotationDistance( same.mean(), q ), 1e-6 );
+}
+
+/** logs the time of Average, single Moments updates and the batch reduction with and without threads */
+void benchmark( const std::size_t n )
+{
+	Random::Vector< double, 6 >::Normal randValue( 0, 1 );
+	std::vector< Vector< double, 6 > > values;
+	values.reserve( n );
+	std::generate_n( std::back_inserter( values ), n, randValue );
+
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	Stochastic::Average< ErrorVector< double, 6 > > average = std::for_each( values.begin(), values.end(), Stochastic::Average< ErrorVector< double, 6 > >() );
+	const ErrorVector< double, 6 > averageResult( average.getAverage() );
+	const double tAverage = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Stochastic::Moments< double, 6 > single = std::for_each( values.begin(), values.end(), Stochastic::Moments< double, 6 >() );
+	const double tSingle = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Stochastic::Moments< double, 6 > batch;
+	Stochastic::accumulate_moments( values.begin(), values.end(), batch );
+	const double tBatch = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	Stochastic::Moments< double, 6 > parallel;
+	Stochastic::accumulate_moments( values.begin(), values.end(), parallel, &pool );
+	const double tParallel = 1e-6 * ( Measurement::readClock( Measurement::clockMonotonic ) - start );
+
+	BOOST_CHECK_SMALL( averageResult.covariance( 0, 0 ) - single.covariance()( 0, 0 ), 1e-9 );
+	BOOST_CHECK_SMALL( batch.covariance()( 0, 5 ) - single.covariance()( 0, 5 ), 1e-9 );
+	BOOST_CHECK_SMALL( parallel.covariance()( 2, 3 ) - single.covariance()( 2, 3 ), 1e-9 );
+
+	LOG4CPP_INFO( timeLogger, n << " 6-vectors: Average " << tAverage << " ms, Moments " << tSingle
+		<< " ms, accumulate_moments " << tBatch << " ms, with 4 threads " << tParallel << " ms" );
+}
+
+} // anonymous namespace
+
+
+void TestMoments()
+{
+	testAccuracy();
+	testQuaternion();
+	benchmark( 10000 );
+	benchmark( 1000000 );
+}
@@ -0,0 +1,198 @@
+
+#include <utMath/Vector.h>
+#include <utMath/Matrix.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Rotation.h>
+
+#ifdef HAVE_LAPACK
+#include <utTracking/PoseKalmanFilter.h>
+#include <utTracking/PoseKalmanFilterBank.h>
+#include <utUtil/ThreadPool.h>
+#include <utUtil/Exception.h>
+#endif
+
+#include <sstream>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <utUtil/BlockTimer.h>
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.PoseKalmanFilterBank" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+#ifdef HAVE_LAPACK
+
+namespace {
+
+Tracking::LinearPoseMotionModel createMotionModel( const int posOrder, const int oriOrder )
+{
+	Tracking::LinearPoseMotionModel motionModel( posOrder, oriOrder );
+	for ( int i = 0; i <= posOrder; i++ )
+		motionModel.setPosPN( i, 0.5 );
+	for ( int i = 0; i <= oriOrder; i++ )
+		motionModel.setOriPN( i, 0.5 );
+	return motionModel;
+}
+
+/**
+ * one step of noisy measurements of slowly rotating and moving bodies at roughly 100 Hz.
+ * Some bodies have no measurement.
+ */
+void createMeasurements( const std::vector< Quaternion >& start, const std::size_t step, std::vector< Measurement::ErrorPose >& m )
+{
+	const Matrix< double, 6, 6 > cov( 1e-4 * Matrix< double, 6, 6 >::identity() );
+	m.resize( start.size() );
+	for ( std::size_t b = 0; b < start.size(); b++ )
+	{
+		if ( Random::distribute_uniform< double >( 0, 1 ) < 0.2 )
+		{
+			m[ b ] = Measurement::ErrorPose();
+			continue;
+		}
+
+		const Measurement::Timestamp t = 1000000000LL + step * 10000000LL + b * 1000LL;
+		const Quaternion q( Quaternion( Vector< double, 3 >( 0, 0, 1 ), 0.01 * step + Random::distribute_normal< double >( 0, 0.01 ) ) * start[ b ] );
+		const Vector< double, 3 > p( 0.01 * step + Random::distribute_normal< double >( 0, 0.01 ), 0.1 * b, 1.0 );
+		m[ b ] = Measurement::ErrorPose( t, ErrorPose( q, p, cov ) );
+	}
+}
+
+/** number of elements that differ between the bank and the scalar filters */
+std::size_t countDifferences( const Tracking::PoseKalmanFilterBank& bank, const std::vector< Tracking::PoseKalmanFilter >& filters )
+{
+	std::size_t nDiff = 0;
+	Tracking::PoseKalmanFilter::StateType state;
+	Tracking::PoseKalmanFilter::CovarianceType covariance;
+	for ( std::size_t b = 0; b < filters.size(); b++ )
+	{
+		bank.getState( b, state );
+		bank.getCovariance( b, covariance );
+		for ( std::size_t i = 0; i < state.size(); i++ )
+		{
+			nDiff += state( i ) != filters[ b ].getState()( i );
+			for ( std::size_t j = 0; j < state.size(); j++ )
+				nDiff += covariance( i, j ) != filters[ b ].getCovariance()( i, j );
+		}
+	}
+	return nDiff;
+}
+
+void testFilterBank( const int posOrder, const int oriOrder, Ubitrack::Util::ThreadPool* pPool )
+{
+	const std::size_t nBodies = 37;
+	const Tracking::LinearPoseMotionModel motionModel( createMotionModel( posOrder, oriOrder ) );
+	Tracking::PoseKalmanFilterBank bank( motionModel, nBodies );
+	bank.setThreadPool( pPool );
+	std::vector< Tracking::PoseKalmanFilter > filters( nBodies, Tracking::PoseKalmanFilter( motionModel ) );
+
+	Random::Quaternion< double >::Uniform randQuat;
+	std::vector< Quaternion > start;
+	for ( std::size_t b = 0; b < nBodies; b++ )
+		start.push_back( randQuat() );
+
+	std::vector< Measurement::ErrorPose > m;
+	for ( std::size_t step = 0; step < 50; step++ )
+	{
+		createMeasurements( start, step, m );
+		bank.addPoseMeasurements( m );
+		for ( std::size_t b = 0; b < nBodies; b++ )
+			if ( m[ b ].get() )
+				filters[ b ].addPoseMeasurement( m[ b ] );
+
+		BOOST_CHECK_EQUAL( countDifferences( bank, filters ), std::size_t( 0 ) );
+	}
+
+	// separate time update
+	std::vector< Measurement::Timestamp > t( nBodies, 0 );
+	for ( std::size_t b = 0; b < nBodies; b += 2 )
+	{
+		t[ b ] = bank.time( b ) + 5000000LL;
+		filters[ b ].timeUpdate( t[ b ] );
+	}
+	bank.timeUpdate( t );
+	BOOST_CHECK_EQUAL( countDifferences( bank, filters ), std::size_t( 0 ) );
+
+	// prediction with a filter taken from the bank
+	const Measurement::Timestamp tPredict( bank.time( 3 ) + 20000000LL );
+	const Measurement::ErrorPose fromBank( bank.filter( 3 ).predictPose( tPredict ) );
+	const Measurement::ErrorPose fromFilter( filters[ 3 ].predictPose( tPredict ) );
+	BOOST_CHECK_EQUAL( fromBank->translation()( 0 ), fromFilter->translation()( 0 ) );
+	BOOST_CHECK_EQUAL( fromBank->rotation().w(), fromFilter->rotation().w() );
+}
+
+void benchmarkFilterBank( const int order, const std::size_t nBodies, const std::size_t nSteps )
+{
+	const Tracking::LinearPoseMotionModel motionModel( createMotionModel( order, order ) );
+	Random::Quaternion< double >::Uniform randQuat;
+	std::vector< Quaternion > start;
+	for ( std::size_t b = 0; b < nBodies; b++ )
+		start.push_back( randQuat() );
+
+	std::vector< std::vector< Measurement::ErrorPose > > m( nSteps );
+	for ( std::size_t step = 0; step < nSteps; step++ )
+		createMeasurements( start, step, m[ step ] );
+
+	std::vector< Tracking::PoseKalmanFilter > filters( nBodies, Tracking::PoseKalmanFilter( motionModel ) );
+	std::ostringstream name;
+	name << "PoseKalmanFilter, " << nBodies << " bodies, " << motionModel.stateSize() << " states";
+	Ubitrack::Util::BlockTimer scalarTimer( name.str(), timeLogger );
+	for ( std::size_t step = 0; step < nSteps; step++ )
+	{
+		UBITRACK_TIME( scalarTimer );
+		for ( std::size_t b = 0; b < nBodies; b++ )
+			if ( m[ step ][ b ].get() )
+				filters[ b ].addPoseMeasurement( m[ step ][ b ] );
+	}
+
+	Tracking::PoseKalmanFilterBank bank( motionModel, nBodies );
+	name.str( "" );
+	name << "PoseKalmanFilterBank, " << nBodies << " bodies, " << motionModel.stateSize() << " states";
+	Ubitrack::Util::BlockTimer bankTimer( name.str(), timeLogger );
+	for ( std::size_t step = 0; step < nSteps; step++ )
+	{
+		UBITRACK_TIME( bankTimer );
+		bank.addPoseMeasurements( m[ step ] );
+	}
+
+	Tracking::PoseKalmanFilterBank parallelBank( motionModel, nBodies );
+	parallelBank.setThreadPool( &Ubitrack::Util::ThreadPool::global() );
+	name.str( "" );
+	name << "PoseKalmanFilterBank, " << Ubitrack::Util::ThreadPool::global().size() << " threads, " << nBodies << " bodies, " << motionModel.stateSize() << " states";
+	Ubitrack::Util::BlockTimer parallelTimer( name.str(), timeLogger );
+	for ( std::size_t step = 0; step < nSteps; step++ )
+	{
+		UBITRACK_TIME( parallelTimer );
+		parallelBank.addPoseMeasurements( m[ step ] );
+	}
+
+	BOOST_CHECK_EQUAL( countDifferences( bank, filters ), std::size_t( 0 ) );
+	BOOST_CHECK_EQUAL( countDifferences( parallelBank, filters ), std::size_t( 0 ) );
+}
+
+} // anonymous namespace
+
+#endif // HAVE_LAPACK
+
+void TestPoseKalmanFilterBank()
+{
+#ifdef HAVE_LAPACK
+	Ubitrack::Util::ThreadPool pool( 3 );
+	for ( int posOrder = 0; posOrder <= 2; posOrder++ )
+		for ( int oriOrder = 0; oriOrder <= 2; oriOrder++ )
+		{
+			testFilterBank( posOrder, oriOrder, 0 );
+			testFilterBank( posOrder, oriOrder, &pool );
+		}
+
+	BOOST_CHECK_THROW( Tracking::PoseKalmanFilterBank bank( Tracking::LinearPoseMotionModel( 3, 1 ), 10 ), Ubitrack::Util::Exception );
+
+	benchmarkFilterBank( 1, 10, 100 );
+	benchmarkFilterBank( 1, 100, 100 );
+	benchmarkFilterBank( 1, 1000, 20 );
+	benchmarkFilterBank( 2, 100, 100 );
+	benchmarkFilterBank( 2, 1000, 20 );
+#endif
+}
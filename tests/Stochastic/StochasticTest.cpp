@@ -3,6 +3,12 @@
 // declare external tests here, to save us some trivial header files
 void TestKMeans();
 void TestExpectationMaximization();
+void TestMoments();
+void TestStreamingStatistics();
+void TestKalman();
+void TestPoseKalmanFilterBank();
+void TestUnscentedTransform();
+void TestCovarianceTransform();
 
 
 
@@ -11,4 +17,10 @@ StochasticTest::StochasticTest()
 {
 	add( BOOST_TEST_CASE( &TestKMeans ) );
 	add( BOOST_TEST_CASE( &TestExpectationMaximization ) );
+	add( BOOST_TEST_CASE( &TestMoments ) );
+	add( BOOST_TEST_CASE( &TestStreamingStatistics ) );
+	add( BOOST_TEST_CASE( &TestKalman ) );
+	add( BOOST_TEST_CASE( &TestPoseKalmanFilterBank ) );
+	add( BOOST_TEST_CASE( &TestUnscentedTransform ) );
+	add( BOOST_TEST_CASE( &TestCovarianceTransform ) );
 }
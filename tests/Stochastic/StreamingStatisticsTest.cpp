@@ -0,0 +1,253 @@
+
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utMath/Stochastic/StreamingStatistics.h>
+#include <utMeasurement/Measurement.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.StreamingStatistics" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace {
+
+/** two-pass mean and covariance of values [ begin, end ) */
+template< std::size_t N >
+void windowReference( const std::vector< Vector< double, N > >& values, const std::size_t begin, const std::size_t end,
+	Vector< double, N >& mean, Matrix< double, N, N >& cov )
+{
+	mean = Vector< double, N >::zeros();
+	for ( std::size_t k = begin; k < end; k++ )
+		mean += values[ k ];
+	mean /= static_cast< double >( end - begin );
+
+	cov = Matrix< double, N, N >::zeros();
+	for ( std::size_t k = begin; k < end; k++ )
+	{
+		const Vector< double, N > d( values[ k ] - mean );
+		cov += boost::numeric::ublas::outer_prod( d, d );
+	}
+	cov /= static_cast< double >( end - begin );
+}
+
+/** the sliding window agrees with a two-pass computation over many buffer replacements */
+void testSlidingWindow()
+{
+	const std::size_t window = 50;
+	Random::Vector< double, 3 >::Normal randNoise( 0, 1 );
+	std::vector< Vector< double, 3 > > values;
+	Stochastic::SlidingWindowStatistics< Vector< double, 3 > > stats( window );
+	BOOST_CHECK_EQUAL( stats.size(), 0u );
+
+	for ( std::size_t k = 0; k < 20 * window + 7; k++ )
+	{
+		// a drifting signal far from the origin
+		values.push_back( Vector< double, 3 >( 1e6 + 0.01 * k, -1e5, 3 ) + randNoise() * ( 1 + 0.5 * std::sin( 0.01 * k ) ) );
+		stats.push( values.back() );
+
+		const std::size_t begin = values.size() > window ? values.size() - window : 0;
+		BOOST_CHECK_EQUAL( stats.size(), values.size() - begin );
+		BOOST_CHECK_EQUAL( stats.full(), values.size() >= window );
+
+		Vector< double, 3 > mean;
+		Matrix< double, 3, 3 > cov;
+		windowReference( values, begin, values.size(), mean, cov );
+		BOOST_CHECK_SMALL( static_cast< double >( norm_2( stats.mean() - mean ) ), 1e-7 );
+		const Matrix< double, 3, 3 > covStats( stats.covariance() );
+		for ( std::size_t i = 0; i < 3; i++ )
+			for ( std::size_t j = 0; j < 3; j++ )
+				BOOST_CHECK_SMALL( covStats( i, j ) - cov( i, j ), 1e-6 );
+	}
+
+	stats.clear();
+	BOOST_CHECK_EQUAL( stats.size(), 0u );
+	typedef Stochastic::SlidingWindowStatistics< Vector< double, 3 > > Window;
+	BOOST_CHECK_THROW( Window( 0 ), Ubitrack::Util::Exception );
+}
+
+double rotationDistance( const Quaternion& a, const Quaternion& b )
+{
+	const double d = a.x() * b.x() + a.y() * b.y() + a.z() * b.z() + a.w() * b.w();
+	return std::sqrt( std::max( 0.0, 2 - 2 * std::fabs( d ) ) );
+}
+
+/** rotations and poses with random quaternion signs average to the true value */
+void testRotations()
+{
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Normal randAxis( 0, 1 );
+	Random::Vector< double, 3 >::Normal randTranslation( 0, 0.01 );
+
+	const Quaternion center( randQuat() );
+	const Vector< double, 3 > position( 1, 2, 3 );
+	Stochastic::SlidingWindowStatistics< Quaternion > rotations( 100 );
+	Stochastic::TimeWindowStatistics< Pose > poses( 1000000000ULL, 200 );
+	Stochastic::ExponentialStatistics< Quaternion > exponential( 0.05 );
+	for ( std::size_t k = 0; k < 500; k++ )
+	{
+		const Quaternion q( center * Quaternion( randAxis(), Random::distribute_uniform< double >( -0.05, 0.05 ) ) );
+		const Quaternion flipped( Random::distribute_uniform< double >( 0, 1 ) < 0.5 ? q : Quaternion( -q.x(), -q.y(), -q.z(), -q.w() ) );
+		rotations.push( flipped );
+		exponential.push( flipped );
+		poses.pushMeasurement( Measurement::Pose( k * 10000000ULL, Pose( flipped, position + randTranslation() ) ) );
+	}
+
+	BOOST_CHECK_SMALL( rotationDistance( rotations.mean(), center ), 1e-2 );
+	BOOST_CHECK_SMALL( rotationDistance( exponential.mean(), center ), 2e-2 );
+	BOOST_CHECK_EQUAL( poses.size(), 100u );
+	BOOST_CHECK_SMALL( rotationDistance( poses.mean().rotation(), center ), 1e-2 );
+	BOOST_CHECK_SMALL( static_cast< double >( norm_2( poses.mean().translation() - position ) ), 5e-3 );
+
+	// the spread of the flipped quaternions is that of the small rotations, not of the signs
+	const Matrix< double, 4, 4 > cov( rotations.covariance() );
+	for ( std::size_t i = 0; i < 4; i++ )
+		BOOST_CHECK( cov( i, i ) < 1e-3 );
+	const Matrix< double, 7, 7 > poseCov( poses.covariance() );
+	BOOST_CHECK_CLOSE( poseCov( 0, 0 ), 1e-4, 30.0 );
+}
+
+/** the time window evicts by timestamp and reports intervals and jitter */
+void testTimeWindow()
+{
+	const Measurement::Timestamp duration = 100000000ULL;
+	Stochastic::TimeWindowStatistics< Vector< double, 3 > > stats( duration, 64 );
+	std::vector< Measurement::Timestamp > times;
+	std::vector< Vector< double, 3 > > values;
+	Random::Vector< double, 3 >::Normal randValue( 0, 1 );
+
+	Measurement::Timestamp t = 5000000000ULL;
+	for ( std::size_t k = 0; k < 400; k++ )
+	{
+		// 100 Hz with jitter, and a dropout of 150ms
+		t += k == 200 ? 150000000ULL : 10000000ULL + static_cast< Measurement::Timestamp >( Random::distribute_uniform< double >( 0, 2000000 ) );
+		times.push_back( t );
+		values.push_back( randValue() );
+		stats.pushMeasurement( Measurement::Position( t, values.back() ) );
+
+		std::size_t begin = times.size() - 1;
+		while ( begin > 0 && times[ begin - 1 ] + duration > t )
+			begin--;
+		BOOST_REQUIRE_EQUAL( stats.size(), times.size() - begin );
+
+		Vector< double, 3 > mean;
+		Matrix< double, 3, 3 > cov;
+		windowReference( values, begin, values.size(), mean, cov );
+		BOOST_CHECK_SMALL( static_cast< double >( norm_2( stats.mean() - mean ) ), 1e-9 );
+
+		if ( stats.size() >= 2 )
+		{
+			double sum = 0;
+			double sum2 = 0;
+			for ( std::size_t i = begin + 1; i < times.size(); i++ )
+			{
+				const double interval = static_cast< double >( times[ i ] - times[ i - 1 ] );
+				sum += interval;
+				sum2 += interval * interval;
+			}
+			const double n = static_cast< double >( times.size() - begin - 1 );
+			BOOST_CHECK_CLOSE( stats.meanInterval(), sum / n, 1e-9 );
+			BOOST_CHECK_SMALL( stats.jitter() - std::sqrt( std::max( 0.0, sum2 / n - ( sum / n ) * ( sum / n ) ) ), 1e-2 );
+		}
+		else
+			BOOST_CHECK_EQUAL( stats.rate(), 0.0 );
+	}
+	BOOST_CHECK_CLOSE( stats.rate(), 1e9 / 11000000.0, 5.0 );
+
+	// more samples than the buffer within the time span
+	Stochastic::TimeWindowStatistics< Vector< double, 3 > > small( duration, 4 );
+	for ( std::size_t k = 0; k < 10; k++ )
+		small.push( 1000 + k, values[ k ] );
+	BOOST_CHECK_EQUAL( small.size(), 4u );
+
+	// a burst of samples with the same timestamp
+	Stochastic::TimeWindowStatistics< Vector< double, 3 > > burst( duration, 8 );
+	for ( std::size_t k = 0; k < 3; k++ )
+		burst.push( 1000, values[ k ] );
+	BOOST_CHECK_EQUAL( burst.meanInterval(), 0.0 );
+	BOOST_CHECK_EQUAL( burst.rate(), 0.0 );
+}
+
+/** exponential weighting of constant and of random samples */
+void testExponential()
+{
+	Stochastic::ExponentialStatistics< Vector< double, 2 > > last( 1 );
+	last.push( Vector< double, 2 >( 1, 2 ) );
+	last.push( Vector< double, 2 >( 3, 4 ) );
+	BOOST_CHECK_SMALL( static_cast< double >( norm_2( last.mean() - Vector< double, 2 >( 3, 4 ) ) ), 1e-12 );
+	BOOST_CHECK_EQUAL( last.count(), 2u );
+
+	Stochastic::ExponentialStatistics< Vector< double, 2 > > stats( 0.001 );
+	Random::Vector< double, 2 >::Normal randValue( 0, 2 );
+	for ( std::size_t k = 0; k < 20000; k++ )
+		stats.push( 1000000ULL * k, Vector< double, 2 >( 10, -5 ) + randValue() );
+	BOOST_CHECK_SMALL( static_cast< double >( norm_2( stats.mean() - Vector< double, 2 >( 10, -5 ) ) ), 0.3 );
+	BOOST_CHECK_CLOSE( stats.covariance()( 0, 0 ), 4.0, 20.0 );
+	BOOST_CHECK_SMALL( stats.covariance()( 0, 1 ), 0.5 );
+	BOOST_CHECK_CLOSE( stats.meanInterval(), 1e6, 1e-6 );
+	BOOST_CHECK_SMALL( stats.jitter(), 1e-3 );
+
+	typedef Stochastic::ExponentialStatistics< Vector< double, 2 > > Exponential;
+	BOOST_CHECK_THROW( Exponential( 0 ), Ubitrack::Util::Exception );
+}
+
+/** logs the time per pose sample of the sliding window against recomputing the window */
+void benchmark( const std::size_t window )
+{
+	const std::size_t n = 200000;
+	Random::Quaternion< double >::Uniform randQuat;
+	Random::Vector< double, 3 >::Normal randTranslation( 0, 1 );
+	std::vector< Pose > poses;
+	for ( std::size_t k = 0; k < n; k++ )
+		poses.push_back( Pose( randQuat(), randTranslation() ) );
+
+	Stochastic::SlidingWindowStatistics< Pose > stats( window );
+	Measurement::Timestamp start = Measurement::readClock( Measurement::clockMonotonic );
+	double sink = 0;
+	for ( std::size_t k = 0; k < n; k++ )
+	{
+		stats.push( poses[ k ] );
+		sink += stats.mean().translation()( 0 );
+	}
+	const double tStreaming = static_cast< double >( Measurement::readClock( Measurement::clockMonotonic ) - start ) / n;
+
+	// naive recomputation of the mean translation of the window for every sample
+	start = Measurement::readClock( Measurement::clockMonotonic );
+	double naiveSink = 0;
+	for ( std::size_t k = 0; k < n; k++ )
+	{
+		const std::size_t begin = k + 1 > window ? k + 1 - window : 0;
+		Vector< double, 3 > sum( Vector< double, 3 >::zeros() );
+		for ( std::size_t i = begin; i <= k; i++ )
+			sum += poses[ i ].translation();
+		naiveSink += sum( 0 ) / ( k + 1 - begin );
+	}
+	const double tNaive = static_cast< double >( Measurement::readClock( Measurement::clockMonotonic ) - start ) / n;
+	BOOST_CHECK_SMALL( sink - naiveSink, 1e-6 * n );
+
+	LOG4CPP_INFO( timeLogger, "window of " << window << " poses: sliding window update and mean " << tStreaming
+		<< " ns per sample, recomputed mean translation " << tNaive << " ns per sample" );
+}
+
+} // anonymous namespace
+
+
+void TestStreamingStatistics()
+{
+	testSlidingWindow();
+	testRotations();
+	testTimeWindow();
+	testExponential();
+	benchmark( 30 );
+	benchmark( 1000 );
+}
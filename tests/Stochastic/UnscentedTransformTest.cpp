@@ -0,0 +1,342 @@
+
+#include <utMath/Stochastic/UnscentedTransform.h>
+#include <utMath/Stochastic/CovarianceTransform.h>
+#include <utMath/Random/Scalar.h>
+#include <utMath/Random/Vector.h>
+#include <utMath/Random/Rotation.h>
+#include <utAlgorithm/Function/MultiplePointProjection.h>
+#include <utAlgorithm/Function/ProjectivePoseNormalize.h>
+#include <utMeasurement/Measurement.h>
+#include <utMeasurement/Clock.h>
+#include <utUtil/ThreadPool.h>
+
+#include <cmath>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <log4cpp/Category.hh>
+static log4cpp::Category& timeLogger( log4cpp::Category::getInstance( "Ubitrack.Test.Stochastic.UnscentedTransform" ) );
+
+using namespace Ubitrack;
+using namespace Ubitrack::Math;
+
+namespace ublas = boost::numeric::ublas;
+
+namespace {
+
+/** y = A * x + b */
+class AffineFunction
+{
+public:
+	AffineFunction( const Matrix< double >& a, const Vector< double >& b )
+		: m_a( a )
+		, m_b( b )
+	{}
+
+	std::size_t size() const
+	{ return m_b.size(); }
+
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& input ) const
+	{ result = ublas::prod( m_a, input ) + m_b; }
+
+	template< class VT1, class VT2, class MT >
+	void evaluateWithJacobian( VT1& result, const VT2& input, MT& j ) const
+	{
+		evaluate( result, input );
+		j = m_a;
+	}
+
+protected:
+	Matrix< double > m_a;
+	Vector< double > m_b;
+};
+
+/** polar to cartesian coordinates */
+class PolarToCartesian
+{
+public:
+	std::size_t size() const
+	{ return 2; }
+
+	template< class VT1, class VT2 >
+	void evaluate( VT1& result, const VT2& input ) const
+	{
+		result( 0 ) = input( 0 ) * std::cos( input( 1 ) );
+		result( 1 ) = input( 0 ) * std::sin( input( 1 ) );
+	}
+};
+
+Matrix< double > randomCovariance( const std::size_t n )
+{
+	Matrix< double > a( n, n );
+	for ( std::size_t i = 0; i < n; i++ )
+		for ( std::size_t j = 0; j < n; j++ )
+			a( i, j ) = Random::distribute_uniform< double >( -1, 1 );
+	Matrix< double > cov( ublas::prod( a, ublas::trans( a ) ) );
+	for ( std::size_t i = 0; i < n; i++ )
+		cov( i, i ) += 0.1;
+	return cov;
+}
+
+void testAffine()
+{
+	const std::size_t n = 4;
+	Matrix< double > a( 3, n );
+	Vector< double > b( 3 );
+	for ( std::size_t i = 0; i < 3; i++ )
+	{
+		b( i ) = Random::distribute_uniform< double >( -5, 5 );
+		for ( std::size_t j = 0; j < n; j++ )
+			a( i, j ) = Random::distribute_uniform< double >( -2, 2 );
+	}
+	const AffineFunction f( a, b );
+
+	Vector< double > mean( n );
+	for ( std::size_t i = 0; i < n; i++ )
+		mean( i ) = Random::distribute_uniform< double >( -1, 1 );
+	const Matrix< double > cov( randomCovariance( n ) );
+
+	// the linear propagation is exact for an affine function
+	Vector< double > refMean( 3 );
+	Matrix< double > refCov( 3, 3 );
+	Stochastic::transformWithCovariance( f, refMean, refCov, mean, cov );
+
+	Ubitrack::Util::ThreadPool pool( 2 );
+	for ( int iRun = 0; iRun < 3; iRun++ )
+	{
+		Stochastic::UnscentedTransformOptions options;
+		if ( iRun == 1 )
+		{
+			options.alpha = 0.5;
+			options.beta = 2;
+			options.kappa = 1;
+		}
+		options.pThreadPool = iRun == 2 ? &pool : 0;
+
+		Vector< double > utMean;
+		Matrix< double > utCov;
+		Stochastic::unscentedTransform( f, utMean, utCov, mean, cov, options );
+
+		BOOST_CHECK_SMALL( ublas::norm_inf( utMean - refMean ), 1e-10 );
+		// the weight of the mean point contributes ( 1 - alpha^2 + beta ) * 0 for an affine function
+		BOOST_CHECK_SMALL( double( ublas::norm_inf( utCov - refCov ) ), 1e-10 );
+	}
+
+	// no sigma points for an indefinite covariance
+	Matrix< double > indefinite( cov );
+	indefinite( 0, 0 ) = -1;
+	Vector< double > utMean;
+	Matrix< double > utCov;
+	BOOST_CHECK_THROW( Stochastic::unscentedTransform( f, utMean, utCov, mean, indefinite ), Ubitrack::Util::Exception );
+}
+
+void testPolar()
+{
+	// range 10 with 10% noise, bearing with 0.3 rad
+	Vector< double > mean( 2 );
+	mean( 0 ) = 10; mean( 1 ) = 0.5;
+	Matrix< double > cov( ublas::zero_matrix< double >( 2, 2 ) );
+	cov( 0, 0 ) = 1; cov( 1, 1 ) = 0.09;
+
+	// exact moments: E[cos] = exp( -s^2 / 2 ) * cos( mu )
+	const double s2 = cov( 1, 1 );
+	Vector< double > exact( 2 );
+	exact( 0 ) = mean( 0 ) * std::exp( -s2 / 2 ) * std::cos( mean( 1 ) );
+	exact( 1 ) = mean( 0 ) * std::exp( -s2 / 2 ) * std::sin( mean( 1 ) );
+
+	Stochastic::UnscentedTransformOptions options;
+	options.alpha = 1;
+	options.beta = 2;
+	options.kappa = 1;
+	Vector< double > utMean;
+	Matrix< double > utCov;
+	Stochastic::unscentedTransform( PolarToCartesian(), utMean, utCov, mean, cov, options );
+
+	// the first order mean ignores the curvature, the unscented mean moves towards the exact one
+	Vector< double > linearMean( 2 );
+	PolarToCartesian().evaluate( linearMean, mean );
+	BOOST_CHECK_LT( ublas::norm_2( utMean - exact ), 0.1 * ublas::norm_2( linearMean - exact ) );
+
+	// the same result in parallel
+	Ubitrack::Util::ThreadPool pool( 3 );
+	options.pThreadPool = &pool;
+	Vector< double > poolMean;
+	Matrix< double > poolCov;
+	Stochastic::unscentedTransform( PolarToCartesian(), poolMean, poolCov, mean, cov, options );
+	BOOST_CHECK_SMALL( ublas::norm_inf( poolMean - utMean ), 1e-12 );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( poolCov - utCov ) ), 1e-12 );
+}
+
+#ifdef HAVE_LAPACK
+
+typedef Algorithm::Function::MultiplePointProjection< double > Projection;
+typedef Algorithm::Function::ProjectivePoseNormalize PoseNormalize;
+
+/** camera looking at random points in front of it and an initial guess close to the true pose */
+void createPoseProblem( const std::size_t nPoints, std::vector< Vector< double, 3 > >& p3D, Matrix< double, 3, 3 >& K,
+	std::vector< Vector< double, 2 > >& measurements, Pose& pose, Pose& initial )
+{
+	K = Matrix< double, 3, 3 >::identity();
+	K( 0, 0 ) = 500; K( 1, 1 ) = 500;
+	K( 0, 2 ) = -320; K( 1, 2 ) = -240; K( 2, 2 ) = -1;
+
+	Random::Quaternion< double >::Uniform randQuat;
+	pose = Pose( randQuat(), Vector< double, 3 >( 0.1, -0.2, -5 ) );
+	initial = Pose( Quaternion::fromLogarithm( Vector< double, 3 >( 0.02, -0.03, 0.01 ) ) * pose.rotation(),
+		pose.translation() + Vector< double, 3 >( 0.05, 0.02, -0.1 ) );
+
+	Random::Vector< double, 3 >::Uniform randPoint( -1, 1 );
+	p3D.clear();
+	for ( std::size_t i = 0; i < nPoints; i++ )
+		p3D.push_back( randPoint() );
+
+	Projection projection( p3D, K );
+	Vector< double, 7 > params;
+	pose.toVector( params );
+	Vector< double > projected( 2 * nPoints );
+	projection.evaluate( projected, params );
+	measurements.resize( nPoints );
+	for ( std::size_t i = 0; i < nPoints; i++ )
+		measurements[ i ] = Vector< double, 2 >( projected( 2 * i ), projected( 2 * i + 1 ) );
+}
+
+/** the same error representation as the unscented transform of poses */
+Vector< double, 6 > poseError( const Pose& p, const Pose& ref )
+{
+	Vector< double, 6 > e;
+	ublas::subrange( e, 0, 3 ) = p.translation() - ref.translation();
+	Quaternion qDiff( ref.rotation() * ~p.rotation() );
+	if ( qDiff.w() < 0 )
+		qDiff = -qDiff;
+	e( 3 ) = qDiff.x(); e( 4 ) = qDiff.y(); e( 5 ) = qDiff.z();
+	return e;
+}
+
+void testPose()
+{
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	std::vector< Vector< double, 2 > > measurements;
+	Pose pose, initial;
+	createPoseProblem( 12, p3D, K, measurements, pose, initial );
+	Projection projection( p3D, K );
+	const double variance = 0.5;
+
+	const Matrix< double, 6, 6 > cov( Stochastic::unscentedTransformPose( measurements, variance, projection, initial,
+		PoseNormalize() ) );
+
+	// the thread pool gives the same result
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Stochastic::UnscentedTransformOptions options;
+	options.pThreadPool = &pool;
+	const Matrix< double, 6, 6 > poolCov( Stochastic::unscentedTransformPose( measurements, variance, projection, initial,
+		PoseNormalize(), options ) );
+	BOOST_CHECK_SMALL( double( ublas::norm_inf( poolCov - cov ) ), 1e-12 * ublas::norm_inf( cov ) );
+
+	// compare to a monte carlo simulation
+	Vector< double > y( 2 * measurements.size() );
+	for ( std::size_t i = 0; i < measurements.size(); i++ )
+	{
+		y( 2 * i ) = measurements[ i ]( 0 );
+		y( 2 * i + 1 ) = measurements[ i ]( 1 );
+	}
+	Vector< double, 7 > truth;
+	pose.toVector( truth );
+	const Stochastic::LeastSquaresSolution< Projection, double, PoseNormalize > solver( projection,
+		Vector< double >( truth ), Optimization::OptTerminate( 200, 1e-6 ) );
+
+	const std::size_t nSamples = 1000;
+	Matrix< double, 6, 6 > mcCov( Matrix< double, 6, 6 >::zeros() );
+	for ( std::size_t k = 0; k < nSamples; k++ )
+	{
+		Vector< double > noisy( y );
+		for ( std::size_t i = 0; i < noisy.size(); i++ )
+			noisy( i ) += Random::distribute_normal< double >( 0, std::sqrt( variance ) );
+		Vector< double > params( 7 );
+		solver.evaluate( params, noisy );
+		const Vector< double, 6 > e( poseError( Pose::fromVector( params ), pose ) );
+		mcCov += ublas::outer_prod( e, e );
+	}
+	mcCov /= double( nSamples );
+
+	double traceUt = 0, traceMc = 0;
+	for ( std::size_t i = 0; i < 6; i++ )
+	{
+		traceUt += cov( i, i );
+		traceMc += mcCov( i, i );
+	}
+	BOOST_CHECK_CLOSE( traceUt, traceMc, 20.0 );
+}
+
+void benchmarkPose( const std::size_t nPoints, const int nRuns )
+{
+	std::vector< Vector< double, 3 > > p3D;
+	Matrix< double, 3, 3 > K;
+	std::vector< Vector< double, 2 > > measurements;
+	Pose pose, initial;
+	createPoseProblem( nPoints, p3D, K, measurements, pose, initial );
+	Projection projection( p3D, K );
+	const double variance = 0.25;
+
+	// sigma points solved from the initial guess instead of the nominal solution
+	Vector< double > y( 2 * nPoints );
+	for ( std::size_t i = 0; i < nPoints; i++ )
+	{
+		y( 2 * i ) = measurements[ i ]( 0 );
+		y( 2 * i + 1 ) = measurements[ i ]( 1 );
+	}
+	Vector< double > cold( 7 );
+	initial.toVector( cold );
+	const Stochastic::LeastSquaresSolution< Projection, double, PoseNormalize > coldSolver( projection,
+		cold, Optimization::OptTerminate( 200, 1e-6 ) );
+	std::vector< Vector< double > > points;
+	std::vector< double > meanWeights, covWeights;
+	Stochastic::unscentedSigmaPoints( y, Matrix< double >( ublas::identity_matrix< double >( y.size() ) * variance ),
+		Stochastic::UnscentedTransformOptions(), points, meanWeights, covWeights );
+
+	Ubitrack::Util::ThreadPool pool( 4 );
+	Stochastic::UnscentedTransformOptions options;
+	Measurement::Timestamp tCold = 0, tWarm = 0, tPool = 0;
+	for ( int run = 0; run < nRuns; run++ )
+	{
+		Measurement::Timestamp t0 = Measurement::readClock( Measurement::clockMonotonic );
+		std::vector< Vector< double > > results;
+		Stochastic::unscentedEvaluate( coldSolver, points, results );
+		Measurement::Timestamp t1 = Measurement::readClock( Measurement::clockMonotonic );
+		options.pThreadPool = 0;
+		Stochastic::unscentedTransformPose( measurements, variance, projection, initial, PoseNormalize(), options );
+		Measurement::Timestamp t2 = Measurement::readClock( Measurement::clockMonotonic );
+		options.pThreadPool = &pool;
+		Stochastic::unscentedTransformPose( measurements, variance, projection, initial, PoseNormalize(), options );
+		Measurement::Timestamp t3 = Measurement::readClock( Measurement::clockMonotonic );
+		tCold += t1 - t0;
+		tWarm += t2 - t1;
+		tPool += t3 - t2;
+	}
+
+	LOG4CPP_INFO( timeLogger, "Unscented pose transform, " << nPoints << " points, " << 4 * nPoints + 1 << " sigma points: cold start "
+		<< tCold * 1e-6 / nRuns << "ms, warm start " << tWarm * 1e-6 / nRuns << "ms, warm start with "
+		<< pool.size() << " threads " << tPool * 1e-6 / nRuns << "ms" );
+}
+
+#endif // HAVE_LAPACK
+
+} // anonymous namespace
+
+
+void TestUnscentedTransform()
+{
+	for ( int i = 0; i < 10; i++ )
+		testAffine();
+	testPolar();
+
+	#ifdef HAVE_LAPACK
+	for ( int i = 0; i < 5; i++ )
+		testPose();
+	benchmarkPose( 10, 20 );
+	benchmarkPose( 30, 10 );
+	#endif
+}
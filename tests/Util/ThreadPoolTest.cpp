@@ -0,0 +1,58 @@
+#include <utUtil/ThreadPool.h>
+#include <utUtil/Exception.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+
+/** marks the iterations of a parallel loop, throws at one index */
+struct MarkIteration
+{
+	MarkIteration( std::vector< int >& marks, const std::size_t throwAt )
+		: m_marks( marks )
+		, m_throwAt( throwAt )
+	{}
+
+	void operator()( std::size_t i )
+	{
+		m_marks[ i ]++;
+		if ( i == m_throwAt )
+			UBITRACK_THROW( "iteration failed" );
+	}
+
+	std::vector< int >& m_marks;
+	const std::size_t m_throwAt;
+};
+
+} // anonymous namespace
+
+
+void TestThreadPool()
+{
+	Ubitrack::Util::ThreadPool pool( 4 );
+	BOOST_CHECK_EQUAL( pool.size(), std::size_t( 4 ) );
+
+	for ( std::size_t run = 0; run < 10; run++ )
+	{
+		std::vector< int > marks( 1000, 0 );
+		MarkIteration f( marks, marks.size() );
+		pool.parallelFor( marks.size(), f );
+		BOOST_CHECK( std::count( marks.begin(), marks.end(), 1 ) == 1000 );
+	}
+
+	// all iterations are executed, the exception is passed to the caller
+	std::vector< int > marks( 100, 0 );
+	MarkIteration f( marks, 17 );
+	BOOST_CHECK_THROW( pool.parallelFor( marks.size(), f ), Ubitrack::Util::Exception );
+	BOOST_CHECK( std::count( marks.begin(), marks.end(), 1 ) == 100 );
+
+	// a pool of size 1 starts no thread but runs all iterations
+	Ubitrack::Util::ThreadPool single( 1 );
+	std::vector< int > singleMarks( 10, 0 );
+	MarkIteration g( singleMarks, singleMarks.size() );
+	single.parallelFor( singleMarks.size(), g );
+	BOOST_CHECK( std::count( singleMarks.begin(), singleMarks.end(), 1 ) == 10 );
+}
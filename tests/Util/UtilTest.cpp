@@ -0,0 +1,12 @@
+#include "UtilTest.h"
+
+// declare external tests here, to save us some trivial header files
+void TestThreadPool();
+
+
+
+UtilTest::UtilTest()
+	: boost::unit_test::test_suite( "UtilTests" )
+{
+	add( BOOST_TEST_CASE( &TestThreadPool ) );
+}
@@ -6,6 +6,8 @@
 #include "Geometry/GeometryTest.h"
 #include "Stochastic/StochasticTest.h"
 #include "Algorithm/AlgorithmTest.h"
+#include "Measurement/MeasurementTest.h"
+#include "Util/UtilTest.h"
 #include "Serializer/SerializerTest.h"
 
 using boost::unit_test::test_suite;
@@ -27,6 +29,8 @@ test_suite* init_unit_test_suite( int, char* [] )
 	allTests->add( new GeometryTest );
 	allTests->add( new StochasticTest );
 	allTests->add( new AlgorithmTest );
+	allTests->add( new MeasurementTest );
+	allTests->add( new UtilTest );
 	allTests->add( new SerializerTest );
 
 	return allTests;